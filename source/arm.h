@@ -390,6 +390,9 @@ struct State {
     } cp15;
 
     uint64_t cycle_count;
+
+    // Number of retired instructions. Equal to cycle_count unless cycle accounting is enabled
+    uint64_t instruction_count;
 };
 static_assert(std::is_pod<State>::value, "State is not a POD type");
 
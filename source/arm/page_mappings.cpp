@@ -0,0 +1,32 @@
+#include "page_mappings.hpp"
+
+#include <iterator>
+
+namespace Interpreter {
+
+void PageMappings::Insert(uint32_t vstart, uint32_t pstart, uint32_t size) {
+    mappings[vstart] = Mapping { pstart, size };
+}
+
+void PageMappings::Remove(uint32_t vstart, uint32_t size) {
+    const uint64_t vend = uint64_t { vstart } + size;
+    auto it = mappings.upper_bound(vstart);
+    if (it != mappings.begin() && std::prev(it)->first + uint64_t { std::prev(it)->second.size } > vstart) {
+        --it;
+    }
+    while (it != mappings.end() && it->first < vend) {
+        const uint32_t mapping_vstart = it->first;
+        const Mapping mapping = it->second;
+        it = mappings.erase(it);
+
+        if (mapping_vstart < vstart) {
+            mappings.emplace(mapping_vstart, Mapping { mapping.pstart, vstart - mapping_vstart });
+        }
+        if (mapping_vstart + uint64_t { mapping.size } > vend) {
+            const uint32_t offset = static_cast<uint32_t>(vend - mapping_vstart);
+            mappings.emplace(static_cast<uint32_t>(vend), Mapping { mapping.pstart + offset, mapping.size - offset });
+        }
+    }
+}
+
+} // namespace Interpreter
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+namespace Interpreter {
+
+/**
+ * Mapped virtual memory ranges of a PageTable, indexed by their starting
+ * virtual address. Used to find the virtual pages mapped to a given physical
+ * page.
+ * Typically, each 3DS process only has a few dozen of these ranges, so a
+ * linear search is faster than maintaining a reverse map for every page.
+ */
+class PageMappings {
+public:
+    struct Mapping {
+        uint32_t pstart;
+        uint32_t size;
+    };
+
+    /**
+     * Records the given virtual memory range, replacing any range starting
+     * at the same address
+     * @pre vstart and pstart are page-aligned
+     */
+    void Insert(uint32_t vstart, uint32_t pstart, uint32_t size);
+
+    /**
+     * Removes the given virtual memory range, trimming or splitting any
+     * ranges that overlap with it
+     */
+    void Remove(uint32_t vstart, uint32_t size);
+
+    /**
+     * Invokes callback with each virtual address that the page at the given
+     * physical address is mapped to
+     */
+    template<typename Callback>
+    void ForEachVirtualAddressOf(uint32_t paddr, Callback&& callback) const {
+        paddr &= ~0xfffu;
+        for (auto& [vstart, mapping] : mappings) {
+            if (paddr >= mapping.pstart && paddr - mapping.pstart < mapping.size) {
+                callback(vstart + (paddr - mapping.pstart));
+            }
+        }
+    }
+
+    const std::map</*VAddr*/ uint32_t, Mapping>& GetMappings() const {
+        return mappings;
+    }
+
+private:
+    std::map</*VAddr*/ uint32_t, Mapping> mappings;
+};
+
+} // namespace Interpreter
@@ -2,6 +2,8 @@
 
 #include <range/v3/algorithm/fill.hpp>
 
+#include <algorithm>
+
 namespace Interpreter {
 
 PageTable::PageTable() noexcept {
@@ -9,16 +11,29 @@ PageTable::PageTable() noexcept {
 }
 
 void PageTable::Insert(Memory::PhysicalMemory& mem, uint32_t vstart, uint32_t pstart, uint32_t size) {
-    auto first_page_index = (vstart >> 12);
-    auto last_page_index = ((vstart + size - 1) >> 12); // Inclusive
-    for (auto page_offset = 0; page_offset <= last_page_index - first_page_index; ++page_offset) {
-        const auto physical_address = pstart + page_offset * 0x1000;
-        physical_addresses[first_page_index + page_offset] = physical_address;
-        virtual_addresses_for[physical_address >> 12].push_back((first_page_index + page_offset) << 12);
-        if (auto memory = Memory::LookupMemoryBackedPage(mem, physical_address)) {
-            host_memory[first_page_index + page_offset] = memory;
+    const uint32_t first_page_index = (vstart >> 12);
+    const uint32_t num_mapped_pages = ((vstart + size - 1) >> 12) - first_page_index + 1;
+
+    // Update the page table in runs of pages that share the same memory bus
+    for (uint32_t page_offset = 0; page_offset < num_mapped_pages;) {
+        const uint32_t physical_address = pstart + page_offset * 0x1000;
+        auto run = Memory::LookupMemoryBackedPages(mem, physical_address, (num_mapped_pages - page_offset) * 0x1000);
+        const uint32_t run_pages = std::max<uint32_t>(1, run.num_bytes >> 12);
+
+        auto page_index = first_page_index + page_offset;
+        for (uint32_t run_offset = 0; run_offset < run_pages; ++run_offset) {
+            physical_addresses[page_index + run_offset] = physical_address + run_offset * 0x1000;
+        }
+        if (run.data) {
+            for (uint32_t run_offset = 0; run_offset < run_pages; ++run_offset) {
+                host_memory[page_index + run_offset] = { run.data + run_offset * 0x1000 };
+            }
         }
+
+        page_offset += run_pages;
     }
+
+    mappings.Insert(vstart & ~0xfffu, pstart, num_mapped_pages * 0x1000);
 }
 
 void PageTable::Remove(uint32_t vstart, uint32_t size) {
@@ -27,16 +42,10 @@ void PageTable::Remove(uint32_t vstart, uint32_t size) {
     {
         auto begin_it = &physical_addresses[vstart >> 12];
         auto end_it = &physical_addresses[(vstart + size) >> 12];
-        std::transform(begin_it, end_it, begin_it,
-                       [=](auto paddr) {
-                           if (paddr == 0xffffffff) {
-                               throw std::runtime_error("Couldn't find virtual memory mapping for removal");
-                           }
-
-                           virtual_addresses_for[paddr >> 12].clear();
-
-                           return 0xffffffff;
-                       });
+        if (std::find(begin_it, end_it, 0xffffffff) != end_it) {
+            throw std::runtime_error("Couldn't find virtual memory mapping for removal");
+        }
+        std::fill(begin_it, end_it, 0xffffffff);
     }
 
     // Remove host memory backed pages, if any
@@ -45,6 +54,9 @@ void PageTable::Remove(uint32_t vstart, uint32_t size) {
         auto end_it = &host_memory[(vstart + size) >> 12];
         std::fill(begin_it, end_it, Memory::HostMemoryBackedPage { nullptr });
     }
+
+    // Trim or split the affected virtual memory ranges
+    mappings.Remove(vstart, size);
 }
 
 ProcessorWithDefaultMemory::ProcessorWithDefaultMemory(Interpreter::Setup& setup)
@@ -85,24 +97,24 @@ void ProcessorWithDefaultMemory::OnVirtualMemoryUnmapped(uint32_t vaddr, uint32_
 }
 
 void ProcessorWithDefaultMemory::OnBackedByHostMemory(Memory::HostMemoryBackedPage page, uint32_t physical_address) {
-    for (auto& virtual_address : page_table.virtual_addresses_for[physical_address >> 12]) {
+    page_table.ForEachVirtualAddressOf(physical_address, [&](uint32_t virtual_address) {
         auto& page_table_entry = page_table.host_memory[virtual_address >> 12];
         if (page_table_entry) {
             // TODO: When creating new processes, we need to initialize page_table based on the current memory state
 //            throw std::runtime_error(fmt::format("Attempted to override page table cache entry at address {:#x} that already existed", physical_address));
         }
         page_table_entry = page;
-    }
+    });
 }
 
 void ProcessorWithDefaultMemory::OnUnbackedByHostMemory(uint32_t physical_address) {
-    for (auto& virtual_address : page_table.virtual_addresses_for[physical_address >> 12]) {
+    page_table.ForEachVirtualAddressOf(physical_address, [&](uint32_t virtual_address) {
         auto& page_table_entry = page_table.host_memory[virtual_address >> 12];
         if (!page_table_entry) {
             throw std::runtime_error("Attempted to remove page table cache entry that does not exist");
         }
         page_table_entry = { };
-    }
+    });
 }
 
 } // namespace Interpreter
@@ -1,8 +1,8 @@
 #pragma once
 
-#include <interpreter.h>
+#include "page_mappings.hpp"
 
-#include <boost/container/small_vector.hpp>
+#include <interpreter.h>
 
 namespace Interpreter {
 
@@ -26,6 +26,15 @@ struct PageTable {
         return host_memory[vaddr >> 12];
     }
 
+    /**
+     * Invokes callback with each virtual address that the page at the given
+     * physical address is mapped to
+     */
+    template<typename Callback>
+    void ForEachVirtualAddressOf(uint32_t paddr, Callback&& callback) const {
+        mappings.ForEachVirtualAddressOf(paddr, std::forward<Callback>(callback));
+    }
+
     static constexpr uint32_t num_pages = (1 << 20);
 
     // List mapping virtual memory page indexes to their corresponding physical memory page
@@ -35,11 +44,8 @@ struct PageTable {
     // List mapping virtual memory page indexes to their corresponding physical memory address
     std::array</*PAddr*/ uint32_t, num_pages> physical_addresses; // 0xffffffff signalizes an unmapped address
 
-    /**
-     * List mapping physical memory page indexes to a list of virtual memory addresses that are mapped to them
-     * Typically, for each 3DS process there are at most 2 (usually just 1) virtual pages that map to the same physical page
-     */
-    std::array<boost::container::small_vector</*VAddr*/ uint32_t, 2>, num_pages> virtual_addresses_for;
+    // Mapped virtual memory ranges, used to find the virtual pages mapped to a given physical page
+    PageMappings mappings;
 };
 
 class ProcessorWithDefaultMemory : public Processor, Memory::PhysicalMemorySubscriber {
@@ -65,6 +71,9 @@ protected:
     static void WriteVirtualMemory(Memory::PhysicalMemory& mem, const PageTable& page_table, uint32_t address, T value) {
         auto page = page_table.LookupHostMemory(address);
         if (page) {
+            if constexpr (Memory::enable_heatmap) {
+                mem.heatmap->Record(page_table.physical_addresses[address >> 12] + (address & 0xfff), Memory::AccessPath::Backed, true);
+            }
             Memory::Write(page, address & 0xfff, value);
             return;
         }
@@ -82,6 +91,9 @@ protected:
     static T ReadVirtualMemory(Memory::PhysicalMemory& mem, const PageTable& page_table, uint32_t address) {
         auto page = page_table.LookupHostMemory(address);
         if (page) {
+            if constexpr (Memory::enable_heatmap) {
+                mem.heatmap->Record(page_table.physical_addresses[address >> 12] + (address & 0xfff), Memory::AccessPath::Backed, false);
+            }
             return Memory::Read<T>(page, address & 0xfff);
         }
         // Else fall back to slow handler-based read
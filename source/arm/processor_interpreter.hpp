@@ -23,6 +23,14 @@ struct InterpreterExecutionContext : ExecutionContextWithDefaultMemory, CPUConte
         std::memcpy(&cpu, &state, sizeof(state));
     }
 
+    uint64_t GetCycleCount() const override {
+        return cpu.cycle_count;
+    }
+
+    uint64_t GetInstructionCount() const override {
+        return cpu.instruction_count;
+    }
+
     std::optional<uint32_t> TranslateVirtualAddress(uint32_t address) {
         return ExecutionContextWithDefaultMemory::TranslateVirtualAddress(address);
     }
@@ -0,0 +1,49 @@
+#include "metrics.hpp"
+
+#include <framework/metrics.hpp>
+
+#include <pistache/router.h>
+
+namespace Debugger {
+
+void MetricsService::RegisterReporter(Profiler::MetricsReporter& new_reporter) {
+    std::lock_guard guard(access_mutex);
+
+    reporter = &new_reporter;
+}
+
+void MetricsService::Shutdown() {
+    std::lock_guard guard(access_mutex);
+
+    reporter = nullptr;
+}
+
+using namespace Pistache;
+
+static void doMetrics(MetricsService& service, const Pistache::Rest::Request&, Pistache::Http::ResponseWriter response) {
+    std::lock_guard guard(service.access_mutex);
+
+    response.headers().add<Http::Header::AccessControlAllowOrigin>("*");
+    response.headers().add<Http::Header::ContentType>(Http::Mime::MediaType { Http::Mime::Type::Text, Http::Mime::Subtype::Plain });
+
+    if (!service.reporter) {
+        response.send(Http::Code::Service_Unavailable, "No emulation session running\n");
+        return;
+    }
+
+    response.send(Http::Code::Ok, service.reporter->Report("http"));
+}
+
+void MetricsService::RegisterRoutes(Pistache::Rest::Router& router) {
+    using namespace Rest;
+
+    Routes::Get(router, "/metrics",
+                [this](const auto& request, auto response) { doMetrics(*this, request, std::move(response)); return Route::Result::Ok; });
+}
+
+template<>
+std::unique_ptr<Service> CreateService<MetricsService>() {
+    return std::make_unique<MetricsService>();
+}
+
+} // namespace Debugger
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <debug_server.hpp>
+
+#include <mutex>
+
+namespace Profiler {
+class MetricsReporter;
+}
+
+namespace Debugger {
+
+struct MetricsService : Service {
+    Profiler::MetricsReporter* reporter = nullptr;
+    std::mutex access_mutex;
+
+    void RegisterReporter(Profiler::MetricsReporter&);
+    void Shutdown();
+
+    void RegisterRoutes(Pistache::Rest::Router&) override;
+};
+
+} // namespace Debugger
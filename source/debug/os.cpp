@@ -32,10 +32,17 @@ void OSService::UnregisterThread(HLE::OS::ProcessId pid, HLE::OS::ThreadId tid)
     processes[pid].threads.erase(tid);
 }
 
+void OSService::RegisterIPCStatistics(HLE::OS::IPCStatistics& statistics) {
+    std::lock_guard guard(access_mutex);
+
+    ipc_statistics = &statistics;
+}
+
 void OSService::Shutdown() {
     std::lock_guard guard(access_mutex);
 
     processes.clear();
+    ipc_statistics = nullptr;
 }
 
 using namespace Pistache;
@@ -84,7 +91,7 @@ static void doHandleTable(OSService& service, const Pistache::Rest::Request& req
 
     auto& process = *service.processes[pid].process;
     std::map<HOS::DebugHandle, std::shared_ptr<HOS::Object>, std::less<HOS::Handle>> sorted_handle_table;
-    ranges::copy(process.handle_table.table, ranges::inserter(sorted_handle_table, ranges::begin(sorted_handle_table)));
+    ranges::copy(process.handle_table.GetEntries(), ranges::inserter(sorted_handle_table, ranges::begin(sorted_handle_table)));
     for (auto& handle : sorted_handle_table) {
         body += fmt::format(R"({{ "id": {}, "name": "{}" }},)", handle.first.value, handle.second->GetName());
     }
@@ -135,6 +142,20 @@ static void doProcessThreadList(OSService& service, const Pistache::Rest::Reques
     response.send(Http::Code::Ok, body + "]");
 }
 
+static void doIPCStatistics(OSService& service, const Pistache::Rest::Request&, Pistache::Http::ResponseWriter response) {
+    std::lock_guard guard(service.access_mutex);
+
+    response.headers().add<Http::Header::AccessControlAllowOrigin>("*");
+    response.headers().add<Http::Header::ContentType>(Http::Mime::MediaType { Http::Mime::Type::Application, Http::Mime::Subtype::Json });
+
+    if (!service.ipc_statistics) {
+        response.send(Http::Code::Service_Unavailable, "[]");
+        return;
+    }
+
+    response.send(Http::Code::Ok, service.ipc_statistics->FormatJSON());
+}
+
 void OSService::RegisterRoutes(Pistache::Rest::Router& router) {
     using namespace Rest;
 
@@ -144,6 +165,8 @@ void OSService::RegisterRoutes(Pistache::Rest::Router& router) {
                 [this](const auto& request, auto response) { doHandleTable(*this, request, std::move(response)); return Route::Result::Ok; });
     Routes::Get(router, "/os/process/:pid/threads",
                 [this](const auto& request, auto response) { doProcessThreadList(*this, request, std::move(response)); return Route::Result::Ok; });
+    Routes::Get(router, "/os/ipc",
+                [this](const auto& request, auto response) { doIPCStatistics(*this, request, std::move(response)); return Route::Result::Ok; });
 //    Routes::Get(router, "/os/process/:pid/thread/:tid/registers",
 //                [this](const auto& request, auto response) { doProcessThreadList(*this, request, std::move(response)); return Route::Result::Ok; });
 
@@ -9,6 +9,7 @@ namespace HLE::OS {
 class OS;
 class Process;
 class Thread;
+class IPCStatistics;
 using ProcessId = uint32_t;
 using ThreadId = uint32_t;
 }
@@ -22,6 +23,7 @@ struct OSService : Service {
     };
 
     std::unordered_map<HLE::OS::ProcessId, ProcessContext> processes;
+    HLE::OS::IPCStatistics* ipc_statistics = nullptr;
     std::mutex access_mutex;
 
     void RegisterProcess(HLE::OS::ProcessId, HLE::OS::Process&);
@@ -30,6 +32,8 @@ struct OSService : Service {
     void RegisterThread(HLE::OS::ProcessId, HLE::OS::ThreadId, HLE::OS::Thread&);
     void UnregisterThread(HLE::OS::ProcessId, HLE::OS::ThreadId);
 
+    void RegisterIPCStatistics(HLE::OS::IPCStatistics&);
+
     void Shutdown();
 
     void RegisterRoutes(Pistache::Rest::Router&) override;
@@ -15,6 +15,7 @@ namespace Debugger {
 
 // Forward declare external services
 template<> std::unique_ptr<Service> CreateService<struct JitService>();
+template<> std::unique_ptr<Service> CreateService<struct MetricsService>();
 template<> std::unique_ptr<Service> CreateService<struct OSService>();
 template<> std::unique_ptr<Service> CreateService<struct GPUService>();
 
@@ -25,6 +26,7 @@ public:
     DebugServerImpl() {
         services.push_back(CreateService<GPUService>());
         services.push_back(CreateService<JitService>());
+        services.push_back(CreateService<MetricsService>());
         services.push_back(CreateService<OSService>());
     }
 
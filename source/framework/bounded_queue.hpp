@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace Mikage {
+
+/**
+ * Thread-safe FIFO queue with a fixed capacity, used to connect the stages
+ * of producer/consumer pipelines without unbounded memory growth.
+ *
+ * Push blocks while the queue is full, and Pop blocks while it's empty.
+ * After Close is called, Push fails and Pop drains the remaining elements
+ * before returning std::nullopt. Closing hence acts both as end-of-stream
+ * marker and as a way to unblock all stages when aborting due to errors.
+ */
+template<typename T>
+class BoundedQueue {
+    std::mutex access_mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<T> elements;
+    std::size_t capacity;
+    bool closed = false;
+
+public:
+    explicit BoundedQueue(std::size_t capacity) : capacity(capacity) {
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Returns false if the queue was closed before the element could be added
+    bool Push(T element) {
+        std::unique_lock lock(access_mutex);
+        not_full.wait(lock, [this] { return closed || elements.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        elements.push_back(std::move(element));
+        lock.unlock();
+        not_empty.notify_one();
+        return true;
+    }
+
+    // Returns std::nullopt once the queue is closed and all elements were popped
+    std::optional<T> Pop() {
+        std::unique_lock lock(access_mutex);
+        not_empty.wait(lock, [this] { return closed || !elements.empty(); });
+        if (elements.empty()) {
+            return std::nullopt;
+        }
+        std::optional<T> ret { std::move(elements.front()) };
+        elements.pop_front();
+        lock.unlock();
+        not_full.notify_one();
+        return ret;
+    }
+
+    void Close() {
+        {
+            std::lock_guard guard(access_mutex);
+            closed = true;
+        }
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+};
+
+} // namespace Mikage
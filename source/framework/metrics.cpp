@@ -0,0 +1,84 @@
+#include "metrics.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+
+namespace Profiler {
+
+MetricsReporter::MetricsReporter(const Profiler& profiler) : profiler(profiler), start_time(std::chrono::steady_clock::now()) {
+}
+
+void MetricsReporter::AddRate(std::string name, std::string_view counter) {
+    std::lock_guard lock(mutex);
+    rates.push_back({ std::move(name), std::string { counter } });
+}
+
+void MetricsReporter::AddRatio(std::string name, std::string_view numerator, std::string_view denominator) {
+    std::lock_guard lock(mutex);
+    ratios.push_back({ std::move(name), std::string { numerator }, std::string { denominator } });
+}
+
+static uint64_t LookupCounter(const std::vector<std::pair<std::string_view, uint64_t>>& counters, std::string_view name) {
+    auto it = std::find_if(counters.begin(), counters.end(), [=](auto& counter) { return counter.first == name; });
+    return (it != counters.end()) ? it->second : 0;
+}
+
+static void ReportActivity(std::string& out, const FrozenMetrics& metrics, const std::string& path) {
+    for (auto& sub_metrics : metrics.sub_metrics) {
+        auto sub_path = path.empty() ? std::string { sub_metrics.activity.GetName() } : path + "/" + std::string { sub_metrics.activity.GetName() };
+        out += fmt::format("mikage_host_time_seconds{{activity=\"{}\"}} {:.6f}\n", sub_path,
+                           std::chrono::duration<double>(sub_metrics.metric.total).count());
+        ReportActivity(out, sub_metrics, sub_path);
+    }
+}
+
+std::string MetricsReporter::Report(std::string_view consumer) {
+    std::lock_guard lock(mutex);
+
+    auto baseline_it = baselines.find(consumer);
+    if (baseline_it == baselines.end()) {
+        baseline_it = baselines.emplace(std::string { consumer }, Baseline { start_time, {} }).first;
+    }
+    auto& baseline = baseline_it->second;
+
+    const auto now = std::chrono::steady_clock::now();
+    const auto interval = std::chrono::duration<double>(now - baseline.time).count();
+    const auto activities = profiler.Freeze();
+    const auto counters = profiler.FreezeCounters();
+
+    auto delta = [&](std::string_view name) {
+        return LookupCounter(counters, name) - LookupCounter(baseline.counters, name);
+    };
+
+    std::string out;
+    out += fmt::format("mikage_uptime_seconds {:.6f}\n", std::chrono::duration<double>(activities.metric.total).count());
+
+    ReportActivity(out, activities, "");
+
+    for (auto& [name, total] : counters) {
+        out += fmt::format("mikage_counter_total{{counter=\"{}\"}} {}\n", name, total);
+        out += fmt::format("mikage_counter_rate{{counter=\"{}\"}} {:.3f}\n", name, interval > 0 ? delta(name) / interval : 0.0);
+    }
+
+    for (auto& rate : rates) {
+        out += fmt::format("mikage_rate{{rate=\"{}\"}} {:.3f}\n", rate.name, interval > 0 ? delta(rate.counter) / interval : 0.0);
+    }
+
+    for (auto& ratio : ratios) {
+        // Fall back to overall totals if nothing happened since the previous report
+        double numerator = delta(ratio.numerator);
+        double denominator = delta(ratio.denominator);
+        if (denominator == 0) {
+            numerator = LookupCounter(counters, ratio.numerator);
+            denominator = LookupCounter(counters, ratio.denominator);
+        }
+        out += fmt::format("mikage_ratio{{ratio=\"{}\"}} {:.4f}\n", ratio.name, denominator ? numerator / denominator : 0.0);
+    }
+
+    baseline.time = now;
+    baseline.counters = counters;
+    return out;
+}
+
+} // namespace Profiler
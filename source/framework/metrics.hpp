@@ -0,0 +1,66 @@
+#pragma once
+
+#include "profiler.hpp"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Profiler {
+
+/**
+ * Renders the activity times and counters of a Profiler as plain text in the
+ * Prometheus exposition format, e.g. for serving over HTTP or dumping to a file.
+ *
+ * Rates and ratios are computed over the interval since the previous report
+ * to the same consumer, so that e.g. the HTTP endpoint and the periodic file
+ * dump don't reset each other's baseline. Thread-safe.
+ */
+class MetricsReporter {
+    struct Rate {
+        std::string name;
+        std::string counter;
+    };
+
+    struct Ratio {
+        std::string name;
+        std::string numerator;
+        std::string denominator;
+    };
+
+    const Profiler& profiler;
+
+    std::mutex mutex;
+
+    std::vector<Rate> rates;
+    std::vector<Ratio> ratios;
+
+    // State at the time of the previous report to a given consumer
+    struct Baseline {
+        TimePoint time;
+        std::vector<std::pair<std::string_view, uint64_t>> counters;
+    };
+
+    const TimePoint start_time;
+    std::map<std::string, Baseline, std::less<>> baselines;
+
+public:
+    MetricsReporter(const Profiler&);
+
+    /// Registers a metric reporting the per-second increment of the given counter
+    void AddRate(std::string name, std::string_view counter);
+
+    /// Registers a metric reporting the ratio between the increments of the given counters
+    void AddRatio(std::string name, std::string_view numerator, std::string_view denominator);
+
+    /**
+     * Renders all metrics
+     * @param consumer Name of the consumer the report is generated for; rates are computed relative to its previous report
+     */
+    std::string Report(std::string_view consumer);
+};
+
+} // namespace Profiler
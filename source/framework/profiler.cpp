@@ -1,141 +1,413 @@
 #include "profiler.hpp"
 
 #include <algorithm>
+#include <array>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 namespace Profiler {
 
-constexpr auto skip_profiler = true;
+namespace detail {
+
+static uint64_t ToNanoseconds(TimePoint time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+static uint64_t TimePassed(uint64_t begin_ns, uint64_t end_ns) {
+    // If measurement begin is later than "end" (e.g. due to cross-thread
+    // access), assume the activity was interrupted before and hence no
+    // metrics were gathered.
+    return (end_ns > begin_ns) ? (end_ns - begin_ns) : 0;
+}
+
+/**
+ * Measurement storage for a single host thread.
+ *
+ * Only the owning thread writes to its slab, so updates are relaxed
+ * load/store pairs rather than read-modify-write operations. Other threads
+ * may read concurrently to aggregate metrics; they might observe values that
+ * are mildly out of date, but never torn ones.
+ */
+struct ThreadSlab {
+    static constexpr uint32_t chunk_size = 256;
+    static constexpr uint32_t max_chunks = 64;
+    static constexpr uint32_t max_depth = 32;
+
+    using Chunk = std::array<std::atomic<uint64_t>, chunk_size>;
+    using Chunks = std::array<std::atomic<Chunk*>, max_chunks>;
+
+    struct Frame {
+        std::atomic<const Activity*> activity = nullptr;
+        std::atomic<uint64_t> begin_ns = 0;
+    };
+
+    const std::thread::id owner = std::this_thread::get_id();
+
+    // Accumulated nanoseconds, indexed by Activity::index
+    Chunks activity_totals {};
+
+    // Accumulated values, indexed by Counter::index
+    Chunks counter_totals {};
+
+    // Activities currently measured on this thread, outermost first.
+    // The root activity is implicit, so stack[n] holds an activity of depth n + 1.
+    std::array<Frame, max_depth> stack;
+    std::atomic<uint32_t> depth = 0;
+
+    ~ThreadSlab() {
+        for (auto* chunks : { &activity_totals, &counter_totals }) {
+            for (auto& chunk : *chunks) {
+                delete chunk.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// Returns the slot for the given index, or nullptr if the index exceeds the slab capacity
+    static std::atomic<uint64_t>* GetSlot(Chunks& chunks, uint32_t index) {
+        const auto chunk_index = index / chunk_size;
+        if (chunk_index >= max_chunks) {
+            return nullptr;
+        }
+
+        auto* chunk = chunks[chunk_index].load(std::memory_order_relaxed);
+        if (!chunk) {
+            chunk = new Chunk {};
+            chunks[chunk_index].store(chunk, std::memory_order_release);
+        }
+        return &(*chunk)[index % chunk_size];
+    }
+
+    /// Adds the contents of the given chunks to totals. Called from arbitrary threads
+    static void AccumulateInto(const Chunks& chunks, std::vector<uint64_t>& totals) {
+        for (uint32_t chunk_index = 0; chunk_index < max_chunks; ++chunk_index) {
+            auto* chunk = chunks[chunk_index].load(std::memory_order_acquire);
+            if (!chunk) {
+                continue;
+            }
+            for (uint32_t slot = 0; slot < chunk_size; ++slot) {
+                const auto index = chunk_index * chunk_size + slot;
+                if (index >= totals.size()) {
+                    return;
+                }
+                totals[index] += (*chunk)[slot].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    static void Add(std::atomic<uint64_t>& slot, uint64_t amount) {
+        // No other thread writes to this slot, so this doesn't need to be an atomic read-modify-write
+        slot.store(slot.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    /// Interrupts all measured activities deeper than new_depth
+    void PopUntil(uint32_t new_depth, uint64_t now_ns) {
+        const auto old_depth = depth.load(std::memory_order_relaxed);
+        if (new_depth >= old_depth) {
+            return;
+        }
+
+        // Shrink the stack before accounting so that concurrent readers
+        // undercount rather than double-count the popped frames
+        depth.store(new_depth, std::memory_order_release);
+        for (auto level = new_depth; level < old_depth; ++level) {
+            auto* activity = stack[level].activity.load(std::memory_order_relaxed);
+            if (auto* slot = GetSlot(activity_totals, activity->index)) {
+                Add(*slot, TimePassed(stack[level].begin_ns.load(std::memory_order_relaxed), now_ns));
+            }
+        }
+    }
+};
+
+class Registry {
+    static inline std::atomic<uint64_t> next_id = 1;
+
+    // Unique across Registry instances, used to validate thread-local slab caches
+    const uint64_t id = next_id++;
+
+    mutable std::mutex slabs_mutex;
+    std::vector<std::unique_ptr<ThreadSlab>> slabs;
+
+    mutable std::mutex counters_mutex;
+    std::deque<Counter> counters;
+
+public:
+    const TimePoint creation_time = std::chrono::steady_clock::now();
+
+    std::atomic<uint32_t> next_activity_index = 0;
+    std::atomic<uint32_t> next_counter_index = 0;
+
+    /// Returns the slab of the calling thread, registering a new one on first use
+    ThreadSlab& GetThreadSlab() {
+        struct CachedSlab {
+            uint64_t registry_id = 0;
+            ThreadSlab* slab = nullptr;
+        };
+        static thread_local CachedSlab cache;
+
+        if (cache.registry_id == id) {
+            return *cache.slab;
+        }
+
+        std::lock_guard lock(slabs_mutex);
+        auto it = std::find_if(slabs.begin(), slabs.end(), [](auto& slab) { return slab->owner == std::this_thread::get_id(); });
+        auto* slab = (it != slabs.end()) ? it->get() : slabs.emplace_back(std::make_unique<ThreadSlab>()).get();
+        cache = { id, slab };
+        return *slab;
+    }
+
+    /// Returns the total nanoseconds measured for each activity index over all threads, including measurements in progress
+    std::vector<uint64_t> AggregateActivityTimes(TimePoint now) const {
+        std::vector<uint64_t> totals(next_activity_index.load(std::memory_order_acquire), 0);
+        const auto now_ns = ToNanoseconds(now);
+
+        std::lock_guard lock(slabs_mutex);
+        for (auto& slab : slabs) {
+            ThreadSlab::AccumulateInto(slab->activity_totals, totals);
+
+            const auto depth = slab->depth.load(std::memory_order_acquire);
+            for (uint32_t level = 0; level < depth; ++level) {
+                auto* activity = slab->stack[level].activity.load(std::memory_order_relaxed);
+                if (activity && activity->index < totals.size()) {
+                    totals[activity->index] += TimePassed(slab->stack[level].begin_ns.load(std::memory_order_relaxed), now_ns);
+                }
+            }
+        }
+        return totals;
+    }
+
+    std::vector<uint64_t> AggregateCounters() const {
+        std::vector<uint64_t> totals(next_counter_index.load(std::memory_order_acquire), 0);
+
+        std::lock_guard lock(slabs_mutex);
+        for (auto& slab : slabs) {
+            ThreadSlab::AccumulateInto(slab->counter_totals, totals);
+        }
+        return totals;
+    }
+
+    Counter& GetCounter(std::string_view name) {
+        std::lock_guard lock(counters_mutex);
+        auto it = std::find_if(counters.begin(), counters.end(), [=](auto& counter) { return counter.GetName() == name; });
+        if (it != counters.end()) {
+            return *it;
+        }
+        return counters.emplace_back(*this, name);
+    }
+
+    std::vector<std::pair<std::string_view, uint64_t>> FreezeCounters() const {
+        auto totals = AggregateCounters();
+
+        std::vector<std::pair<std::string_view, uint64_t>> ret;
+        std::lock_guard lock(counters_mutex);
+        for (auto& counter : counters) {
+            ret.emplace_back(counter.GetName(), counter.index < totals.size() ? totals[counter.index] : 0);
+        }
+        return ret;
+    }
+};
+
+} // namespace detail
+
+using detail::ThreadSlab;
 
 Duration DurationMeasure::TimePassedUntil(TimePoint now) const {
     return std::chrono::duration_cast<Duration>(now - begin);
 }
 
-Metric Accumulator::SnapshotFor(TimePoint now) const {
-    // Careful here for race-conditions!
+Counter::Counter(detail::Registry& registry, std::string_view name)
+    : registry(registry), index(registry.next_counter_index++), name(name) {
+}
 
-    // If paused, immediately return the metric. If paused gets toggled before returning, metric will be mildy out of date at worst.
-    if (paused) {
-        return metric;
+void Counter::Add(uint64_t amount) {
+    if (auto* slot = ThreadSlab::GetSlot(registry.GetThreadSlab().counter_totals, index)) {
+        ThreadSlab::Add(*slot, amount);
     }
+}
 
-    // Get the current metric.
-    // TODO: Race condition here - measure.begin might get updated after taking the metric snapshot :/
-    auto snapshot_metric = metric; // TODO: Copying this should be ensured atomic!
-    auto snapshot_measure = measure;
+uint64_t Counter::Total() const {
+    auto totals = registry.AggregateCounters();
+    return index < totals.size() ? totals[index] : 0;
+}
 
-    auto time_passed = snapshot_measure.TimePassedUntil(now);
+Activity::Activity(detail::Registry& registry)
+    : name("root"), registry(registry), index(registry.next_activity_index++) {
+}
 
-    // If measurement begin is later than "now" (e.g. due to cross-thread
-    // access), assume the activity was interrupted before and hence no
-    // metrics were gathered.
-    snapshot_metric.total += std::max(time_passed, std::chrono::duration_values<Duration>::zero());
+Activity::Activity(Activity& parent, std::string_view name)
+    : name(name), parent(&parent), registry(parent.registry), index(registry.next_activity_index++), depth(parent.depth + 1) {
+}
 
-    return snapshot_metric;
+Activity::~Activity() {
+    auto* child = first_child.load(std::memory_order_relaxed);
+    while (child) {
+        auto* next = child->next_sibling.load(std::memory_order_relaxed);
+        delete child;
+        child = next;
+    }
 }
 
 Activity& Activity::GetSubActivity(std::string_view name) {
-    auto it = std::find_if(sub_activities.begin(), sub_activities.end(), [=](auto& activity) { return activity.name == name; });
-    if (it != sub_activities.end()) {
-        return *it;
+    std::atomic<Activity*>* link = &first_child;
+    while (true) {
+        for (auto* child = link->load(std::memory_order_acquire); child; child = link->load(std::memory_order_acquire)) {
+            if (child->name == name) {
+                return *child;
+            }
+            link = &child->next_sibling;
+        }
+
+        // Append a new activity. If another thread appended concurrently,
+        // continue scanning from its entry since it may have the same name.
+        auto new_activity = std::make_unique<Activity>(*this, name);
+        Activity* expected = nullptr;
+        if (link->compare_exchange_strong(expected, new_activity.get(), std::memory_order_release, std::memory_order_relaxed)) {
+            return *new_activity.release();
+        }
     }
+}
 
-    return sub_activities.emplace_back(*this, name);
+Activity& Activity::GetSubActivityByPosition(size_t position) {
+    auto* child = first_child.load(std::memory_order_acquire);
+    for (; child && position; --position) {
+        child = child->next_sibling.load(std::memory_order_acquire);
+    }
+    if (!child) {
+        throw std::out_of_range("No sub activity at the given position in activity " + name);
+    }
+    return *child;
 }
 
-void Activity::ResumeFrom(TimePoint time) {
-    if constexpr (skip_profiler) {
-        return;
+bool Activity::IsMeasuring() const {
+    if (!parent) {
+        // The root activity always stays active
+        return true;
+    }
+
+    if (depth > ThreadSlab::max_depth) {
+        return false;
     }
 
+    auto& slab = registry.GetThreadSlab();
+    return depth <= slab.depth.load(std::memory_order_relaxed) &&
+           slab.stack[depth - 1].activity.load(std::memory_order_relaxed) == this;
+}
+
+void Activity::ResumeFrom(TimePoint time) {
     if (!parent) {
         // The root activity always stays active
         return;
     }
 
-    assert(!IsMeasuring());
+    if (depth > ThreadSlab::max_depth) {
+        // Too deeply nested to be tracked
+        return;
+    }
 
-    // Resume parent first, just to make sure they always get a slightly higher total metric
-    if (!parent->IsMeasuring()) {
-        parent->ResumeFrom(time);
+    // Chain of activities from the outermost one down to this one
+    std::array<const Activity*, ThreadSlab::max_depth> path;
+    for (auto* activity = this; activity->parent; activity = activity->parent) {
+        path[activity->depth - 1] = activity;
     }
 
-    if (!accumulator) {
-        accumulator = std::make_unique<Accumulator>(metric, time);
-        assert(IsMeasuring());
-    } else {
-        assert(!IsMeasuring());
-        accumulator->Resume(time);
+    // Keep measuring any ancestors that are already active, and interrupt everything else
+    auto& slab = registry.GetThreadSlab();
+    const auto current_depth = slab.depth.load(std::memory_order_relaxed);
+    uint32_t common_depth = 0;
+    while (common_depth < std::min(current_depth, depth) &&
+           slab.stack[common_depth].activity.load(std::memory_order_relaxed) == path[common_depth]) {
+        ++common_depth;
     }
-}
 
-void Activity::InterruptAt(TimePoint time) {
-    if constexpr (skip_profiler) {
+    if (common_depth == depth) {
+        // Already measuring
         return;
     }
 
-    // Interrupt children first, to make sure the parent always has a slightly higher total metric
-    for (auto& activity : sub_activities) {
-        if (activity.IsMeasuring()) {
-            activity.InterruptAt(time);
-        }
+    const auto now_ns = detail::ToNanoseconds(time);
+    slab.PopUntil(common_depth, now_ns);
+    for (auto level = common_depth; level < depth; ++level) {
+        slab.stack[level].activity.store(path[level], std::memory_order_relaxed);
+        slab.stack[level].begin_ns.store(now_ns, std::memory_order_relaxed);
     }
+    slab.depth.store(depth, std::memory_order_release);
+}
 
-    if (!IsMeasuring()) {
-        throw std::runtime_error("Called Interrupt on Activity " + name + " which wasn't active");
+void Activity::InterruptAt(TimePoint time) {
+    auto& slab = registry.GetThreadSlab();
+    if (!parent) {
+        slab.PopUntil(0, detail::ToNanoseconds(time));
+        return;
     }
-    accumulator->Interrupt(time);
-}
 
-void Activity::Resume() {
-    if constexpr (skip_profiler) {
+    if (!IsMeasuring()) {
+        // Activities may be interrupted implicitly by resuming an unrelated
+        // one (e.g. when switching between emulated threads), so this is not
+        // an error
         return;
     }
 
+    // Interrupts children first, too
+    slab.PopUntil(depth - 1, detail::ToNanoseconds(time));
+}
+
+void Activity::Resume() {
     auto time = std::chrono::steady_clock::now();
     ResumeFrom(time);
 }
 
 void Activity::Interrupt() {
-    if constexpr (skip_profiler) {
-        return;
-    }
-
     auto time = std::chrono::steady_clock::now();
     InterruptAt(time);
 }
 
 void Activity::SwitchSubActivity(std::string_view from, std::string_view to) {
-    if constexpr (skip_profiler) {
-        return;
-    }
-
     auto time = std::chrono::steady_clock::now();
     GetSubActivity(from).InterruptAt(time);
     GetSubActivity(to).ResumeFrom(time);
 }
 
+FrozenMetrics Activity::GetMetrics(const std::vector<uint64_t>& totals_ns) const {
+    auto total_ns = (index < totals_ns.size()) ? totals_ns[index] : 0;
+    FrozenMetrics ret { *this, { std::chrono::duration_cast<Duration>(std::chrono::nanoseconds { total_ns }) }, {} };
+    for (auto* child = first_child.load(std::memory_order_acquire); child; child = child->next_sibling.load(std::memory_order_acquire)) {
+        ret.sub_metrics.emplace_back(child->GetMetrics(totals_ns));
+    }
+    return ret;
+}
+
 FrozenMetrics Activity::GetMetricsAt(TimePoint now) const {
-    // TODO: Race condition here. What if IsMeasuring changes before we take the snapshot?
-    auto metrics = IsMeasuring() ? accumulator->SnapshotFor(now) : metric;
+    auto totals = registry.AggregateActivityTimes(now);
 
-    FrozenMetrics ret { *this, metrics, {} };
-    // TODO: Verify iteration over std::list is thread-safe
-    if constexpr (!skip_profiler) {
-    for (auto& activity : sub_activities) {
-        ret.sub_metrics.emplace_back(activity.GetMetricsAt(now));
+    // The root activity has been measuring ever since its creation
+    auto* root = this;
+    while (root->parent) {
+        root = root->parent;
     }
+    if (root->index < totals.size()) {
+        totals[root->index] = detail::TimePassed(detail::ToNanoseconds(registry.creation_time), detail::ToNanoseconds(now));
     }
-    return std::move(ret);
+
+    return GetMetrics(totals);
 }
 
-FrozenMetrics Profiler::Freeze() const {
-    // TODO: Achieve this without interrupting any activity, and don't assume no activity is running right now!
-//    root_activity->Interrupt();
-//    root_activity->accumulator->Resume();
+Profiler::Profiler() : registry(std::make_unique<detail::Registry>()), root_activity(*registry) {
+}
 
+Profiler::~Profiler() = default;
+
+Counter& Profiler::GetCounter(std::string_view name) {
+    return registry->GetCounter(name);
+}
+
+FrozenMetrics Profiler::Freeze() const {
     return root_activity->GetMetricsAt(std::chrono::steady_clock::now());
 }
 
+std::vector<std::pair<std::string_view, uint64_t>> Profiler::FreezeCounters() const {
+    return registry->FreezeCounters();
+}
+
 // TODO: MeasureScope should get the previously active activity and restore it!
 
 } // namespace Profiler
@@ -1,13 +1,15 @@
 ﻿#pragma once
 
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cstdint>
 #include <exception>
-#include <list>
 #include <memory>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 #include <boost/mp11/algorithm.hpp>
@@ -18,6 +20,11 @@ namespace Profiler {
 using TimePoint = std::chrono::time_point<std::chrono::steady_clock>;
 using Duration = std::chrono::microseconds;
 
+namespace detail {
+class Registry;
+struct ThreadSlab;
+}
+
 /**
  * A DurationMeasure measures the time from a fixed starting point in time to
  * later moments in time.
@@ -34,52 +41,39 @@ public:
 
 struct Metric {
     /// Total time spend on the given task
-    /// TODO: Should use an atomic for this!
     Duration total;
 };
 
-class Accumulator {
-    friend class Activity;
-
-    Accumulator(const Accumulator&) = delete;
-    Accumulator& operator=(const Accumulator&) = delete;
-
-    Metric& metric;
-
-    DurationMeasure measure;
+/**
+ * Monotonic event counter (e.g. instructions executed or bytes read).
+ *
+ * Each host thread increments a private slot in its own slab, so Add() never
+ * contends with other threads. The total is aggregated lazily on request.
+ */
+class Counter {
+    friend class detail::Registry;
 
-    bool paused = false;
+    detail::Registry& registry;
+    uint32_t index;
+    std::string name;
 
 public:
-    Accumulator(Metric& metric, TimePoint begin) : metric(metric), measure(begin) {
-    }
-
-    ~Accumulator() {
-    }
+    Counter(detail::Registry&, std::string_view name);
 
-    void Interrupt(TimePoint end) {
-        metric.total += measure.TimePassedUntil(end);
-        paused = true;
-    }
-
-    /// Resume after prior interruption
-    void Resume(TimePoint begin) {
-        measure = DurationMeasure(begin);
-        paused = false;
-    }
+    Counter(const Counter&) = delete;
+    Counter& operator=(const Counter&) = delete;
 
-    bool IsPaused() const {
-        return paused;
-    }
+    void Add(uint64_t amount = 1);
 
     /**
-     * Returns metrics for the given TimePoint.
-     * @note If the given time point is earlier than begin, it is assumed that
-     *       measuring has been interrupted throughout the entire time between
-     *       the two TimePoints.
-     * Thread-safe.
+     * Sum of all increments over all threads.
+     * Thread-safe, but may miss increments performed concurrently.
      */
-    Metric SnapshotFor(TimePoint) const;
+    uint64_t Total() const;
+
+    std::string_view GetName() const {
+        return name;
+    }
 };
 
 class Activity;
@@ -94,46 +88,56 @@ struct FrozenMetrics {
 
 /**
  * The life time of these should last until the end of the program so that references are guaranteed to be stable.
+ *
+ * Measurement state is tracked per host thread: Each thread keeps a stack of
+ * the activities it is currently measuring along with a slab of accumulated
+ * times indexed by Activity::index. Resuming an activity that is not a
+ * descendant of the innermost measured activity on the calling thread
+ * implicitly interrupts the measured activities that aren't its ancestors.
+ * Hence the same activity may be measured on multiple threads simultaneously,
+ * in which case the reported total is the sum over all threads.
  */
 class Activity {
-public: // TODO: Iteration interface!
+    friend class Profiler;
+    friend class detail::Registry;
+    friend struct detail::ThreadSlab;
+
     std::string name;
-    Metric metric = {};
 
     // Parent activity, or nullptr for the root activity
     Activity* parent = nullptr;
 
-    // Using std::list here because we need stable references when appending new activities.
-    // TODO: Use something that has more efficient iteration, and random-access for compile-time-specified activities!
-    // We also need thread-safe iteration while adding new elements at the end of the list.
-    // Invariant: Not more than one of these IsMeasuring at any point in time.
-    // Invariant: !IsMeasuring implies no sub activity IsMeasuring.
-    // NOTE: The first entries are occupied by compile-time activities
-//    std::list<Activity> sub_activities;
-    std::list<Activity> sub_activities;
-
-    // @pre: Only active if parent->accumulator is active
-    // TODO: Why is this a unique_ptr again?
-    std::unique_ptr<Accumulator> accumulator;
+    detail::Registry& registry;
 
-    /// Creates the root activity in the measuring state
-    Activity() : name("root") {
-        accumulator = std::make_unique<Accumulator>(metric, std::chrono::steady_clock::now());
-    }
+    // Unique identifier used to index into per-thread slabs
+    uint32_t index;
 
-    friend class Profiler;
+    // Distance to the root activity
+    uint32_t depth = 0;
 
-    bool IsMeasuring() const {
-        return accumulator && !accumulator->IsPaused();
-    }
+    // Append-only singly-linked list of sub activities. Insertion is lock-free
+    // and may happen concurrently with iteration from other threads.
+    // NOTE: The first entries are occupied by compile-time activities
+    std::atomic<Activity*> first_child = nullptr;
+    std::atomic<Activity*> next_sibling = nullptr;
 
     void InterruptAt(TimePoint);
 
     void ResumeFrom(TimePoint);
+
+    FrozenMetrics GetMetrics(const std::vector<uint64_t>& totals_ns) const;
+
 public:
+    /// Creates the root activity, which is measuring for its entire life time
+    Activity(detail::Registry&);
+
     /// Creates the activity in the stopped state
-    Activity(Activity& parent, std::string_view name) : name(name), parent(&parent) {
-    }
+    Activity(Activity& parent, std::string_view name);
+
+    Activity(const Activity&) = delete;
+    Activity& operator=(const Activity&) = delete;
+
+    ~Activity();
 
     /**
      * Look up or create new sub task with the given name
@@ -141,7 +145,13 @@ public:
     Activity& GetSubActivity(std::string_view name);
 
     /**
-     * Interrupt all measurements in this activity, including any subactivities
+     * Returns the sub activity at the given position in order of creation
+     */
+    Activity& GetSubActivityByPosition(size_t position);
+
+    /**
+     * Interrupt all measurements in this activity on the calling thread, including any subactivities.
+     * Does nothing if the activity isn't being measured on the calling thread.
      */
     void Interrupt();
 
@@ -153,6 +163,9 @@ public:
 
     void SwitchSubActivity(std::string_view from, std::string_view to);
 
+    /// Returns true if this activity is being measured on the calling thread
+    bool IsMeasuring() const;
+
     // Get a snapshot of the metrics for this and all child activities
     // Thread-safe.
     FrozenMetrics GetMetricsAt(TimePoint) const;
@@ -169,10 +182,9 @@ struct TaggedActivity {
 
     Activity activity;
 
-    TaggedActivity() {
+    TaggedActivity(detail::Registry& registry) : activity(registry) {
         auto populate_activity = [](Activity& activity, auto tag, auto&& self) {
             boost::mp11::mp_for_each<typename decltype(tag)::tags>([&activity, self](auto subtag) {
-//                activity.sub_activities.reserve(100);
                 auto& sub_activity = activity.GetSubActivity(subtag.name);
                 self(sub_activity, subtag, self);
             });
@@ -211,12 +223,11 @@ struct TaggedActivity {
         static_assert(index != boost::mp11::mp_size<SubTags>::value, "Given tag is not a child of this activity");
 
         // reinterpret_cast here is (hopefully) fine since Activity is the only member in TaggedActivity
-        auto& result = *std::next(activity.sub_activities.begin(), index);
-        if (result.name != SubActivityTag::name) {
-            throw std::runtime_error("WTF? " + result.name + " <-> " + std::string{SubActivityTag::name});
+        auto& result = activity.GetSubActivityByPosition(index);
+        if (result.GetName() != SubActivityTag::name) {
+            throw std::runtime_error("WTF? " + std::string{result.GetName()} + " <-> " + std::string{SubActivityTag::name});
         }
         return reinterpret_cast<TaggedActivity<SubActivityTag>&>(result);
-//        return reinterpret_cast<TaggedActivity<SubActivityTag>&>(*std::next(activity.sub_activities.begin(), index));
     }
 
 //    template<typename FirstTag, typename SecondTag, typename... SubActivityTags>
@@ -264,23 +275,34 @@ class Profiler {
         };
     */
 
-    // TODO: Keep separate root Activity per thread!
-//    Activity root_activity;
+    // Owns the per-thread slabs. Must outlive all activities and counters.
+    std::unique_ptr<detail::Registry> registry;
+
     TaggedActivity<Activities::Root> root_activity;
 
 public:
-    Profiler() {
-        root_activity->Resume();
-    }
+    Profiler();
+    ~Profiler();
 
     Activity& GetActivity(std::string_view name) {
         return root_activity->GetSubActivity(name);
     }
 
+    /**
+     * Look up or create the counter with the given name.
+     * Callers on hot paths should cache the returned reference, which stays
+     * valid for the life time of the Profiler.
+     */
+    Counter& GetCounter(std::string_view name);
+
     // Get a snapshot of the metrics for all activities
     // Thread-safe.
     FrozenMetrics Freeze() const;
 
+    // Get a snapshot of all counters in order of creation
+    // Thread-safe.
+    std::vector<std::pair<std::string_view, uint64_t>> FreezeCounters() const;
+
     // TODO: Activity GetActive() => Should be able to dynamically add a sub activity for the current one!
 };
 
@@ -6,6 +6,7 @@
 
 #include <string>
 #include <variant>
+#include <vector>
 
 namespace Settings {
 
@@ -74,6 +75,11 @@ struct BootToHomeMenu : Config::BooleanOption<BootToHomeMenu> {
 };
 
 
+// Restore the FIRM modules launched on OS startup from a cache validated against the installed FIRM title and keys
+struct FastBoot : Config::BooleanOption<FastBoot> {
+    static constexpr const char* name = "FastBoot";
+};
+
 // Use the native HID module upon OS startup
 struct UseNativeHID : Config::BooleanOption<UseNativeHID> {
     static constexpr const char* name = "UseNativeHID";
@@ -127,6 +133,76 @@ struct EnableAudioEmulation : Config::BooleanOption<EnableAudioEmulation> {
     static constexpr const char* name = "EnableAudioEmulation";
 };
 
+// Advance emulated time by approximate per-instruction cycle costs instead of one tick per instruction
+struct EnableCycleAccounting : Config::BooleanOption<EnableCycleAccounting> {
+    static constexpr const char* name = "EnableCycleAccounting";
+};
+
+// Host file to periodically write performance metrics to (disabled if empty)
+struct MetricsDumpFile : Config::Option {
+    static constexpr const char* name = "MetricsDumpFile";
+    using type = std::string;
+    static type default_value() { return {}; }
+};
+
+// Collect per-service IPC statistics and expose them via the debug server (implied by IPCStatsDumpFile)
+struct EnableIPCStatistics : Config::BooleanOption<EnableIPCStatistics> {
+    static constexpr const char* name = "EnableIPCStatistics";
+};
+
+// Host file to additionally write IPC statistics to on shutdown (disabled if empty)
+struct IPCStatsDumpFile : Config::Option {
+    static constexpr const char* name = "IPCStatsDumpFile";
+    using type = std::string;
+    static type default_value() { return {}; }
+};
+
+// Host file to write the physical memory access heatmap to on shutdown (requires ENABLE_MEMORY_HEATMAP)
+struct MemoryHeatmapFile : Config::Option {
+    static constexpr const char* name = "MemoryHeatmapFile";
+    using type = std::string;
+    static type default_value() { return {}; }
+};
+
+// Host directory to write guest-level profiles to on shutdown (disabled if empty)
+struct GuestProfileDir : Config::Option {
+    static constexpr const char* name = "GuestProfileDir";
+    using type = std::string;
+    static type default_value() { return {}; }
+};
+
+// Number of emulated CPU cycles between guest profiler samples of each thread
+struct GuestProfileInterval : Config::IntegralOption<unsigned, GuestProfileInterval> {
+    static constexpr const char* name = "GuestProfileInterval";
+};
+
+// Symbol files for the guest profiler, each given as "<process name>=<host path>"
+struct GuestProfileSymbols : Config::Option {
+    static constexpr const char* name = "GuestProfileSymbols";
+    using type = std::vector<std::string>;
+    static type default_value() { return {}; }
+};
+
+// Latch host input once per emulated frame so that runs are reproducible
+// (implied by ReplayRecordFile and ReplayPlaybackFile)
+struct DeterministicExecution : Config::BooleanOption<DeterministicExecution> {
+    static constexpr const char* name = "DeterministicExecution";
+};
+
+// Host file to record latched input to (disabled if empty)
+struct ReplayRecordFile : Config::Option {
+    static constexpr const char* name = "ReplayRecordFile";
+    using type = std::string;
+    static type default_value() { return {}; }
+};
+
+// Host file to play back recorded input from instead of using frontend input (disabled if empty)
+struct ReplayPlaybackFile : Config::Option {
+    static constexpr const char* name = "ReplayPlaybackFile";
+    using type = std::string;
+    static type default_value() { return {}; }
+};
+
 
 struct Settings : Config::Options<PathConfigDir,
                                   PathImmutableDataDir,
@@ -135,6 +211,7 @@ struct Settings : Config::Options<PathConfigDir,
                                   CPUEngineTag,
                                   InitialApplicationTag,
                                   BootToHomeMenu,
+                                  FastBoot,
                                   UseNativeHID,
                                   UseNativeFS,
                                   DumpFrames,
@@ -143,6 +220,17 @@ struct Settings : Config::Options<PathConfigDir,
                                   AppMemType,
                                   RendererTag,
                                   ShaderEngineTag,
-                                  EnableAudioEmulation> { };
+                                  EnableAudioEmulation,
+                                  EnableCycleAccounting,
+                                  MetricsDumpFile,
+                                  EnableIPCStatistics,
+                                  IPCStatsDumpFile,
+                                  MemoryHeatmapFile,
+                                  GuestProfileDir,
+                                  GuestProfileInterval,
+                                  GuestProfileSymbols,
+                                  DeterministicExecution,
+                                  ReplayRecordFile,
+                                  ReplayPlaybackFile> { };
 
 } // namespace Settings
@@ -0,0 +1,115 @@
+#include <platform/crypto.hpp>
+
+#include <catch2/catch.hpp>
+
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using KeyType = KeyDatabase::KeyType;
+
+// Reference implementation of the key scrambler using 128-bit integer arithmetic
+KeyType ReferenceNormalKey(const KeyType& key_x, const KeyType& key_y) {
+    auto load = [](const KeyType& key) {
+        unsigned __int128 value = 0;
+        for (auto byte : key) {
+            value = (value << 8) | byte;
+        }
+        return value;
+    };
+    auto rol = [](unsigned __int128 value, unsigned shift) {
+        return (value << shift) | (value >> (128 - shift));
+    };
+
+    const KeyType constant = { 0x1f, 0xf9, 0xe9, 0xaa, 0xc5, 0xfe, 0x04, 0x08, 0x02, 0x45, 0x91, 0xdc, 0x5d, 0x52, 0x76, 0x8a };
+    auto value = rol((rol(load(key_x), 2) ^ load(key_y)) + load(constant), 128 - 41);
+
+    KeyType key;
+    for (int i = key.size() - 1; i >= 0; --i) {
+        key[i] = static_cast<uint8_t>(value);
+        value >>= 8;
+    }
+    return key;
+}
+
+KeyType MakeKey(uint8_t seed) {
+    KeyType key;
+    for (unsigned i = 0; i < key.size(); ++i) {
+        key[i] = static_cast<uint8_t>(seed * 0x3b + i * 0x11);
+    }
+    return key;
+}
+
+} // anonymous namespace
+
+TEST_CASE("KeyDatabase generates normal keys like the hardware key scrambler") {
+    for (uint8_t seed = 0; seed < 16; ++seed) {
+        auto key_x = MakeKey(seed);
+        auto key_y = MakeKey(seed + 0x80);
+        REQUIRE(KeyDatabase::GenerateNormalKey(key_x, key_y) == ReferenceNormalKey(key_x, key_y));
+    }
+}
+
+TEST_CASE("KeyDatabase caches normal keys per slot and KeyY") {
+    KeyDatabase keydb;
+    keydb.aes_slots[0x2c].x = MakeKey(1);
+    keydb.aes_slots[0x25].x = MakeKey(2);
+
+    const auto key_y = MakeKey(3);
+    const auto normal_key = keydb.GetNormalKey(0x2c, key_y);
+    REQUIRE(normal_key == KeyDatabase::GenerateNormalKey(MakeKey(1), key_y));
+    REQUIRE(keydb.GetNormalKey(0x2c, key_y) == normal_key);
+
+    // Other slots and KeyYs get separate entries
+    REQUIRE(keydb.GetNormalKey(0x25, key_y) == KeyDatabase::GenerateNormalKey(MakeKey(2), key_y));
+    REQUIRE(keydb.GetNormalKey(0x2c, MakeKey(4)) == KeyDatabase::GenerateNormalKey(MakeKey(1), MakeKey(4)));
+
+    // Repeated lookups are served from the cache without consulting KeyX again
+    keydb.aes_slots[0x2c].x = MakeKey(5);
+    REQUIRE(keydb.GetNormalKey(0x2c, key_y) == normal_key);
+    keydb.aes_slots[0x2c].x.reset();
+    REQUIRE(keydb.GetNormalKey(0x2c, key_y) == normal_key);
+
+    // Slots without a KeyX can't be used
+    REQUIRE_THROWS_AS(keydb.GetNormalKey(0x11, key_y), std::bad_optional_access);
+}
+
+TEST_CASE("KeyDatabase copies don't share cached keys") {
+    KeyDatabase keydb;
+    keydb.aes_slots[0x2c].x = MakeKey(1);
+    const auto key_y = MakeKey(3);
+    keydb.GetNormalKey(0x2c, key_y);
+
+    // Changing KeyX in the copy must not return keys derived from the original KeyX
+    KeyDatabase copy = keydb;
+    copy.aes_slots[0x2c].x = MakeKey(5);
+    REQUIRE(copy.GetNormalKey(0x2c, key_y) == KeyDatabase::GenerateNormalKey(MakeKey(5), key_y));
+
+    keydb = copy;
+    REQUIRE(keydb.GetNormalKey(0x2c, key_y) == KeyDatabase::GenerateNormalKey(MakeKey(5), key_y));
+}
+
+TEST_CASE("KeyDatabase returns consistent keys under concurrent use") {
+    KeyDatabase keydb;
+    keydb.aes_slots[0x2c].x = MakeKey(1);
+
+    std::vector<std::vector<KeyType>> results(4);
+    {
+        std::vector<std::jthread> threads;
+        for (auto& thread_results : results) {
+            threads.emplace_back([&keydb, &thread_results]() {
+                for (uint8_t seed = 0; seed < 64; ++seed) {
+                    thread_results.push_back(keydb.GetNormalKey(0x2c, MakeKey(seed % 8)));
+                }
+            });
+        }
+    }
+
+    for (auto& thread_results : results) {
+        for (uint8_t seed = 0; seed < 64; ++seed) {
+            REQUIRE(thread_results[seed] == KeyDatabase::GenerateNormalKey(MakeKey(1), MakeKey(seed % 8)));
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#include <hardware/hash.hpp>
+
+#include <catch2/catch.hpp>
+
+#include <array>
+#include <vector>
+
+using namespace Memory;
+
+namespace {
+
+std::vector<uint8_t> MakeData(uint32_t size) {
+    std::vector<uint8_t> data(size);
+    for (uint32_t i = 0; i < size; ++i) {
+        data[i] = static_cast<uint8_t>(i * 7 + (i >> 8));
+    }
+    return data;
+}
+
+std::array<uint8_t, 0x20> ReferenceDigest(const uint8_t* data, uint32_t size) {
+    std::array<uint8_t, 0x20> digest;
+    CryptoPP::SHA256().CalculateDigest(digest.data(), data, size);
+    return digest;
+}
+
+// Running hash as exposed by the HASH registers, computed without buffering
+std::array<uint8_t, 0x20> ReferenceRunningHash(const uint8_t* data, uint32_t size) {
+    MySHA256 hash;
+    hash.Update(data, size);
+    std::array<uint8_t, 0x20> running_hash;
+    memcpy(running_hash.data(), hash.StateBuf(), sizeof(running_hash));
+    return running_hash;
+}
+
+// Writes the given data to the FIFO registers in words, like the FS module does
+void WriteFIFOWords(HashEngine& engine, const uint8_t* data, uint32_t size) {
+    for (uint32_t offset = 0; offset < size; offset += 4) {
+        engine.WriteFIFO((engine.hashed_data_size % HashEngine::block_size), data + offset, std::min<uint32_t>(4, size - offset));
+    }
+}
+
+} // anonymous namespace
+
+TEST_CASE("HashEngine computes SHA-256 over data written to the FIFO") {
+    // Cover partial blocks as well as more blocks than fit into the pending buffer
+    for (uint32_t size : { 0u, 4u, 0x40u, 0x44u, 0x1000u, (HashEngine::max_pending_blocks + 3) * HashEngine::block_size + 0x24 }) {
+        auto data = MakeData(size);
+
+        HashEngine engine;
+        WriteFIFOWords(engine, data.data(), size);
+        REQUIRE(engine.hashed_data_size == size);
+        engine.Finalize();
+        REQUIRE(engine.running_hash == ReferenceDigest(data.data(), size));
+    }
+}
+
+TEST_CASE("HashEngine hashes bulk FIFO data like individual writes") {
+    const uint32_t size = (HashEngine::max_pending_blocks + 5) * HashEngine::block_size + 0x1c;
+    auto data = MakeData(size);
+
+    // Start with an unaligned chunk so that FeedFIFO needs to complete the current block first
+    HashEngine engine;
+    WriteFIFOWords(engine, data.data(), 0x24);
+    engine.FeedFIFO(data.data() + 0x24, size - 0x24);
+    REQUIRE(engine.hashed_data_size == size);
+    engine.Finalize();
+    REQUIRE(engine.running_hash == ReferenceDigest(data.data(), size));
+}
+
+TEST_CASE("HashEngine exposes the running hash of all complete blocks") {
+    const uint32_t size = 0x30 * HashEngine::block_size;
+    auto data = MakeData(size);
+
+    HashEngine engine;
+    WriteFIFOWords(engine, data.data(), 0x10 * HashEngine::block_size);
+    REQUIRE(engine.GetRunningHash() == ReferenceRunningHash(data.data(), 0x10 * HashEngine::block_size));
+
+    engine.FeedFIFO(data.data() + 0x10 * HashEngine::block_size, size - 0x10 * HashEngine::block_size);
+    REQUIRE(engine.GetRunningHash() == ReferenceRunningHash(data.data(), size));
+}
+
+TEST_CASE("HashEngine resumes hashing from a restored running hash") {
+    // Mirrors how the FS module hashes ExeFS data: Save the running hash,
+    // reset the engine, restore the running hash and byte count, and
+    // then continue hashing the remaining data
+    const uint32_t size = 0x123 * HashEngine::block_size + 0x38;
+    const uint32_t split = 0x101 * HashEngine::block_size;
+    auto data = MakeData(size);
+
+    HashEngine engine;
+    WriteFIFOWords(engine, data.data(), split);
+    auto running_hash = engine.GetRunningHash();
+    engine.Finalize();
+    engine.Reset();
+
+    for (uint32_t offset = 0; offset < running_hash.size(); offset += 4) {
+        engine.WriteRunningHash(offset, running_hash.data() + offset, 4);
+    }
+    engine.SetByteCount(split);
+    WriteFIFOWords(engine, data.data() + split, size - split);
+    engine.Finalize();
+    REQUIRE(engine.running_hash == ReferenceDigest(data.data(), size));
+}
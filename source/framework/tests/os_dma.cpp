@@ -0,0 +1,176 @@
+#include "os_dma.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <map>
+#include <vector>
+
+using namespace HLE::OS;
+
+namespace {
+
+DMAConfig::SubConfig MakeSubConfig(uint8_t peripheral_id, uint16_t transfer_size, uint16_t stride) {
+    auto config = DMAConfig::SubConfig::Default();
+    config.unknown = peripheral_id;
+    config.transfer_size = transfer_size;
+    config.stride = stride;
+    return config;
+}
+
+/**
+ * Page-granular virtual memory map for tests. Adjacent virtual pages that are
+ * also adjacent physically are reported as a single contiguous range, like
+ * the memory map of an actual process would.
+ */
+struct TestMemoryMap {
+    // Physical page for each mapped virtual page
+    std::map<VAddr, PAddr> pages;
+
+    void Map(VAddr vaddr, PAddr paddr, uint32_t num_pages) {
+        for (uint32_t page = 0; page < num_pages; ++page) {
+            pages[vaddr + page * 0x1000] = paddr + page * 0x1000;
+        }
+    }
+
+    std::optional<std::pair<PAddr, uint32_t>> Resolve(VAddr addr) const {
+        auto it = pages.find(addr & ~0xfffu);
+        if (it == pages.end()) {
+            return std::nullopt;
+        }
+
+        const PAddr paddr = it->second + (addr & 0xfff);
+        uint32_t size = 0x1000 - (addr & 0xfff);
+        for (auto next = std::next(it); next != pages.end() && next->first == std::prev(next)->first + 0x1000 &&
+                                        next->second == std::prev(next)->second + 0x1000; ++next) {
+            size += 0x1000;
+        }
+        return std::make_pair(paddr, size);
+    }
+
+    DMAResolveFunction Resolver() const {
+        return [this](VAddr addr) { return Resolve(addr); };
+    }
+};
+
+std::vector<DMARun> Split(uint32_t size, const DMAAddressGenerator& source, const DMAAddressGenerator& dest,
+                          const TestMemoryMap& source_map, const TestMemoryMap& dest_map, uint32_t& bytes_transferred) {
+    std::vector<DMARun> runs;
+    bytes_transferred = SplitDMATransfer(size, source, dest, source_map.Resolver(), dest_map.Resolver(),
+                                         [&](const DMARun& run) { runs.push_back(run); });
+    return runs;
+}
+
+} // anonymous namespace
+
+TEST_CASE("DMAAddressGenerator generates linear addresses by default") {
+    // Peripheral-side configurations are accessed linearly regardless of the stride
+    DMAAddressGenerator peripheral { 0x1000, MakeSubConfig(0x5, 0x10, 0x40) };
+    REQUIRE(peripheral.chunk_size == 0);
+    REQUIRE(peripheral(0x123).first == 0x1123);
+
+    // Memory-side configurations with matching transfer size and stride are contiguous, too
+    DMAAddressGenerator contiguous { 0x1000, MakeSubConfig(0xff, 0x10, 0x10) };
+    REQUIRE(contiguous.chunk_size == 0);
+    REQUIRE(contiguous(0x123).first == 0x1123);
+
+    // A zero transfer size means the transfer is done in one chunk
+    DMAAddressGenerator single_chunk { 0x1000, MakeSubConfig(0xff, 0, 0x40) };
+    REQUIRE(single_chunk.chunk_size == 0);
+    REQUIRE(single_chunk(0x12345).first == 0x13345);
+}
+
+TEST_CASE("DMAAddressGenerator gathers strided chunks") {
+    DMAAddressGenerator generator { 0x10000, MakeSubConfig(0xff, 0x10, 0x40) };
+    REQUIRE(generator.chunk_size == 0x10);
+
+    REQUIRE(generator(0x0) == std::make_pair(VAddr { 0x10000 }, uint32_t { 0x10 }));
+    REQUIRE(generator(0x4) == std::make_pair(VAddr { 0x10004 }, uint32_t { 0xc }));
+    REQUIRE(generator(0x10) == std::make_pair(VAddr { 0x10040 }, uint32_t { 0x10 }));
+    REQUIRE(generator(0x2f) == std::make_pair(VAddr { 0x1008f }, uint32_t { 0x1 }));
+}
+
+TEST_CASE("SplitDMATransfer splits transfers at physical discontinuities") {
+    TestMemoryMap source_map;
+    source_map.Map(0x100000, 0x20000000, 2);
+    source_map.Map(0x102000, 0x20010000, 1);
+
+    TestMemoryMap dest_map;
+    dest_map.Map(0x200000, 0x24000000, 3);
+
+    const DMAAddressGenerator source { 0x100800, DMAConfig::SubConfig::Default() };
+    const DMAAddressGenerator dest { 0x200000, MakeSubConfig(0x5, 0, 0) };
+
+    uint32_t bytes_transferred;
+    auto runs = Split(0x2000, source, dest, source_map, dest_map, bytes_transferred);
+    REQUIRE(bytes_transferred == 0x2000);
+    REQUIRE(runs == std::vector<DMARun> {
+        { 0x0,    0x20000800, 0x24000000, 0x800 },  // Source crosses a page boundary
+        { 0x800,  0x20001000, 0x24000800, 0x800 },  // Destination crosses a page boundary
+        { 0x1000, 0x20001800, 0x24001000, 0x800 },  // Source is physically discontiguous
+        { 0x1800, 0x20010000, 0x24001800, 0x800 },
+    });
+}
+
+TEST_CASE("SplitDMATransfer scatters strided chunks") {
+    TestMemoryMap source_map;
+    source_map.Map(0x100000, 0x20000000, 1);
+
+    TestMemoryMap dest_map;
+    dest_map.Map(0x200000, 0x24000000, 1);
+
+    const DMAAddressGenerator source { 0x100000, DMAConfig::SubConfig::Default() };
+    const DMAAddressGenerator dest { 0x200000, MakeSubConfig(0xff, 0x8, 0x20) };
+
+    uint32_t bytes_transferred;
+    auto runs = Split(0x18, source, dest, source_map, dest_map, bytes_transferred);
+    REQUIRE(bytes_transferred == 0x18);
+    REQUIRE(runs == std::vector<DMARun> {
+        { 0x0,  0x20000000, 0x24000000, 0x8 },
+        { 0x8,  0x20000008, 0x24000020, 0x8 },
+        { 0x10, 0x20000010, 0x24000040, 0x8 },
+    });
+}
+
+TEST_CASE("SplitDMATransfer keeps gathering in a partial last chunk") {
+    TestMemoryMap source_map;
+    source_map.Map(0x100000, 0x20000000, 1);
+
+    TestMemoryMap dest_map;
+    dest_map.Map(0x200000, 0x24000000, 1);
+
+    const DMAAddressGenerator source { 0x100000, MakeSubConfig(0xff, 0x10, 0x40) };
+    const DMAAddressGenerator dest { 0x200000, DMAConfig::SubConfig::Default() };
+
+    // The transfer size is not a multiple of the chunk size, so the last run is clamped
+    uint32_t bytes_transferred;
+    auto runs = Split(0x28, source, dest, source_map, dest_map, bytes_transferred);
+    REQUIRE(bytes_transferred == 0x28);
+    REQUIRE(runs == std::vector<DMARun> {
+        { 0x0,  0x20000000, 0x24000000, 0x10 },
+        { 0x10, 0x20000040, 0x24000010, 0x10 },
+        { 0x20, 0x20000080, 0x24000020, 0x8 },
+    });
+}
+
+TEST_CASE("SplitDMATransfer aborts at the first unmapped page") {
+    TestMemoryMap source_map;
+    source_map.Map(0x100000, 0x20000000, 4);
+
+    TestMemoryMap dest_map;
+    dest_map.Map(0x200000, 0x24000000, 1);
+    dest_map.Map(0x202000, 0x24002000, 1);
+
+    const DMAAddressGenerator source { 0x100000, DMAConfig::SubConfig::Default() };
+    const DMAAddressGenerator dest { 0x200000, DMAConfig::SubConfig::Default() };
+
+    uint32_t bytes_transferred;
+    auto runs = Split(0x3000, source, dest, source_map, dest_map, bytes_transferred);
+    REQUIRE(bytes_transferred == 0x1000);
+    REQUIRE(runs == std::vector<DMARun> { { 0x0, 0x20000000, 0x24000000, 0x1000 } });
+
+    // Nothing is transferred if the first page is unmapped
+    const DMAAddressGenerator unmapped_source { 0x300000, DMAConfig::SubConfig::Default() };
+    runs = Split(0x1000, unmapped_source, dest, source_map, dest_map, bytes_transferred);
+    REQUIRE(bytes_transferred == 0);
+    REQUIRE(runs.empty());
+}
@@ -0,0 +1,102 @@
+#include "os_handle_table.hpp"
+
+#include <framework/exceptions.hpp>
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+
+using namespace HLE::OS;
+
+namespace {
+
+struct TestObject : Object {
+};
+
+struct DerivedTestObject : TestObject {
+};
+
+struct OtherObject : Object {
+};
+
+} // anonymous namespace
+
+TEST_CASE("HandleTable looks up created handles") {
+    HandleTable table;
+    auto object = std::make_shared<TestObject>();
+
+    auto [handle, ptr] = table.CreateHandle(object, DebugHandle::DebugInfo {});
+    REQUIRE(ptr == object);
+    REQUIRE(table.FindObjectPointer<TestObject>(handle) == object.get());
+    REQUIRE(table.FindObjectPointer<Object>(handle) == object.get());
+    REQUIRE(table.FindObject<TestObject>(handle) == object);
+    REQUIRE(table.FindHandle(object).value == handle.value);
+    REQUIRE(table.FindHandle(std::make_shared<TestObject>()).value == HANDLE_INVALID.value);
+
+    // The table holds a reference until the handle is closed
+    std::weak_ptr<TestObject> weak = object;
+    object.reset();
+    ptr.reset();
+    REQUIRE(!weak.expired());
+    table.CloseHandle(handle);
+    REQUIRE(weak.expired());
+}
+
+TEST_CASE("HandleTable casts objects to the requested type") {
+    HandleTable table;
+    auto derived = std::make_shared<DerivedTestObject>();
+    auto handle = table.CreateHandle(derived, DebugHandle::DebugInfo {}).first;
+
+    REQUIRE(table.FindObjectPointer<DerivedTestObject>(handle) == derived.get());
+    REQUIRE(table.FindObjectPointer<TestObject>(handle) == derived.get());
+    REQUIRE(table.FindObjectPointer<OtherObject>(handle, true) == nullptr);
+    REQUIRE_THROWS(table.FindObjectPointer<OtherObject>(handle));
+}
+
+TEST_CASE("HandleTable rejects stale handles after slot reuse") {
+    HandleTable table;
+    auto first = std::make_shared<TestObject>();
+    auto second = std::make_shared<TestObject>();
+
+    auto stale_handle = table.CreateHandle(first, DebugHandle::DebugInfo {}).first;
+    table.CloseHandle(stale_handle);
+    REQUIRE(table.FindObjectPointer<TestObject>(stale_handle, true) == nullptr);
+    REQUIRE_THROWS_AS(table.FindObjectPointer<TestObject>(stale_handle), Mikage::Exceptions::Invalid);
+
+    // The freed slot is reused with a new generation
+    auto new_handle = table.CreateHandle(second, DebugHandle::DebugInfo {}).first;
+    REQUIRE(new_handle.value != stale_handle.value);
+    REQUIRE((new_handle.value & 0x7fff) == (stale_handle.value & 0x7fff));
+    REQUIRE(table.FindObjectPointer<TestObject>(stale_handle, true) == nullptr);
+    REQUIRE(table.FindObjectPointer<TestObject>(new_handle) == second.get());
+
+    // Closing the stale handle must not affect the new entry
+    table.CloseHandle(stale_handle);
+    REQUIRE(table.FindObjectPointer<TestObject>(new_handle) == second.get());
+}
+
+TEST_CASE("HandleTable manages reserved handles separately") {
+    HandleTable table;
+    auto process = std::make_shared<TestObject>();
+    auto object = std::make_shared<TestObject>();
+
+    const Handle process_handle { 0xFFFF8001 };
+    table.CreateEntry(DebugHandle { process_handle.value, {} }, process);
+    REQUIRE_THROWS(table.CreateEntry(DebugHandle { process_handle.value, {} }, process));
+    REQUIRE_THROWS(table.CreateEntry(DebugHandle { 0x1234, {} }, process));
+    REQUIRE(table.FindObjectPointer<TestObject>(process_handle) == process.get());
+    REQUIRE(table.FindHandle(process).value == process_handle.value);
+
+    auto handle = table.CreateHandle(object, DebugHandle::DebugInfo {}).first;
+    auto handles = table.GetHandles();
+    REQUIRE(handles.size() == 2);
+    REQUIRE(std::count(handles.begin(), handles.end(), handle) == 1);
+    REQUIRE(std::count(handles.begin(), handles.end(), process_handle) == 1);
+    REQUIRE(table.GetEntries().size() == 2);
+
+    for (auto entry_handle : handles) {
+        table.CloseHandle(entry_handle);
+    }
+    REQUIRE(table.GetHandles().empty());
+    REQUIRE(table.FindObjectPointer<TestObject>(process_handle, true) == nullptr);
+}
@@ -0,0 +1,119 @@
+#include "os_input_replay.hpp"
+
+#include <spdlog/logger.h>
+#include <spdlog/sinks/null_sink.h>
+
+#include <catch2/catch.hpp>
+
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+using namespace HLE::OS;
+
+namespace {
+
+struct TemporaryFile {
+    std::string filename = (std::filesystem::temp_directory_path() / "mikage_test_replay.bin").string();
+
+    ~TemporaryFile() {
+        std::remove(filename.c_str());
+    }
+};
+
+spdlog::logger MakeLogger() {
+    return spdlog::logger { "test", std::make_shared<spdlog::sinks::null_sink_st>() };
+}
+
+} // anonymous namespace
+
+TEST_CASE("InputReplay plays back recorded input") {
+    TemporaryFile file;
+    auto logger = MakeLogger();
+    const InputReplay::Title title { 0x0004000000123400, 3 };
+
+    {
+        Settings::Settings settings;
+        settings.set<Settings::ReplayRecordFile>(file.filename);
+        settings.set<Settings::EnableCycleAccounting>(true);
+
+        InputSource input;
+        InputReplay replay(logger, input, settings, title);
+
+        // Frontend input is hidden until the first vblank
+        input.SetPressedA(true);
+        REQUIRE(input.GetButtonState() == 0);
+
+        replay.OnVBlank(); // frame 0: A
+        replay.OnVBlank(); // frame 1: A (unchanged, not recorded)
+        input.SetPressedA(false);
+        input.SetTouch(0.25f, 0.75f);
+        replay.OnVBlank(); // frame 2: touch
+        input.EndTouch();
+        replay.OnVBlank(); // frame 3: no input
+    }
+
+    auto metadata = InputReplay::ReadMetadata(file.filename);
+    REQUIRE(metadata.title.id == title.id);
+    REQUIRE(metadata.title.version == title.version);
+    REQUIRE(metadata.cycle_accounting);
+
+    Settings::Settings settings;
+    settings.set<Settings::ReplayPlaybackFile>(file.filename);
+    settings.set<Settings::EnableCycleAccounting>(metadata.cycle_accounting);
+
+    InputSource input;
+    InputReplay replay(logger, input, settings, title);
+
+    // Frontend input is ignored during playback
+    input.SetPressedB(true);
+
+    // Only A was pressed while recording
+    InputSource reference_input;
+    reference_input.SetPressedA(true);
+    const uint16_t button_a = reference_input.GetFrontendState().buttons;
+
+    replay.OnVBlank();
+    REQUIRE(input.GetButtonState() == button_a);
+    REQUIRE(!input.GetTouchState().pressed);
+
+    replay.OnVBlank();
+    REQUIRE(input.GetButtonState() == button_a);
+
+    replay.OnVBlank();
+    REQUIRE(input.GetButtonState() == 0);
+    REQUIRE(input.GetTouchState().pressed);
+    REQUIRE(input.GetTouchState().x == 0.25f);
+    REQUIRE(input.GetTouchState().y == 0.75f);
+
+    replay.OnVBlank();
+    REQUIRE(input.GetButtonState() == 0);
+    REQUIRE(!input.GetTouchState().pressed);
+}
+
+TEST_CASE("InputReplay refuses playback for other titles and timing settings") {
+    TemporaryFile file;
+    auto logger = MakeLogger();
+    const InputReplay::Title title { 0x0004000000123400, 3 };
+
+    {
+        Settings::Settings settings;
+        settings.set<Settings::ReplayRecordFile>(file.filename);
+        InputSource input;
+        InputReplay replay(logger, input, settings, title);
+        replay.OnVBlank();
+    }
+
+    Settings::Settings settings;
+    settings.set<Settings::ReplayPlaybackFile>(file.filename);
+    InputSource input;
+
+    REQUIRE_NOTHROW(InputReplay(logger, input, settings, title));
+    REQUIRE_THROWS_AS(InputReplay(logger, input, settings, InputReplay::Title { 0x0004000000567800, 3 }), std::runtime_error);
+    REQUIRE_THROWS_AS(InputReplay(logger, input, settings, InputReplay::Title { title.id, 4 }), std::runtime_error);
+
+    settings.set<Settings::EnableCycleAccounting>(true);
+    REQUIRE_THROWS_AS(InputReplay(logger, input, settings, title), std::runtime_error);
+}
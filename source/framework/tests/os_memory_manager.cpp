@@ -0,0 +1,126 @@
+#include "os_memory_manager.hpp"
+
+#include <framework/exceptions.hpp>
+
+#include <catch2/catch.hpp>
+
+#include <utility>
+#include <vector>
+
+using namespace HLE::OS;
+
+namespace {
+
+struct TestOwner : MemoryBlockOwner {
+};
+
+struct TestMemoryManager : MemoryManager {
+    std::vector<std::pair<PAddr, uint32_t>> discarded;
+
+    TestMemoryManager(PAddr start, uint32_t size)
+        : MemoryManager([this](PAddr addr, uint32_t num_bytes) { discarded.emplace_back(addr, num_bytes); }, start, size) {
+    }
+};
+
+} // anonymous namespace
+
+TEST_CASE("MemoryManager allocates best-fit blocks") {
+    TestMemoryManager manager(0x20000000, 0x10000);
+    auto owner = std::make_shared<TestOwner>();
+
+    auto a = manager.AllocateBlock(owner, 0x1000);
+    auto b = manager.AllocateBlock(owner, 0x3000);
+    auto c = manager.AllocateBlock(owner, 0x1000);
+    REQUIRE(a == 0x20000000);
+    REQUIRE(b == 0x20001000);
+    REQUIRE(c == 0x20004000);
+    REQUIRE(manager.UsedMemory() == 0x5000);
+
+    // Free a hole of 0x3000 bytes in front of the 0xb000 byte tail
+    manager.DeallocateBlock(owner, *b, 0x3000);
+    REQUIRE(manager.discarded == std::vector<std::pair<PAddr, uint32_t>> { { 0x20001000, 0x3000 } });
+
+    // The smaller hole is preferred over the tail
+    REQUIRE(manager.AllocateBlock(owner, 0x2000) == 0x20001000);
+    REQUIRE(manager.AllocateBlock(owner, 0x4000) == 0x20005000);
+
+    auto stats = manager.GetStatistics();
+    REQUIRE(stats.used_bytes == 0x8000);
+    REQUIRE(stats.num_allocations == 5);
+    REQUIRE(stats.num_deallocations == 1);
+    REQUIRE(stats.num_free_blocks == 2);
+    REQUIRE(stats.largest_free_block == 0x7000);
+}
+
+TEST_CASE("MemoryManager coalesces free blocks") {
+    TestMemoryManager manager(0, 0x4000);
+    auto owner = std::make_shared<TestOwner>();
+
+    auto a = manager.AllocateBlock(owner, 0x1000);
+    auto b = manager.AllocateBlock(owner, 0x1000);
+    auto c = manager.AllocateBlock(owner, 0x1000);
+    REQUIRE(manager.GetStatistics().num_free_blocks == 1);
+
+    manager.DeallocateBlock(owner, *a, 0x1000);
+    manager.DeallocateBlock(owner, *c, 0x1000);
+    REQUIRE(manager.GetStatistics().num_free_blocks == 2);
+
+    // Freeing the middle block merges all three with the tail
+    manager.DeallocateBlock(owner, *b, 0x1000);
+    REQUIRE(manager.GetStatistics().num_free_blocks == 1);
+    REQUIRE(manager.GetStatistics().largest_free_block == 0x4000);
+    REQUIRE(manager.UsedMemory() == 0);
+
+    // The full region can be allocated at once again
+    REQUIRE(manager.AllocateBlock(owner, 0x4000) == 0);
+}
+
+TEST_CASE("MemoryManager fails allocations that don't fit") {
+    TestMemoryManager manager(0, 0x3000);
+    auto owner = std::make_shared<TestOwner>();
+
+    auto a = manager.AllocateBlock(owner, 0x1000);
+    manager.AllocateBlock(owner, 0x1000);
+    manager.DeallocateBlock(owner, *a, 0x1000);
+
+    // 0x2000 bytes are free, but not contiguously
+    REQUIRE(!manager.AllocateBlock(owner, 0x2000));
+    REQUIRE(!manager.AllocateBlock(owner, 0x4000));
+    REQUIRE(manager.GetStatistics().num_failed_allocations == 2);
+    REQUIRE(manager.UsedMemory() == 0x1000);
+}
+
+TEST_CASE("MemoryManager rejects empty allocations") {
+    TestMemoryManager manager(0, 0x1000);
+    auto owner = std::make_shared<TestOwner>();
+
+    REQUIRE_THROWS_AS(manager.AllocateBlock(owner, 0), Mikage::Exceptions::Invalid);
+    REQUIRE(manager.GetStatistics().num_allocations == 0);
+    REQUIRE(manager.GetStatistics().num_failed_allocations == 0);
+    REQUIRE(manager.AllocateBlock(owner, 0x1000) == 0);
+}
+
+TEST_CASE("MemoryManager splits and releases blocks per owner") {
+    TestMemoryManager manager(0, 0x4000);
+    auto owner_a = std::make_shared<TestOwner>();
+    auto owner_b = std::make_shared<TestOwner>();
+
+    auto a = manager.AllocateBlock(owner_a, 0x3000);
+    auto b = manager.AllocateBlock(owner_b, 0x1000);
+    REQUIRE(manager.taken.size() == 2);
+
+    // Freeing the middle of a block keeps both ends allocated
+    manager.DeallocateBlock(owner_a, *a + 0x1000, 0x1000);
+    REQUIRE(manager.taken.size() == 3);
+    REQUIRE(manager.UsedMemory() == 0x3000);
+
+    // Transferring adjacent memory to the same owner merges the taken blocks
+    manager.TransferOwnership(owner_b, owner_a, *b, 0x1000);
+    REQUIRE(manager.taken.size() == 2);
+
+    manager.DeallocateAllBlocks(owner_a);
+    REQUIRE(manager.taken.empty());
+    REQUIRE(manager.UsedMemory() == 0);
+    REQUIRE(manager.GetStatistics().num_free_blocks == 1);
+    REQUIRE(manager.discarded.size() == 3);
+}
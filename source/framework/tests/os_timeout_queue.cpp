@@ -0,0 +1,92 @@
+#include "os_timeout_queue.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+using namespace HLE::OS;
+
+namespace {
+
+struct TestWaiter {
+    int id;
+    int64_t timeout_at = -1;
+    uint64_t wait_sequence = 0;
+};
+
+std::shared_ptr<TestWaiter> MakeWaiter(int id, int64_t timeout_at) {
+    return std::make_shared<TestWaiter>(TestWaiter { id, timeout_at });
+}
+
+std::vector<int> PopAllExpired(TimeoutQueue<TestWaiter>& queue, int64_t now) {
+    std::vector<int> ids;
+    while (auto waiter = queue.PopExpired(now)) {
+        ids.push_back(waiter->id);
+    }
+    return ids;
+}
+
+} // anonymous namespace
+
+TEST_CASE("TimeoutQueue returns expired waiters by deadline") {
+    TimeoutQueue<TestWaiter> queue;
+    auto waiters = { MakeWaiter(0, 300), MakeWaiter(1, 100), MakeWaiter(2, 200), MakeWaiter(3, 100), MakeWaiter(4, 400) };
+    for (auto& waiter : waiters) {
+        queue.Schedule(waiter);
+    }
+
+    REQUIRE(PopAllExpired(queue, 50).empty());
+
+    // Equal deadlines are returned in scheduling order
+    REQUIRE(PopAllExpired(queue, 200) == std::vector<int> { 1, 3, 2 });
+    REQUIRE(PopAllExpired(queue, 399) == std::vector<int> { 0 });
+    REQUIRE(queue.size() == 1);
+    REQUIRE(PopAllExpired(queue, 1000) == std::vector<int> { 4 });
+    REQUIRE(queue.size() == 0);
+}
+
+TEST_CASE("TimeoutQueue ignores waiters without timeout") {
+    TimeoutQueue<TestWaiter> queue;
+    auto waiter = MakeWaiter(0, -1);
+    queue.Schedule(waiter);
+    REQUIRE(waiter->wait_sequence != 0);
+    REQUIRE(queue.size() == 0);
+    REQUIRE(queue.PopExpired(1000) == nullptr);
+}
+
+TEST_CASE("TimeoutQueue discards timeouts of earlier waits") {
+    TimeoutQueue<TestWaiter> queue;
+    auto waiter = MakeWaiter(0, 100);
+    auto other = MakeWaiter(1, 150);
+    queue.Schedule(waiter);
+    queue.Schedule(other);
+
+    // The waiter starts a new wait with a later deadline before the first one expires
+    waiter->timeout_at = 200;
+    queue.Schedule(waiter);
+    REQUIRE(queue.size() == 3);
+
+    // The stale entry must not time out the new wait early
+    REQUIRE(PopAllExpired(queue, 150) == std::vector<int> { 1 });
+    REQUIRE(queue.size() == 1);
+    REQUIRE(PopAllExpired(queue, 200) == std::vector<int> { 0 });
+
+    // Starting a wait without timeout cancels the pending one, too
+    queue.Schedule(waiter);
+    waiter->timeout_at = -1;
+    queue.Schedule(waiter);
+    REQUIRE(PopAllExpired(queue, 1000).empty());
+    REQUIRE(queue.size() == 0);
+}
+
+TEST_CASE("TimeoutQueue skips destroyed waiters") {
+    TimeoutQueue<TestWaiter> queue;
+    auto waiter = MakeWaiter(0, 100);
+    auto destroyed = MakeWaiter(1, 50);
+    queue.Schedule(waiter);
+    queue.Schedule(destroyed);
+    destroyed.reset();
+
+    REQUIRE(PopAllExpired(queue, 100) == std::vector<int> { 0 });
+    REQUIRE(queue.size() == 0);
+}
@@ -0,0 +1,154 @@
+#include "os_translation_cache.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <map>
+#include <vector>
+
+using namespace HLE::OS;
+
+namespace {
+
+/**
+ * Emulates a process memory map along with the host memory backing it.
+ * Counts lookups so that tests can check whether accesses hit the cache.
+ */
+struct TestMemoryMap {
+    std::vector<Memory::EmulatedMemory> host_memory = std::vector<Memory::EmulatedMemory>(0x10000);
+
+    // Physical page for each mapped virtual page
+    std::map<VAddr, PAddr> pages;
+
+    // Incremented on every change to pages, like Process::memory_map_generation
+    uint32_t generation = 0;
+
+    unsigned num_lookups = 0;
+
+    static constexpr PAddr host_memory_base = 0x20000000;
+
+    void Map(VAddr vaddr, PAddr paddr) {
+        pages[vaddr] = paddr;
+        ++generation;
+    }
+
+    void Unmap(VAddr vaddr) {
+        pages.erase(vaddr);
+        ++generation;
+    }
+
+    // Hook slots shared by all pages
+    std::unique_ptr<Memory::HookBase> read_hook;
+    std::unique_ptr<Memory::HookBase> write_hook;
+
+    std::optional<TranslationCache::Translation> LookupPhysical(PAddr page) {
+        ++num_lookups;
+        if (page < host_memory_base || page - host_memory_base >= host_memory.size()) {
+            return std::nullopt;
+        }
+        return TranslationCache::Translation { page, { host_memory.data() + (page - host_memory_base) }, { &read_hook, &write_hook } };
+    }
+
+    std::optional<TranslationCache::Translation> LookupVirtual(VAddr page) {
+        auto it = pages.find(page);
+        if (it == pages.end()) {
+            ++num_lookups;
+            return std::nullopt;
+        }
+        return LookupPhysical(it->second);
+    }
+
+    const TranslationCache::Entry* Lookup(TranslationCache& cache, VAddr addr) {
+        return cache.LookupVirtual(addr, generation, [this](VAddr page) { return LookupVirtual(page); });
+    }
+};
+
+} // anonymous namespace
+
+TEST_CASE("TranslationCache caches virtual pages") {
+    TestMemoryMap memory;
+    memory.Map(0x100000, 0x20001000);
+    TranslationCache cache;
+
+    auto entry = memory.Lookup(cache, 0x100123);
+    REQUIRE(entry);
+    REQUIRE(entry->paddr == 0x20001000);
+    REQUIRE(entry->page.data == memory.host_memory.data() + 0x1000);
+    REQUIRE(entry->hooks.read_hook == &memory.read_hook);
+    REQUIRE(entry->hooks.write_hook == &memory.write_hook);
+    REQUIRE(memory.num_lookups == 1);
+
+    REQUIRE(memory.Lookup(cache, 0x100ffc) == entry);
+    REQUIRE(memory.num_lookups == 1);
+
+    // Pages that can't be cached are looked up again on each access
+    REQUIRE(memory.Lookup(cache, 0x200000) == nullptr);
+    REQUIRE(memory.Lookup(cache, 0x200000) == nullptr);
+    REQUIRE(memory.num_lookups == 3);
+}
+
+TEST_CASE("HostMemoryBackedPage stays pointer-sized") {
+    // Page tables store one HostMemoryBackedPage per emulated page, so these must stay small
+    REQUIRE(sizeof(Memory::HostMemoryBackedPage) == sizeof(Memory::EmulatedMemory*));
+}
+
+TEST_CASE("TranslationCache evicts pages that map to the same entry") {
+    TestMemoryMap memory;
+    const VAddr conflicting_vaddr = 0x100000 + TranslationCache::num_entries * 0x1000;
+    memory.Map(0x100000, 0x20001000);
+    memory.Map(conflicting_vaddr, 0x20002000);
+    TranslationCache cache;
+
+    REQUIRE(memory.Lookup(cache, 0x100000)->paddr == 0x20001000);
+    REQUIRE(memory.Lookup(cache, conflicting_vaddr)->paddr == 0x20002000);
+    REQUIRE(memory.Lookup(cache, 0x100000)->paddr == 0x20001000);
+    REQUIRE(memory.num_lookups == 3);
+}
+
+TEST_CASE("TranslationCache flushes virtual pages when the memory map changes") {
+    TestMemoryMap memory;
+    memory.Map(0x100000, 0x20001000);
+    memory.Map(0x101000, 0x20002000);
+    TranslationCache cache;
+
+    REQUIRE(memory.Lookup(cache, 0x100000));
+    REQUIRE(memory.Lookup(cache, 0x101000));
+    cache.LookupPhysical(0x20003000, [&](PAddr page) { return memory.LookupPhysical(page); });
+
+    // Unmapping a page must not leave it accessible through the cache
+    memory.Unmap(0x100000);
+    REQUIRE(memory.Lookup(cache, 0x100000) == nullptr);
+
+    // Remapping a page to different memory must not return the old translation
+    memory.Unmap(0x101000);
+    memory.Map(0x101000, 0x20004000);
+    auto entry = memory.Lookup(cache, 0x101000);
+    REQUIRE(entry);
+    REQUIRE(entry->paddr == 0x20004000);
+    REQUIRE(entry->page.data == memory.host_memory.data() + 0x4000);
+
+    // Physical pages are not affected
+    const unsigned num_lookups = memory.num_lookups;
+    auto physical_entry = cache.LookupPhysical(0x20003000, [&](PAddr page) { return memory.LookupPhysical(page); });
+    REQUIRE(physical_entry);
+    REQUIRE(physical_entry->page.data == memory.host_memory.data() + 0x3000);
+    REQUIRE(memory.num_lookups == num_lookups);
+}
+
+TEST_CASE("TranslationCache only caches physical pages backed by host memory") {
+    TestMemoryMap memory;
+    TranslationCache cache;
+    auto lookup = [&](PAddr addr) {
+        return cache.LookupPhysical(addr, [&](PAddr page) { return memory.LookupPhysical(page); });
+    };
+
+    auto entry = lookup(0x20005678);
+    REQUIRE(entry);
+    REQUIRE(entry->tag == 0x20005000);
+    REQUIRE(entry->paddr == 0x20005000);
+    REQUIRE(lookup(0x20005000) == entry);
+    REQUIRE(memory.num_lookups == 1);
+
+    REQUIRE(lookup(0x10000000) == nullptr);
+    REQUIRE(lookup(0x10000000) == nullptr);
+    REQUIRE(memory.num_lookups == 3);
+}
@@ -0,0 +1,90 @@
+#include <arm/page_mappings.hpp>
+
+#include <catch2/catch.hpp>
+
+#include <utility>
+#include <vector>
+
+using namespace Interpreter;
+
+namespace {
+
+using Ranges = std::vector<std::pair</*VAddr*/ uint32_t, std::pair</*PAddr*/ uint32_t, uint32_t>>>;
+
+Ranges GetRanges(const PageMappings& mappings) {
+    Ranges ranges;
+    for (auto& [vstart, mapping] : mappings.GetMappings()) {
+        ranges.push_back({ vstart, { mapping.pstart, mapping.size } });
+    }
+    return ranges;
+}
+
+std::vector<uint32_t> GetVirtualAddressesOf(const PageMappings& mappings, uint32_t paddr) {
+    std::vector<uint32_t> vaddrs;
+    mappings.ForEachVirtualAddressOf(paddr, [&](uint32_t vaddr) { vaddrs.push_back(vaddr); });
+    return vaddrs;
+}
+
+} // anonymous namespace
+
+TEST_CASE("PageMappings finds all virtual pages mapped to a physical page") {
+    PageMappings mappings;
+    mappings.Insert(0x100000, 0x20000000, 0x4000);
+    mappings.Insert(0x200000, 0x20002000, 0x2000); // Aliases the second half of the first range
+    mappings.Insert(0x300000, 0x24000000, 0x1000);
+
+    REQUIRE(GetVirtualAddressesOf(mappings, 0x20000000) == std::vector<uint32_t> { 0x100000 });
+    REQUIRE(GetVirtualAddressesOf(mappings, 0x20001fff) == std::vector<uint32_t> { 0x101000 });
+    REQUIRE(GetVirtualAddressesOf(mappings, 0x20003123) == std::vector<uint32_t> { 0x103000, 0x201000 });
+    REQUIRE(GetVirtualAddressesOf(mappings, 0x24000000) == std::vector<uint32_t> { 0x300000 });
+    REQUIRE(GetVirtualAddressesOf(mappings, 0x20004000).empty());
+    REQUIRE(GetVirtualAddressesOf(mappings, 0x1ffff000).empty());
+}
+
+TEST_CASE("PageMappings removes whole ranges") {
+    PageMappings mappings;
+    mappings.Insert(0x100000, 0x20000000, 0x4000);
+    mappings.Insert(0x200000, 0x20002000, 0x2000);
+
+    mappings.Remove(0x100000, 0x4000);
+    REQUIRE(GetRanges(mappings) == Ranges { { 0x200000, { 0x20002000, 0x2000 } } });
+
+    // Other mappings of the same physical pages remain intact
+    REQUIRE(GetVirtualAddressesOf(mappings, 0x20002000) == std::vector<uint32_t> { 0x200000 });
+    REQUIRE(GetVirtualAddressesOf(mappings, 0x20000000).empty());
+}
+
+TEST_CASE("PageMappings trims and splits partially removed ranges") {
+    PageMappings mappings;
+    mappings.Insert(0x100000, 0x20000000, 0x8000);
+
+    // Trim the front and the back
+    mappings.Remove(0x100000, 0x1000);
+    mappings.Remove(0x107000, 0x1000);
+    REQUIRE(GetRanges(mappings) == Ranges { { 0x101000, { 0x20001000, 0x6000 } } });
+
+    // Split in the middle
+    mappings.Remove(0x103000, 0x2000);
+    REQUIRE(GetRanges(mappings) == Ranges { { 0x101000, { 0x20001000, 0x2000 } },
+                                            { 0x105000, { 0x20005000, 0x2000 } } });
+    REQUIRE(GetVirtualAddressesOf(mappings, 0x20003000).empty());
+    REQUIRE(GetVirtualAddressesOf(mappings, 0x20005000) == std::vector<uint32_t> { 0x105000 });
+}
+
+TEST_CASE("PageMappings removes ranges spanning multiple mappings") {
+    PageMappings mappings;
+    mappings.Insert(0x100000, 0x20000000, 0x2000);
+    mappings.Insert(0x102000, 0x21000000, 0x2000);
+    mappings.Insert(0x104000, 0x22000000, 0x2000);
+    mappings.Insert(0x108000, 0x23000000, 0x1000);
+
+    mappings.Remove(0x101000, 0x4000);
+    REQUIRE(GetRanges(mappings) == Ranges { { 0x100000, { 0x20000000, 0x1000 } },
+                                            { 0x105000, { 0x22001000, 0x1000 } },
+                                            { 0x108000, { 0x23000000, 0x1000 } } });
+
+    // Ranges ending at the top of the address space
+    mappings.Insert(0xfffff000, 0x24000000, 0x1000);
+    mappings.Remove(0xfffff000, 0x1000);
+    REQUIRE(GetRanges(mappings).size() == 3);
+}
@@ -0,0 +1,78 @@
+#include "framework/profiler.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <thread>
+
+TEST_CASE("Profiler activities") {
+    Profiler::Profiler profiler;
+    auto& os = profiler.GetActivity("OS");
+    auto& svc = os.GetSubActivity("SVC");
+
+    REQUIRE(&os.GetSubActivity("SVC") == &svc);
+    REQUIRE(!svc.IsMeasuring());
+
+    svc.Resume();
+    REQUIRE(svc.IsMeasuring());
+    REQUIRE(os.IsMeasuring());
+
+    // Resuming an unrelated activity interrupts the previous one
+    auto& gpu = profiler.GetActivity("GPU");
+    gpu.Resume();
+    REQUIRE(gpu.IsMeasuring());
+    REQUIRE(!svc.IsMeasuring());
+    REQUIRE(!os.IsMeasuring());
+
+    // Interrupting inactive activities is a no-op
+    svc.Interrupt();
+    gpu.Interrupt();
+    REQUIRE(!gpu.IsMeasuring());
+
+    {
+        auto scope = MeasureScope(os, "SVC", "WaitSyncN");
+        REQUIRE(svc.GetSubActivity("WaitSyncN").IsMeasuring());
+    }
+    REQUIRE(!os.IsMeasuring());
+}
+
+TEST_CASE("Profiler activities measured on multiple threads") {
+    Profiler::Profiler profiler;
+    auto& activity = profiler.GetActivity("Worker");
+
+    std::thread worker([&]() {
+        auto scope = MeasureScope(activity);
+        std::this_thread::sleep_for(std::chrono::milliseconds { 2 });
+    });
+    worker.join();
+
+    // Measurement state is per thread
+    REQUIRE(!activity.IsMeasuring());
+
+    auto metrics = profiler.Freeze();
+    auto it = std::find_if(metrics.sub_metrics.begin(), metrics.sub_metrics.end(),
+                           [&](auto& sub) { return &sub.activity == &activity; });
+    REQUIRE(it != metrics.sub_metrics.end());
+    REQUIRE(it->metric.total >= std::chrono::milliseconds { 2 });
+    REQUIRE(metrics.metric.total >= it->metric.total);
+}
+
+TEST_CASE("Profiler counters") {
+    Profiler::Profiler profiler;
+    auto& counter = profiler.GetCounter("Bytes");
+    REQUIRE(&profiler.GetCounter("Bytes") == &counter);
+
+    counter.Add(5);
+    std::thread worker([&]() {
+        for (int i = 0; i < 1000; ++i) {
+            counter.Add();
+        }
+    });
+    worker.join();
+
+    REQUIRE(counter.Total() == 1005);
+
+    auto counters = profiler.FreezeCounters();
+    REQUIRE(counters.size() == 1);
+    REQUIRE(counters[0].first == "Bytes");
+    REQUIRE(counters[0].second == 1005);
+}
@@ -5,10 +5,12 @@
 #include "platform/file_formats/cia.hpp"
 #include "platform/file_formats/ncch.hpp"
 #include "processes/pxi_fs.hpp"
+#include "processes/title_database.hpp"
 #define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
 
 #include "session.hpp"
 #include "os.hpp"
+#include "os_input_replay.hpp"
 
 #include "framework/logging.hpp"
 #include "framework/meta_tools.hpp"
@@ -45,7 +47,7 @@
 
 
 
-void InstallCIA(std::filesystem::path, spdlog::logger&, const KeyDatabase&, HLE::PXI::FS::FileContext&, HLE::PXI::FS::File&);
+void InstallCIA(std::filesystem::path, spdlog::logger&, const KeyDatabase&, HLE::PXI::TitleDatabase&, HLE::PXI::FS::FileContext&, HLE::PXI::FS::File&);
 
 
 using boost::endian::big_uint32_t;
@@ -120,6 +122,7 @@ int main(int argc, char* argv[]) {
             ("help", "produce help message")
             ("input", bpo::value<std::string>(&filename), "Input file to load")
             ("launch_menu", bpo::bool_switch(), "Launch Home Menu from NAND on startup")
+            ("fast_boot", bpo::bool_switch(), "Cache FIRM modules launched on startup to speed up subsequent boots")
             ("debug", bpo::bool_switch(&enable_debugging), "Connect to GDB upon startup")
             ("dump_frames", bpo::bool_switch(), "Dump frame data")
             // TODO: Instead read this from the game image... or add support for software reboots!
@@ -130,6 +133,17 @@ int main(int argc, char* argv[]) {
             ("enable_logging", bpo::bool_switch(&enable_logging), "Enable logging (slow!)")
             ("bootstrap_nand", bpo::bool_switch(&bootstrap_nand), "Bootstrap NAND from game update partition")
             ("enable_audio", bpo::bool_switch(), "Enable audio emulation (slow!)")
+            ("cycle_accounting", bpo::bool_switch(), "Advance emulated time by approximate instruction costs rather than by instruction count")
+            ("metrics_file", bpo::value<std::string>(), "Periodically write performance metrics to the given file")
+            ("ipc_stats", bpo::bool_switch(), "Collect per-service IPC statistics and serve them via the debug server")
+            ("ipc_stats_file", bpo::value<std::string>(), "Write per-service IPC statistics to the given file on exit (implies --ipc_stats)")
+            ("memory_heatmap_file", bpo::value<std::string>(), "Write per-page memory access statistics to the given file on exit (requires a build with ENABLE_MEMORY_HEATMAP)")
+            ("guest_profile_dir", bpo::value<std::string>(), "Sample emulated code and write flamegraph-compatible profiles to the given directory on exit")
+            ("guest_profile_interval", bpo::value<unsigned>()->default_value(Settings::GuestProfileInterval::default_value()), "Number of emulated CPU cycles between guest profiler samples of each thread")
+            ("guest_symbols", bpo::value<std::vector<std::string>>()->composing(), "Symbol file for the guest profiler, given as <process name>=<nm output file>")
+            ("deterministic", bpo::bool_switch(), "Latch input once per emulated frame so that repeated runs behave identically")
+            ("record_replay", bpo::value<std::string>(), "Record input to the given file for later playback (implies --deterministic)")
+            ("play_replay", bpo::value<std::string>(), "Play back input recorded to the given file instead of using live input (implies --deterministic)")
             ;
 
         boost::program_options::positional_options_description p;
@@ -195,6 +209,7 @@ int main(int argc, char* argv[]) {
 
         settings.set<Settings::DumpFrames>(vm["dump_frames"].as<bool>());
         settings.set<Settings::BootToHomeMenu>(vm["launch_menu"].as<bool>());
+        settings.set<Settings::FastBoot>(vm["fast_boot"].as<bool>());
         if (enable_debugging) {
             settings.set<Settings::ConnectToDebugger>(true);
             settings.set<Settings::AttachToProcessOnStartup>(vm["attach_to_process"].as<unsigned>());
@@ -214,6 +229,52 @@ int main(int argc, char* argv[]) {
         }
 
         settings.set<Settings::EnableAudioEmulation>(vm["enable_audio"].as<bool>());
+        settings.set<Settings::EnableCycleAccounting>(vm["cycle_accounting"].as<bool>());
+        settings.set<Settings::EnableIPCStatistics>(vm["ipc_stats"].as<bool>());
+
+        if (vm.count("metrics_file")) {
+            settings.set<Settings::MetricsDumpFile>(vm["metrics_file"].as<std::string>());
+        }
+
+        if (vm.count("ipc_stats_file")) {
+            settings.set<Settings::IPCStatsDumpFile>(vm["ipc_stats_file"].as<std::string>());
+        }
+
+        if (vm.count("memory_heatmap_file")) {
+            if (!Memory::enable_heatmap) {
+                std::cerr << "WARNING: Memory heatmap instrumentation is not available in this build" << std::endl;
+            }
+            settings.set<Settings::MemoryHeatmapFile>(vm["memory_heatmap_file"].as<std::string>());
+        }
+
+        if (vm.count("guest_profile_dir")) {
+            settings.set<Settings::GuestProfileDir>(vm["guest_profile_dir"].as<std::string>());
+        }
+        settings.set<Settings::GuestProfileInterval>(vm["guest_profile_interval"].as<unsigned>());
+        if (vm.count("guest_symbols")) {
+            settings.set<Settings::GuestProfileSymbols>(vm["guest_symbols"].as<std::vector<std::string>>());
+        }
+
+        settings.set<Settings::DeterministicExecution>(vm["deterministic"].as<bool>());
+        if (vm.count("record_replay")) {
+            settings.set<Settings::ReplayRecordFile>(vm["record_replay"].as<std::string>());
+        }
+        if (vm.count("play_replay")) {
+            settings.set<Settings::ReplayPlaybackFile>(vm["play_replay"].as<std::string>());
+
+            // Emulated timing must match the recording, so restore the settings it was recorded with
+            try {
+                auto replay_metadata = HLE::OS::InputReplay::ReadMetadata(vm["play_replay"].as<std::string>());
+                if (replay_metadata.cycle_accounting != settings.get<Settings::EnableCycleAccounting>()) {
+                    std::cerr << "WARNING: Replay was recorded with cycle accounting " << (replay_metadata.cycle_accounting ? "enabled" : "disabled")
+                              << ", overriding command line option" << std::endl;
+                }
+                settings.set<Settings::EnableCycleAccounting>(replay_metadata.cycle_accounting);
+            } catch (std::exception& err) {
+                std::cerr << "ERROR: " << err.what() << std::endl;
+                std::exit(1);
+            }
+        }
 
         if (vm.count("input")) {
             Settings::InitialApplicationTag::HostFile file{vm["input"].as<std::string>()};
@@ -266,6 +327,10 @@ if (bootstrap_nand) // Experimental system bootstrapper
         }
 
         std::filesystem::path content_dir = settings.get<Settings::PathDataDir>() + "/data";
+        std::filesystem::create_directories(content_dir);
+
+        // Shared across all installed CIAs so that the data directory is only scanned once
+        HLE::PXI::TitleDatabase title_database(*frontend_logger, content_dir, keydb);
 
         for (uint32_t metadata_offset = 0; metadata_offset < level3_header.file_metadata_size;) {
             FileFormat::RomFSFileMetadata file_metadata;
@@ -297,7 +362,7 @@ if (bootstrap_nand) // Experimental system bootstrapper
 
                 fprintf(stderr, "CIA header size: %#x\n", cia_header.header_size);
 
-                InstallCIA(content_dir, *frontend_logger, keydb, file_context, *cia_file);
+                InstallCIA(content_dir, *frontend_logger, keydb, title_database, file_context, *cia_file);
 
                 romfs = cia_file->ReleaseParentAndClose();
             }
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cryptopp/sha.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace Memory {
+
+// Child of CryptoPP::SHA256, the sole purpose of which is to publish some protected methods of SHA256
+struct MySHA256 : CryptoPP::SHA256 {
+    using Parent = IteratedHashWithStaticTransform<CryptoPP::word32, CryptoPP::BigEndian, 64, 32, CryptoPP::SHA256, 32, true>;
+
+    /// Pointer to data to be hashed (only block-wise!)
+    CryptoPP::word32* DataBuf() { return Parent::DataBuf(); }
+    /// Pointer to running hash
+    CryptoPP::word32* StateBuf() { return Parent::StateBuf(); }
+
+    using IteratedHashBase = CryptoPP::IteratedHashBase<CryptoPP::SHA256::HashWordType, CryptoPP::HashTransformation>;
+};
+
+struct ByteCountHiMember {
+    typedef MySHA256::HashWordType MySHA256::IteratedHashBase::*type;
+    friend type get(ByteCountHiMember);
+};
+
+struct ByteCountLoMember {
+    typedef MySHA256::HashWordType MySHA256::IteratedHashBase::*type;
+    friend type get(ByteCountLoMember);
+};
+
+/**
+ * Helper class used to access the private m_countHi and m_countLo data
+ * members of CryptoPP::SHA256.
+ * Yes, accessing private data members is possible.
+ * And yes, this is indeed ridiculously ugly - but a necessary evil, unless
+ * we want to require people to install a custom CryptoPP version.
+ */
+template<typename Tag, typename Tag::type M>
+struct CryptoPPPrivateDataMembersWorkaround {
+    friend typename Tag::type get(Tag) {
+        return M;
+    }
+};
+
+template struct CryptoPPPrivateDataMembersWorkaround<ByteCountHiMember, &MySHA256::IteratedHashBase::m_countHi>;
+template struct CryptoPPPrivateDataMembersWorkaround<ByteCountLoMember, &MySHA256::IteratedHashBase::m_countLo>;
+
+/**
+ * SHA256 state shared by the two HASH register blocks.
+ *
+ * Data written to the input FIFO is collected in a buffer of complete blocks
+ * that is only hashed once it fills up or once the guest observes the hash
+ * state. Passing many blocks to CryptoPP at once lets it use its
+ * multi-block transform, which is backed by the SHA extensions on CPUs that
+ * support them.
+ */
+struct HashEngine {
+    static constexpr uint32_t block_size = 0x40;
+    static constexpr uint32_t max_pending_blocks = 0x100;
+
+    MySHA256 hash;
+
+    // Complete blocks that have not been passed to the hash yet, followed by the block currently being written
+    std::array<uint8_t, (max_pending_blocks + 1) * block_size> pending {};
+    uint32_t pending_blocks = 0;
+
+    std::array<uint8_t, 0x20> running_hash {};
+
+    // Set if blocks were added since running_hash was last updated from the hash state
+    bool running_hash_stale = false;
+
+    uint32_t hashed_data_size = 0; // size of data that went into the FIFO so far
+
+    uint8_t* CurrentBlock() {
+        return &pending[pending_blocks * block_size];
+    }
+
+    // Passes all complete blocks to the hash and moves the current block to the start of the buffer
+    void Flush() {
+        if (!pending_blocks) {
+            return;
+        }
+
+        hash.Update(pending.data(), pending_blocks * block_size);
+        memcpy(pending.data(), CurrentBlock(), block_size);
+        pending_blocks = 0;
+    }
+
+    void OnBlockCompleted() {
+        ++pending_blocks;
+        memset(CurrentBlock(), 0, block_size);
+        running_hash_stale = true;
+        if (pending_blocks == max_pending_blocks) {
+            Flush();
+        }
+    }
+
+    void WriteFIFO(uint32_t offset, const uint8_t* data, uint32_t size) {
+        memcpy(CurrentBlock() + offset, data, size);
+
+        // TODO: It seems that the hashed data size (as reported in MMIO reads) will only get updated in 0x40 chunks! Our current code needs the byte-precise information though, so we just keep updating this and return the cropped version when reading i back
+        hashed_data_size += size;
+
+        if (offset + size == block_size) {
+            OnBlockCompleted();
+        }
+    }
+
+    // Equivalent to writing the given data to the FIFO registers sequentially, but hashes full blocks in place
+    void FeedFIFO(const uint8_t* data, uint32_t size) {
+        // Fill up the current block first
+        while (size && (hashed_data_size % block_size)) {
+            auto chunk_size = std::min(size, block_size - hashed_data_size % block_size);
+            WriteFIFO(hashed_data_size % block_size, data, chunk_size);
+            data += chunk_size;
+            size -= chunk_size;
+        }
+
+        uint32_t bulk_size = size - size % block_size;
+        if (bulk_size) {
+            Flush();
+            hash.Update(data, bulk_size);
+            hashed_data_size += bulk_size;
+            running_hash_stale = true;
+            data += bulk_size;
+            size -= bulk_size;
+        }
+
+        if (size) {
+            WriteFIFO(0, data, size);
+        }
+    }
+
+    const std::array<uint8_t, 0x20>& GetRunningHash() {
+        if (running_hash_stale) {
+            Flush();
+
+            // TODO: Endianness? I think StateBuf is a uint32_t pointer...
+            memcpy(running_hash.data(), hash.StateBuf(), sizeof(running_hash));
+            running_hash_stale = false;
+        }
+        return running_hash;
+    }
+
+    void WriteRunningHash(uint32_t offset, const uint8_t* data, uint32_t size) {
+        // Pending blocks must be hashed based on the state prior to this write
+        GetRunningHash();
+
+        memcpy(&running_hash[offset], data, size);
+        memcpy(reinterpret_cast<char*>(hash.StateBuf()) + offset, data, size);
+    }
+
+    void SetByteCount(uint32_t value) {
+        Flush();
+
+        // TODOTEST: When writing a non-0x40-byte aligned value, will the lower bits be chopped off on read back?
+        hashed_data_size = value;
+
+        // NOTE: This code is an ugly hack (see the definition of
+        //       "CryptoPPPrivateDataMembersWorkaround" above) to access
+        //       some data members of CryptoPP::SHA256 even though they
+        //       are private. This is necessary to restore a given state
+        //       as required to implement the HASH registers properly.
+        hash.*get(ByteCountHiMember()) = 0;
+        hash.*get(ByteCountLoMember()) = value;
+    }
+
+    void Reset() {
+        pending.fill(0);
+        pending_blocks = 0;
+        running_hash.fill(0);
+        running_hash_stale = false;
+        hash = decltype(hash){};
+        hashed_data_size = 0;
+    }
+
+    void Finalize() {
+        // Hash pending data, if any
+        Flush();
+        if (hashed_data_size % block_size) {
+            hash.Update(pending.data(), hashed_data_size % block_size);
+        }
+        hash.Final(running_hash.data());
+        running_hash_stale = false;
+    }
+};
+
+} // namespace Memory
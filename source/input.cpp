@@ -74,6 +74,10 @@ void InputSource::SetPressedHome(bool pressed) {
 }
 
 auto InputSource::GetTouchState() -> TouchState {
+    if (latched) {
+        return latched->touch;
+    }
+
     std::lock_guard lock(touch_mutex);
 
     return touch;
@@ -94,6 +98,10 @@ void InputSource::EndTouch() {
 }
 
 auto InputSource::GetCirclePadState() -> CirclePadState {
+    if (latched) {
+        return latched->circle_pad;
+    }
+
     std::lock_guard lock(touch_mutex);
 
     return circle_pad;
@@ -105,3 +113,13 @@ void InputSource::SetCirclePad(float x, float y) {
     circle_pad.x = x;
     circle_pad.y = y;
 }
+
+auto InputSource::GetFrontendState() -> Snapshot {
+    std::lock_guard lock(touch_mutex);
+
+    return Snapshot { buttons, touch, circle_pad, home_button };
+}
+
+void InputSource::Latch(const Snapshot& state) {
+    latched = state;
+}
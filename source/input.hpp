@@ -3,6 +3,7 @@
 #include <atomic>
 #include <cstdint>
 #include <mutex>
+#include <optional>
 
 /**
  * Interface for the frontend to set emulator-visible input state.
@@ -22,6 +23,15 @@ class InputSource {
         float y = 0.f;
     };
 
+public:
+    struct Snapshot {
+        uint16_t buttons = 0;
+        TouchState touch;
+        CirclePadState circle_pad;
+        bool home_button = false;
+    };
+
+private:
     std::atomic<uint16_t> buttons { 0 };
 
     std::mutex touch_mutex;
@@ -30,16 +40,32 @@ class InputSource {
 
     std::atomic<bool> home_button;
 
+    // If set, Get* member functions return this state instead of the one set by the frontend
+    std::optional<Snapshot> latched;
+
 public:
     uint16_t GetButtonState() const {
-        return buttons;
+        return latched ? latched->buttons : buttons.load();
     }
 
     TouchState GetTouchState();
 
     CirclePadState GetCirclePadState();
 
-    bool IsHomeButtonPressed() const { return home_button; };
+    bool IsHomeButtonPressed() const { return latched ? latched->home_button : home_button.load(); };
+
+    /**
+     * Returns the input state most recently set by the frontend, regardless
+     * of any latched state
+     */
+    Snapshot GetFrontendState();
+
+    /**
+     * Makes the emulator core observe the given state until the next call to
+     * Latch, instead of any changes applied by the frontend meanwhile.
+     * Reserved for the emulator core, like Get* member functions.
+     */
+    void Latch(const Snapshot&);
 
     void SetPressedA(bool);
     void SetPressedB(bool);
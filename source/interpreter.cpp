@@ -3,6 +3,7 @@
 #include "arm/processor_default.hpp"
 #include "arm/processor_interpreter.hpp"
 #include "os.hpp"
+#include "os_guest_profiler.hpp"
 
 #include <framework/exceptions.hpp>
 
@@ -2955,6 +2956,96 @@ InterpreterARMHandlerForJIT LookupHandler(ARM::Instr instr) {
 
 static const auto default_dispatch_table = GenerateDispatchTable(LookupHandler, Wrap<LegacyHandler>);
 
+/**
+ * Approximate issue costs of ARM instruction classes on the ARM11 MPCore, in
+ * CPU cycles. These are charged to the cycle counter when cycle accounting is
+ * enabled, so that emulated time (and hence the system tick and timer
+ * interrupts) advances roughly at the rate titles expect from real hardware.
+ *
+ * Pipeline interlocks and cache effects are not modeled.
+ */
+static constexpr uint8_t LookupCycleCost(ARM::Instr instr) {
+    switch (instr) {
+    case ARM::Instr::MUL:
+        return 3;
+
+    case ARM::Instr::B:
+    case ARM::Instr::BL:
+    case ARM::Instr::BX:
+    case ARM::Instr::BLX:
+    case ARM::Instr::BLXImm:
+        return 3;
+
+    case ARM::Instr::LDR:
+    case ARM::Instr::LDRB:
+    case ARM::Instr::LDRH:
+    case ARM::Instr::LDRSH:
+    case ARM::Instr::LDRSB:
+    case ARM::Instr::STR:
+    case ARM::Instr::STRB:
+    case ARM::Instr::STRH:
+    case ARM::Instr::VLDR:
+    case ARM::Instr::VSTR:
+        return 2;
+
+    case ARM::Instr::LDRD:
+    case ARM::Instr::STRD:
+    case ARM::Instr::MRRC:
+    case ARM::Instr::MCRR:
+    case ARM::Instr::MRRC_VFP:
+    case ARM::Instr::MCRR_VFP:
+        return 2;
+
+    // Block transfers take roughly one cycle per pair of registers
+    case ARM::Instr::LDM:
+    case ARM::Instr::STM:
+    case ARM::Instr::VLDM:
+    case ARM::Instr::VSTM:
+        return 4;
+
+    case ARM::Instr::VFP_S:
+        return 2;
+
+    case ARM::Instr::VFP_D:
+        return 4;
+
+    case ARM::Instr::SWI:
+        return 8;
+
+    default:
+        return 1;
+    }
+}
+
+static const auto arm_cycle_costs = GenerateDispatchTable(LookupCycleCost, uint8_t { 1 });
+
+// Same as LookupCycleCost, but for Thumb instructions indexed by their upper 8 bits
+static constexpr std::array<uint8_t, 256> thumb_cycle_costs = [] {
+    std::array<uint8_t, 256> costs { };
+    for (unsigned index = 0; index < costs.size(); ++index) {
+        if (index == 0x47) {
+            // BX/BLX
+            costs[index] = 3;
+        } else if (index >= 0x48 && index < 0xa0) {
+            // Loads and stores
+            costs[index] = 2;
+        } else if ((index & 0xf6) == 0xb4 || (index >= 0xc0 && index < 0xd0)) {
+            // PUSH/POP and LDMIA/STMIA
+            costs[index] = 4;
+        } else if (index == 0xdf) {
+            // SWI
+            costs[index] = 8;
+        } else if (index >= 0xd0 && index < 0xe8) {
+            // Conditional and unconditional branches
+            costs[index] = 3;
+        } else {
+            // Data processing and both halves of BL/BLX
+            costs[index] = 1;
+        }
+    }
+    return costs;
+}();
+
 static uint32_t HandlerStubThumb(CPUContext& ctx, ARM::ThumbInstr instr, const std::string& message) {
     std::stringstream err;
     err << "Unknown instruction 0x" << std::hex << std::setw(4) << std::setfill('0') << instr.raw;
@@ -3147,7 +3238,13 @@ InterpreterExecutionContext* Interpreter::CreateExecutionContextImpl2() {
     return new InterpreterExecutionContext(*this, setup);
 }
 
-template<auto arm_dispatch_table>
+/**
+ * Fetches, decodes, and executes the instruction at the current PC.
+ * The retired instruction counter is always updated. If cycle_accounting is
+ * set, the instruction's approximate cycle cost is added to the cycle counter;
+ * callers are responsible for counting cycles otherwise.
+ */
+template<auto arm_dispatch_table, bool cycle_accounting = false>
 static void StepWithDispatchTable(ExecutionContext& ctx_) try {
     auto& ctx = static_cast<InterpreterExecutionContext&>(ctx_);
 //    if (!ctx.backtrace.empty() && ctx.cpu.PC() == ctx.backtrace.back().source + (ctx.cpu.cpsr.thumb ? 2 : 4))
@@ -3156,6 +3253,8 @@ static void StepWithDispatchTable(ExecutionContext& ctx_) try {
     // TODO: Instead of translating the PC here over and over again, just have the OS allocate linear .text memory instead and just get a pointer to it using Memory::LookupContiguousMemoryBackedPage!
     uint32_t pc_phys = *ctx.TranslateVirtualAddress(ctx.cpu.PC());
 
+    ++ctx.cpu.instruction_count;
+
     // Fetch and process next instruction
     if (ctx.cpu.cpsr.thumb) {
 
@@ -3164,6 +3263,9 @@ static void StepWithDispatchTable(ExecutionContext& ctx_) try {
 //             throw std::runtime_error("Unaligned THUMB PC");
 
         ARM::ThumbInstr instr = { ReadPhysicalMemory<uint16_t>(ctx.setup->mem, pc_phys) };
+        if constexpr (cycle_accounting) {
+            ctx.cpu.cycle_count += thumb_cycle_costs[instr.raw >> 8];
+        }
         ctx.cpu.PC() = DispatchThumb<arm_dispatch_table>(ctx, instr);
     } else {
 // TODO: Do this check when a jump or thumb/arm mode switch happens!
@@ -3173,9 +3275,16 @@ static void StepWithDispatchTable(ExecutionContext& ctx_) try {
         // TODO: This is always an aligned read. We can considerably speed up this operation with that in mind!
         ARM::ARMInstr instr = { ReadPhysicalMemory<uint32_t>(ctx.setup->mem, pc_phys) };
         if (instr.cond != 0xf) {
-            ctx.cpu.PC() = (*arm_dispatch_table)[ARM::BuildDispatchTableKey(instr.raw)](ctx_, instr);
+            const auto dispatch_key = ARM::BuildDispatchTableKey(instr.raw);
+            if constexpr (cycle_accounting) {
+                ctx.cpu.cycle_count += arm_cycle_costs[dispatch_key];
+            }
+            ctx.cpu.PC() = (*arm_dispatch_table)[dispatch_key](ctx_, instr);
         } else {
             // Handle unconditional instructions explicitly
+            if constexpr (cycle_accounting) {
+                ctx.cpu.cycle_count += 1;
+            }
 
             if (instr.opcode_prim == 0b1010 || instr.opcode_prim == 0b1011) {
                 // Branch with Link and Exchange
@@ -3241,16 +3350,42 @@ static void TriggerPreemption(InterpreterExecutionContext& ctx) {
     ctx.os->SwitchToSchedulerFromThread(*ctx.os->active_thread);
 }
 
+// Runs instructions until the cycle counter reaches the given value
+template<bool cycle_accounting>
+static void RunUntilCycle(InterpreterExecutionContext& ctx, uint64_t end_cycle) {
+    while (ctx.cpu.cycle_count < end_cycle) {
+        if constexpr (!cycle_accounting) {
+            ++ctx.cpu.cycle_count;
+        }
+        StepWithDispatchTable<&default_dispatch_table, cycle_accounting>(ctx);
+    }
+}
+
 void Interpreter::Run(ExecutionContext& ctx_, ProcessorController& controller, uint32_t process_id, uint32_t thread_id) try {
     auto& ctx = static_cast<InterpreterExecutionContext&>(ctx_);
     ctx.controller = &controller;
+    const bool cycle_accounting = ctx.os->settings.get<Settings::EnableCycleAccounting>();
+    auto run_until_cycle = cycle_accounting ? &RunUntilCycle<true> : &RunUntilCycle<false>;
+    HLE::OS::GuestProfiler* guest_profiler = ctx.os->guest_profiler.get();
     for (;;) {
         if (!ctx.debugger_attached) {
-            // Run a bunch of instructions at a time, then check the debugging state again
-            for (int i = 0; i < 10000; ++i) {
-//            for (int i = 0; i < ctx.os->active_thread->GetParentProcess().GetId() == 17 ? 10 : 10000; ++i) {
-                ++ctx.cpu.cycle_count;
-                StepWithDispatchTable<&default_dispatch_table>(ctx);
+            // Run a bunch of cycles at a time, then check the debugging state again
+            const auto slice_end = ctx.cpu.cycle_count + 10000;
+            if (!guest_profiler) {
+                run_until_cycle(ctx, slice_end);
+            } else {
+                // Split the slice at sampling points so that samples are spread evenly over the executed code
+                if (!ctx.next_profiler_sample) {
+                    ctx.next_profiler_sample = ctx.cpu.cycle_count + guest_profiler->GetSampleInterval();
+                }
+                while (ctx.cpu.cycle_count < slice_end) {
+                    run_until_cycle(ctx, std::min(slice_end, ctx.next_profiler_sample));
+                    if (ctx.cpu.cycle_count >= ctx.next_profiler_sample) {
+                        auto& process = static_cast<HLE::OS::EmuProcess&>(ctx.os->active_thread->GetParentProcess());
+                        guest_profiler->RecordSample(process, ctx.cpu.PC(), ctx.cpu.LR());
+                        ctx.next_profiler_sample = ctx.cpu.cycle_count + guest_profiler->GetSampleInterval();
+                    }
+                }
             }
 
             TriggerPreemption(ctx);
@@ -3307,9 +3442,15 @@ void Interpreter::Run(ExecutionContext& ctx_, ProcessorController& controller, u
             }
 
             // Single step
-            StepWithDispatchTable<&default_dispatch_table>(ctx);
-            ++ctx.cpu.cycle_count;
-            if ((ctx.cpu.cycle_count & 0xFFF) == 0) {
+            const auto prev_cycle_count = ctx.cpu.cycle_count;
+            if (cycle_accounting) {
+                StepWithDispatchTable<&default_dispatch_table, true>(ctx);
+            } else {
+                StepWithDispatchTable<&default_dispatch_table>(ctx);
+                ++ctx.cpu.cycle_count;
+            }
+            // Preempt whenever a multiple of 0x1000 cycles is crossed
+            if ((prev_cycle_count ^ ctx.cpu.cycle_count) & ~uint64_t { 0xFFF }) {
                 TriggerPreemption(ctx);
             }
         }
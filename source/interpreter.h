@@ -340,6 +340,9 @@ struct CPUContext {
 
     bool trap_on_resume = false;
 
+    // Cycle count at which the guest profiler samples this context next
+    uint64_t next_profiler_sample = 0;
+
     ControlFlowLogger cfl{};
 
     void RecordCall(uint32_t source, uint32_t target, ARM::State state);
@@ -396,6 +399,12 @@ struct ExecutionContext {
     virtual ARM::State ToGenericContext() = 0;
     virtual void FromGenericContext(const ARM::State&) = 0;
 
+    // Equivalent to ToGenericContext().cycle_count, without copying the full CPU state
+    virtual uint64_t GetCycleCount() const = 0;
+
+    // Equivalent to ToGenericContext().instruction_count
+    virtual uint64_t GetInstructionCount() const = 0;
+
     /**
      * Enables ProcessorController to take control over the thread corresponding to this context.
      */
@@ -1,9 +1,9 @@
-#include <cryptopp/sha.h>
 #include "display.hpp"
 #include "input.hpp"
 #include "memory.h"
 
 #include "hardware/dsp.hpp"
+#include "hardware/hash.hpp"
 
 #include "framework/bit_field_new.hpp"
 #include "framework/exceptions.hpp"
@@ -22,9 +22,18 @@
 
 #include <teakra/teakra.h>
 
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <new>
 #include <optional>
 
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#include <unistd.h>
+#define MIKAGE_HAS_MMAN 1
+#endif
+
 Teakra::Teakra* g_teakra = nullptr; // TODO: Remove
 Memory::PhysicalMemory* g_mem = nullptr; // TODO: Remove
 bool g_dsp_running = false; // TODO: Remove
@@ -173,6 +182,7 @@ struct GPU : MemoryAccessHandler {
     uint32_t Read32(uint32_t offset) {
         logger->info("Read from GPU register {:#010x}", offset);
 
+        ScopedAccessSource access_source(AccessSource::GPU);
         uint32_t ret;
         ::GPU::Read<uint32_t>(*context, ret, offset + 0x1EF00000);
         return ret;
@@ -234,74 +244,27 @@ struct GPU : MemoryAccessHandler {
 #endif
         // Forward register write to video_core
         // TODO: Catch writes to registers unknown to video_core
+        ScopedAccessSource access_source(AccessSource::GPU);
         ::GPU::Write<uint32_t>(*context, offset, value);
     }
 };
 
-// Child of CryptoPP::SHA256, the sole purpose of which is to publish some protected methods of SHA256
-struct MySHA256 : CryptoPP::SHA256 {
-    using Parent = IteratedHashWithStaticTransform<CryptoPP::word32, CryptoPP::BigEndian, 64, 32, CryptoPP::SHA256, 32, true>;
-
-    /// Pointer to data to be hashed (only block-wise!)
-    CryptoPP::word32* DataBuf() { return Parent::DataBuf(); }
-    /// Pointer to running hash
-    CryptoPP::word32* StateBuf() { return Parent::StateBuf(); }
-
-    using IteratedHashBase = CryptoPP::IteratedHashBase<CryptoPP::SHA256::HashWordType, CryptoPP::HashTransformation>;
-};
-
-// TODO: Remove these globals
-static uint8_t hash_data[0x40]; // data to be hashed
-static uint8_t running_hash[0x20];
-MySHA256 hash;
-uint32_t hashed_data_size = 0; // size of data that went into running_hash so far
-
-struct ByteCountHiMember {
-    typedef MySHA256::HashWordType MySHA256::IteratedHashBase::*type;
-    friend type get(ByteCountHiMember);
-};
-
-struct ByteCountLoMember {
-    typedef MySHA256::HashWordType MySHA256::IteratedHashBase::*type;
-    friend type get(ByteCountLoMember);
-};
-
-/**
- * Helper class used to access the private m_countHi and m_countLo data
- * members of CryptoPP::SHA256.
- * Yes, accessing private data members is possible.
- * And yes, this is indeed ridiculously ugly - but a necessary evil, unless
- * we want to require people to install a custom CryptoPP version.
- */
-template<typename Tag, typename Tag::type M>
-struct CryptoPPPrivateDataMembersWorkaround {
-    friend typename Tag::type get(Tag) {
-        return M;
-    }
-};
-
-template struct CryptoPPPrivateDataMembersWorkaround<ByteCountHiMember, &MySHA256::IteratedHashBase::m_countHi>;
-template struct CryptoPPPrivateDataMembersWorkaround<ByteCountLoMember, &MySHA256::IteratedHashBase::m_countLo>;
-
 struct HASH : MemoryAccessHandler {
     std::shared_ptr<spdlog::logger> logger;
     uint32_t base;
 
+    std::shared_ptr<HashEngine> engine;
+
     uint32_t hash_cnt = 0;
 
-    HASH(LogManager& log_manager, const char* log_name, uint32_t base) : logger(log_manager.RegisterLogger(log_name)), base(base) {
+    HASH(LogManager& log_manager, const char* log_name, uint32_t base, std::shared_ptr<HashEngine> engine)
+        : logger(log_manager.RegisterLogger(log_name)), base(base), engine(std::move(engine)) {
 
     }
 
     uint32_t Read32(uint32_t offset) {
-//         static int iter = 0;
-
         uint32_t ret = 0;
 
-//         if (iter >= 2 && iter < 5)
-//             ret = 1;
-//         iter++;
-
         if (offset >= 0x40 && offset < 0x60) {
             // TODO: This may actually also be used to read the running hash!
             // The FS module does this while hashing the loaded application's ExeFS. While doing so, it is doing the following:
@@ -313,29 +276,19 @@ struct HASH : MemoryAccessHandler {
             // * Write the amount of bytes already hashed to 0x10101004 (not sure if this is relevant)
             // * Write the remaining data to the HASH IO registers and finalize hashing as usual
             boost::endian::little_uint32_t hashpart;
-            memcpy(&hashpart, &running_hash[offset - 0x40], sizeof(hashpart));
+            memcpy(&hashpart, &engine->GetRunningHash()[offset - 0x40], sizeof(hashpart));
             ret = hashpart;
-//             static int lol =0;
-//             lol++;
-//             ret = lol;
 
             // TODO: Assert this is only read when there is no pending (incomplete) block
         } else if (offset == 0x4) {
-//             if ((hashed_data_size % 0x40) != 0)
-//                 throw std::runtime_error("hashed_data size somehow got unaligned!");
-
             // NOTE: data size gets updated every 0x40 hashed bytes. It's unknown what happens if you write a non-0x40-byte-aligned value and try to read it back, though!
-            ret = (hashed_data_size / 0x40) * 0x40;
-//             ret = 0xdeadbeef;
-//             ret = 0x20;
-//            ret = hashed_data_size;
-
+            ret = (engine->hashed_data_size / 0x40) * 0x40;
         } else if (offset == 0x0) {
             ret = hash_cnt;
         } else {
             throw std::runtime_error("Read from unknown HASH reg");
         }
-        logger->warn("Read from HASH register {:#010x} {:#x}-> {:#010x}", base + offset, offset, ret);
+        logger->trace("Read from HASH register {:#010x} {:#x}-> {:#010x}", base + offset, offset, ret);
 
         return ret;
     }
@@ -363,25 +316,7 @@ struct HASH : MemoryAccessHandler {
 //                                                     boost::endian::big_uint16_t,
                                                     boost::endian::little_uint16_t,
                                                     uint8_t>> be_value = value;
-                memcpy(&hash_data[offset], &be_value, sizeof(be_value));
-
-                // TODO: It seems that the hashed data size (as reported in MMIO reads) will only get updated in 0x40 chunks! Our current code needs the byte-precise information though, so we just keep updating this and return the cropped version when reading i back
-                hashed_data_size += sizeof(T);
-
-                if (offset == 0x40 - sizeof(T)) {
-                    hash.Update(hash_data, sizeof(hash_data));
-                    // TODOTODO: Use Transform instead!
-
-                    memset(hash_data, 0, sizeof(hash_data));
-
-//                     logger->warn("Written to final hash data register after {:#x} bytes, updating hash", hashed_data_size);
-
-                    if (!hash.StateBuf())
-                        throw std::runtime_error("bla2");
-
-                    // TODO: Endianness? I think StateBuf is a uint32_t pointer...
-                    memcpy(running_hash, hash.StateBuf(), sizeof(running_hash));
-                }
+                engine->WriteFIFO(offset, reinterpret_cast<const uint8_t*>(&be_value), sizeof(be_value));
             } else if (offset >= 0x40 && offset < 0x60) {
                 throw std::runtime_error("bla");
             } else {
@@ -391,16 +326,7 @@ struct HASH : MemoryAccessHandler {
             if (sizeof(T) != 4)
                 throw std::runtime_error("Only 32-bit writes supported in this code path");
 
-            // TODOTEST: When writing a non-0x40-byte aligned value, will the lower bits be chopped off on read back?
-            hashed_data_size = value;
-
-            // NOTE: This code is an ugly hack (see the definition of
-            //       "CryptoPPPrivateDataMembersWorkaround" above) to access
-            //       some data members of CryptoPP::SHA256 even though they
-            //       are private. This is necessary to restore a given state
-            //       as required to implement the HASH registers properly.
-            hash.*get(ByteCountHiMember()) = 0;
-            hash.*get(ByteCountLoMember()) = value;
+            engine->SetByteCount(value);
             logger->warn("Resetting HASH byte count to {:#x}", value);
         } else {
             if (offset == 0) {
@@ -410,23 +336,15 @@ struct HASH : MemoryAccessHandler {
                     throw std::runtime_error("Only 32-bit writes supported in this code path");
 
                 if (value & 1) {
-//                     static int lol = 0;
-                    memset(hash_data, 0, sizeof(hash_data));
-                    memset(running_hash, 0, sizeof(running_hash));
-                    hash = decltype(hash){};
-                    hashed_data_size = 0;
+                    engine->Reset();
 
                     // TODO: Should we instead keep hash_data, running_hash, and hashed_data_size at their prior values?
                     logger->warn("Reset HASH engine");
                 }
 
                 if (value & 2) {
-                    // Hash pending data, if any
-                    if (hashed_data_size % 0x40) {
-                        hash.Update(hash_data, hashed_data_size % 0x40);
-                    }
-                    logger->warn("Finalizing HASH engine after {:#x} bytes", hashed_data_size);
-                    hash.Final(running_hash);
+                    logger->warn("Finalizing HASH engine after {:#x} bytes", engine->hashed_data_size);
+                    engine->Finalize();
                 }
                 hash_cnt = value & 0xfffffffc;
             } else if (offset >= 0x40 && offset < 0x60) {
@@ -435,13 +353,12 @@ struct HASH : MemoryAccessHandler {
 
 //                 boost::endian::big_uint32_t be_val = value;
                 boost::endian::little_uint32_t be_val = value;
-                memcpy(&running_hash[offset - 0x40], &be_val, sizeof(be_val));
-                memcpy(reinterpret_cast<char*>(hash.StateBuf()) + (offset - 0x40), &be_val, sizeof(be_val));
+                engine->WriteRunningHash(offset - 0x40, reinterpret_cast<const uint8_t*>(&be_val), sizeof(be_val));
 
                 logger->warn("Write to HASH register {:#010x} {:#x}<- {:#010x}", base, offset, value);
             }
         }
-        logger->warn("{}-bit write to HASH register {:#010x} {:#x}<- {:#010x}", sizeof(T) * 8, base, offset, value);
+        logger->trace("{}-bit write to HASH register {:#010x} {:#x}<- {:#010x}", sizeof(T) * 8, base, offset, value);
     }
 };
 
@@ -1054,21 +971,27 @@ struct DSPMMIO : MemoryAccessHandler {
                 // NOTE: These don't seem to be needed (only for unaligned memory accesses?)
                 static Teakra::AHBMCallback ahbm;
                 ahbm.read8 = [](uint32_t addr) -> uint8_t {
+                    ScopedAccessSource access_source(AccessSource::DSP);
                     return ReadLegacy<uint8_t>(*g_mem, addr);
                 };
                 ahbm.read16 = [](uint32_t addr) -> uint16_t {
+                    ScopedAccessSource access_source(AccessSource::DSP);
                     return ReadLegacy<uint16_t>(*g_mem, addr);
                 };
                 ahbm.read32 = [](uint32_t addr) -> uint32_t {
+                    ScopedAccessSource access_source(AccessSource::DSP);
                     return ReadLegacy<uint32_t>(*g_mem, addr);
                 };
                 ahbm.write8 = [](uint32_t addr, uint8_t value) {
+                    ScopedAccessSource access_source(AccessSource::DSP);
                     return WriteLegacy(*g_mem, addr, value);
                 };
                 ahbm.write16 = [](uint32_t addr, uint16_t value) {
+                    ScopedAccessSource access_source(AccessSource::DSP);
                     return WriteLegacy(*g_mem, addr, value);
                 };
                 ahbm.write32 = [](uint32_t addr, uint32_t value) {
+                    ScopedAccessSource access_source(AccessSource::DSP);
                     return WriteLegacy(*g_mem, addr, value);
                 };
                 g_teakra->SetAHBMCallback(ahbm);
@@ -1245,6 +1168,31 @@ void MemoryAccessHandler::Write32(uint32_t offset, uint32_t value) {
     throw std::runtime_error(fmt::format("Unimplemented 32-bit write of {:#10x} to offset {:#010x}", value, offset));
 }
 
+uint8_t* detail::AllocateHostMemory(uint32_t num_bytes) {
+#ifdef MIKAGE_HAS_MMAN
+    // Anonymous mappings are zero-filled on demand by the host
+    void* data = mmap(nullptr, num_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+        throw std::bad_alloc { };
+    }
+    return static_cast<uint8_t*>(data);
+#else
+    auto data = static_cast<uint8_t*>(std::calloc(num_bytes, 1));
+    if (!data) {
+        throw std::bad_alloc { };
+    }
+    return data;
+#endif
+}
+
+void detail::FreeHostMemory(uint8_t* data, uint32_t num_bytes) {
+#ifdef MIKAGE_HAS_MMAN
+    munmap(data, num_bytes);
+#else
+    std::free(data);
+#endif
+}
+
 // TODO: Stop creating temporary FCRAM pointers and instead use just FCRAM{}
 PhysicalMemory::PhysicalMemory(LogManager& log_manager)
     // Large memory blocks like FCRAM are explicitly heap-allocated here
@@ -1254,17 +1202,31 @@ PhysicalMemory::PhysicalMemory(LogManager& log_manager)
              IO_LCD(std::make_unique<LCD>(log_manager)),
              IO_AXI(std::make_unique<AXIHandler>(log_manager)),
              IO_GPU(std::make_unique<GPU>(log_manager)),
-             IO_HASH(std::make_unique<HASH>(log_manager, "IO_HASH_1", 0x10101000)),
+             IO_HASH(std::make_unique<HASH>(log_manager, "IO_HASH_1", 0x10101000, std::make_shared<HashEngine>())),
              IO_CONFIG11(std::make_unique<CONFIG11>(log_manager)),
              IO_DSP1(std::make_unique<DSPMMIO>(log_manager, "IO_DSP_1")),
              IO_SPIBUS2(std::make_unique<SPI>(log_manager, "IO_SPI_2", 0x10142000)),
              IO_SPIBUS3(std::make_unique<SPI>(log_manager, "IO_SPI_3", 0x10143000)),
-             IO_HASH2(std::make_unique<HASH>(log_manager, "IO_HASH_2", 0x10301000)),
+             IO_HASH2(std::make_unique<HASH>(log_manager, "IO_HASH_2", 0x10301000, nullptr)),
              IO_GPIO(std::make_unique<GPIO>(log_manager)),
              IO_SPIBUS1(std::make_unique<SPI>(log_manager, "IO_SPI_1", 0x10160000)),
              IO_DSP2(std::make_unique<DSPMMIO>(log_manager, "IO_DSP_2")),
              MPCorePrivateBus(std::make_unique<MPCorePrivate>())) {
     g_mem = this;
+
+    // Both HASH register blocks operate on the same engine
+    std::get<IO_HASH2>(memory).handler->engine = std::get<IO_HASH>(memory).handler->engine;
+
+    if constexpr (enable_heatmap) {
+        heatmap = std::make_unique<AccessHeatmap>();
+    }
+}
+
+void FeedHashFIFO(PhysicalMemory& mem, const uint8_t* data, uint32_t num_bytes) {
+    if constexpr (enable_heatmap) {
+        mem.heatmap->Record(hash_fifo_start, AccessPath::MMIO, true);
+    }
+    std::get<IO_HASH2>(mem.memory).handler->engine->FeedFIFO(data, num_bytes);
 }
 
 void PhysicalMemory::InjectDependency(AudioFrontend& frontend) {
@@ -1381,6 +1343,9 @@ void SetHook(PhysicalMemory& mem, PAddr start, uint32_t num_bytes, HookHandler<K
                 for (auto& subscriber : mem.subscribers) {
                     subscriber->OnUnbackedByHostMemory((page << 12) + bus.start);
                 }
+                if constexpr (enable_heatmap) {
+                    mem.heatmap->RecordBackingChange((page << 12) + bus.start);
+                }
             }
         }
 
@@ -1461,6 +1426,9 @@ void ClearHook(PhysicalMemory& mem, HookKind kind, PAddr start, uint32_t num_byt
                 for (auto& subscriber : mem.subscribers) {
                     subscriber->OnBackedByHostMemory(detail::GetMemoryBackedPageFor(bus, (page << 12) + bus.start), (page << 12) + bus.start);
                 }
+                if constexpr (enable_heatmap) {
+                    mem.heatmap->RecordBackingChange((page << 12) + bus.start);
+                }
             }
         }
 
@@ -1469,10 +1437,149 @@ void ClearHook(PhysicalMemory& mem, HookKind kind, PAddr start, uint32_t num_byt
     detail::ForEachMemoryBus(mem.memory, callback);
 }
 
+// Bulk accesses through host memory are counted once per page
+static void RecordBulkAccess(PhysicalMemory& mem, PAddr address, uint32_t num_bytes, HookKind kind) {
+    for (PAddr page = address & ~0xfff; page < address + num_bytes; page += 0x1000) {
+        auto callback = [&](auto& bus) {
+            if (!IsInside{page}(bus)) {
+                return false;
+            }
+
+            auto path = detail::ClassifyAccess(bus, page);
+            if (HasReadHook(kind)) {
+                mem.heatmap->Record(page, path, false);
+            }
+            if (HasWriteHook(kind)) {
+                mem.heatmap->Record(page, path, true);
+            }
+            return true;
+        };
+        detail::ForEachMemoryBus(mem.memory, callback);
+    }
+}
+
+static void DiscardHostPages(uint8_t* begin, uint8_t* end) {
+#ifdef MIKAGE_HAS_MMAN
+    // Host pages may be larger than 4 KiB, so only whole host pages are
+    // returned to the host and the remainder is cleared manually
+    static const uintptr_t host_page_size = sysconf(_SC_PAGESIZE);
+    auto aligned_begin = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(begin) + host_page_size - 1) & ~(host_page_size - 1));
+    auto aligned_end = reinterpret_cast<uint8_t*>(reinterpret_cast<uintptr_t>(end) & ~(host_page_size - 1));
+    if (aligned_begin < aligned_end && madvise(aligned_begin, aligned_end - aligned_begin, MADV_DONTNEED) == 0) {
+        std::memset(begin, 0, aligned_begin - begin);
+        std::memset(aligned_end, 0, end - aligned_end);
+        return;
+    }
+#endif
+    std::memset(begin, 0, end - begin);
+}
+
+void DiscardHostMemory(PhysicalMemory& mem, PAddr address, uint32_t num_bytes) {
+    auto callback = [&](auto& bus) {
+        if (!IsInside{address}(bus)) {
+            return false;
+        }
+
+        if (!IsMemoryBus(bus)) {
+            return true;
+        }
+
+        const uint32_t start_page = (address - bus.start) >> 12;
+        const uint32_t end_page = std::min<uint32_t>(address - bus.start + num_bytes, bus.size) >> 12;
+        for (uint32_t page = start_page; page < end_page;) {
+            if (HasAnyHooks(bus, page)) {
+                ++page;
+                continue;
+            }
+
+            uint32_t run_end = page + 1;
+            while (run_end < end_page && !HasAnyHooks(bus, run_end)) {
+                ++run_end;
+            }
+            DiscardHostPages(bus.data + (page << 12), bus.data + (run_end << 12));
+            page = run_end;
+        }
+        return true;
+    };
+    detail::ForEachMemoryBus(mem.memory, callback);
+}
+
+void WriteBlock(PhysicalMemory& mem, PAddr address, const uint8_t* data, uint32_t num_bytes) {
+    while (num_bytes) {
+        uint32_t chunk_size = std::min<uint32_t>(num_bytes, 0x1000 - (address & 0xfff));
+
+        bool copied = false;
+        auto callback = [&](auto& bus) {
+            if (!IsInside{address}(bus)) {
+                return false;
+            }
+
+            if (!bus.write_hooks[(address - bus.start) >> 12]) {
+                memcpy(bus.data + (address - bus.start), data, chunk_size);
+                copied = true;
+            }
+            return true;
+        };
+        detail::ForEachMemoryBus(mem.memory, callback);
+
+        if (copied) {
+            if constexpr (enable_heatmap) {
+                RecordBulkAccess(mem, address, chunk_size, HookKind::Write);
+            }
+        } else {
+            for (uint32_t offset = 0; offset < chunk_size; ++offset) {
+                WriteLegacy<uint8_t>(mem, address + offset, data[offset]);
+            }
+        }
+
+        address += chunk_size;
+        data += chunk_size;
+        num_bytes -= chunk_size;
+    }
+}
+
+void ReadBlock(PhysicalMemory& mem, PAddr address, uint8_t* dest, uint32_t num_bytes) {
+    while (num_bytes) {
+        uint32_t chunk_size = std::min<uint32_t>(num_bytes, 0x1000 - (address & 0xfff));
+
+        bool copied = false;
+        auto callback = [&](auto& bus) {
+            if (!IsInside{address}(bus)) {
+                return false;
+            }
+
+            if (!bus.read_hooks[(address - bus.start) >> 12]) {
+                memcpy(dest, bus.data + (address - bus.start), chunk_size);
+                copied = true;
+            }
+            return true;
+        };
+        detail::ForEachMemoryBus(mem.memory, callback);
+
+        if (copied) {
+            if constexpr (enable_heatmap) {
+                RecordBulkAccess(mem, address, chunk_size, HookKind::Read);
+            }
+        } else {
+            for (uint32_t offset = 0; offset < chunk_size; ++offset) {
+                dest[offset] = ReadLegacy<uint8_t>(mem, address + offset);
+            }
+        }
+
+        address += chunk_size;
+        dest += chunk_size;
+        num_bytes -= chunk_size;
+    }
+}
+
 // Deprecated since this doesn't check for or trigger any memory hooks
 HostMemoryBackedPages LookupContiguousMemoryBackedPage(PhysicalMemory& mem, PAddr address, uint32_t num_bytes) {
     ValidateContract(num_bytes != 0);
 
+    if constexpr (enable_heatmap) {
+        RecordBulkAccess(mem, address, num_bytes, HookKind::ReadWrite);
+    }
+
     HostMemoryBackedPage out_page = { nullptr };
     auto callback = [&](auto& bus) {
         if (IsInside{address}(bus)) {
@@ -1522,6 +1629,10 @@ template<HookKind AccessMode>
 HostMemoryBackedPages LookupContiguousMemoryBackedPage(PhysicalMemory& mem, PAddr address, uint32_t num_bytes) {
     ValidateContract(num_bytes != 0);
 
+    if constexpr (enable_heatmap) {
+        RecordBulkAccess(mem, address, num_bytes, AccessMode);
+    }
+
 //fprintf(stderr, "HOOK: Requesting contiguous memory region %#x-%#x\n", address, address + num_bytes);
 
     HostMemoryBackedPage out_page = { nullptr };
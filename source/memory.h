@@ -5,6 +5,8 @@
 
 #pragma once
 
+#include "memory_heatmap.hpp"
+
 #include <spdlog/fmt/fmt.h>
 
 #include <boost/endian/conversion.hpp>
@@ -13,6 +15,7 @@
 #include <cassert>
 #include <cstdint>
 #include <memory>
+#include <utility>
 #include <vector>
 
 struct AudioFrontend;
@@ -37,6 +40,8 @@ using EmulatedMemory = uint8_t;
 
 using PAddr = uint32_t;
 
+struct HookBase;
+
 struct HostMemoryBackedPage {
     // nullptr if no memory backed page exists
     EmulatedMemory* data = nullptr;
@@ -46,6 +51,17 @@ struct HostMemoryBackedPage {
     }
 };
 
+/**
+ * Hook slots of a page backed by host memory. Hooks may be installed or
+ * removed at any time, so users that hold on to a HostMemoryBackedPage must
+ * check these on each access and fall back to ReadLegacy/WriteLegacy if a
+ * hook is set.
+ */
+struct PageHookSlots {
+    const std::unique_ptr<HookBase>* read_hook = nullptr;
+    const std::unique_ptr<HookBase>* write_hook = nullptr;
+};
+
 // Set of contiguous pages in memory backed by host RAM
 struct HostMemoryBackedPages {
     EmulatedMemory* data = nullptr;
@@ -151,11 +167,45 @@ struct Hook<HookKind::Write> : HookBase {
 using ReadHook = Hook<HookKind::Read>;
 using WriteHook = Hook<HookKind::Write>;
 
-// TODO: Find optimal alignment (check VEC_SIZE in glibc? Might just be 64 for AVX2). Having any alignment at all helps the compiler generate better memset()s for initialization
+namespace detail {
+uint8_t* AllocateHostMemory(uint32_t num_bytes);
+void FreeHostMemory(uint8_t* data, uint32_t num_bytes);
+} // namespace detail
+
+/**
+ * Zero-initialized host storage for emulated memory.
+ *
+ * The storage is mapped such that the host only commits pages once they are
+ * first written to, so host memory usage follows what the emulated system
+ * actually touches rather than the size of the bus.
+ */
+template<uint32_t Size>
+class HostMemoryStorage {
+    uint8_t* data = detail::AllocateHostMemory(Size);
+
+public:
+    HostMemoryStorage() = default;
+
+    HostMemoryStorage(HostMemoryStorage&& other) noexcept : data(std::exchange(other.data, nullptr)) {
+    }
+
+    HostMemoryStorage& operator=(HostMemoryStorage&&) = delete;
+
+    ~HostMemoryStorage() {
+        if (data) {
+            detail::FreeHostMemory(data, Size);
+        }
+    }
+
+    operator uint8_t*() const noexcept {
+        return data;
+    }
+};
+
 template<uint32_t PAddrStart, uint32_t Size>
-struct alignas(512) MemoryBus : Bus<PAddrStart, Size> {
+struct MemoryBus : Bus<PAddrStart, Size> {
     // NOTE: If we over-allocate this array (by adding 3 more entries than strictly necessary), we can avoid needing range checks! (or at least we can reshuffle them past the actual writes to benefit from speculative execution)
-    uint8_t data[Size];
+    HostMemoryStorage<Size> data;
 
     std::array<std::unique_ptr<HookBase>, (Size >> 12)> write_hooks;
     std::array<std::unique_ptr<HookBase>, (Size >> 12)> read_hooks;
@@ -280,6 +330,12 @@ struct ProxyBus : MemoryBus<PAddrStart, Size> {
     void Write32(uint32_t address, uint32_t value);
 };
 
+template<typename T>
+struct IsProxyBus : std::false_type {};
+
+template<typename T, uint32_t PAddrStart, uint32_t Size>
+struct IsProxyBus<ProxyBus<T, PAddrStart, Size>> : std::true_type {};
+
 struct MPCorePrivate;
 struct HID;
 struct LCD;
@@ -338,6 +394,9 @@ struct PhysicalMemory {
 
     std::vector<PhysicalMemorySubscriber*> subscribers;
 
+    // Only allocated if enable_heatmap is set
+    std::unique_ptr<AccessHeatmap> heatmap;
+
     /**
      * @note This constructor leaves the memory system in a partially
      *       unintialized state. To finalize initialization, some of the busses
@@ -426,11 +485,24 @@ struct BusWriter {
     }
 };
 
+template<typename Bus>
+AccessPath ClassifyAccess(const Bus& bus, uint32_t address) {
+    if constexpr (IsProxyBus<Bus>::value) {
+        return AccessPath::MMIO;
+    } else {
+        auto page_index = (address - bus.start) >> 12;
+        return (bus.read_hooks[page_index] || bus.write_hooks[page_index]) ? AccessPath::Hooked : AccessPath::Backed;
+    }
+}
+
 template<typename DataType, typename BusTuple, size_t... Idxs>
 DataType ReadHelper(PhysicalMemory& mem, uint32_t address, std::index_sequence<Idxs...>) {
     DataType data;
     auto attempt_read = [&](auto&& bus) {
         if (IsInside{address}(bus)) {
+            if constexpr (enable_heatmap) {
+                mem.heatmap->Record(address, ClassifyAccess(bus, address), false);
+            }
             data = BusReader<DataType>{address}(bus);
             return true;
         } else {
@@ -450,6 +522,9 @@ template<typename DataType, typename BusTuple, size_t... Idxs>
 void WriteHelper(PhysicalMemory& mem, uint32_t address, DataType value, std::index_sequence<Idxs...>) {
     auto attempt_write = [&](auto&& bus) {
         if (IsInside{address}(bus)) {
+            if constexpr (enable_heatmap) {
+                mem.heatmap->Record(address, ClassifyAccess(bus, address), true);
+            }
             BusWriter<DataType>{address}(bus, value);
             return true;
         } else {
@@ -483,6 +558,12 @@ HostMemoryBackedPage GetMemoryBackedPageFor(Bus& bus, PAddr address) {
     return { bus.data + (address - bus.start) };
 }
 
+template<typename Bus>
+PageHookSlots GetPageHookSlotsFor(Bus& bus, PAddr address) {
+    auto page_index = (address - bus.start) >> 12;
+    return { &bus.read_hooks[page_index], &bus.write_hooks[page_index] };
+}
+
 } // namespace detail
 
 /**
@@ -513,6 +594,35 @@ void WriteLegacy(PhysicalMemory& mem, uint32_t address, DataType value) {
     detail::WriteHelper<DataType, BusTuple>(mem, address, value, std::make_index_sequence<length>{});
 }
 
+// Input FIFO of the HASH engine
+inline constexpr PAddr hash_fifo_start = 0x10301000;
+inline constexpr uint32_t hash_fifo_size = 0x40;
+
+/**
+ * Feed data to the input FIFO of the HASH engine, as done by DMA transfers
+ * targeting the FIFO registers. Equivalent to writing the data to the FIFO
+ * registers in order (wrapping around at the end), but full blocks are
+ * hashed in bulk.
+ */
+void FeedHashFIFO(PhysicalMemory&, const uint8_t* data, uint32_t num_bytes);
+
+/**
+ * Copy a block of host data to PhysicalMemory. Pages without write hooks are
+ * copied in bulk, while hooked pages and MMIO are written bytewise so that
+ * handlers observe each access.
+ * @throws std::runtime_error when any part of the given range is outside the
+ *         known physical address ranges
+ */
+void WriteBlock(PhysicalMemory& mem, PAddr address, const uint8_t* data, uint32_t num_bytes);
+
+/**
+ * Copy a block of PhysicalMemory to host memory. Counterpart to WriteBlock:
+ * Pages without read hooks are copied in bulk, others are read bytewise.
+ * @throws std::runtime_error when any part of the given range is outside the
+ *         known physical address ranges
+ */
+void ReadBlock(PhysicalMemory& mem, PAddr address, uint8_t* dest, uint32_t num_bytes);
+
 template<uint32_t PAddrStart, uint32_t Size>
 inline constexpr bool IsMemoryBus(const MemoryBus<PAddrStart, Size>&) {
     return true;
@@ -523,7 +633,12 @@ inline constexpr bool IsMemoryBus(const T&) {
     return false;
 }
 
-inline HostMemoryBackedPage LookupMemoryBackedPage(PhysicalMemory& mem, PAddr address) {
+/**
+ * Returns the host memory backing the page at the given address, or a null
+ * page if it's not backed by host memory.
+ * @param out_hooks If non-null, receives the hook slots of the page (only if the page is backed by host memory)
+ */
+inline HostMemoryBackedPage LookupMemoryBackedPage(PhysicalMemory& mem, PAddr address, PageHookSlots* out_hooks = nullptr) {
     HostMemoryBackedPage out_page = { nullptr };
     auto callback = [&](auto& bus) {
         if (IsInside{address}(bus)) {
@@ -532,6 +647,9 @@ inline HostMemoryBackedPage LookupMemoryBackedPage(PhysicalMemory& mem, PAddr ad
 //            if (!bus.write_hooks[(address - bus.start) >> 12] && !bus.read_hooks[(address - bus.start) >> 12]) {
             if (IsMemoryBus(bus)) {
                 out_page = detail::GetMemoryBackedPageFor(bus, address);
+                if (out_hooks) {
+                    *out_hooks = detail::GetPageHookSlotsFor(bus, address);
+                }
             }
             return true;
         }
@@ -543,6 +661,37 @@ inline HostMemoryBackedPage LookupMemoryBackedPage(PhysicalMemory& mem, PAddr ad
     return out_page;
 }
 
+/**
+ * Returns the host memory backing the given range to the host system, such
+ * that it's no longer committed and reads back as zero. Used when emulated
+ * memory is deallocated. Pages with memory hooks are left untouched.
+ */
+void DiscardHostMemory(PhysicalMemory& mem, PAddr address, uint32_t num_bytes);
+
+/**
+ * Range version of LookupMemoryBackedPage: Returns the host memory backing
+ * the given address, along with the number of bytes (up to num_bytes) that
+ * are covered by the same bus. data is nullptr if the bus is not backed by
+ * host memory, and num_bytes is zero if the address is not covered by any bus.
+ */
+inline HostMemoryBackedPages LookupMemoryBackedPages(PhysicalMemory& mem, PAddr address, uint32_t num_bytes) {
+    HostMemoryBackedPages out_pages = { nullptr, 0 };
+    auto callback = [&](auto& bus) {
+        if (IsInside{address}(bus)) {
+            if (IsMemoryBus(bus)) {
+                out_pages.data = detail::GetMemoryBackedPageFor(bus, address).data;
+            }
+            out_pages.num_bytes = std::min<uint32_t>(num_bytes, bus.end - address);
+            return true;
+        }
+
+        return false;
+    };
+
+    detail::ForEachMemoryBus(mem.memory, callback);
+    return out_pages;
+}
+
 // Deprecated since this doesn't check for or trigger any memory hooks
 [[deprecated]] HostMemoryBackedPages LookupContiguousMemoryBackedPage(PhysicalMemory& mem, PAddr address, uint32_t num_bytes);
 
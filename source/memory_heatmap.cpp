@@ -0,0 +1,104 @@
+#include "memory_heatmap.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace Memory {
+
+namespace detail {
+thread_local AccessSource current_access_source = AccessSource::OS;
+}
+
+void AccessHeatmap::Record(PAddr address, AccessPath path, bool is_write) {
+    std::lock_guard guard(access_mutex);
+
+    auto& page = pages[address >> 12];
+    auto source_index = static_cast<size_t>(detail::current_access_source);
+    auto path_index = static_cast<size_t>(path);
+    ++(is_write ? page.writes : page.reads)[source_index][path_index];
+}
+
+void AccessHeatmap::RecordBackingChange(PAddr address) {
+    std::lock_guard guard(access_mutex);
+
+    ++pages[address >> 12].backing_changes;
+}
+
+static const char* GetBusName(PAddr address) {
+    struct BusRange {
+        PAddr start;
+        uint32_t size;
+        const char* name;
+    };
+
+    static constexpr BusRange ranges[] = {
+        { 0x10101000, 0x1000, "HASH" },
+        { 0x10103000, 0x1000, "DSP1" },
+        { 0x10140000, 0x2000, "CONFIG11" },
+        { 0x10142000, 0x2000, "SPI" },
+        { 0x10146000, 0x1000, "HID" },
+        { 0x10147000, 0x1000, "GPIO" },
+        { 0x10160000, 0x1000, "SPI" },
+        { 0x10202000, 0x1000, "LCD" },
+        { 0x10203000, 0x1000, "DSP2" },
+        { 0x1020f000, 0x1000, "AXI_IO" },
+        { 0x10301000, 0x1000, "HASH2" },
+        { 0x10400000, 0x2000, "GPU" },
+        { 0x17e00000, 0x2000, "MPCore" },
+        { 0x18000000, 0x600000, "VRAM" },
+        { 0x1ff00000, 0x80000, "DSP" },
+        { 0x1ff80000, 0x80000, "AXI" },
+        { 0x20000000, 0x8000000, "FCRAM" },
+    };
+
+    for (auto& range : ranges) {
+        if (address >= range.start && address - range.start < range.size) {
+            return range.name;
+        }
+    }
+    return "unknown";
+}
+
+void AccessHeatmap::WriteCSV(std::ostream& os) const {
+    static constexpr const char* source_names[] = { "cpu", "os", "gpu", "dsp", "dma" };
+    static constexpr const char* path_names[] = { "backed", "hooked", "mmio" };
+    static_assert(std::size(source_names) == static_cast<size_t>(AccessSource::Count));
+    static_assert(std::size(path_names) == static_cast<size_t>(AccessPath::Count));
+
+    std::lock_guard guard(access_mutex);
+
+    std::vector<uint32_t> page_indexes;
+    page_indexes.reserve(pages.size());
+    for (auto& page : pages) {
+        page_indexes.push_back(page.first);
+    }
+    std::sort(page_indexes.begin(), page_indexes.end());
+
+    os << "page,bus,backing_changes,source,path,reads,writes\n";
+    for (auto page_index : page_indexes) {
+        auto& page = pages.at(page_index);
+        PAddr address = page_index << 12;
+        bool written = false;
+        for (size_t source = 0; source < std::size(source_names); ++source) {
+            for (size_t path = 0; path < std::size(path_names); ++path) {
+                auto reads = page.reads[source][path];
+                auto writes = page.writes[source][path];
+                if (!reads && !writes) {
+                    continue;
+                }
+                os << fmt::format("{:#010x},{},{},{},{},{},{}\n", address, GetBusName(address), page.backing_changes,
+                                  source_names[source], path_names[path], reads, writes);
+                written = true;
+            }
+        }
+
+        if (!written) {
+            // Pages that were never accessed but changed their backing state
+            os << fmt::format("{:#010x},{},{},,,0,0\n", address, GetBusName(address), page.backing_changes);
+        }
+    }
+}
+
+} // namespace Memory
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <utility>
+
+#ifndef ENABLE_MEMORY_HEATMAP
+#define ENABLE_MEMORY_HEATMAP 0
+#endif
+
+namespace Memory {
+
+using PAddr = uint32_t;
+
+// Instrumentation is compiled out entirely unless enabled at configuration time
+inline constexpr bool enable_heatmap = ENABLE_MEMORY_HEATMAP;
+
+// Hardware component that initiated a memory access
+enum class AccessSource : uint8_t {
+    CPU,    // Emulated ARM11 code
+    OS,     // HLE kernel and HLE services
+    GPU,
+    DSP,
+    DMA,
+
+    Count
+};
+
+// Way a memory access was serviced
+enum class AccessPath : uint8_t {
+    Backed, // Direct access to host memory
+    Hooked, // Memory bus access with a read or write hook set on the page
+    MMIO,   // Access to an MMIO handler
+
+    Count
+};
+
+/**
+ * Tally of physical memory accesses per page, source, and access path.
+ *
+ * Also counts how often pages transition between being backed by host
+ * memory (i.e. accessible directly through the CPU page table) and not
+ * being backed (due to hooks being set up on them).
+ */
+class AccessHeatmap {
+    struct PageStats {
+        std::array<std::array<uint64_t, static_cast<size_t>(AccessPath::Count)>, static_cast<size_t>(AccessSource::Count)> reads {};
+        std::array<std::array<uint64_t, static_cast<size_t>(AccessPath::Count)>, static_cast<size_t>(AccessSource::Count)> writes {};
+        uint64_t backing_changes = 0;
+    };
+
+    // Accesses may come in from GPU worker threads, so guard against concurrent updates
+    mutable std::mutex access_mutex;
+    std::unordered_map<uint32_t, PageStats> pages;
+
+public:
+    void Record(PAddr address, AccessPath path, bool is_write);
+
+    void RecordBackingChange(PAddr address);
+
+    // Writes one row per page, source, and access path in CSV format
+    void WriteCSV(std::ostream&) const;
+};
+
+namespace detail {
+extern thread_local AccessSource current_access_source;
+}
+
+/**
+ * Attributes all accesses issued by the current host thread to the given
+ * source for the lifetime of this object.
+ */
+class ScopedAccessSource {
+    AccessSource previous;
+
+public:
+    ScopedAccessSource(AccessSource source) {
+        if constexpr (enable_heatmap) {
+            previous = std::exchange(detail::current_access_source, source);
+        }
+    }
+
+    ~ScopedAccessSource() {
+        if constexpr (enable_heatmap) {
+            detail::current_access_source = previous;
+        }
+    }
+
+    ScopedAccessSource(const ScopedAccessSource&) = delete;
+    ScopedAccessSource& operator=(const ScopedAccessSource&) = delete;
+};
+
+} // namespace Memory
@@ -1,7 +1,10 @@
 ﻿#define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_OFF
 #include "ipc.hpp"
 #include "os.hpp"
+#include "os_boot_cache.hpp"
 #include "os_console.hpp"
+#include "os_guest_profiler.hpp"
+#include "os_input_replay.hpp"
 #include "os_hypervisor.hpp"
 #include "pica.hpp"
 #include "video_core/src/video_core/vulkan/renderer.hpp" // TODO: Get rid of this
@@ -18,6 +21,7 @@
 
 #include "processes/errdisp.hpp"
 #include "processes/fs.hpp"
+#include "processes/fs_common.hpp"
 #include "processes/gpio.hpp"
 #include "processes/i2c.hpp"
 #include "processes/mcu.hpp"
@@ -27,6 +31,7 @@
 #include "processes/ptm.hpp"
 #include "processes/pxi.hpp"
 #include "processes/pxi_fs.hpp"
+#include "processes/title_database.hpp"
 
 #include "processes/act.hpp"
 #include "processes/am.hpp"
@@ -56,6 +61,7 @@
 #include "framework/meta_tools.hpp"
 #include "framework/bit_field_new.hpp"
 
+#include <future>
 #include <iostream>
 
 #include <tracy/Tracy.hpp>
@@ -96,6 +102,8 @@
 #include <range/v3/view/transform.hpp>
 #include <range/v3/view/reverse.hpp>
 
+#include <bit>
+#include <fstream>
 #include <iomanip>
 #include <memory>
 #include <sstream>
@@ -121,7 +129,7 @@ std::ostream& operator<<(std::ostream& os, const ProcessPrinter& printer) {
 
 std::ostream& operator<<(std::ostream& os, const ThreadPrinter& printer) {
     os << ProcessPrinter{printer.thread.GetParentProcess()};
-    if (auto emuthread = dynamic_cast<EmuThread*>(&printer.thread)) {
+    if (printer.thread.AsEmuThread()) {
         os << ", thread " << std::dec << printer.thread.GetId();
     } else {
         os << ", " << GetThreadObjectName(printer.thread);
@@ -147,7 +155,7 @@ std::ostream& operator<<(std::ostream& os, const ObjectPrinter& printer) {
 }
 
 std::ostream& operator<<(std::ostream& os, const HandlePrinter& printer) {
-    auto object_ptr = printer.thread.GetProcessHandleTable().FindObject<Object>(printer.handle, true);
+    auto object_ptr = printer.thread.GetProcessHandleTable().FindObjectPointer<Object>(printer.handle, true);
     if (object_ptr) {
         os << /*ObjectPrinter{object_ptr}*/ printer.handle.value << "(" << object_ptr->GetName() << ")";
     } else {
@@ -383,6 +391,10 @@ Thread::Thread(Process& owner, uint32_t id, uint32_t priority)
                 }/*,  boost::coroutines2::attributes(0x1000000)*/)) {
 }
 
+Thread::~Thread() {
+    ClearWaitList();
+}
+
 std::shared_ptr<Thread> Thread::GetPointer() {
     return std::dynamic_pointer_cast<Thread>(shared_from_this());
 }
@@ -399,23 +411,109 @@ OS& Thread::GetOS() {
     return GetParentProcess().GetOS();
 }
 
+// Returns true if an access of the given type at the given address stays within a single page
+template<typename DataType>
+static bool IsWithinPage(uint32_t addr) {
+    return (addr & 0xfff) <= 0x1000 - sizeof(DataType);
+}
+
+// Accesses emulated memory through a cached page, unless hooks must be triggered for it
+template<typename DataType>
+static DataType ReadThroughCache(Memory::PhysicalMemory& mem, const TranslationCache::Entry& entry, uint32_t page_offset) {
+    if (Memory::enable_heatmap || *entry.hooks.read_hook) {
+        return Memory::ReadLegacy<DataType>(mem, entry.paddr + page_offset);
+    }
+    return Memory::Read<DataType>(entry.page, page_offset);
+}
+
+template<typename DataType>
+static void WriteThroughCache(Memory::PhysicalMemory& mem, const TranslationCache::Entry& entry, uint32_t page_offset, DataType value) {
+    if (Memory::enable_heatmap || *entry.hooks.write_hook) {
+        return Memory::WriteLegacy<DataType>(mem, entry.paddr + page_offset, value);
+    }
+    Memory::Write<DataType>(entry.page, page_offset, value);
+}
+
+template<typename DataType>
+DataType Thread::ReadMemoryCached(VAddr addr) {
+    if (IsWithinPage<DataType>(addr)) {
+        if (auto* entry = LookupVirtualPage(addr)) {
+            return ReadThroughCache<DataType>(GetParentProcess().interpreter_setup.mem, *entry, addr & 0xfff);
+        }
+    }
+
+    if constexpr (std::is_same_v<DataType, uint8_t>) {
+        return GetParentProcess().ReadMemory(addr);
+    } else {
+        return GetParentProcess().ReadMemory32(addr);
+    }
+}
+
+template<typename DataType>
+void Thread::WriteMemoryCached(VAddr addr, DataType value) {
+    if (IsWithinPage<DataType>(addr)) {
+        if (auto* entry = LookupVirtualPage(addr)) {
+            return WriteThroughCache<DataType>(GetParentProcess().interpreter_setup.mem, *entry, addr & 0xfff, value);
+        }
+    }
+
+    if constexpr (std::is_same_v<DataType, uint8_t>) {
+        GetParentProcess().WriteMemory(addr, value);
+    } else {
+        GetParentProcess().WriteMemory32(addr, value);
+    }
+}
+
+template<typename DataType>
+DataType Thread::ReadPhysicalMemoryCached(PAddr addr) {
+    if (IsWithinPage<DataType>(addr)) {
+        if (auto* entry = LookupPhysicalPage(addr)) {
+            return ReadThroughCache<DataType>(GetParentProcess().interpreter_setup.mem, *entry, addr & 0xfff);
+        }
+    }
+    return Memory::ReadLegacy<DataType>(GetParentProcess().interpreter_setup.mem, addr);
+}
+
+template<typename DataType>
+void Thread::WritePhysicalMemoryCached(PAddr addr, DataType value) {
+    if (IsWithinPage<DataType>(addr)) {
+        if (auto* entry = LookupPhysicalPage(addr)) {
+            return WriteThroughCache<DataType>(GetParentProcess().interpreter_setup.mem, *entry, addr & 0xfff, value);
+        }
+    }
+    Memory::WriteLegacy<DataType>(GetParentProcess().interpreter_setup.mem, addr, value);
+}
+
 void Thread::WriteMemory(VAddr addr, uint8_t value) {
-    GetParentProcess().WriteMemory(addr, value);
+    WriteMemoryCached<uint8_t>(addr, value);
 }
 
 uint8_t Thread::ReadMemory(VAddr addr) {
-    return GetParentProcess().ReadMemory(addr);
+    return ReadMemoryCached<uint8_t>(addr);
 }
 
 uint32_t Thread::ReadMemory32(VAddr addr) {
-    return (static_cast<uint32_t>(GetParentProcess().ReadMemory(addr)) << 0)
-           | (static_cast<uint32_t>(GetParentProcess().ReadMemory(addr+1)) << 8)
-           | (static_cast<uint32_t>(GetParentProcess().ReadMemory(addr+2)) << 16)
-           | (static_cast<uint32_t>(GetParentProcess().ReadMemory(addr+3)) << 24);
+    return ReadMemoryCached<uint32_t>(addr);
 }
 
 void Thread::WriteMemory32(VAddr addr, uint32_t value) {
-    GetParentProcess().WriteMemory32(addr, value);
+    WriteMemoryCached<uint32_t>(addr, value);
+}
+
+uint8_t Thread::ReadPhysicalMemory(PAddr addr) {
+    return ReadPhysicalMemoryCached<uint8_t>(addr);
+}
+
+uint32_t Thread::ReadPhysicalMemory32(PAddr addr) {
+    return ReadPhysicalMemoryCached<uint32_t>(addr);
+}
+
+void Thread::WritePhysicalMemory(PAddr addr, uint8_t value) {
+    WritePhysicalMemoryCached<uint8_t>(addr, value);
+}
+
+void Thread::WritePhysicalMemory32(PAddr addr, uint32_t value) {
+    WritePhysicalMemoryCached<uint32_t>(addr, value);
 }
 
 uint32_t Thread::GetId() const {
@@ -430,27 +528,23 @@ std::shared_ptr<spdlog::logger> Thread::GetLogger() {
     return GetOS().logger;
 }
 
-void Thread::OnResourceAcquired(ObserverSubject& resource) {
+void Thread::OnResourceAcquired(WaitNode& node) {
     assert(status == Thread::Status::Sleeping);
+    assert(!node.linked);
 
-    GetLogger()->info("{}OnResourceAcquired called on {}", ThreadPrinter{*this}, ObjectRefPrinter{resource});
+    GetLogger()->info("{}OnResourceAcquired called on {}", ThreadPrinter{*this}, ObjectRefPrinter{*node.subject});
 
-    auto it = boost::find_if(wait_list, [&](auto&& resource_ptr) { return resource_ptr.get() == &resource; });
-    if (it == wait_list.end())
-        throw std::runtime_error("Given resource was not being waited for");
+    wake_index = &node - wait_list.data();
+    woken_object = node.subject;
+    woken_handle = node.handle;
+    --pending_wait_count;
 
-    wake_index = std::distance(wait_list.begin(), it);
-    woken_object = *it;
-    (void)wait_list.erase(it);
-
-    if (!wait_for_all) {
+    if (!wait_for_all || pending_wait_count == 0) {
         GetLogger()->info("{}waking up", ThreadPrinter{*this});
 
         // we are already done, clear the remaining events
-        for (auto sync_object : wait_list)
-            sync_object->Unregister(GetPointer());
-
-        wait_list.clear();
+        // TODO: For SVCWaitSynchronizationN with wait_for_all, what index should we return in this case, though?
+        ClearWaitList();
         status = Thread::Status::Ready;
 
         // TODO: Push in priority order.. ?
@@ -458,22 +552,26 @@ void Thread::OnResourceAcquired(ObserverSubject& resource) {
 //         GetOS().priority_queue.push_back(GetPointer());
 //         GetOS().ready_queue.push_back(GetPointer());
         GetOS().ready_queue.push_front(GetPointer());
-//         GetOS().ready_queue.insert(std::next(GetOS().ready_queue.begin()), GetPointer());
-    } else if (wait_list.empty()) {
-        GetLogger()->info("{}waking up", ThreadPrinter{*this});
-        status = Thread::Status::Ready;
-        // TODO: For SVCWaitSynchronizationN, what index should we return in this case, though?
-        // TODO: Push in priority order.. ?
-        // TODO: Currently, this will be followed by a reschedule, due to which this will be moved to the back anyway...
-//         GetOS().ready_queue.push_back(GetPointer());
-        GetOS().ready_queue.push_front(GetPointer());
-//         GetOS().priority_queue.push_back(GetPointer());
-//         GetOS().ready_queue.push_front(GetPointer());
 //         GetOS().ready_queue.insert(std::next(GetOS().ready_queue.begin()), GetPointer());
     }
 }
 
+void Thread::ClearWaitList() {
+    for (auto& node : wait_list) {
+        if (node.linked) {
+            node.subject->Unregister(node);
+        }
+    }
+    wait_list.clear();
+    pending_wait_count = 0;
+}
+
 void Thread::YieldForSVC(uint32_t svc) {
+    if (inline_svc_budget && GetOS().TryInlineSVC(static_cast<EmuThread&>(*this), svc)) {
+        --inline_svc_budget;
+        return;
+    }
+
     decltype(callback_for_svc) store_result_in_context;
 
     // TODO: This need not be a lambda expression but rather can be a member function!!
@@ -518,6 +616,8 @@ bool Thread::TryAcquireImpl(std::shared_ptr<Thread>) {
 
 EmuThread::EmuThread(Process& owner, std::unique_ptr<Interpreter::ExecutionContext> context_, uint32_t id, uint32_t priority, VAddr entry, VAddr stack_top, TLSSlot tls_, uint32_t r0, uint32_t fpscr)
         : Thread(owner, id, priority), context(std::move(context_)), tls(std::move(tls_)) {
+    emu_thread = this;
+
     ARM::State cpu { };
     cpu.cpsr.mode = ARM::InternalProcessorMode::User;
 
@@ -693,6 +793,10 @@ bool FakeProcess::IsInternalAddress(VAddr addr) const {
     return addr >> 31;
 }
 
+bool FakeProcess::IsCacheableAddress(VAddr addr) const {
+    return !IsInternalAddress(addr);
+}
+
 void FakeProcess::WriteMemory(VAddr addr, uint8_t value) {
     if (IsInternalAddress(addr)) {
         for (auto& static_buffer : static_buffers) {
@@ -718,7 +822,7 @@ void FakeProcess::WriteMemory(VAddr addr, uint8_t value) {
 void FakeProcess::WriteMemory32(VAddr addr, uint32_t value) {
     if (addr % 4) {
 //        throw std::runtime_error("Unaligned target address for 32-bit write");
-        Process::WriteMemory32(addr, value);
+        return Process::WriteMemory32(addr, value);
     }
 
     if (IsInternalAddress(addr)) {
@@ -765,6 +869,31 @@ uint8_t FakeProcess::ReadMemory(VAddr addr) {
                                          addr, ProcessPrinter{*this}));
 }
 
+uint32_t FakeProcess::ReadMemory32(VAddr addr) {
+    if (addr % 4) {
+        return Process::ReadMemory32(addr);
+    }
+
+    if (IsInternalAddress(addr)) {
+        for (auto& static_buffer : static_buffers) {
+            if (addr >= static_buffer.first &&
+                    addr + sizeof(uint32_t) - 1 < static_buffer.first + static_buffer.second.data.size()) {
+                auto* data = &static_buffer.second.data[addr - static_buffer.first];
+                return data[0] | (data[1] << 8) | (data[2] << 16) | (uint32_t { data[3] } << 24);
+            }
+        }
+    } else {
+        // Access emulated memory
+        auto phys_addr_opt = ResolveVirtualAddr(addr);
+        if (phys_addr_opt) {
+            return Memory::ReadLegacy<uint32_t>(interpreter_setup.mem, *phys_addr_opt);
+        }
+    }
+
+    throw std::runtime_error(fmt::format("Tried to read from address {:#010x}, which is outside fake address range of {}",
+                                         addr, ProcessPrinter{*this}));
+}
+
 // TODO: What's the actual difference between this and AllocateBuffer at this point?
 uint32_t FakeProcess::AllocateStaticBuffer(uint32_t size) {
     size = (size + 0xfff) & ~0xfff;
@@ -969,12 +1098,12 @@ HandleTable::Entry<ServerPort> FakeService::Setup() {
     }
 
     Handle service_handle{ReadTLS(0x8c)};
-    auto service_port = GetProcessHandleTable().FindObject<ServerPort>(service_handle);
+    auto service_port = GetProcessHandleTable().FindObjectPointer<ServerPort>(service_handle);
 
     SetupService();
 
     GetLogger()->info("{}{} setup done", ThreadPrinter{*this}, GetInternalName());
-    return { service_handle, service_port };
+    return { service_handle, std::static_pointer_cast<ServerPort>(service_port->shared_from_this()) };
 }
 
 std::string FakeService::GetInternalName() const {
@@ -990,55 +1119,91 @@ public:
     virtual ~BootThread() = default;
 
     void Run() override try {
-        // Open firm ExeFS
-        uint8_t exefs_section[8] = { '.', 'f', 'i', 'r', 'm' };
+        const uint64_t title_id_sm     = 0x4013000001002;
+        const uint64_t title_id_pxi    = 0x4013000001402;
+        const uint64_t title_id_fs     = 0x4013000001102;
+        const uint64_t title_id_loader = 0x4013000001302;
+        const uint64_t title_id_pm     = 0x4013000001202;
+
         Platform::FS::ProgramInfo info { 0x4013800000002, Meta::to_underlying(Platform::FS::MediaType::NAND) };
-        auto firm_file = HLE::PXI::FS::OpenNCCHSubFile(*this, info, 0, 1, std::basic_string_view<uint8_t>(exefs_section, sizeof(exefs_section)), nullptr);
+        auto& settings = GetOS().settings;
+        auto& keydb = GetParentProcess().interpreter_setup.keydb;
 
-        HLE::PXI::FS::FileContext file_context { *GetLogger() };
-        std::vector<uint8_t> firm_data;
-        {
-            firm_file->OpenReadOnly(file_context);
-            auto [result, num_bytes] = firm_file->GetSize(file_context);
-            if (result != RESULT_OK) {
-                throw std::runtime_error("Could not determine file size");
-            }
-            GetLogger()->info("Reading ExeFS from FIRM ({:#x} bytes)", num_bytes);
-            firm_data.resize(num_bytes);
-            uint64_t bytes_read = 0;
-            std::tie(result, bytes_read) = firm_file->Read(file_context, 0, num_bytes, HLE::PXI::FS::FileBufferInHostMemory { firm_data.data(), static_cast<uint32_t>(num_bytes) });
+        std::optional<BootCache> boot_cache;
+        if (settings.get<Settings::FastBoot>()) {
+            auto firm_path = HLE::PXI::TitleDatabase::GetContentPath(GetRootDataDirectory(settings), info.program_id, 0);
+            boot_cache.emplace(*GetLogger(), std::filesystem::path { settings.get<Settings::PathCacheDir>() } / "boot", firm_path, keydb);
         }
 
-        const uint8_t marker[] = { 'N', 'C', 'C', 'H' };
+        // Only parse the FIRM if any of the natively launched modules is missing from the boot cache
+        const bool firm_cached = boot_cache && ranges::all_of(std::initializer_list<uint64_t> { title_id_sm, title_id_loader, title_id_pm },
+                                                              [&](uint64_t title_id) { return boot_cache->Find(title_id) != nullptr; });
+
+        // Open firm ExeFS
+        uint8_t exefs_section[8] = { '.', 'f', 'i', 'r', 'm' };
+
+        HLE::PXI::FS::FileContext file_context { *GetLogger() };
 
         // Maps title id to offset + size in bytes
         std::map<uint64_t, std::pair<uint32_t, uint32_t>> firm_titles;
 
-        // Find embedded NCCHs
-        auto match_it = firm_data.begin() + 0x200;
-        while (true) {
-            auto [new_match_it, end_match_it] = ranges::search(match_it, firm_data.end(), std::begin(marker), std::end(marker));
-            match_it = end_match_it;
-            if (match_it == firm_data.end()) {
-                break;
+        if (!firm_cached) {
+            auto firm_file = HLE::PXI::FS::OpenNCCHSubFile(*this, info, 0, 1, std::basic_string_view<uint8_t>(exefs_section, sizeof(exefs_section)), nullptr);
+
+            std::vector<uint8_t> firm_data;
+            {
+                firm_file->OpenReadOnly(file_context);
+                auto [result, num_bytes] = firm_file->GetSize(file_context);
+                if (result != RESULT_OK) {
+                    throw std::runtime_error("Could not determine file size");
+                }
+                GetLogger()->info("Reading ExeFS from FIRM ({:#x} bytes)", num_bytes);
+                firm_data.resize(num_bytes);
+                uint64_t bytes_read = 0;
+                std::tie(result, bytes_read) = firm_file->Read(file_context, 0, num_bytes, HLE::PXI::FS::FileBufferInHostMemory { firm_data.data(), static_cast<uint32_t>(num_bytes) });
             }
-            uint32_t offset = std::distance(firm_data.begin(), new_match_it) - offsetof(FileFormat::NCCHHeader, magic);
-            auto title_id = FileFormat::LoadValue<uint64_t, boost::endian::order::little>(FileFormat::MakeStreamInFromContainer(new_match_it + 0x18, new_match_it + 0x20));
-            auto num_bytes = 0x200 * FileFormat::LoadValue<uint32_t, boost::endian::order::little>(FileFormat::MakeStreamInFromContainer(new_match_it + 0x4, new_match_it + 0x8));
-            if ((title_id >> 32) != 0x40130) {
-                // This isn't an embedded NCCH, but just the string "NCCH" in the FIRM's NCCH loader
-                continue;
+
+            const uint8_t marker[] = { 'N', 'C', 'C', 'H' };
+
+            // Find embedded NCCHs
+            auto match_it = firm_data.begin() + 0x200;
+            while (true) {
+                auto [new_match_it, end_match_it] = ranges::search(match_it, firm_data.end(), std::begin(marker), std::end(marker));
+                match_it = end_match_it;
+                if (match_it == firm_data.end()) {
+                    break;
+                }
+                uint32_t offset = std::distance(firm_data.begin(), new_match_it) - offsetof(FileFormat::NCCHHeader, magic);
+                auto title_id = FileFormat::LoadValue<uint64_t, boost::endian::order::little>(FileFormat::MakeStreamInFromContainer(new_match_it + 0x18, new_match_it + 0x20));
+                auto num_bytes = 0x200 * FileFormat::LoadValue<uint32_t, boost::endian::order::little>(FileFormat::MakeStreamInFromContainer(new_match_it + 0x4, new_match_it + 0x8));
+                if ((title_id >> 32) != 0x40130) {
+                    // This isn't an embedded NCCH, but just the string "NCCH" in the FIRM's NCCH loader
+                    continue;
+                }
+                GetLogger()->info("Found embedded FIRM title {:#x} at offset {:#x} ({:#x} bytes)", title_id, offset, num_bytes);
+                firm_titles[title_id] = { offset, num_bytes };
             }
-            GetLogger()->info("Found embedded FIRM title {:#x} at offset {:#x} ({:#x} bytes)", title_id, offset, num_bytes);
-            firm_titles[title_id] = { offset, num_bytes };
         }
-        firm_file.reset();
 
-        const uint64_t title_id_sm     = 0x4013000001002;
-        const uint64_t title_id_pxi    = 0x4013000001402;
-        const uint64_t title_id_fs     = 0x4013000001102;
-        const uint64_t title_id_loader = 0x4013000001302;
-        const uint64_t title_id_pm     = 0x4013000001202;
+        // Decrypt and decompress all uncached modules in parallel. Only the file handles are set up on the
+        // emulator thread, since opening them accesses OS state
+        std::map<uint64_t, std::future<BootCache::Module>> pending_modules;
+        for (auto title_id : { title_id_sm, title_id_loader, title_id_pm }) {
+            if (boot_cache && boot_cache->Find(title_id)) {
+                continue;
+            }
+
+            auto firm_file = HLE::PXI::FS::OpenNCCHSubFile(*this, info, 0, 1, std::basic_string_view<uint8_t>(exefs_section, sizeof(exefs_section)), nullptr);
+            auto [offset, num_bytes] = firm_titles.at(title_id);
+            std::unique_ptr<PXI::FS::File> ncch_file = std::make_unique<PXI::FS::FileView>(std::move(firm_file), offset, num_bytes);
+            pending_modules[title_id] = std::async(std::launch::async, [logger = GetLogger(), &keydb, ncch_file = std::move(ncch_file)]() mutable {
+                HLE::PXI::FS::FileContext file_context { *logger };
+                BootCache::Module module;
+                module.exheader = HLE::PXI::GetExtendedHeader(file_context, keydb, *ncch_file);
+                module.code_image = LoadCodeImage(*logger, keydb, module.exheader, std::move(ncch_file));
+                return module;
+            });
+        }
 
         HandleTable::Entry<ClientSession> srv_session;
         for (auto title_id : { title_id_sm, title_id_pxi, title_id_fs, title_id_loader, title_id_pm }) {
@@ -1050,11 +1215,16 @@ public:
 
 
             GetLogger()->info("Launching FIRM title {:#x}", title_id);
-            auto firm_file = HLE::PXI::FS::OpenNCCHSubFile(*this, info, 0, 1, std::basic_string_view<uint8_t>(exefs_section, sizeof(exefs_section)), nullptr);
-            auto [offset, num_bytes] = firm_titles.at(title_id);
-            auto ncch_file = std::make_unique<PXI::FS::FileView>(std::move(firm_file), offset, num_bytes);
-            auto exheader = HLE::PXI::GetExtendedHeader(file_context, GetParentProcess().interpreter_setup.keydb, *ncch_file);
-            auto process = LoadProcessFromFile(*this, true, exheader, std::move(ncch_file));
+            const BootCache::Module* module = boot_cache ? boot_cache->Find(title_id) : nullptr;
+            BootCache::Module loaded_module;
+            if (module) {
+                GetLogger()->info("Restoring FIRM title {:#x} from boot cache", title_id);
+            } else {
+                loaded_module = pending_modules.at(title_id).get();
+                module = &loaded_module;
+            }
+            auto& exheader = module->exheader;
+            auto process = CreateProcessFromCodeImage(*this, true, exheader, module->code_image);
 
             OS::StartupInfo startup{};
             startup.stack_size = exheader.stack_size;
@@ -1062,6 +1232,10 @@ public:
             auto [result] = CallSVC(&OS::SVCRun, process.first, startup);
             CallSVC(&OS::SVCCloseHandle, std::move(process).first);
 
+            if (module == &loaded_module && boot_cache) {
+                boot_cache->Store(title_id, std::move(loaded_module));
+            }
+
             if (title_id == title_id_sm) {
                 // Wait until SM has spawned its main port so HLE services can assume it's already set up
                 while (true) {
@@ -1073,6 +1247,10 @@ public:
             }
         }
 
+        if (boot_cache) {
+            boot_cache->Save();
+        }
+
 
         GetLogger()->info("{}FakeThread \"BootThread\" exiting", ThreadPrinter{*this});
         CallSVC(&OS::SVCExitThread);
@@ -1081,26 +1259,33 @@ public:
     }
 };
 
-bool ObserverSubject::TryAcquire(std::shared_ptr<Thread> thread) {
+bool ObserverSubject::TryAcquire(WaitNode& node) {
+    auto thread = node.thread->GetPointer();
     bool acquired = TryAcquireImpl(thread);
     if (acquired) {
         thread->GetLogger()->info("{}Successfully tried acquiring {}",
                                   ThreadPrinter{*thread}, ObjectRefPrinter{*this});
-        Unregister(thread);
+        Unregister(node);
     }
 
     return acquired;
 }
 
-void ObserverSubject::Register(std::shared_ptr<Thread> thread) {
-    observers.push_back(thread);
+void ObserverSubject::Register(WaitNode& node) {
+    assert(!node.linked);
+    node.prev = last_observer;
+    node.next = nullptr;
+    (last_observer ? last_observer->next : first_observer) = &node;
+    last_observer = &node;
+    node.linked = true;
 }
 
-void ObserverSubject::Unregister(std::shared_ptr<Thread> thread) {
-    // This should always find a match
-    auto it = std::find_if(observers.begin(), observers.end(), [&thread](auto& observer) { return observer.lock() == thread; });
-    assert(it != observers.end());
-    observers.erase(it);
+void ObserverSubject::Unregister(WaitNode& node) {
+    assert(node.linked);
+    (node.prev ? node.prev->next : first_observer) = node.next;
+    (node.next ? node.next->prev : last_observer) = node.prev;
+    node.prev = node.next = nullptr;
+    node.linked = false;
 }
 
 // TODOTEST: What happens if the application were doing something stupid like
@@ -1279,193 +1464,9 @@ bool Timer::Expired(uint64_t current_time) const {
     return (active && current_time >= timeout_time_ns);
 }
 
-MemoryManager::MemoryManager(PAddr start_address, uint32_t size)
-    : region_start_paddr(start_address), region_size_bytes(size) {
-    free[region_start_paddr] = MemoryBlock { region_size_bytes, {} };
-}
-
-std::optional<uint32_t> MemoryManager::AllocateBlock(std::shared_ptr<MemoryBlockOwner> owner, uint32_t size_bytes) {
-    for (auto block_it = free.begin(); block_it != free.end(); ++block_it) {
-        ValidateContract(block_it->second.owner.expired());
-
-        const uint32_t addr = block_it->first;
-        const uint32_t free_size = block_it->second.size_bytes;
-
-        if (free_size < size_bytes)
-            continue;
-
-        // Declare new "taken" memory block
-        free.erase(block_it);
-        taken[addr] = { size_bytes, owner };
-        // TODO: Merge block with adjacent taken blocks
-
-        // Add "free" entry for remaining space
-        if (free_size != size_bytes)
-            free[addr + size_bytes] = { free_size - size_bytes, {} };
-
-        // TODO: Use a proper logger for this
-        auto get_chunk_size = ranges::views::transform([](auto& chunk) -> uint32_t { return chunk.second.size_bytes; });
-//        std::cout << "MemoryManager allocated new block at 0x" << std::hex << std::setw(8) << std::setfill('0') << addr << " with 0x" << size_bytes << " bytes; 0x" << ranges::accumulate(free | get_chunk_size, uint32_t{0}) << "/0x" << region_size_bytes << " bytes remaining" << std::endl;
-        fmt::print( "MemoryManager allocated new block at {:#010x} with {:#x} bytes; {:#x}/{:#x} bytes remaining (owner {})\n",
-                    addr, size_bytes, ranges::accumulate(free | get_chunk_size, uint32_t{0}), region_size_bytes, fmt::ptr(owner.get()));
-
-            // TODO: Merge with adjacent free blocks in the else cases
-            // Defragment the entire region as a stopgap solution
-            for (auto it = free.begin(); it != free.end() && it != std::prev(free.end());) {
-                auto next_it = std::next(it);
-                if (it->first + it->second.size_bytes == next_it->first && it->second.owner.lock() == next_it->second.owner.lock()) {
-                    it->second.size_bytes += next_it->second.size_bytes;
-                    (void)free.erase(next_it);
-                    // Repeat in case the next block can also be merged
-                } else {
-                    ++it;
-                }
-            }
-            for (auto it = taken.begin(); it != taken.end() && it != std::prev(taken.end());) {
-                auto next_it = std::next(it);
-                if (it->first + it->second.size_bytes == next_it->first && it->second.owner.lock() == next_it->second.owner.lock()) {
-                    it->second.size_bytes += next_it->second.size_bytes;
-                    (void)taken.erase(next_it);
-                    // Repeat in case the next block can also be merged
-                } else {
-                    ++it;
-                }
-            }
-
-        return addr;
-    }
-    return {};
-}
-
-void MemoryManager::DeallocateBlock(std::shared_ptr<MemoryBlockOwner> owner, PAddr start_addr, uint32_t size_bytes) {
-    fmt::print("Trying to free: {:#x}-{:#x}\n", start_addr, start_addr + size_bytes);
-    for (auto block_it = taken.begin(); block_it != taken.end(); ++block_it) {
-        const uint32_t chunk_addr = block_it->first;
-        const uint32_t chunk_size = block_it->second.size_bytes;
-
-        fmt::print("Chunk: {:#x}-{:#x}\n", chunk_addr, chunk_addr + chunk_size);
-
-        ValidateContract(!block_it->second.owner.expired());
-
-        if (chunk_addr <= start_addr && chunk_addr + chunk_size > start_addr) {
-            ValidateContract(block_it->second.owner.lock() == owner);
-
-            if (chunk_addr + chunk_size < start_addr + size_bytes) {
-                throw Mikage::Exceptions::Invalid("Size to free is larger than allocated block");
-            }
-
-            // Declare new "taken" memory block
-            taken.erase(block_it);
-
-            free[start_addr] = MemoryBlock { size_bytes, {} };
-
-            // Add "taken" entry for remaining space
-            if (chunk_addr < start_addr) {
-                taken[chunk_addr] = { start_addr - chunk_addr, owner};
-            }
-            if (chunk_addr + chunk_size > start_addr + size_bytes) {
-                taken[start_addr + size_bytes] = { chunk_addr + chunk_size - start_addr - size_bytes, owner };
-            }
-
-            // TODO: Merge with adjacent free blocks in the else cases
-            // Defragment the entire region as a stopgap solution
-            for (auto it = free.begin(); it != free.end() && it != std::prev(free.end());) {
-                auto next_it = std::next(it);
-                if (it->first + it->second.size_bytes == next_it->first && it->second.owner.lock() == next_it->second.owner.lock()) {
-                    it->second.size_bytes += next_it->second.size_bytes;
-                    (void)free.erase(next_it);
-                    // Repeat in case the next block can also be merged
-                } else {
-                    ++it;
-                }
-            }
-            for (auto it = taken.begin(); it != taken.end() && it != std::prev(taken.end());) {
-                auto next_it = std::next(it);
-                if (it->first + it->second.size_bytes == next_it->first && it->second.owner.lock() == next_it->second.owner.lock()) {
-                    it->second.size_bytes += next_it->second.size_bytes;
-                    (void)taken.erase(next_it);
-                    // Repeat in case the next block can also be merged
-                } else {
-                    ++it;
-                }
-            }
-
-            // TODO: Use a proper logger for this
-            std::cout << "MemoryManager freed up block at 0x" << std::hex << std::setw(8) << std::setfill('0') << start_addr << " with 0x" << size_bytes << " bytes\n";
-            return;
-        }
-    }
-
-    throw std::runtime_error("No suitable block found to free");
-}
-
-void MemoryManager::TransferOwnership(  std::shared_ptr<MemoryBlockOwner> old_owner, std::shared_ptr<MemoryBlockOwner> new_owner,
-                                        PAddr start_addr, uint32_t size_bytes) {
-    fmt::print("Trying to transfer memory ownership from {} to {}: {:#x}-{:#x}\n", fmt::ptr(old_owner.get()), fmt::ptr(new_owner.get()), start_addr, start_addr + size_bytes);
-    for (auto block_it = taken.begin(); block_it != taken.end(); ++block_it) {
-        const uint32_t chunk_addr = block_it->first;
-        const uint32_t chunk_size = block_it->second.size_bytes;
-
-        fmt::print("Chunk: {:#x}-{:#x} (owner {})\n", chunk_addr, chunk_addr + chunk_size, fmt::ptr(block_it->second.owner.lock()));
-
-        ValidateContract(!block_it->second.owner.expired());
-
-        if (chunk_addr <= start_addr && chunk_addr + chunk_size >= start_addr + size_bytes) {
-            ValidateContract(block_it->second.owner.lock() == old_owner);
-
-            if (chunk_addr + chunk_size < start_addr + size_bytes) {
-                throw Mikage::Exceptions::Invalid("Size to transfer is larger than allocated block ({:#x}-{:#x}, next {:#x}-{:#x}",
-                chunk_addr, chunk_addr + chunk_size, std::next(block_it)->first, std::next(block_it)->first + std::next(block_it)->second.size_bytes);
-            }
-
-            // Declare new "taken" memory block
-            taken.erase(block_it);
-
-            taken[start_addr] = MemoryBlock { size_bytes, new_owner };
-
-            // Add "taken" entry for remaining space
-            if (chunk_addr < start_addr) {
-                taken[chunk_addr] = { start_addr - chunk_addr, old_owner };
-            }
-            if (chunk_addr + chunk_size > start_addr + size_bytes) {
-                taken[start_addr + size_bytes] = { chunk_addr + chunk_size - start_addr - size_bytes, old_owner };
-            }
-
-            // TODO: Merge adjacent taken blocks
-            // Defragment the entire region as a stopgap solution
-            for (auto it = taken.begin(); it != taken.end() && it != std::prev(taken.end());) {
-                auto next_it = std::next(it);
-                if (it->first + it->second.size_bytes == next_it->first && it->second.owner.lock() == next_it->second.owner.lock()) {
-                    it->second.size_bytes += next_it->second.size_bytes;
-                    (void)taken.erase(next_it);
-                    // Repeat in case the next block can also be merged
-                } else {
-                    ++it;
-                }
-            }
-
-            // TODO: Use a proper logger for this
-            std::cout << "MemoryManager transferred ownership of block at 0x" << std::hex << std::setw(8) << std::setfill('0') << start_addr << " with 0x" << size_bytes << " bytes\n";
-            return;
-        }
-    }
-
-    throw std::runtime_error("No suitable block found to transfer ownership of");
-}
-
-static uint32_t GetTotalSizeOfMemoryBlocks(const std::map<uint32_t, MemoryBlock>& list) {
-    using boost::adaptors::map_values;
-    using boost::adaptors::transformed;
-    auto get_block_size = [](const MemoryBlock& block) { return block.size_bytes; };
-    return boost::accumulate(list | map_values | transformed(get_block_size), uint32_t{});
-}
-
-uint32_t MemoryManager::UsedMemory() const {
-    return GetTotalSizeOfMemoryBlocks(taken);
-}
-
-uint32_t MemoryManager::TotalSize() const {
-    return UsedMemory() + GetTotalSizeOfMemoryBlocks(free);
+MemoryManager::MemoryManager(Memory::PhysicalMemory& mem, PAddr start_address, uint32_t size)
+    : MemoryManager([&mem](PAddr start_addr, uint32_t size_bytes) { Memory::DiscardHostMemory(mem, start_addr, size_bytes); },
+                    start_address, size) {
 }
 
 void OS::Initialize() {
@@ -1563,43 +1564,27 @@ void OS::RegisterToScheduler(std::shared_ptr<Thread> thread) {
 
 void OS::OnResourceReady(ObserverSubject& resource) {
     // TODO: Iterate threads in priority order!
-    while (!resource.observers.empty()) {
-        auto thread = resource.observers.front().lock();
-        if (!thread) {
-            resource.observers.pop_front();
-            continue;
-        }
-
+    while (auto node = resource.FirstObserver()) {
         // A non-sleeping thread shouldn't be in our observer list
-        assert(thread->status == Thread::Status::Sleeping);
+        assert(node->thread->status == Thread::Status::Sleeping);
 
         // Wake threads until resource acquisition fails (TryAcquire will
-        // remove "thread" from resource.observers on success)
-        bool acquired = resource.TryAcquire(thread);
+        // unregister the node on success)
+        bool acquired = resource.TryAcquire(*node);
         if (!acquired)
             break;
 
-        thread->OnResourceAcquired(resource);
+        node->thread->OnResourceAcquired(*node);
     }
 }
 
-void HandleTable::ErrorNotFound(Handle handle, const char* requested_type) {
-    throw Mikage::Exceptions::Invalid("Could not find handle {} of type \"{}\" in handle table", handle.value, requested_type);
-}
-
-void HandleTable::ErrorWrongType(std::shared_ptr<Object> object, const char* requested_type) {
-    auto& obj = *object;
-    throw std::runtime_error(fmt::format("Requested type \"{}\", but found object has type \"{}\"\n", requested_type, obj.GetName()));
-}
-
-void HandleTable::CloseHandle(Handle handle) {
-    auto it = table.find(handle);
-    if (it == table.end()) {
-        return; // TODO: 3dscraft workaround, only
-        throw std::runtime_error("Tried to close handle " + std::to_string(handle.value) + " that is not in the handle table");
+void HandleTable::SetCurrentThread(const std::shared_ptr<Thread>& thread) {
+    auto& slot = reserved_slots[0];
+    if (!thread) {
+        slot = {};
+    } else if (slot.object != thread) {
+        slot = { thread, &typeid(Thread), {}, 0 };
     }
-
-    table.erase(table.find(handle));
 }
 
 Process::Process(OS& os, Profiler::Activity& activity, Interpreter::Setup& setup, uint32_t pid, MemoryManager& memory_allocator) : os(os), pid(pid), next_tid(1), interpreter_setup(setup), memory_allocator(memory_allocator),
@@ -1642,8 +1627,9 @@ bool Process::MapVirtualMemory(PAddr phys_addr, uint32_t size, VAddr vaddr, Memo
 
     // Insert new mapping and invoke implementation-specific behavior
     virtual_memory.insert({vaddr, {phys_addr,size,permissions}});
+    ++memory_map_generation;
 
-    GetLogger()->info("{}Mapped VAddr [{:#010x};{:#010x}] to PAddr [{:#010x};{:#010x}]", ProcessPrinter{*this}, vaddr, vaddr + size, phys_addr, phys_addr + size);
+    GetLogger()->debug("{}Mapped VAddr [{:#010x};{:#010x}] to PAddr [{:#010x};{:#010x}]", ProcessPrinter{*this}, vaddr, vaddr + size, phys_addr, phys_addr + size);
 
     OnVirtualMemoryMapped(phys_addr, size, vaddr);
     return true;
@@ -1678,6 +1664,7 @@ bool Process::UnmapVirtualMemory(VAddr vaddr, uint32_t size) {
     ValidateContract(unmapped_chunk_vstart + unmapped_chunk.size > vaddr);
 
     (void)virtual_memory.erase(it);
+    ++memory_map_generation;
 
     if (unmapped_chunk_vstart < vaddr) {
         // Reinsert the remaining memory into the map
@@ -1698,7 +1685,7 @@ bool Process::UnmapVirtualMemory(VAddr vaddr, uint32_t size) {
         unmapped_chunk.size = size;
     }
 
-    GetLogger()->info("{}Unmapped VAddr [{:#010x};{:#010x}]", ProcessPrinter{*this}, unmapped_chunk_vstart, unmapped_chunk_vstart + unmapped_chunk.size);
+    GetLogger()->debug("{}Unmapped VAddr [{:#010x};{:#010x}]", ProcessPrinter{*this}, unmapped_chunk_vstart, unmapped_chunk_vstart + unmapped_chunk.size);
 
     OnVirtualMemoryUnmapped(unmapped_chunk_vstart, unmapped_chunk.size);
 
@@ -1749,6 +1736,75 @@ static std::optional<std::pair<VAddr, uint32_t>> ResolveVirtualAddrWithSize(Proc
     return std::make_pair<VAddr, uint32_t>(addr_range_pstart + (addr - addr_range_vstart), addr_range_size - (addr - addr_range_vstart));
 }
 
+const TranslationCache::Entry* Thread::LookupVirtualPage(VAddr addr) {
+    auto& process = GetParentProcess();
+    return translation_cache.LookupVirtual(addr, process.memory_map_generation,
+                                           [&](VAddr page) -> std::optional<TranslationCache::Translation> {
+        // FakeProcess-internal buffers are not part of the memory map, so don't bother looking them up
+        if (!process.IsCacheableAddress(page)) {
+            return std::nullopt;
+        }
+
+        // Only cache pages that are mapped in full and backed by host memory
+        auto physical_chunk = ResolveVirtualAddrWithSize(process, page);
+        if (!physical_chunk || (physical_chunk->first & 0xfff) || physical_chunk->second < 0x1000) {
+            return std::nullopt;
+        }
+
+        Memory::PageHookSlots hooks;
+        auto host_page = Memory::LookupMemoryBackedPage(process.interpreter_setup.mem, physical_chunk->first, &hooks);
+        if (!host_page) {
+            return std::nullopt;
+        }
+
+        return TranslationCache::Translation { physical_chunk->first, host_page, hooks };
+    });
+}
+
+const TranslationCache::Entry* Thread::LookupPhysicalPage(PAddr addr) {
+    return translation_cache.LookupPhysical(addr, [&](PAddr page) -> std::optional<TranslationCache::Translation> {
+        Memory::PageHookSlots hooks;
+        auto host_page = Memory::LookupMemoryBackedPage(GetParentProcess().interpreter_setup.mem, page, &hooks);
+        if (!host_page) {
+            return std::nullopt;
+        }
+
+        return TranslationCache::Translation { page, host_page, hooks };
+    });
+}
+
+void Process::ReadMemoryBlock(VAddr addr, uint8_t* dest, uint32_t num_bytes) {
+    while (num_bytes) {
+        auto physical_chunk = ResolveVirtualAddrWithSize(*this, addr);
+        if (!physical_chunk) {
+            throw std::runtime_error(fmt::format("Tried to read from unmapped address {:#010x} in {}", addr, ProcessPrinter{*this}));
+        }
+
+        auto chunk_size = std::min(physical_chunk->second, num_bytes);
+        Memory::ReadBlock(interpreter_setup.mem, physical_chunk->first, dest, chunk_size);
+
+        addr += chunk_size;
+        dest += chunk_size;
+        num_bytes -= chunk_size;
+    }
+}
+
+void Process::WriteMemoryBlock(VAddr addr, const uint8_t* data, uint32_t num_bytes) {
+    while (num_bytes) {
+        auto physical_chunk = ResolveVirtualAddrWithSize(*this, addr);
+        if (!physical_chunk) {
+            throw std::runtime_error(fmt::format("Tried to write to unmapped address {:#010x} in {}", addr, ProcessPrinter{*this}));
+        }
+
+        auto chunk_size = std::min(physical_chunk->second, num_bytes);
+        Memory::WriteBlock(interpreter_setup.mem, physical_chunk->first, data, chunk_size);
+
+        addr += chunk_size;
+        data += chunk_size;
+        num_bytes -= chunk_size;
+    }
+}
+
 std::optional<uint32_t> Process::FindAvailableVirtualMemory(uint32_t size, VAddr vaddr_start, VAddr vaddr_end) {
 
     // TODO: Guard against integer overflows throughout this function!
@@ -1947,19 +2003,44 @@ const uint32_t num_firm_modules = 5;
 //       See MakeNewProcessId for details.
 //       TODO: Instead of this workaround, we should just not launch
 //             FakeDebugProcess before the FIRM modules.
+// Identifies the application on the emulated game card, if any
+static InputReplay::Title GetGameCardTitle(spdlog::logger& logger, Interpreter::Setup& setup) {
+    if (!setup.gamecard) {
+        return {};
+    }
+
+    auto partition = setup.gamecard->GetPartitionFromId(Loader::NCSDPartitionId::Executable);
+    if (!partition) {
+        return {};
+    }
+
+    PXI::FS::FileContext file_context { logger };
+    auto exheader = PXI::GetExtendedHeader(file_context, setup.keydb, **partition);
+    return { exheader.aci.program_id, exheader.remaster_version };
+}
+
 OS::OS( Profiler::Profiler& profiler, Settings::Settings& settings,
         Interpreter::Setup& setup_, LogManager& log_manager,
-        AudioFrontend& audio, PicaContext& pica, EmuDisplay::EmuDisplay& display)
+        AudioFrontend& audio, PicaContext& pica, EmuDisplay::EmuDisplay& display, InputSource& input)
     : hypervisor(settings, audio),
       next_pid(num_firm_modules),
       internal_memory_owner(std::make_shared<MemoryBlockOwner>()),
       memory_regions {
-        MemoryManager { ApplicationMemoryStart(settings), ApplicationMemorySize(settings) },
-        MemoryManager { SysMemoryStart(settings), SysMemorySize(settings) },
-        MemoryManager { BaseMemoryStart(settings), BaseMemorySize(settings) }
+        MemoryManager { setup_.mem, ApplicationMemoryStart(settings), ApplicationMemorySize(settings) },
+        MemoryManager { setup_.mem, SysMemoryStart(settings), SysMemorySize(settings) },
+        MemoryManager { setup_.mem, BaseMemoryStart(settings), BaseMemorySize(settings) }
       },
       profiler(profiler),
       activity(profiler.GetActivity("OS")),
+      counters {
+        profiler.GetCounter("os.system_ticks"),
+        profiler.GetCounter("os.scheduler.idle_ticks"),
+        profiler.GetCounter("os.vblanks"),
+        profiler.GetCounter("cpu.instructions"),
+        profiler.GetCounter("cpu.cycles"),
+        profiler.GetCounter("ipc.requests"),
+        profiler.GetCounter("fs.bytes_read"),
+      },
       pica_context(pica),
       display(display),
       settings(settings),
@@ -1967,9 +2048,44 @@ OS::OS( Profiler::Profiler& profiler, Settings::Settings& settings,
       log_manager(log_manager),
       logger(log_manager.RegisterLogger("OS")) {
     logger->set_pattern("[%T.%e] [%n] [%l] %v");
+
+    if (!settings.get<Settings::GuestProfileDir>().empty()) {
+        guest_profiler = std::make_unique<GuestProfiler>(settings.get<Settings::GuestProfileInterval>());
+        for (auto& symbols : settings.get<Settings::GuestProfileSymbols>()) {
+            auto separator = symbols.find('=');
+            if (separator == std::string::npos) {
+                throw std::runtime_error(fmt::format("Invalid guest symbol file specification \"{}\", expected <process name>=<path>", symbols));
+            }
+            guest_profiler->LoadSymbols(symbols.substr(0, separator), symbols.substr(separator + 1));
+        }
+    }
+
+    if (settings.get<Settings::DeterministicExecution>() ||
+        !settings.get<Settings::ReplayRecordFile>().empty() ||
+        !settings.get<Settings::ReplayPlaybackFile>().empty()) {
+        input_replay = std::make_unique<InputReplay>(*logger, input, settings, GetGameCardTitle(*logger, setup));
+    }
+
+    if (settings.get<Settings::EnableIPCStatistics>() || !settings.get<Settings::IPCStatsDumpFile>().empty()) {
+        ipc_statistics = std::make_unique<IPCStatistics>();
+    }
 }
 
 OS::~OS() {
+    if (guest_profiler) {
+        guest_profiler->WriteFoldedStacks(*logger, settings.get<Settings::GuestProfileDir>());
+    }
+
+    if (auto ipc_stats_filename = settings.get<Settings::IPCStatsDumpFile>(); !ipc_stats_filename.empty() && ipc_statistics) {
+        std::ofstream file(ipc_stats_filename);
+        ipc_statistics->WriteCSV(file);
+    }
+
+    if (auto heatmap_filename = settings.get<Settings::MemoryHeatmapFile>(); !heatmap_filename.empty() && setup.mem.heatmap) {
+        std::ofstream file(heatmap_filename);
+        setup.mem.heatmap->WriteCSV(file);
+    }
+
     // Threads/processes typically hold circular references to each other, so
     // we can't rely on reference counting for cleanup. Instead, terminate them
     // explicitly.
@@ -2028,8 +2144,8 @@ OS::~OS() {
     debug_process.reset(); // TODO: Not needed
 }
 
-std::pair<std::unique_ptr<OS>, std::unique_ptr<::ConsoleModule>> OS::Create(Settings::Settings& settings, Interpreter::Setup& setup, LogManager& log_manager, Profiler::Profiler& profiler, AudioFrontend& audio, PicaContext& pica, EmuDisplay::EmuDisplay& display) {
-    auto&& os = std::make_unique<OS>(profiler, settings, setup, log_manager, audio, pica, display);
+std::pair<std::unique_ptr<OS>, std::unique_ptr<::ConsoleModule>> OS::Create(Settings::Settings& settings, Interpreter::Setup& setup, LogManager& log_manager, Profiler::Profiler& profiler, AudioFrontend& audio, PicaContext& pica, EmuDisplay::EmuDisplay& display, InputSource& input) {
+    auto&& os = std::make_unique<OS>(profiler, settings, setup, log_manager, audio, pica, display, input);
     auto&& console_module = std::unique_ptr<::ConsoleModule>(new ConsoleModule(*os));
     return std::make_pair(std::move(os), std::move(console_module));
 }
@@ -2061,6 +2177,11 @@ SVCFuture<OS::Result,uint32_t> OS::SVCControlProcessMemory(Thread& source, Proce
 
     case 3: // Allocate new memory block
     {
+        if (size == 0) {
+            // Nothing to allocate or map
+            return MakeFuture(RESULT_OK, addr0);
+        }
+
         auto& memory_manager = Meta::invoke([&]() -> MemoryManager& {
             // TODO: Panic if the current PID is not 1 (i.e. not the loader process)
             switch (operation & 0xF00) {
@@ -2090,8 +2211,9 @@ SVCFuture<OS::Result,uint32_t> OS::SVCControlProcessMemory(Thread& source, Proce
         //       addresses would always be at a high vaddress.
         auto block_address_opt = memory_manager.AllocateBlock(static_pointer_cast<Process>(process.shared_from_this()), size);
         if (!block_address_opt) {
-            throw Mikage::Exceptions::Invalid(  "Failed to allocate physical memory: Requested {:#x} bytes, only {:#x}/{:#x} available",
-                                                size, memory_manager.TotalSize() - memory_manager.UsedMemory(), memory_manager.TotalSize());
+            throw Mikage::Exceptions::Invalid(  "Failed to allocate physical memory: Requested {:#x} bytes, only {:#x}/{:#x} available (largest free block: {:#x} bytes)",
+                                                size, memory_manager.TotalSize() - memory_manager.UsedMemory(), memory_manager.TotalSize(),
+                                                memory_manager.GetStatistics().largest_free_block);
         }
 
         // Set virtual address region according to the LINEAR flag
@@ -2237,7 +2359,7 @@ void OS::ExitThread(Thread& thread) {
 
     // Find all owned mutexes and release them
     // TODO: Should we also release any semaphore counts?
-    for (auto& entry : thread.GetProcessHandleTable().table) {
+    for (auto& entry : thread.GetProcessHandleTable().GetEntries()) {
         auto mutex = std::dynamic_pointer_cast<Mutex>(entry.second);
 
         if (mutex && mutex->IsOwner(thread.GetPointer())) {
@@ -2253,14 +2375,15 @@ void OS::ExitThread(Thread& thread) {
     // TODO: Deallocate Thread Local Storage
 
     // Unregister from all wait objects to make sure we don't run into cyclic dependencies
-    for (auto& notifier : thread.wait_list)
-        notifier->Unregister(thread.GetPointer());
+    thread.ClearWaitList();
 
     thread.GetProcessHandleTable().SetCurrentThread(nullptr); // release internal reference
 
-    thread.control->PrepareForExit();
+    if (ipc_statistics) {
+        ipc_statistics->OnThreadExited(thread);
+    }
 
-    thread.wait_list.clear();
+    thread.control->PrepareForExit();
 
     thread.status = Thread::Status::Stopped;
 
@@ -2295,7 +2418,7 @@ SVCEmptyFuture OS::SVCSleepThread(Thread& source, int64_t duration) {
     source.status = Thread::Status::WaitingForTimeout;
     ready_queue.remove_if([ptr=source.GetPointer()](auto elem) { return elem.lock() == ptr; });
 //     priority_queue.remove_if([ptr=source.GetPointer()](auto elem) { return elem.lock() == ptr; });
-    waiting_queue.push_back(source.GetPointer());
+    timeout_queue.Schedule(source.GetPointer());
 
     return MakeFuture(nullptr);
 }
@@ -2305,9 +2428,9 @@ SVCFuture<OS::Result> OS::SVCRun(Thread& source, Handle process_handle, const OS
     source.GetLogger()->info("{}SVCRun: Running process {}, stack size {:#x}", ThreadPrinter{source}, HandlePrinter{source,process_handle}, startup.stack_size);
 
     // FakeProcesses automatically run on creation
-    auto fake_process = source.GetProcessHandleTable().FindObject<FakeProcess>(process_handle, true);
+    auto fake_process = source.GetProcessHandleTable().FindObjectPointer<FakeProcess>(process_handle, true);
     if (fake_process) {
-        if (auto wrapped_fake_process = std::dynamic_pointer_cast<WrappedFakeProcess>(fake_process)) {
+        if (auto wrapped_fake_process = dynamic_cast<WrappedFakeProcess*>(fake_process)) {
             wrapped_fake_process->SpawnMainThread();
         }
         fake_process->status = Process::Status::Running;
@@ -2315,19 +2438,20 @@ SVCFuture<OS::Result> OS::SVCRun(Thread& source, Handle process_handle, const OS
     }
 
     // Explicitly requesting EmuProcess here because spawning FakeProcesses like this can only cause problems down the road.
-    auto process = source.GetProcessHandleTable().FindObject<EmuProcess>(process_handle);
+    auto process = source.GetProcessHandleTable().FindObjectPointer<EmuProcess>(process_handle);
     if (process->status != Process::Status::Created) {
         throw Mikage::Exceptions::Invalid("Called SVCRun on a process that was already active");
     }
+    auto process_ref = std::static_pointer_cast<EmuProcess>(process->shared_from_this());
 
     // In its own handle table, the new Process is accessible through a fixed constant
     // NOTE: This was moved from SVCCreateProcess, since it's easier to unwind
     //       processes in Created status if they don't have self-references.
-    process->handle_table.CreateEntry<Process>(Handle{0xFFFF8001}, process);
+    process->handle_table.CreateEntry<Process>(Handle{0xFFFF8001}, process_ref);
 
     // Allocate stack memory for the main thread
     // NOTE: Retail applications expect the stack to end at 0x10000000
-    auto stack_paddr_opt = source.GetParentProcess().GetPhysicalMemoryManager().AllocateBlock(process, startup.stack_size);
+    auto stack_paddr_opt = source.GetParentProcess().GetPhysicalMemoryManager().AllocateBlock(process_ref, startup.stack_size);
     auto stack_vaddr_opt = process->FindAvailableVirtualMemory(startup.stack_size, 0x10000000 - startup.stack_size, 0x10000000);
     process->MapVirtualMemory(*stack_paddr_opt, startup.stack_size, *stack_vaddr_opt, MemoryPermissions::ReadWrite);
 
@@ -2380,7 +2504,7 @@ SVCFuture<OS::Result,HandleTable::Entry<Mutex>> OS::SVCCreateMutex(Thread& sourc
 
 SVCFuture<OS::Result> OS::SVCReleaseMutex(Thread& source, Handle mutex_handle) {
     source.GetLogger()->info("{}SVCReleaseMutex, handle={}", ThreadPrinter{source}, HandlePrinter{source,mutex_handle});
-    auto mutex = source.GetProcessHandleTable().FindObject<Mutex>(mutex_handle);
+    auto mutex = source.GetProcessHandleTable().FindObjectPointer<Mutex>(mutex_handle);
     if (!mutex || !mutex->IsOwner(source.GetPointer())) {
         throw std::runtime_error("Mutex not owned by the current thread");
     }
@@ -2429,7 +2553,7 @@ SVCFuture<OS::Result,HandleTable::Entry<Event>> OS::SVCCreateEvent(Thread& sourc
 
 SVCFuture<OS::Result> OS::SVCSignalEvent(Thread& source, Handle event_handle) {
     source.GetLogger()->info("{}SVCSignalEvent, handle={}", ThreadPrinter{source}, HandlePrinter{source,event_handle});
-    auto event = source.GetProcessHandleTable().FindObject<Event>(event_handle, true);
+    auto event = source.GetProcessHandleTable().FindObjectPointer<Event>(event_handle, true);
     if (!event) {
         throw Mikage::Exceptions::Invalid("Attempted to signal invalid event");
     }
@@ -2450,7 +2574,7 @@ SVCFuture<OS::Result> OS::SVCSignalEvent(Thread& source, Handle event_handle) {
 
 SVCFuture<OS::Result> OS::SVCClearEvent(Thread& source, Handle event_handle) {
     source.GetLogger()->info("{}SVCClearEvent, handle={}", ThreadPrinter{source}, HandlePrinter{source,event_handle});
-    auto event = source.GetProcessHandleTable().FindObject<Event>(event_handle, true);
+    auto event = source.GetProcessHandleTable().FindObjectPointer<Event>(event_handle, true);
     if (!event) {
         throw Mikage::Exceptions::Invalid("Passed invalid event handle to SVCClearEvent");
     }
@@ -2539,7 +2663,7 @@ SVCFuture<OS::Result> OS::SVCMapMemoryBlock(Thread& source, Handle block_handle,
                              ThreadPrinter{source}, block_handle.value /* TODO: HandlePrinter! */, addr,
                              Meta::to_underlying(caller_perms), Meta::to_underlying(other_perms));
 
-    auto block = source.GetProcessHandleTable().FindObject<SharedMemoryBlock>(block_handle);
+    auto block = source.GetProcessHandleTable().FindObjectPointer<SharedMemoryBlock>(block_handle);
     if (!block) {
         throw std::runtime_error(fmt::format("Invalid block handle {} for SharedMemoryBlock", HandlePrinter{source,block_handle}));
     }
@@ -2743,9 +2867,7 @@ break;
             source.status = Thread::Status::WaitingForArbitration;
             ready_queue.remove_if([ptr=source.GetPointer()](auto elem) { return elem.lock() == ptr; });
 //             priority_queue.remove_if([ptr=source.GetPointer()](auto elem) { return elem.lock() == ptr; });
-            if (source.timeout_at != -1) {
-                waiting_queue.push_back(source.GetPointer());
-            }
+            timeout_queue.Schedule(source.GetPointer());
 
             Reschedule(source.GetPointer());
         }
@@ -2761,14 +2883,11 @@ break;
 OS::Result OS::CloseHandle(Thread& source, Handle handle) {
     hypervisor.OnHandleClosed(source.GetParentProcess().GetId(), handle);
 
-    auto use_count = [&]() {
-        auto ptr = source.GetProcessHandleTable().FindObject<Object>(handle, true);
-        return (ptr ? (ptr.use_count() - 1) : 0);
-    }();
+    auto object = source.GetProcessHandleTable().FindObjectPointer<Object>(handle, true);
+    auto use_count = object ? object->weak_from_this().use_count() : 0;
     source.GetLogger()->info("{}CloseHandle: handle={} (object use count: {})",
                              ThreadPrinter{source}, HandlePrinter{source,handle}, use_count);
     {
-        auto object = source.GetProcessHandleTable().FindObject<Object>(handle, true);
 
         // TODO: If this handle was a ClientSession, notify the ServerSession about this (it must wake up for the server to close it) TODOTEST
         // TODO: If a Session is closed because both its ClientSession and ServerSession have been closed, wake the ServerPort since a session has become free (TODOTEST: I guess it's sufficient for the ServerSession to become closed!)
@@ -2777,7 +2896,7 @@ OS::Result OS::CloseHandle(Thread& source, Handle handle) {
         // First off, release any remaining locks on ObserverSubjects
         // TODO: No idea whether we are actually supposed to do this here, since there are explicit release SVCs for this.
 
-        if (auto client_session = std::dynamic_pointer_cast<ClientSession>(object)) {
+        if (auto client_session = dynamic_cast<ClientSession*>(object)) {
             if (use_count == 1) {
                 source.GetLogger()->info("{}Closed last instance of a ClientSession => waking up server", ThreadPrinter{source});
                 // Wake up any threads waiting on the corresponding server session.
@@ -2789,13 +2908,13 @@ OS::Result OS::CloseHandle(Thread& source, Handle handle) {
                     OnResourceReady(*server_session);
                 }
             }
-        } else if (auto server_session = std::dynamic_pointer_cast<ServerSession>(object)) {
+        } else if (auto server_session = dynamic_cast<ServerSession*>(object)) {
             if (use_count == 1) {
                 auto port = server_session->port;
                 if (port) {
                     ++port->available_sessions;
                     source.GetLogger()->info("{}Closed last instance of {} => freeing up a session slot in {} (now have {} open sessions)",
-                                             ThreadPrinter{source}, ObjectPrinter{server_session}, ObjectPrinter{port}, port->available_sessions);
+                                             ThreadPrinter{source}, ObjectRefPrinter{*server_session}, ObjectPrinter{port}, port->available_sessions);
                     OnResourceReady(*port);
 
                     // TODO: LLE sm expects this to be signaled: If GetServiceHandle is called on a full port, the reply is withheld until the client port is signaled
@@ -2805,20 +2924,22 @@ OS::Result OS::CloseHandle(Thread& source, Handle handle) {
                     }
                 }
             }
-        } else if (auto mutex = std::dynamic_pointer_cast<Mutex>(object)) {
+        } else if (auto mutex = dynamic_cast<Mutex*>(object)) {
             // TODOTEST: Should something like this indeed be done? Perhaps only if this was the last handle in the current process, however?
             if (mutex->IsOwner(source.GetPointer())) {
                 mutex->Release();
                 OnResourceReady(*mutex);
             }
-        } else if (auto process = std::dynamic_pointer_cast<Process>(object)) {
+        } else if (auto process = dynamic_cast<Process*>(object)) {
             // TODO: ?
-        } else if (auto block = std::dynamic_pointer_cast<SharedMemoryBlock>(object)) {
+        } else if (auto block = dynamic_cast<SharedMemoryBlock*>(object)) {
             if (use_count == 1 && block->owns_memory) {
-                FindMemoryRegionContaining(block->phys_address, block->size).DeallocateBlock(block, block->phys_address, block->size);
+                auto block_ref = std::static_pointer_cast<SharedMemoryBlock>(block->shared_from_this());
+                FindMemoryRegionContaining(block->phys_address, block->size).DeallocateBlock(block_ref, block->phys_address, block->size);
             }
-        } else if (auto codeset = std::dynamic_pointer_cast<CodeSet>(object)) {
+        } else if (auto codeset_ptr = dynamic_cast<CodeSet*>(object)) {
             if (use_count == 1) {
+                auto codeset = std::static_pointer_cast<CodeSet>(codeset_ptr->shared_from_this());
                 try {
                     const uint32_t page_size = 0x1000;
                     for (auto& mapping : codeset->text_phys) {
@@ -2903,61 +3024,63 @@ SVCFuture<PromisedResult,PromisedWakeIndex> OS::SVCWaitSynchronizationN(Thread&
         throw std::runtime_error(fmt::format("Internal precondition violated: Expected wait list to be empty"));
     }
 
+    // Validate all handles before registering any wait nodes
     for (Handle* handle = handles; handle != handles + handle_count; ++handle) {
-        auto subject = source.GetProcessHandleTable().FindObject<ObserverSubject>(*handle);
-        if (!subject) {
+        if (!source.GetProcessHandleTable().FindObjectPointer<ObserverSubject>(*handle)) {
             throw std::runtime_error(fmt::format("Given handle {:#x} not found in process handle table", handle->value));
         }
+    }
 
-        subject->Register(source.GetPointer());
-        source.wait_list.push_back(subject);
+    // NOTE: Nodes are registered only after sizing wait_list, since they must not be moved while registered
+    source.wait_list.resize(handle_count);
+    for (uint32_t index = 0; index < handle_count; ++index) {
+        auto& node = source.wait_list[index];
+        node.thread = &source;
+        // Waiting threads keep the subject alive even if its handle is closed
+        auto subject = source.GetProcessHandleTable().FindObjectPointer<ObserverSubject>(handles[index]);
+        node.subject = std::static_pointer_cast<ObserverSubject>(subject->shared_from_this());
+        node.handle = handles[index];
+        node.subject->Register(node);
     }
+    source.pending_wait_count = handle_count;
 
     // Check once whether any of the resources we're waiting on are already
     // ready (e.g. sticky events). Then (if need be), put the thread to sleep
     // until one of the resources becomes ready.
-    for (auto it = source.wait_list.begin(); it != source.wait_list.end();) {
-        auto object = *it;
-        if (!object->TryAcquire(source.GetPointer())) {
-            ++it;
+    for (auto& node : source.wait_list) {
+        auto object = node.subject;
+        if (!object->TryAcquire(node)) {
             continue;
         }
 
-        // Resource acquired successfully - remove it from the wait_list.
+        // Resource acquired successfully.
         // NOTE: TryAcquire already Unregister'ed us.
-        source.wake_index = std::distance(source.wait_list.begin(), it);
-        source.woken_object = *it;
-        it = source.wait_list.erase(it);
+        source.wake_index = &node - source.wait_list.data();
+        source.woken_object = object;
+        source.woken_handle = node.handle;
+        --source.pending_wait_count;
 
         source.GetLogger()->info("{}WaitSynchronizationN signalled on {}", ThreadPrinter{source}, ObjectPrinter{object});
 
-        if (!wait_for_all) {
+        if (!wait_for_all || source.pending_wait_count == 0) {
             source.GetLogger()->info("{}WaitSynchronizationN waking up", ThreadPrinter{source});
 
             // we are already done, clear the remaining events
-            for (auto sync_object : source.wait_list)
-                sync_object->Unregister(source.GetPointer());
-
-            source.wait_list.clear();
-            break;
-        } else if (source.wait_list.empty()) {
-            source.GetLogger()->info("{}WaitSynchronizationN waking up", ThreadPrinter{source});
-            // TODO: What index would we return in this case, though?
+            // TODO: For wait_for_all, what index would we return in this case, though?
+            source.ClearWaitList();
             break;
         }
     }
 
-    // If this didn't already empty the list, suspend this thread until we are set back to Status::Ready again
+    // If this didn't already acquire all resources, suspend this thread until we are set back to Status::Ready again
     // TODO: Is it acceptable that we don't schedule at all if this condition evaluates to false?
     // TODO: When we timeout after we tried to acquire multiple resources, is it acceptable to leave some of the requested resources in an acquired state?
-    if (!source.wait_list.empty()) {
+    if (source.pending_wait_count) {
         source.wait_for_all = wait_for_all;
         source.status = Thread::Status::Sleeping;
         ready_queue.remove_if([ptr=source.GetPointer()](auto elem) { return elem.lock() == ptr; });
 //         priority_queue.remove_if([ptr=source.GetPointer()](auto elem) { return elem.lock() == ptr; });
-        if (source.timeout_at != -1) {
-            waiting_queue.push_back(source.GetPointer());
-        }
+        timeout_queue.Schedule(source.GetPointer());
         source.GetLogger()->info("{}Putting thread into sleep state...", ThreadPrinter{source});
         Reschedule(source.GetPointer());
     } else {
@@ -2970,13 +3093,13 @@ SVCFuture<PromisedResult,PromisedWakeIndex> OS::SVCWaitSynchronizationN(Thread&
 SVCFuture<OS::Result,Handle> OS::SVCDuplicateHandle(Thread& source, Handle handle) {
     source.GetLogger()->info("{}SVCDuplicateHandle: handle={}", ThreadPrinter{source}, HandlePrinter{source,handle});
 
-    auto object = source.GetProcessHandleTable().FindObject<Object>(handle);
+    auto object = source.GetProcessHandleTable().FindObjectPointer<Object>(handle);
     if (!object) {
         throw std::runtime_error(fmt::format("{}Called SVCDuplicateHandle on invalid handle {}",
                                   ThreadPrinter{source}, HandlePrinter{source,handle}));
     }
 
-    auto new_handle = source.GetProcessHandleTable().CreateHandle(object, MakeHandleDebugInfo(DebugHandle::Duplicated)).first;
+    auto new_handle = source.GetProcessHandleTable().CreateHandle(object->shared_from_this(), MakeHandleDebugInfo(DebugHandle::Duplicated)).first;
     auto process_id = source.GetParentProcess().GetId();
     hypervisor.OnHandleDuplicated(process_id, handle, process_id, new_handle);
 
@@ -3088,14 +3211,29 @@ detail::ScopeExit<Callable> OnScopeExit(Callable callback) {
 }
 
 
+// Returns the name of the service the given session is connected to, or an empty string if unknown
+static std::string GetServiceName(ClientSession& session) {
+    std::string_view name = session.name;
+    if (!name.starts_with("CSession_")) {
+        // Session to a port not registered with sm or to no port at all (e.g. FS files)
+        return {};
+    }
+    name.remove_prefix(9);
+    if (name.starts_with("Port_")) {
+        name.remove_prefix(5);
+    }
+    return std::string { name };
+}
+
 SVCFuture<PromisedResult> OS::SVCSendSyncRequest(Thread& source, Handle session_handle) {
     ZoneScoped;
     auto& svc_activity = activity.GetSubActivity("SVC").GetSubActivity("SendSyncRequest");
     auto scope_measure = MeasureScope(svc_activity);
+    counters.ipc_requests.Add();
 
     // TODO: appletEd workaround. Upon exit, it tries to close an invalid client session
-//    auto session = source.GetProcessHandleTable().FindObject<ClientSession>(session_handle);
-    auto session = source.GetProcessHandleTable().FindObject<ClientSession>(session_handle, true);
+//    auto session = source.GetProcessHandleTable().FindObjectPointer<ClientSession>(session_handle);
+    auto session = source.GetProcessHandleTable().FindObjectPointer<ClientSession>(session_handle, true);
     if (!session) {
 // TODO: HOME Menu tries to send requests to news:s before actually GetServiceHandle'ing its handle.
 //throw std::runtime_error(fmt::format("Invalid session handle {}", HandlePrinter{source, session_handle}));
@@ -3115,13 +3253,17 @@ SVCFuture<PromisedResult> OS::SVCSendSyncRequest(Thread& source, Handle session_
     }
 
     session->threads.push_back(source.GetPointer());
+    if (ipc_statistics) {
+        ipc_statistics->OnRequestSent(source, GetServiceName(*session), IPC::CommandHeader { source.ReadTLS(0x80) }.command_id, system_tick.count());
+    }
 
     // Report success by default. If an error occurs later on, we will override
     // this with the proper error code.
     source.promised_result = RESULT_OK;
 
     // NOTE: boost::hana::fix does not support functions returning void, so we are returning a dummy value from within our thing and wrap it in a void lambda
-    auto continuation = boost::hana::fix([&svc_activity, session, session_handle](auto self, std::shared_ptr<Thread> thread) -> std::nullptr_t {
+    // The continuation may run after the session handle was closed, so it must keep the session alive
+    auto continuation = boost::hana::fix([&svc_activity, session=std::static_pointer_cast<ClientSession>(session->shared_from_this()), session_handle](auto self, std::shared_ptr<Thread> thread) -> std::nullptr_t {
         svc_activity.Resume();
 
         // Wait until the server accepts the session
@@ -3241,7 +3383,7 @@ OS::SVCCreatePort(Thread& source, const std::string& name, int32_t max_sessions)
 
 SVCFuture<OS::Result,HandleTable::Entry<ClientSession>> OS::SVCCreateSessionToPort(Thread& source, Handle client_port_handle) {
     auto log_message = fmt::format("{}SVCCreateSessionToPort: handle={}", ThreadPrinter{source}, HandlePrinter{source,client_port_handle});
-    auto client_port = source.GetProcessHandleTable().FindObject<ClientPort>(client_port_handle);
+    auto client_port = source.GetProcessHandleTable().FindObjectPointer<ClientPort>(client_port_handle);
     if (!client_port)
         SVCBreak(source, BreakReason::Panic);
 
@@ -3351,7 +3493,7 @@ SVCFuture<OS::Result,HandleTable::Entry<ServerSession>> OS::SVCAcceptSession(Thr
     return MakeFuture(RESULT_OK, session_handle_entry);
 }
 
-void OS::TranslateIPCMessage(Thread& source, Thread& dest, bool is_reply) {
+uint32_t OS::TranslateIPCMessage(Thread& source, Thread& dest, bool is_reply) {
     IPC::CommandHeader header = { source.ReadTLS(0x80) };
     // Copy header code and normal parameters
     unsigned tls_offset = 0x80;
@@ -3396,6 +3538,7 @@ void OS::TranslateIPCMessage(Thread& source, Thread& dest, bool is_reply) {
     }
 
     uint32_t dest_static_buffers_used_mask = 0;
+    uint32_t bytes_translated = 0;
 
     // Copy translate parameters
     while (tls_offset < command_end) {
@@ -3430,7 +3573,7 @@ void OS::TranslateIPCMessage(Thread& source, Thread& dest, bool is_reply) {
                         // Similarly, passing a null handle to dsp::DSP::RegisterInterruptEvents has special behavior
                         dest.WriteTLS(tls_offset, 0);
                     } else {
-                        auto object = source.GetProcessHandleTable().FindObject<Object>(source_handle);
+                        auto object = source.GetProcessHandleTable().FindObjectPointer<Object>(source_handle);
                         if (!object) {
                             throw std::runtime_error(fmt::format("Unknown handle {} input for translation", source_handle.value));
                         }
@@ -3440,11 +3583,11 @@ void OS::TranslateIPCMessage(Thread& source, Thread& dest, bool is_reply) {
                         // rejecting them is a good measure to prevent effects that
                         // would otherwise be hard to debug.
                         // TODO: How does hardware handle address arbitration across processes?
-                        if (nullptr != std::dynamic_pointer_cast<AddressArbiter>(object)) {
+                        if (nullptr != dynamic_cast<AddressArbiter*>(object)) {
                             throw std::runtime_error("Attempting to transfer address arbiter via IPC");
                         }
 
-                        auto handle_table_entry = dest.GetProcessHandleTable().CreateHandle(object, MakeHandleDebugInfoFromIPC(dest.ReadTLS(0x80)));
+                        auto handle_table_entry = dest.GetProcessHandleTable().CreateHandle(object->shared_from_this(), MakeHandleDebugInfoFromIPC(dest.ReadTLS(0x80)));
                         auto handle = handle_table_entry.first;
                         hypervisor.OnHandleDuplicated(source.GetParentProcess().GetId(), source_handle,
                                                       dest.GetParentProcess().GetId(), handle);
@@ -3452,7 +3595,7 @@ void OS::TranslateIPCMessage(Thread& source, Thread& dest, bool is_reply) {
                         // TODOTEST: If the object is already mapped in the target process, should the existing handle be used or a new one be created?
                         source.GetLogger()->info("Translated {} handle {:#x} to the {} handle {:#x} (object: {})",
                                                 ProcessPrinter { source.GetParentProcess() }, source_handle.value,
-                                                ProcessPrinter { dest.GetParentProcess() }, handle.value, ObjectPrinter{object});
+                                                ProcessPrinter { dest.GetParentProcess() }, handle.value, ObjectRefPrinter{*object});
 
                         if (descriptor.handles.close_handle) {
                             auto result = std::get<0>(Unwrap(SVCCloseHandle(source, source_handle)));
@@ -3506,6 +3649,7 @@ void OS::TranslateIPCMessage(Thread& source, Thread& dest, bool is_reply) {
             // TODO: Remove libapplet_launch workaround std::min
             for (uint32_t offset = 0; offset < std::min<uint32_t>(dest_buffer_size, descriptor.static_buffer.size); ++offset)
                 dest.WriteMemory(dest_buffer_addr + offset, source.ReadMemory(source_data_addr + offset));
+            bytes_translated += std::min<uint32_t>(dest_buffer_size, descriptor.static_buffer.size);
 
             // Read the static buffer address from TLS and copy it into the IPC message
             dest.WriteTLS(tls_offset, dest_buffer_addr);
@@ -3537,6 +3681,7 @@ void OS::TranslateIPCMessage(Thread& source, Thread& dest, bool is_reply) {
             }
 
             uint32_t buffer_size = descriptor.pxi_buffer.size;
+            bytes_translated += buffer_size;
 
             VAddr buffer_address = source.ReadTLS(tls_offset);
 
@@ -3718,6 +3863,7 @@ void OS::TranslateIPCMessage(Thread& source, Thread& dest, bool is_reply) {
 
                 // Write target address. Care must be taken to preserve the page offset into the source data
                 dest.WriteTLS(tls_offset, *buffer_dest_vaddr_opt + (buffer_source_addr & 0xfff));
+                bytes_translated += descriptor.map_buffer.size;
 
                 source.GetLogger()->info(   "{}Mapping buffer for input data at {:#010x} in thread {}:",
                                             ThreadPrinter{source}, buffer_source_addr, ThreadPrinter{dest});
@@ -3738,6 +3884,8 @@ void OS::TranslateIPCMessage(Thread& source, Thread& dest, bool is_reply) {
             throw std::runtime_error("Unknown IPC descriptor type");
         }
     }
+
+    return bytes_translated;
 }
 
 // Postcondition: On success or on error 0xc920181a, -1 <= wake_index < handle_count. On success, wake_index will not be -1.
@@ -3760,7 +3908,7 @@ SVCFuture<PromisedResult,PromisedWakeIndex> OS::SVCReplyAndReceive(Thread& sourc
 
     // TODO: The HANDLE_INVALID check is only necessary to get the fake services running. Actually, the kernel (likely) only provides the former check!
     if ((source.ReadTLS(0x80) >> 16) != 0xFFFF && reply_target != HANDLE_INVALID) {
-        auto server_session = source.GetProcessHandleTable().FindObject<ServerSession>(reply_target);
+        auto server_session = source.GetProcessHandleTable().FindObjectPointer<ServerSession>(reply_target);
         if (!server_session) {
             source.GetLogger()->error("{}Server session for reply target has been closed!", ThreadPrinter{source});
             SVCBreak(source, OS::BreakReason::Panic);
@@ -3777,7 +3925,10 @@ SVCFuture<PromisedResult,PromisedWakeIndex> OS::SVCReplyAndReceive(Thread& sourc
         assert(client_thread);
         source.GetLogger()->info("{}Sending IPC reply on {} with result {:#x}", ThreadPrinter{source}, ObjectPrinter{client_session}, source.ReadTLS(0x84));
         hypervisor.OnIPCReplyFromTo(source, *client_thread, reply_target);
-        TranslateIPCMessage(source, *client_thread, true);
+        auto bytes_translated = TranslateIPCMessage(source, *client_thread, true);
+        if (ipc_statistics) {
+            ipc_statistics->OnReplySent(*client_thread, bytes_translated, system_tick.count());
+        }
 
         source.GetLogger()->info("{}SERVER ReplyAndReceive notifying client session {} about IPC reply",
                                  ThreadPrinter{source}, ObjectPrinter{client_session});
@@ -3811,7 +3962,7 @@ SVCFuture<PromisedResult,PromisedWakeIndex> OS::SVCReplyAndReceive(Thread& sourc
     svc_activity.Resume();
 
     // NOTE: handles will have ran out of scope when this callback is executed,
-    // hence we read woken_object instead of looking up the handle ourselves.
+    // hence we read woken_object and woken_handle instead of looking up the handle ourselves.
     RunWhenReady(source, [this, future](std::shared_ptr<Thread> thread) {
         auto& svc_activity = activity.GetSubActivity("SVC").GetSubActivity("ReplyAndReceive"); // TODO: Use scope exit for interrupting this!
         svc_activity.Resume();
@@ -3845,9 +3996,12 @@ SVCFuture<PromisedResult,PromisedWakeIndex> OS::SVCReplyAndReceive(Thread& sourc
                 assert(client_thread);
 
                 thread->GetLogger()->info("{}Incoming IPC request on {}", ThreadPrinter{*thread}, ObjectPrinter{client_session});
-                TranslateIPCMessage(*client_thread, *thread, false);
+                auto bytes_translated = TranslateIPCMessage(*client_thread, *thread, false);
+                if (ipc_statistics) {
+                    ipc_statistics->OnRequestDelivered(*client_thread, *thread, bytes_translated);
+                }
 
-                hypervisor.OnIPCRequestFromTo(*client_thread, *thread, thread->GetProcessHandleTable().FindHandle(server_session));
+                hypervisor.OnIPCRequestFromTo(*client_thread, *thread, thread->woken_handle);
             } else {
                 // The thread was woken up because the client session was closed, so report this to the caller
                 thread->promised_result = 0xc920181a;
@@ -3900,13 +4054,24 @@ SVCFuture<OS::Result> OS::SVCBindInterrupt(Thread& source, uint32_t interrupt_in
     return MakeFuture(RESULT_OK);
 }
 
+SVCFuture<OS::Result> OS::SVCUnbindInterrupt(Thread& source, uint32_t interrupt_index, std::shared_ptr<Event> signal_event) {
+    source.GetLogger()->info("{}SVCUnbindInterrupt: Unbinding interrupt {:#x} from {}",
+                             ThreadPrinter{source}, interrupt_index, ObjectPrinter{signal_event});
+
+    std::erase_if(bound_interrupts[interrupt_index], [&](const std::weak_ptr<Event>& event) {
+        return event.expired() || event.lock() == signal_event;
+    });
+    Reschedule(source.GetPointer());
+    return MakeFuture(RESULT_OK);
+}
+
 auto OS::SVCInvalidateProcessDataCache(Thread& source, Handle process_handle, uint32_t start, uint32_t num_bytes)
     -> SVCFuture<Result> {
     source.GetLogger()->info("{}SVCInvalidateProcessDataCache: VAddr range [{:#010x}:{:#010x}] in process {}",
                              ThreadPrinter{source}, start, start + num_bytes, HandlePrinter { source, process_handle });
 
     // Assert the address is valid, ignore otherwise as we don't emulate caches
-    auto process = source.GetProcessHandleTable().FindObject<Process>(process_handle);
+    auto process = source.GetProcessHandleTable().FindObjectPointer<Process>(process_handle);
     auto src_paddr_opt = process->ResolveVirtualAddr(start);
     if (!src_paddr_opt) {
         throw std::runtime_error("Failed to look up source address");
@@ -3922,7 +4087,7 @@ auto OS::SVCFlushProcessDataCache(Thread& source, Handle process_handle, uint32_
                              ThreadPrinter{source}, start, start + num_bytes, HandlePrinter { source, process_handle });
 
     // Assert the address is valid, ignore otherwise as we don't emulate caches
-    auto process = source.GetProcessHandleTable().FindObject<Process>(process_handle);
+    auto process = source.GetProcessHandleTable().FindObjectPointer<Process>(process_handle);
     auto src_paddr_opt = process->ResolveVirtualAddr(start);
     if (!src_paddr_opt) {
         throw std::runtime_error("Failed to look up source address");
@@ -3958,6 +4123,8 @@ SVCFuture<OS::Result,HandleTable::Entry<DMAObject>> OS::SVCStartInterprocessDMA(
 //         SVCBreak(source, BreakReason::Panic);
 //     }
 
+    Memory::ScopedAccessSource access_source(Memory::AccessSource::DMA);
+
     // NOTE: Correct implementation of this function is critical: The
     //       loader process DMAs an entire ExeFS over the HASH IO registers
     //       to compute SHA256 hashes for verification
@@ -3973,54 +4140,71 @@ SVCFuture<OS::Result,HandleTable::Entry<DMAObject>> OS::SVCStartInterprocessDMA(
     }
     auto src_paddr = *src_paddr_opt;
 
-    // 0 means "transfer in one chunk". Otherwise it seems to repeatedly copy over the same chunk of memory address space?
-    if (!dma_config.source.transfer_size) {
-        dma_config.source.transfer_size = size;
-    }
-
-    // TODO: Flush source region
-    pica_context.renderer->InvalidateRange(paddr, size);
-
-    // If the transfer crosses a page boundary, make sure the virtual memory range is contiguous.
-    // TODO: Ideally this should just work; the real kernel likely splits the DMAs at non-contiguous page boundaries
-    auto check_contiguity = [](Process& process, uint32_t vstart, uint32_t pstart, uint32_t num_bytes) {
-        const uint32_t page_mask = 0xfffff000;
-        const uint32_t page_size = 0x1000;
-        uint32_t first_vpage = vstart & page_mask;
-        uint32_t first_ppage = pstart & page_mask;
-        for (uint32_t offset = 0; first_vpage + offset < vstart + num_bytes; offset += page_size) {
-            auto resolved_paddr = process.ResolveVirtualAddr(first_vpage + offset);
-            if (!resolved_paddr || *resolved_paddr != first_ppage + offset) {
-                throw std::runtime_error("DMAs involving non-contiguous memory ranges are not supported, yet");
-            }
+    // A transfer_size of 0 means "transfer in one chunk", which the address
+    // generators treat as linear addressing. Substituting the transfer size
+    // here would truncate it to 16 bits and switch large transfers into
+    // gather mode.
+    const DMAAddressGenerator src_addresses { src_address, dma_config.source };
+    const DMAAddressGenerator dst_addresses { dst_address, dma_config.dest };
+
+    if (size && paddr >= Memory::hash_fifo_start && paddr < Memory::hash_fifo_start + Memory::hash_fifo_size && !src_addresses.chunk_size) {
+        // Hashing large buffers is performance-critical during boot, so
+        // feed the HASH FIFO in one go rather than word-by-word
+        auto& mem = src_process.interpreter_setup.mem;
+        if (ResolveVirtualAddrWithSize(src_process, src_address)->second >= size) {
+            auto source_memory = Memory::LookupContiguousMemoryBackedPage<Memory::HookKind::Read>(mem, src_paddr, size);
+            Memory::FeedHashFIFO(mem, source_memory.data, size);
+        } else {
+            std::vector<uint8_t> data(size);
+            src_process.ReadMemoryBlock(src_address, data.data(), size);
+            Memory::FeedHashFIFO(mem, data.data(), size);
         }
-    };
-    try {
-        check_contiguity(src_process, src_address, src_paddr, size);
-        check_contiguity(dst_process, dst_address, paddr, size);
-    } catch(...) {
-        // TODO: Digimon World workaround for Y2R
         size = 0;
     }
 
-    for (uint32_t offset = 0; offset < size; ) {
-        const auto bytes_remaining = size - offset;
-
-        // dma_config.source.type is a bit mask specifying transfer granularities that may be involved.
-        // E.g. if bit 2 is set, 4-byte transfers may be used, and if not other granularities are used.
-        // TODO: Re-enable the mod! A "wrapping" mode exists that writes to a repeated version of the same target range, e.g. used for the HASH registers
-        // TODO: Implement the (dma_config.source.type & 2) case for 16-bit transfer granularity
-        if ((dma_config.source.type & 4) && bytes_remaining >= 4) {
-            auto value = src_process.ReadPhysicalMemory32(src_paddr + offset);
-            dst_process.WritePhysicalMemory32(paddr + (offset /*% dma_config.source.transfer_size*/), value);
-            offset += 4;
-        } else if (dma_config.source.type & 1) {
-            auto value = src_process.ReadPhysicalMemory(src_paddr + offset);
-            dst_process.WritePhysicalMemory(paddr + (offset /*% dma_config.source.transfer_size*/), value);
-            ++offset;
-        } else {
-            throw std::runtime_error(fmt::format("Given transfer of size {:#x} not supported with the given parameters (:#x)", size, dma_config.source.type));
+    // Split the transfer into runs that are contiguous in physical memory on
+    // both sides. Runs between memory-backed regions are copied in bulk, while
+    // runs involving MMIO are emitted in the access granularity given by the
+    // source configuration.
+    auto& mem = src_process.interpreter_setup.mem;
+    std::array<uint8_t, 0x1000> staging_buffer;
+    auto transfer_run = [&](const DMARun& run) {
+        // TODO: Flush source region
+        pica_context.renderer->InvalidateRange(run.dest, run.size);
+
+        if (Memory::LookupMemoryBackedPage(mem, run.source).data && Memory::LookupMemoryBackedPage(mem, run.dest).data) {
+            Memory::ReadBlock(mem, run.source, staging_buffer.data(), run.size);
+            Memory::WriteBlock(mem, run.dest, staging_buffer.data(), run.size);
+            return;
+        }
+
+        for (uint32_t run_offset = 0; run_offset < run.size; ) {
+            const auto bytes_remaining = run.size - run_offset;
+
+            // dma_config.source.type is a bit mask specifying transfer granularities that may be involved.
+            // E.g. if bit 2 is set, 4-byte transfers may be used, and if not other granularities are used.
+            // TODO: Implement the (dma_config.source.type & 2) case for 16-bit transfer granularity
+            if ((dma_config.source.type & 4) && bytes_remaining >= 4) {
+                auto value = src_process.ReadPhysicalMemory32(run.source + run_offset);
+                dst_process.WritePhysicalMemory32(run.dest + run_offset, value);
+                run_offset += 4;
+            } else if (dma_config.source.type & 1) {
+                auto value = src_process.ReadPhysicalMemory(run.source + run_offset);
+                dst_process.WritePhysicalMemory(run.dest + run_offset, value);
+                ++run_offset;
+            } else {
+                throw std::runtime_error(fmt::format("Given transfer of size {:#x} not supported with the given parameters ({:#x})", size, dma_config.source.type));
+            }
         }
+    };
+    auto bytes_transferred = SplitDMATransfer(size, src_addresses, dst_addresses,
+                                              [&](VAddr addr) { return ResolveVirtualAddrWithSize(src_process, addr); },
+                                              [&](VAddr addr) { return ResolveVirtualAddrWithSize(dst_process, addr); },
+                                              transfer_run);
+    if (bytes_transferred < size) {
+        // TODO: Digimon World workaround for Y2R
+        source.GetLogger()->warn("{}Aborting DMA at offset {:#x}: Source address {:#010x} or target address {:#010x} is not mapped",
+                                 ThreadPrinter{source}, bytes_transferred, src_addresses(bytes_transferred).first, dst_addresses(bytes_transferred).first);
     }
 
     auto dma_object = source.GetProcessHandleTable().CreateHandle(std::make_shared<DMAObject>(), MakeHandleDebugInfo());
@@ -4224,7 +4408,7 @@ static PAddr ResolveStandardVirtualAddress(VAddr vaddr) {
 SVCFuture<OS::Result,HandleTable::Entry<Process>> OS::SVCCreateProcess(Thread& source, Handle codeset_handle, KernelCapability* kernel_caps, uint32_t num_kernel_caps) {
     source.GetLogger()->info("{}SVCCreateProcess: num_kernel_caps={:#x}",
                              ThreadPrinter{source}, num_kernel_caps);
-    auto codeset = source.GetProcessHandleTable().FindObject<CodeSet>(codeset_handle);
+    auto codeset_ptr = source.GetProcessHandleTable().FindObjectPointer<CodeSet>(codeset_handle);
 
     const uint32_t page_size = 0x1000;
 
@@ -4235,7 +4419,7 @@ SVCFuture<OS::Result,HandleTable::Entry<Process>> OS::SVCCreateProcess(Thread& s
     //       on-the-fly by FakePXI. This tricks LLE loader/pm into accepting
     //       our fake processes.
     for (auto& [process_name, fake_process_info] : hle_titles) {
-        if (!ranges::equal(std::string_view { codeset->app_name }, process_name)) {
+        if (!ranges::equal(std::string_view { codeset_ptr->app_name }, process_name)) {
             continue;
         }
 
@@ -4287,7 +4471,8 @@ SVCFuture<OS::Result,HandleTable::Entry<Process>> OS::SVCCreateProcess(Thread& s
     // TODO: This masks a bug in the ResourceManager: The sequence "HOME Menu -> SM3DL -> HOME Menu -> Mii Maker -> Create new Mii -> Start from scratch" will produce a glitchy button texture without this line
     pica_context.renderer->InvalidateRange(memory_allocator.RegionStart(), memory_allocator.RegionEnd() - memory_allocator.RegionStart());
 
-    // Create process
+    // Create process. It takes over the CodeSet and its memory
+    auto codeset = std::static_pointer_cast<CodeSet>(codeset_ptr->shared_from_this());
     auto process = std::make_shared<EmuProcess>(*this, source.GetParentProcess().interpreter_setup, MakeNewProcessId(), codeset, memory_allocator);
 
     // Map program segments into process
@@ -4455,6 +4640,39 @@ SVCFuture<Result> OS::SVCSetResourceLimitValues(Thread& source, ResourceLimit& r
     return MakeFuture(RESULT_OK);
 }
 
+SVCFuture<Result> OS::SVCGetResourceLimitValues(Thread& source, ResourceLimit& resource_limit, bool is_limits, VAddr out_addr, VAddr names_addr, uint32_t num_names) {
+    source.GetLogger()->info("{}SVCGetResourceLimit{}Values to addr {:#x}, {:#x} names at addr {:#x}",
+                             ThreadPrinter{source}, is_limits ? "Limit" : "Current", out_addr, num_names, names_addr);
+
+    for (unsigned name = 0; name < num_names; ++name) {
+        uint32_t addr = names_addr + name * 4;
+        uint32_t limit_type = source.ReadMemory32(addr);
+        source.GetLogger()->info("{}Name {}: {:#x}", ThreadPrinter{source}, name, limit_type);
+
+        if (limit_type > std::size(resource_limit.limits)) {
+            throw Mikage::Exceptions::Invalid("Out-of-bounds limit type");
+        }
+        if (is_limits) {
+            source.WriteMemory32(out_addr + 8 * name    , resource_limit.limits[limit_type] & 0xffffffff);
+            source.WriteMemory32(out_addr + 8 * name + 4, resource_limit.limits[limit_type] >> 32);
+        } else {
+            if (limit_type == 0x1) {
+                // Current commit: Apparently, Citra always returns 0 here.
+                // TODO: Properly respect the application's exheader flags here.
+                // TODO NOW: We just changed this to write 8 bytes instead of 4, and I'm not sure whether I got the word order right.
+                source.WriteMemory32(out_addr + 8 * name    , memory_app().UsedMemory());
+                source.WriteMemory32(out_addr + 8 * name + 4, 0);
+                source.GetLogger()->info("{}Returning {:#x}", ThreadPrinter{source}, memory_app().UsedMemory());
+            } else {
+                throw Mikage::Exceptions::NotImplemented("Unsupported resource type {:#x} for SVCGetResourceLimitCurrentValues", limit_type);
+            }
+        }
+    }
+
+    RescheduleImmediately(source.GetPointer());
+    return MakeFuture(RESULT_OK);
+}
+
 SVCEmptyFuture OS::SVCDoNothing(Thread& source) {
     Reschedule(source.GetPointer());
     return MakeFuture(nullptr);
@@ -4471,6 +4689,75 @@ SVCFuture<OS::Result,HandleTable::Entry<Object>> OS::SVCCreateDummyObject(FakeTh
     return MakeFuture(RESULT_OK, object);
 }
 
+bool OS::TryInlineSVC(EmuThread& source, unsigned svc_id) try {
+    switch (svc_id) {
+    case 0x11: // GetCurrentProcessorNumber
+    case 0x28: // GetSystemTick
+    case 0x35: // GetProcessId
+    case 0x37: // GetThreadId
+    case 0x39: // GetResourceLimitLimitValues
+    case 0x3a: // GetResourceLimitCurrentValues
+        break;
+
+    default:
+        return false;
+    }
+
+    // Handle lookup failures are left to SVCRaw for consistent error reporting
+    auto regs = source.context->ToGenericContext();
+    auto& handle_table = source.GetProcessHandleTable();
+    switch (svc_id) {
+    case 0x11: // GetCurrentProcessorNumber
+        regs.reg[0] = RESULT_OK;
+        regs.reg[1] = 1;
+        break;
+
+    case 0x28: // GetSystemTick
+    {
+        auto [tick] = Unwrap(SVCGetSystemTick(source));
+        regs.reg[0] = tick & 0xFFFFFFFF;
+        regs.reg[1] = tick >> 32;
+        break;
+    }
+
+    case 0x35: // GetProcessId
+    {
+        auto process = handle_table.FindObjectPointer<Process>(Handle{regs.reg[1]}, true);
+        if (!process) {
+            return false;
+        }
+        std::tie(regs.reg[0], regs.reg[1]) = Unwrap(SVCGetProcessId(source, *process));
+        break;
+    }
+
+    case 0x37: // GetThreadId
+    {
+        auto thread = handle_table.FindObjectPointer<Thread>(Handle{regs.reg[1]}, true);
+        if (!thread) {
+            return false;
+        }
+        std::tie(regs.reg[0], regs.reg[1]) = Unwrap(SVCGetThreadId(source, *thread));
+        break;
+    }
+
+    case 0x39: // GetResourceLimitLimitValues
+    case 0x3a: // GetResourceLimitCurrentValues
+    {
+        auto resource_limit = handle_table.FindObjectPointer<ResourceLimit>(Handle{regs.reg[1]}, true);
+        if (!resource_limit) {
+            return false;
+        }
+        std::tie(regs.reg[0]) = Unwrap(SVCGetResourceLimitValues(source, *resource_limit, svc_id == 0x39, regs.reg[0], regs.reg[2], regs.reg[3]));
+        break;
+    }
+    }
+
+    source.context->FromGenericContext(regs);
+    return true;
+} catch(const std::runtime_error& err) {
+    HandleOSThreadException(err, source);
+}
+
 SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::ExecutionContext& ctx) try {
     ZoneScopedN("SVCRaw");
 
@@ -4575,7 +4862,7 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
         bool for_calling_process = (svc_id == 0x2);
 
         VAddr address = for_calling_process ? input_regs.reg[2] : input_regs.reg[3];
-        auto& process = *source.GetProcessHandleTable().FindObject<Process>(for_calling_process ? Handle{0xffff8001} : Handle{input_regs.reg[2]});
+        auto& process = *source.GetProcessHandleTable().FindObjectPointer<Process>(for_calling_process ? Handle{0xffff8001} : Handle{input_regs.reg[2]});
 
         source.GetLogger()->warn("{}SVCQuery{}Memory: process {}, address {:#x})",
                                  ThreadPrinter{source}, for_calling_process ? "" : "Process", ProcessPrinter { process }, address);
@@ -4674,7 +4961,7 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
 
     case 0x5: // SetProcessAffinityMask
     {
-        auto process = source.GetProcessHandleTable().FindObject<Process>(Handle{input_regs.reg[0]});
+        auto process = source.GetProcessHandleTable().FindObjectPointer<Process>(Handle{input_regs.reg[0]});
         if (!process)
             SVCBreak(source, BreakReason::Panic);
 
@@ -4686,7 +4973,7 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
 
     case 0x7: // SetProcessIdealProcessor
     {
-        auto process = source.GetProcessHandleTable().FindObject<Process>(Handle{input_regs.reg[0]});
+        auto process = source.GetProcessHandleTable().FindObjectPointer<Process>(Handle{input_regs.reg[0]});
         if (!process)
             SVCBreak(source, BreakReason::Panic);
 
@@ -4717,7 +5004,7 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
     case 0xb: // GetThreadPriority
     {
         source.GetLogger()->info("SVCGetThreadPriority for {}", HandlePrinter{source,Handle{input_regs.reg[1]}});
-        auto thread = source.GetProcessHandleTable().FindObject<Thread>(Handle{input_regs.reg[1]});
+        auto thread = source.GetProcessHandleTable().FindObjectPointer<Thread>(Handle{input_regs.reg[1]});
         if (!thread)
             SVCBreak(source, BreakReason::Panic);
 
@@ -4777,7 +5064,7 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
     {
         Handle handle{input_regs.reg[1]};
         int32_t times = input_regs.reg[2];
-        auto semaphore = source.GetProcessHandleTable().FindObject<Semaphore>(handle);
+        auto semaphore = source.GetProcessHandleTable().FindObjectPointer<Semaphore>(handle);
         if (semaphore == nullptr)
             SVCBreak(source, BreakReason::Panic);
 
@@ -4810,7 +5097,7 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
 
     case 0x1b: // SetTimer
     {
-        auto timer = source.GetProcessHandleTable().FindObject<Timer>(Handle{input_regs.reg[0]});
+        auto timer = source.GetProcessHandleTable().FindObjectPointer<Timer>(Handle{input_regs.reg[0]});
         int64_t initial = (static_cast<int64_t>(input_regs.reg[3]) << 32) | input_regs.reg[2];
         int64_t interval = (static_cast<int64_t>(input_regs.reg[4]) << 32) | input_regs.reg[1];
         if (!timer) {
@@ -4830,7 +5117,7 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
 
     case 0x20: // UnmapMemoryBlock
     {
-        auto mem_block = source.GetProcessHandleTable().FindObject<SharedMemoryBlock>(Handle{input_regs.reg[0]});
+        auto mem_block = source.GetProcessHandleTable().FindObjectPointer<SharedMemoryBlock>(Handle{input_regs.reg[0]});
         if (!mem_block)
             SVCBreak(source,BreakReason::Panic);
         return EncodeFuture(OS::SVCUnmapMemoryBlock(source, *mem_block, input_regs.reg[1]));
@@ -4917,7 +5204,7 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
 
     case 0x2b: // GetProcessInfo
     {
-        auto& process = *source.GetProcessHandleTable().FindObject<Process>(Handle{input_regs.reg[1]});
+        auto& process = *source.GetProcessHandleTable().FindObjectPointer<Process>(Handle{input_regs.reg[1]});
 
         // r2 specifies the kind of information to retrieve. Currently, we only
         // support a limited set of inputs
@@ -4980,19 +5267,19 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
 
     case 0x35: // GetProcessId
     {
-        auto process = source.GetProcessHandleTable().FindObject<Process>(Handle{input_regs.reg[1]});
+        auto process = source.GetProcessHandleTable().FindObjectPointer<Process>(Handle{input_regs.reg[1]});
         return EncodeFuture(SVCGetProcessId(source, *process));
     }
 
     case 0x37: // GetThreadId
     {
-        auto thread = source.GetProcessHandleTable().FindObject<Thread>(Handle{input_regs.reg[1]});
+        auto thread = source.GetProcessHandleTable().FindObjectPointer<Thread>(Handle{input_regs.reg[1]});
         return EncodeFuture(SVCGetThreadId(source, *thread));
     }
 
     case 0x38: // GetResourceLimit
     {
-        auto process = source.GetProcessHandleTable().FindObject<Process>(Handle{input_regs.reg[1]});
+        auto process = source.GetProcessHandleTable().FindObjectPointer<Process>(Handle{input_regs.reg[1]});
 
         std::cerr << "SVCGetResourceLimit" << std::endl;
 
@@ -5008,44 +5295,8 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
     case 0x39: // GetResourceLimitLimitValues
     case 0x3a: // GetResourceLimitCurrentValues
     {
-        uint32_t out_addr = input_regs.reg[0];
-        auto resource_limit = source.GetProcessHandleTable().FindObject<ResourceLimit>({input_regs.reg[1]});
-        uint32_t names_addr = input_regs.reg[2];
-        uint32_t num_names = input_regs.reg[3];
-
-        const bool is_limits = (svc_id == 0x39);
-
-        std::cerr << (is_limits ? "SVCGetResourceLimitLimitValues" : "SVCGetResourceLimitCurrentValues") << " to addr 0x"
-                  << std::hex << out_addr
-                  << ", 0x" << num_names
-                  << " names at addr 0x" << names_addr << std::endl;
-        for (unsigned name = 0; name < num_names; ++name) {
-            uint32_t addr = names_addr + name * 4;
-            uint32_t limit_type = source.ReadMemory32(addr);
-            std::cerr << "Name " << std::dec << name << ": 0x" << std::hex << limit_type << std::endl;
-
-            if (limit_type > std::size(resource_limit->limits)) {
-                throw Mikage::Exceptions::Invalid("Out-of-bounds limit type");
-            }
-            if (is_limits) {
-                source.WriteMemory32(out_addr + 8 * name    , resource_limit->limits[limit_type] & 0xffffffff);
-                source.WriteMemory32(out_addr + 8 * name + 4, resource_limit->limits[limit_type] >> 32);
-            } else {
-                if (limit_type == 0x1) {
-                    // Current commit: Apparently, Citra always returns 0 here.
-                    // TODO: Properly respect the application's exheader flags here.
-                    // TODO NOW: We just changed this to write 8 bytes instead of 4, and I'm not sure whether I got the word order right.
-                    source.WriteMemory32(out_addr + 8 * name    , memory_app().UsedMemory());
-                    source.WriteMemory32(out_addr + 8 * name + 4, 0);
-                    std::cerr << "Returning value 0x" << std::hex << memory_app().UsedMemory() << std::endl;
-                } else {
-                    throw 5;
-                }
-            }
-        }
-
-        RescheduleImmediately(source.GetPointer());
-        return Encode(RESULT_OK);
+        auto resource_limit = source.GetProcessHandleTable().FindObjectPointer<ResourceLimit>({input_regs.reg[1]});
+        return EncodeFuture(SVCGetResourceLimitValues(source, *resource_limit, svc_id == 0x39, input_regs.reg[0], input_regs.reg[2], input_regs.reg[3]));
     }
 
     case 0x3c: // Break
@@ -5093,7 +5344,7 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
 
     case 0x4a: // AcceptSession
     {
-        auto server_port = source.GetProcessHandleTable().FindObject<ServerPort>(Handle{input_regs.reg[1]});
+        auto server_port = source.GetProcessHandleTable().FindObjectPointer<ServerPort>(Handle{input_regs.reg[1]});
         return EncodeFuture(SVCAcceptSession(source, *server_port));
     }
 
@@ -5116,8 +5367,19 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
         int32_t priority = input_regs.reg[2];
         uint32_t is_manual_clear = input_regs.reg[3];
 
-        auto observer = source.GetProcessHandleTable().FindObject<Event>(observer_handle);
-        return EncodeFuture(SVCBindInterrupt(source, interrupt_index, observer, priority, is_manual_clear));
+        auto observer = source.GetProcessHandleTable().FindObjectPointer<Event>(observer_handle);
+        auto observer_ref = observer ? std::static_pointer_cast<Event>(observer->shared_from_this()) : nullptr;
+        return EncodeFuture(SVCBindInterrupt(source, interrupt_index, std::move(observer_ref), priority, is_manual_clear));
+    }
+
+    case 0x51: // UnbindInterrupt
+    {
+        uint32_t interrupt_index = input_regs.reg[0];
+        Handle observer_handle{input_regs.reg[1]};
+
+        auto observer = source.GetProcessHandleTable().FindObjectPointer<Event>(observer_handle);
+        auto observer_ref = observer ? std::static_pointer_cast<Event>(observer->shared_from_this()) : nullptr;
+        return EncodeFuture(SVCUnbindInterrupt(source, interrupt_index, std::move(observer_ref)));
     }
 
     case 0x52: // InvalidateProcessDataCache
@@ -5150,8 +5412,8 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
 
     case 0x55: // StartInterprocessDMA
     {
-        auto dst_process = source.GetProcessHandleTable().FindObject<Process>({input_regs.reg[1]});
-        auto src_process = source.GetProcessHandleTable().FindObject<Process>({input_regs.reg[3]});
+        auto dst_process = source.GetProcessHandleTable().FindObjectPointer<Process>({input_regs.reg[1]});
+        auto src_process = source.GetProcessHandleTable().FindObjectPointer<Process>({input_regs.reg[3]});
         const uint32_t dst_address = input_regs.reg[2];
         const uint32_t src_address = input_regs.reg[0];
         uint32_t size = input_regs.reg[4];
@@ -5159,8 +5421,8 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
 
         source.GetLogger()->info("{}SVCStartInterprocessDMA: {:#x} bytes from address {:#010x} in {} to address {:#010x} in {}",
                                  ThreadPrinter{source}, size,
-                                 src_address, ObjectPrinter{src_process},
-                                 dst_address, ObjectPrinter{dst_process});
+                                 src_address, HandlePrinter{source, Handle{input_regs.reg[3]}},
+                                 dst_address, HandlePrinter{source, Handle{input_regs.reg[1]}});
 
         // TODO: Most of the contents of this struct need to be verified!
         DMAConfig dma_config = {
@@ -5232,7 +5494,7 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
 
     case 0x70: // ControlProcessMemory
     {
-        auto& process = *source.GetProcessHandleTable().FindObject<Process>(Handle{input_regs.reg[0]});
+        auto& process = *source.GetProcessHandleTable().FindObjectPointer<Process>(Handle{input_regs.reg[0]});
         uint32_t addr0 = input_regs.reg[1];
         uint32_t addr1 = input_regs.reg[2];
         uint32_t size = input_regs.reg[3];
@@ -5280,7 +5542,8 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
 
     case 0x76: // TerminateProcess
     {
-        auto process = source.GetProcessHandleTable().FindObject<Process>({input_regs.reg[0]});
+        // Keep the process alive until its last thread has been destroyed
+        auto process = std::static_pointer_cast<Process>(source.GetProcessHandleTable().FindObjectPointer<Process>({input_regs.reg[0]})->shared_from_this());
         source.GetLogger()->info("{}SVCTerminateProcess: {}", ThreadPrinter{source}, ProcessPrinter{*process});
 
         if (process.get() == &source.GetParentProcess()) {
@@ -5314,10 +5577,11 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
 
     case 0x77: // SetProcessResourceLimits
     {
-        auto process = source.GetProcessHandleTable().FindObject<Process>({input_regs.reg[0]});
-        auto limit = source.GetProcessHandleTable().FindObject<ResourceLimit>({input_regs.reg[1]});
-        source.GetLogger()->info("{}SetProcessResourceLimits: {} for process {}", ThreadPrinter{source}, ObjectPrinter { limit }, ObjectPrinter { process });
-        process->limit = limit;
+        auto process = source.GetProcessHandleTable().FindObjectPointer<Process>({input_regs.reg[0]});
+        auto limit = source.GetProcessHandleTable().FindObjectPointer<ResourceLimit>({input_regs.reg[1]});
+        source.GetLogger()->info("{}SetProcessResourceLimits: {} for process {}", ThreadPrinter{source},
+                                 HandlePrinter { source, Handle{input_regs.reg[1]} }, HandlePrinter { source, Handle{input_regs.reg[0]} });
+        process->limit = limit ? std::static_pointer_cast<ResourceLimit>(limit->shared_from_this()) : nullptr;
         RescheduleImmediately(source.GetPointer());
         return Encode(RESULT_OK);
     }
@@ -5329,7 +5593,7 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
 
     case 0x79: // SetResourceLimitValues
     {
-        auto resource_limit = source.GetProcessHandleTable().FindObject<ResourceLimit>({input_regs.reg[0]});
+        auto resource_limit = source.GetProcessHandleTable().FindObjectPointer<ResourceLimit>({input_regs.reg[0]});
         uint32_t limit_type_addr{input_regs.reg[1]};
         uint32_t limit_value_addr{input_regs.reg[2]};
         uint32_t limit_count{input_regs.reg[3]};
@@ -5378,16 +5642,32 @@ SVCCallbackType OS::SVCRaw(Thread& source, unsigned svc_id, Interpreter::Executi
 }
 
 void OS::NotifyInterrupt(uint32_t index) {
-    std::cout << "Firing interrupt 0x" << std::hex << index << "" << std::endl;
-    if (bound_interrupts[index].empty()) {
-        std::cout << "Firing interrupt 0x" << std::hex << index << ", but nobody is listening" << std::endl;
-        return;
-    }
+    pending_interrupts[index / 64].fetch_or(uint64_t { 1 } << (index % 64), std::memory_order_relaxed);
+}
+
+void OS::DeliverPendingInterrupts() {
+    for (uint32_t word_index = 0; word_index < pending_interrupts.size(); ++word_index) {
+        auto& word = pending_interrupts[word_index];
+        if (!word.load(std::memory_order_relaxed)) {
+            continue;
+        }
+
+        for (uint64_t pending = word.exchange(0, std::memory_order_relaxed); pending; pending &= pending - 1) {
+            const uint32_t index = word_index * 64 + std::countr_zero(pending);
+            auto& events = bound_interrupts[index];
+            std::erase_if(events, [](const std::weak_ptr<Event>& event) { return event.expired(); });
+            if (events.empty()) {
+                logger->debug("Firing interrupt {:#x}, but nobody is listening", index);
+                continue;
+            }
 
-    for (auto observer : bound_interrupts[index]) {
-        auto locked_observer = observer.lock();
-        locked_observer->SignalEvent();
-        OnResourceReady(*locked_observer);
+            logger->debug("Firing interrupt {:#x}", index);
+            for (auto& weak_event : events) {
+                auto event = weak_event.lock();
+                event->SignalEvent();
+                OnResourceReady(*event);
+            }
+        }
     }
 }
 
@@ -5435,7 +5715,7 @@ std::vector<std::shared_ptr<Thread>> OS::GetThreadList() const {
 
     auto lock_weak_ptr = [](auto& weak_ptr) { return weak_ptr.lock(); };
     auto not_nullptr = [](const auto& ptr) { return ptr != nullptr; };
-    auto is_emuthread = [](const auto& ptr) { return (nullptr != std::dynamic_pointer_cast<EmuThread>(ptr)); };
+    auto is_emuthread = [](const auto& ptr) { return (nullptr != ptr->AsEmuThread()); };
     ranges::copy(threads | ranges::view::transform(lock_weak_ptr) | ranges::view::filter(not_nullptr) | ranges::view::filter(is_emuthread), ranges::back_inserter(ret));
     return ret;
 }
@@ -5507,6 +5787,12 @@ void SetupOSDSPCallbacks(OS& os) {
     dsp_tick = GetDspTick(os);
 }
 
+static void DisplayFramesToHost(Memory::PhysicalMemory& mem, spdlog::logger& logger, EmuDisplay::EmuDisplay& display, Pica::Renderer& renderer);
+
+// Upper bound for the number of system calls a thread may execute inline
+// before returning to the scheduler, which is what advances emulated time
+static constexpr uint32_t max_inline_svcs_per_dispatch = 64;
+
 void OS::EnterExecutionLoop() {
     g_os = this;
 //    auto dsp_interrupt_handlera = [this]() {
@@ -5528,6 +5814,8 @@ void OS::EnterExecutionLoop() {
 
     /*auto */dsp_tick = GetDspTick(*this);
 
+    auto& dsp_activity = activity.GetSubActivity("DSP");
+
     while (!stop_requested) {
         // TODO: Gather these from the "caller" (i.e. the coroutine)
         auto max_cycles = 100;
@@ -5550,8 +5838,13 @@ void OS::EnterExecutionLoop() {
                 // For profiling, present DSP emulation as one logical fiber
                 TracyFiberEnter("DSP");
                 TracyCZoneN(DSPSliceZone, "DSPSlice", true);
+                dsp_activity.Resume();
 //                fprintf(stderr, "Running %d teakra cycles\n", (int)dsp_tick_diff.count());
-                g_teakra->Run(dsp_tick_diff.count());
+                {
+                    Memory::ScopedAccessSource access_source(Memory::AccessSource::DSP);
+                    g_teakra->Run(dsp_tick_diff.count());
+                }
+                dsp_activity.Interrupt();
                 dsp_tick = GetDspTick(*this);
                 TracyCZoneEnd(DSPSliceZone);
                 TracyFiberLeave;
@@ -5565,6 +5858,13 @@ void OS::EnterExecutionLoop() {
         //       execution after.
         TracyCZoneN(SchedulerZonePre, "OS", true);
 
+        if (std::exchange(frame_presentation_pending, false)) {
+            DisplayFramesToHost(setup.mem, *logger, display, *pica_context.renderer);
+            counters.vblanks.Add();
+        }
+
+        DeliverPendingInterrupts();
+
         // TODO: If all threads are waiting, the GDB stub still should be able
         //       to interrupt execution! (currently, this is not possible
         //       because an EmuThread needs to invoke the interpreter so that
@@ -5575,6 +5875,7 @@ void OS::EnterExecutionLoop() {
             // TODO: Find next event instead (i.e. interrupt or timer)
 //            const auto duration_per_tick = std::chrono::nanoseconds(10000000);
             const auto duration_per_tick = std::chrono::nanoseconds(100000);
+            counters.idle_ticks.Add(std::chrono::duration_cast<ticks>(duration_per_tick).count());
             ElapseTime(duration_per_tick);
             TracyCZoneEnd(SchedulerZonePre)
             continue;
@@ -5599,76 +5900,91 @@ void OS::EnterExecutionLoop() {
         }
 
         // Resume thread until it invokes a system call
+        // NOTE: next_thread keeps the thread alive until the end of this
+        //       iteration, so plain references are used from here on
+        Thread& thread = *next_thread;
+        EmuThread* const emuthread = thread.AsEmuThread();
 
-        active_thread = next_thread.get();
-        decltype(ARM::State::cycle_count) ticks_elapsed = 0;
-        {
-            auto emuthread = std::dynamic_pointer_cast<EmuThread>(next_thread);
+        // Per-dispatch logging copies the full CPU state, so skip it entirely unless enabled
+        const auto thread_logger = thread.GetLogger();
+        const bool log_dispatch = thread_logger->should_log(spdlog::level::info);
 
-            if (emuthread) {
+        active_thread = &thread;
+        decltype(ARM::State::cycle_count) ticks_elapsed = 0;
+        decltype(ARM::State::instruction_count) instructions_elapsed = 0;
+        if (emuthread) {
+            if (log_dispatch) {
                 auto cpu = emuthread->context->ToGenericContext();
-                next_thread->GetLogger()->info("{}Dispatcher entering (PC at {:#x}), r0={:x}, r1={:x}, r2={:x}, r3={:x}, r4={:x}, r5={:x}, r6={:x}, r7={:x}, r8={:x}",
-                                               ThreadPrinter{*next_thread}, cpu.reg[15], cpu.reg[0], cpu.reg[1],
-                                               cpu.reg[2], cpu.reg[3], cpu.reg[4], cpu.reg[5], cpu.reg[6],
-                                               cpu.reg[7], cpu.reg[8]);
-
-
-                ticks_elapsed = cpu.cycle_count;
-            } else {
-                next_thread->GetLogger()->info("{}Dispatcher entering", ThreadPrinter{*next_thread});
+                thread_logger->info("{}Dispatcher entering (PC at {:#x}), r0={:x}, r1={:x}, r2={:x}, r3={:x}, r4={:x}, r5={:x}, r6={:x}, r7={:x}, r8={:x}",
+                                    ThreadPrinter{thread}, cpu.reg[15], cpu.reg[0], cpu.reg[1],
+                                    cpu.reg[2], cpu.reg[3], cpu.reg[4], cpu.reg[5], cpu.reg[6],
+                                    cpu.reg[7], cpu.reg[8]);
             }
+
+            ticks_elapsed = emuthread->context->GetCycleCount();
+            instructions_elapsed = emuthread->context->GetInstructionCount();
+        } else if (log_dispatch) {
+            thread_logger->info("{}Dispatcher entering", ThreadPrinter{thread});
         }
-        next_thread->GetProcessHandleTable().SetCurrentThread(next_thread);
-        next_thread->RestoreContext();
+        thread.GetProcessHandleTable().SetCurrentThread(next_thread);
+        thread.RestoreContext();
+        thread.inline_svc_budget = max_inline_svcs_per_dispatch;
 
         TracyCZoneEnd(SchedulerZonePre);
         {
+            Memory::ScopedAccessSource access_source((Memory::enable_heatmap && emuthread)
+                                                     ? Memory::AccessSource::CPU : Memory::AccessSource::OS);
 #ifdef TRACY_ENABLE
             // TODO: Also add a name for FakeProcesses
-            if (auto* emuproc = dynamic_cast<EmuProcess*>(&next_thread->GetParentProcess())) {
+            if (auto* emuproc = emuthread ? &static_cast<EmuProcess&>(thread.GetParentProcess()) : nullptr) {
                 static std::unordered_map<ProcessId, std::unordered_map<ThreadId, std::string>> thread_names;
-                auto [thread_name_it, new_thread] = thread_names[emuproc->GetId()].emplace(next_thread->GetId(), "");
+                auto [thread_name_it, new_thread] = thread_names[emuproc->GetId()].emplace(thread.GetId(), "");
                 if (new_thread) {
-                    thread_name_it->second = fmt::format("{} thread {}", emuproc->codeset->app_name, next_thread->GetId());
+                    thread_name_it->second = fmt::format("{} thread {}", emuproc->codeset->app_name, thread.GetId());
                 }
                 TracyFiberEnter( thread_name_it->second.c_str() );
                 bool is_gsp = emuproc->codeset->app_name == std::string_view { "gsp" };
                 if (is_gsp) {
                     // GSP does little actual CPU emulation work; most of it is spent emulating the GPU
                     ZoneNamedN(Activity, "GPU emulation", true);
-                    next_thread->control->ResumeFromScheduler();
+                    thread.control->ResumeFromScheduler();
                 } else {
                     ZoneNamedN(Activity, "CPU emulation", true);
-                    next_thread->control->ResumeFromScheduler();
+                    thread.control->ResumeFromScheduler();
                 }
                 TracyFiberLeave;
 #else
             if (false) {
 #endif
             } else {
-                next_thread->control->ResumeFromScheduler();
+                thread.control->ResumeFromScheduler();
             }
         }
         ZoneNamedN(SchedulerZonePost, "OS", true);
 
-        next_thread->SaveContext();
-        {
-            auto emuthread = std::dynamic_pointer_cast<EmuThread>(next_thread);
-            next_thread->GetLogger()->info("{}Dispatcher leaving {}", ThreadPrinter{*active_thread},
-                                             emuthread ? fmt::format(" (PC at {:#x}, LR at {:#x})", emuthread->context->ToGenericContext().reg[15], emuthread->context->ToGenericContext().reg[14]) : "");
-
-            if (emuthread) {
+        thread.SaveContext();
+        if (emuthread) {
+            if (log_dispatch) {
                 auto cpu = emuthread->context->ToGenericContext();
-                next_thread->GetLogger()->info("{}Dispatcher LEAVING (PC at {:#x}), r0={:x}, r1={:x}, r2={:x}, r3={:x}, r4={:x}, r5={:x}, r6={:x}, r7={:x}, r8={:x}",
-                                               ThreadPrinter{*next_thread}, cpu.reg[15], cpu.reg[0], cpu.reg[1],
-                                               cpu.reg[2], cpu.reg[3], cpu.reg[4], cpu.reg[5], cpu.reg[6],
-                                               cpu.reg[7], cpu.reg[8]);
+                thread_logger->info("{}Dispatcher leaving (PC at {:#x}, LR at {:#x})", ThreadPrinter{*active_thread}, cpu.reg[15], cpu.reg[14]);
+                thread_logger->info("{}Dispatcher LEAVING (PC at {:#x}), r0={:x}, r1={:x}, r2={:x}, r3={:x}, r4={:x}, r5={:x}, r6={:x}, r7={:x}, r8={:x}",
+                                    ThreadPrinter{thread}, cpu.reg[15], cpu.reg[0], cpu.reg[1],
+                                    cpu.reg[2], cpu.reg[3], cpu.reg[4], cpu.reg[5], cpu.reg[6],
+                                    cpu.reg[7], cpu.reg[8]);
 
                 ticks_elapsed = cpu.cycle_count - ticks_elapsed;
+                instructions_elapsed = cpu.instruction_count - instructions_elapsed;
+            } else {
+                ticks_elapsed = emuthread->context->GetCycleCount() - ticks_elapsed;
+                instructions_elapsed = emuthread->context->GetInstructionCount() - instructions_elapsed;
             }
+        } else if (log_dispatch) {
+            thread_logger->info("{}Dispatcher leaving ", ThreadPrinter{*active_thread});
         }
         active_thread = debug_process->thread.get();
 
+        counters.instructions.Add(instructions_elapsed);
+        counters.cycles.Add(ticks_elapsed);
         ElapseTime(std::chrono::duration_cast<std::chrono::nanoseconds>(ticks{ticks_elapsed}));
 
         activity.GetSubActivity("SVC").Resume();
@@ -5754,6 +6070,7 @@ static uint64_t timestamp = 0; // TODO
 void OS::ElapseTime(std::chrono::nanoseconds time) {
     const auto system_tick_old = system_tick;
     system_tick += std::chrono::duration_cast<ticks>(time);
+    counters.system_ticks.Add((system_tick - system_tick_old).count());
 
     {
         auto ms_now = std::chrono::duration_cast<std::chrono::milliseconds>(system_tick);
@@ -5778,9 +6095,6 @@ void OS::ElapseTime(std::chrono::nanoseconds time) {
 
     if (std::chrono::duration_cast<vblanks_per_sec>(system_tick).count() !=
         std::chrono::duration_cast<vblanks_per_sec>(system_tick_old).count()) {
-        std::cerr << "OS scheduler signalling interrupts: " << std::chrono::duration_cast<vblanks_per_sec>(system_tick).count() << " vs " <<
-                  std::chrono::duration_cast<vblanks_per_sec>(system_tick_old).count() << " vblanks" << std::endl;
-        std::cerr << "OS scheduler signalling interrupts" << std::endl;
         // 0x28 and 0x2a together trigger PSC0
         // 0x29 and 0x2a together trigger PSC1
         // 0x2b and 0x2a together trigger VBlank1
@@ -5790,7 +6104,11 @@ void OS::ElapseTime(std::chrono::nanoseconds time) {
         static bool signal_2ba = true; // TODO: Remove this. Trying out stuff since maybe vblank0 and vblank1 are signaled too closely together, although really that shouldnt matter.
 
         // TODO: Display previous frame now
-        DisplayFramesToHost(setup.mem, *logger, display, *pica_context.renderer);
+        frame_presentation_pending = true;
+
+        if (input_replay) {
+            input_replay->OnVBlank();
+        }
 
 //         if (signal_2ba)
             NotifyInterrupt(0x2a); // does wake VBlank0, but not VBlank1, nor PPF, nor PSC0
@@ -5812,32 +6130,27 @@ void OS::ElapseTime(std::chrono::nanoseconds time) {
         NotifyInterrupt(0x6a);
     }*/
 
-    // TODO NOW: This should also be checked for threads waiting for arbitration or events with timeout!!!
-    for (auto thread_it = waiting_queue.begin(); thread_it != waiting_queue.end();) {
-        auto thread = thread_it->lock();
-        if (!thread) {
-            thread_it = waiting_queue.erase(thread_it);
-        } else if (thread->timeout_at <= GetTimeInNanoSeconds()) {
-            thread->GetLogger()->info("{}Waking up thread after timeout", ThreadPrinter{*thread});
-
-            // status==Sleeping corresponds to WaitSynchronizationN timing out... TODO: This is extremely ugly, clean this up instead :/
-            // NOTE: The returned value indeed does not have the topmost bit set (as any regular error code would)
-            if (thread->status == Thread::Status::Sleeping) {
-                thread->promised_result = 0x09401BFE;
-
-                // Clear wait_list
-                for (auto sync_object : thread->wait_list)
-                    sync_object->Unregister(thread);
-                thread->wait_list.clear();
-            }
+    const auto now = GetTimeInNanoSeconds();
+    while (auto thread = timeout_queue.PopExpired(static_cast<int64_t>(now))) {
+        if (thread->status != Thread::Status::Sleeping &&
+            thread->status != Thread::Status::WaitingForTimeout &&
+            thread->status != Thread::Status::WaitingForArbitration) {
+            // Thread was woken up by other means in the meantime
+            continue;
+        }
 
-            thread->status = Thread::Status::Ready;
-            ready_queue.push_back(thread);
-//             priority_queue.push_back(thread);
-            thread_it = waiting_queue.erase(thread_it);
-        } else {
-            ++thread_it;
+        thread->GetLogger()->info("{}Waking up thread after timeout", ThreadPrinter{*thread});
+
+        // status==Sleeping corresponds to WaitSynchronizationN timing out... TODO: This is extremely ugly, clean this up instead :/
+        // NOTE: The returned value indeed does not have the topmost bit set (as any regular error code would)
+        if (thread->status == Thread::Status::Sleeping) {
+            thread->promised_result = 0x09401BFE;
+            thread->ClearWaitList();
         }
+
+        thread->status = Thread::Status::Ready;
+        ready_queue.push_back(thread);
+//             priority_queue.push_back(thread);
     }
 }
 
@@ -5896,21 +6209,15 @@ try{
         //       preventing process destruction)
         process_handles.erase(parent_process->GetId());
 
-        // Close all pending handles
-        while (!parent_process->handle_table.table.empty()) {
-            CloseHandle(*thread, parent_process->handle_table.table.begin()->first);
+        // Close all pending handles. Objects released in the process may create new handles, so repeat until the table is empty
+        for (auto handles = parent_process->handle_table.GetHandles(); !handles.empty(); handles = parent_process->handle_table.GetHandles()) {
+            for (auto handle : handles) {
+                CloseHandle(*thread, handle);
+            }
         }
 
         for (auto& memory_region : memory_regions) {
-            // TODO: Add an interface to MemoryManager to do this more cleanly
-            for (auto taken_it = memory_region.taken.begin(); taken_it != memory_region.taken.end();) {
-                if (taken_it->second.owner.lock() == parent_process) {
-                    memory_region.DeallocateBlock(parent_process, taken_it->first, taken_it->second.size_bytes);
-                    taken_it = memory_region.taken.begin();
-                } else {
-                    ++taken_it;
-                }
-            }
+            memory_region.DeallocateAllBlocks(parent_process);
         }
 
         // If this was the last non-stopped thread, terminate the process itself
@@ -5919,7 +6226,7 @@ try{
         auto keep_process_alive = parent_process->shared_from_this();
         if (terminate_process) {
             for (auto& other_process : process_handles) {
-                for (auto& handle : other_process.second->handle_table.table) {
+                for (auto& handle : other_process.second->handle_table.GetEntries()) {
                     // The pm module holds references to every other process.
                     // If any other modules still reference the process, then
                     // that indicates a handle leak.
@@ -2,7 +2,13 @@
 
 #include "interpreter.h"
 
+#include "os_dma.hpp"
+#include "os_handle_table.hpp"
 #include "os_hypervisor.hpp"
+#include "os_ipc_statistics.hpp"
+#include "os_memory_manager.hpp"
+#include "os_timeout_queue.hpp"
+#include "os_translation_cache.hpp"
 #include "os_types.hpp"
 
 #include "framework/bit_field_new.hpp"
@@ -19,15 +25,21 @@
 #include <boost/hana/ext/std/tuple.hpp>
 #include <boost/hana/functional/overload.hpp>
 
+#include <array>
+#include <atomic>
 #include <list>
 #include <map>
 #include <unordered_map>
 #include <memory>
 #include <queue>
+#include <set>
 #include <thread>
+#include <typeinfo>
+#include <vector>
 
 #include "video_core/src/interrupt_listener.hpp"
 
+class InputSource;
 class LogManager;
 class PicaContext;
 
@@ -40,41 +52,50 @@ class GDBStub;
 namespace Profiler {
 class Profiler;
 class Activity;
+class Counter;
 }
 
 namespace HLE {
 
 namespace OS {
 
-// Abstract object with some unique ID.
-class Object : public std::enable_shared_from_this<Object> {
-public:
-    Object() = default;
-    Object(const Object&) = delete;
+// TODO: Add a reference counting base class?
 
-    virtual ~Object() = default;
+class Thread;
+class EmuThread;
+class ObserverSubject;
 
-    std::string name{};
+/**
+ * Entry of a Thread in the queue of threads waiting on an ObserverSubject.
+ *
+ * Nodes are owned by the waiting thread (see Thread::wait_list) and linked
+ * into an intrusive list maintained by the subject, so registering and
+ * unregistering waiters is O(1) and doesn't require any allocations.
+ */
+struct WaitNode {
+    Thread* thread = nullptr;
 
-    std::string GetName() const {
-        if (!name.empty())
-            return name;
+    std::shared_ptr<ObserverSubject> subject;
 
-       return typeid(*this).name();
-    }
-};
+    // Handle the waiting thread referred to subject with
+    Handle handle;
 
-// TODO: Add a reference counting base class?
+    WaitNode* prev = nullptr;
+    WaitNode* next = nullptr;
 
-class Thread;
+    // True while registered to subject
+    bool linked = false;
+};
 
 // Called "KSynchronizationObject" on 3dbrew.
 class ObserverSubject : public Object {
     friend class OS;
-public:
-    // List of observers. May include the same Thread multiple times.
-    std::list<std::weak_ptr<Thread>> observers;
 
+    // Queue of waiting threads in registration order. May include the same Thread multiple times.
+    WaitNode* first_observer = nullptr;
+    WaitNode* last_observer = nullptr;
+
+public:
     // TODO: This should be made purely virtual once all ObserverSubject
     //       instances have this function implemented
     virtual bool TryAcquireImpl(std::shared_ptr<Thread>) {
@@ -85,137 +106,36 @@ public:
     virtual ~ObserverSubject() = default;
 
     /**
-     * Tries to acquire the maintained resource in the given thread.
-     * If successful, thread will be unregistered from observers.
+     * Tries to acquire the maintained resource for the thread owning the
+     * given node. If successful, the node will be unregistered.
      */
-    bool TryAcquire(std::shared_ptr<Thread> thread);
+    bool TryAcquire(WaitNode& node);
 
     /**
-     * Registers the given thread for notifications. This will make sure that
+     * Registers the given node for notifications. This will make sure that
      * threads waiting for this subject to become ready will be woken up when
      * it does.
-     * The thread will be unregistered once the event has been acquired using
+     * The node will be unregistered once the event has been acquired using
      * TryAcquire.
      */
-    void Register(std::shared_ptr<Thread> thread);
+    void Register(WaitNode& node);
 
     /**
-     * Manually unregister the given thread from notifications.
+     * Manually unregister the given node from notifications.
      */
-    void Unregister(std::shared_ptr<Thread> thread);
-};
-
-/**
- * A handle table is a collection of handles owned by a particular process.
- * Handles are process-unique, but handles of different threads may refer to
- * the same object. The objects are "owned" in the sense that deleting all
- * handles that refer to a particular object will trigger destruction of the
- * object.
- */
-class HandleTable {
-public: // TODO: Un-publicize. We currently need to do this to be able to find mutexes held by an exited thread :/
-    friend class ConsoleModule;
+    void Unregister(WaitNode& node);
 
-    std::unordered_map<DebugHandle, std::shared_ptr<Object>> table;
-
-    Handle cur_handle = { 0 };
-
-    // Prints an internal logging message about a type mismatch.
-    void ErrorNotFound(Handle, const char* requested_type);
-
-    // Prints an internal logging message about a type mismatch.
-    void ErrorWrongType(std::shared_ptr<Object> object, const char* requested_type);
-
-public:
-    template<typename Type>
-    using Entry = std::pair<DebugHandle, std::shared_ptr<Type>>;
-
-    /**
-     * Inserts the given Object into the handle table and returns a Handle to the object.
-     * @return Immutable pair of Handle and pointer the object.
-     */
-    template<typename Type>
-    Entry<Type> CreateHandle(std::shared_ptr<Type> object, const DebugHandle::DebugInfo& debug_info) {
-        static_assert(std::is_base_of<Object,Type>::value, "object must be a shared_ptr to a derivative class of Object!");
-        ++cur_handle.value; // TODO: Make sure this never becomes one of the reserved handles
-        DebugHandle debug_handle{cur_handle.value, debug_info};
-        table[debug_handle] = object;
-        return { debug_handle, object };
+    // Returns the longest-waiting observer, or nullptr if there is none
+    WaitNode* FirstObserver() const {
+        return first_observer;
     }
-
-    /**
-     * Inserts the given Object into the handle table with the specified Handle.
-     * Use this to set up reserved handles (e.g. 0xFFFF8001 for the handle of the current process)
-     */
-    template<typename Type>
-    void CreateEntry(const DebugHandle& handle, std::shared_ptr<Type> object) {
-        static_assert(std::is_base_of<Object,Type>::value, "object must be a shared_ptr to a derivative class of Object!");
-        if (table.count(handle))
-            throw std::runtime_error("Handle already in table!");
-
-        table[handle] = object;
-    }
-
-    /**
-     * Returns a shared pointer to the kernel Object referenced by handle if
-     * it is in the table and if the object can be downcast to Type.
-     * @param fail_expected If true, we won't log an error when an object of different type is found with the given handle
-     * @return shared_ptr of the given Type. nullptr if the handle can't be used to obtain a pointer to Type.
-     */
-    template<typename Type>
-    std::shared_ptr<Type> FindObject(Handle handle, bool fail_expected = false) {
-        static_assert(std::is_base_of<Object,Type>::value, "object must be a shared_ptr to a derivative class of Object!");
-
-        if (table.count(handle) == 0) {
-            if (!fail_expected) {
-                ErrorNotFound(handle, typeid(Type).name());
-            }
-            return nullptr;
-        }
-
-        auto object_ptr = std::dynamic_pointer_cast<Type>(table[handle]);
-        if (!fail_expected && !object_ptr)
-            ErrorWrongType(table[handle], typeid(Type).name());
-        return object_ptr;
-    }
-
-    DebugHandle FindHandle(void* object) {
-        for (auto& entry : table) {
-            if (entry.second.get() == object) {
-                return entry.first;
-            }
-        }
-        return Handle{HANDLE_INVALID};
-    }
-
-    template<typename Type>
-    Handle FindHandle(std::shared_ptr<Type> object) {
-        static_assert(std::is_base_of<Object,Type>::value, "object must be a shared_ptr to a derivative class of Object!");
-        return FindHandle(object.get());
-    }
-
-    /**
-     * Sets the currently running thread (to be exposed as handle 0xFFFF8000)
-     * TODO: What does this return when multiple threads of the same process run on different CPUs?
-     */
-    void SetCurrentThread(std::shared_ptr<Thread> thread) {
-        if (!thread) {
-            table.erase(Handle{0xFFFF8000});
-        } else {
-            table[Handle{0xFFFF8000}] = std::static_pointer_cast<Object>(thread);
-        }
-    }
-
-    /**
-     * Closes the given handle. Does not release any locks still hold on ObserverSubjects.
-     * @todo Implement error case?
-     */
-    void CloseHandle(Handle handle);
 };
 
 class Process;
 class OS;
 class Session;
+class GuestProfiler;
+class InputReplay;
 
 /// Returned as part of an SVCFuture to signalize that a Thread's wake_index should be returned upon next dispatch
 struct PromisedWakeIndex {};
@@ -297,7 +217,34 @@ public:
 class Thread : public ObserverSubject {
     uint32_t id;
 
+    TranslationCache translation_cache;
+
+    // Return nullptr if the page containing the given address is not backed by host memory
+    const TranslationCache::Entry* LookupVirtualPage(VAddr addr);
+    const TranslationCache::Entry* LookupPhysicalPage(PAddr addr);
+
+    template<typename DataType>
+    DataType ReadMemoryCached(VAddr addr);
+
+    template<typename DataType>
+    void WriteMemoryCached(VAddr addr, DataType value);
+
+    template<typename DataType>
+    DataType ReadPhysicalMemoryCached(PAddr addr);
+
+    template<typename DataType>
+    void WritePhysicalMemoryCached(PAddr addr, DataType value);
+
+protected:
+    // Set by EmuThread, so that hot paths can tell thread types apart without RTTI
+    EmuThread* emu_thread = nullptr;
+
 public:
+    // Returns nullptr if this is not an EmuThread
+    EmuThread* AsEmuThread() const {
+        return emu_thread;
+    }
+
     // TODO: Figure out how this actually affects behavior on the 3DS!
     uint32_t priority;
 
@@ -311,6 +258,9 @@ public:
      */
     int64_t timeout_at;
 
+    // Identifies the most recent wait operation. Used to discard stale entries in OS::timeout_queue (see TimeoutQueue)
+    uint64_t wait_sequence = 0;
+
     // Address that this thread is currently watching via an AddressArbiter
     VAddr arbitration_address;
 
@@ -330,6 +280,14 @@ public:
      */
     SVCCallbackType callback_for_svc;
 
+    /**
+     * Number of system calls that may still be executed inline (see
+     * OS::TryInlineSVC) before control must be returned to the scheduler.
+     * Bounded so that threads polling e.g. GetSystemTick in a loop don't
+     * starve timers, interrupts, and the DSP. Reset on each dispatch.
+     */
+    uint32_t inline_svc_budget = 0;
+
     // TODO: Make this private!
 /*    struct Context {
         uint32_t regs[16];
@@ -344,10 +302,18 @@ public:
         Stopped,               // thread exited and is waiting for its destruction
     } status = Status::Ready;
 
-    /// List of resources that are being waited on as part of SVCWaitSynchronizationN.
-    std::list<std::shared_ptr<ObserverSubject>> wait_list;
+    /**
+     * Resources that are being waited on as part of SVCWaitSynchronizationN,
+     * in the order given by the application. Acquired resources are
+     * unregistered but kept in the list so that their indexes stay valid.
+     * Must not be resized while any node is registered.
+     */
+    std::vector<WaitNode> wait_list;
 
-    /// If true, will not wake up the thread before wait_list is empty.
+    /// Number of entries in wait_list that have not been acquired yet.
+    uint32_t pending_wait_count = 0;
+
+    /// If true, will not wake up the thread before all entries of wait_list have been acquired.
     bool wait_for_all;
 
     /**
@@ -363,6 +329,9 @@ public:
      */
     std::weak_ptr<Object> woken_object;
 
+    // Handle that was used to wait on woken_object
+    Handle woken_handle;
+
     // Notify thread of a resource being ready for being TryAcquire'ed
     // TODO: This function is unused now!
     void SignalResourceReady();
@@ -371,7 +340,7 @@ public:
 
     Thread(Process& owner, uint32_t id, uint32_t priority);
 
-    virtual ~Thread() = default;
+    virtual ~Thread();
 
     // Guaranteed to be valid, since every thread must have a process.
     Process& GetParentProcess() {
@@ -432,6 +401,15 @@ public:
      */
     uint32_t ReadMemory32(VAddr addr);
 
+    /**
+     * Counterparts to Process::ReadPhysicalMemory and friends that go through
+     * this thread's translation cache
+     */
+    uint8_t ReadPhysicalMemory(PAddr addr);
+    uint32_t ReadPhysicalMemory32(PAddr addr);
+    void WritePhysicalMemory(PAddr addr, uint8_t value);
+    void WritePhysicalMemory32(PAddr addr, uint32_t value);
+
     /**
      * Get the value of the given CPU register in this thread's context.
      * @param reg_index Index of the CPU register. r0-r15 are mapped to the first 16 values; CPSR is value 16.
@@ -501,12 +479,14 @@ public:
 
     /**
      * Notifies this Thread about the resource being acquired for it. The
-     * resource will be removed from wait_list and the thread will be
-     * woken up if appropriate.
+     * thread will be woken up if appropriate.
      * @pre Thread state must be waiting for resources
-     * @pre The given resource must have been in wait_list
+     * @pre The given node must be an entry of wait_list that was unregistered by TryAcquire
      */
-    void OnResourceAcquired(ObserverSubject& resource);
+    void OnResourceAcquired(WaitNode& node);
+
+    // Unregisters all entries of wait_list from their resources and clears the list
+    void ClearWaitList();
 
     /**
      * Signals a software interrupt to the HardwareScheduler and yields the
@@ -715,17 +695,8 @@ public:
     void ProcessLaunched(Process& process, Interpreter::ProcessorController& controller);
 };
 
-class MemoryManager;
 class ResourceLimit;
 
-/**
- * Owner of a physical memory allocation: Either a Process, a SharedMemoryBlock, or a CodeSet
- */
-class MemoryBlockOwner {
-public:
-    virtual ~MemoryBlockOwner() = default;
-};
-
 enum class MemoryPermissions : uint32_t {
     None      = 0,
     Read      = 1,
@@ -756,6 +727,9 @@ class Process : public ObserverSubject, public MemoryBlockOwner {
 public: // TODO: Make this private again!
     // Map from starting address to the virtual memory block
     std::map<uint32_t, VirtualMemoryBlock> virtual_memory;
+
+    // Incremented whenever virtual_memory changes, to invalidate cached translations
+    uint32_t memory_map_generation = 0;
 private:
 
     OS& os;
@@ -869,6 +843,16 @@ public:
 
     virtual void WriteMemory32(VAddr addr, uint32_t value);
 
+    /**
+     * Copy a block of host data to this process's virtual memory. The target
+     * range must be backed by emulated memory; the data is committed in bulk
+     * for each contiguous physical range.
+     */
+    void WriteMemoryBlock(VAddr addr, const uint8_t* data, uint32_t num_bytes);
+
+    // Counterpart to WriteMemoryBlock
+    void ReadMemoryBlock(VAddr addr, uint8_t* dest, uint32_t num_bytes);
+
     /**
      * Read a byte from a location in this process's virtual memory
      */
@@ -876,6 +860,14 @@ public:
 
     virtual uint32_t ReadMemory32(VAddr addr);
 
+    /**
+     * Returns false if accesses to the given address must always go through
+     * ReadMemory/WriteMemory instead of a Thread's translation cache
+     */
+    virtual bool IsCacheableAddress(VAddr) const {
+        return true;
+    }
+
     /**
      * Read a byte from a location in physical memory. Only intended to be used
      * by the PXI process
@@ -980,6 +972,10 @@ public:
     void WriteMemory32(VAddr addr, uint32_t value) override;
 
     uint8_t ReadMemory(VAddr addr) override;
+
+    uint32_t ReadMemory32(VAddr addr) override;
+
+    bool IsCacheableAddress(VAddr addr) const override;
 };
 
 /**
@@ -1119,61 +1115,6 @@ struct CodeSetInfo {
     );
 };
 
-// TODO: Most of the contents of this struct need to be verified!
-struct DMAConfig {
-    // There are 8 channels the application may chose from (values 0 through 7)
-    // 0xff means "any channel"
-    uint8_t channel;
-
-    // Value size (used for endian-swapping): 0=uint8, 2=uint16, 4=uint32, 8=uint64
-    uint8_t value_size;
-
-    struct {
-        uint8_t storage;
-
-        using Fields = v2::BitField::Fields<uint32_t>;
-
-        /// Load target configuration following this structure
-        auto LoadTargetConfig() const { return Fields::MakeOn<0, 1>(this); }
-
-        /// Load source configuration following this structure and the target configuration
-        auto LoadSourceConfig() const { return Fields::MakeOn<1, 1>(this); }
-
-        auto BlockUntilCompletion() const { return Fields::MakeOn<2, 1>(this); }
-
-        /// Load target configuration, but force its peripheral_id to be 0xff
-        auto LoadTargetAltConfig() const { return Fields::MakeOn<6, 1>(this); }
-
-        /// Load source configuration, but force its peripheral_id to be 0xff
-        auto LoadSourceAltConfig() const { return Fields::MakeOn<7, 1>(this); }
-    } flags;
-
-    uint8_t unknown2;
-
-    struct SubConfig {
-        uint8_t unknown;
-
-        // Seems to indicate the value size? TODO: how is this compatible with the member value_size above?
-        uint8_t type;
-
-        uint16_t unknown2;
-
-        uint16_t transfer_size;
-
-        uint16_t unknown3;
-
-        uint16_t stride;
-
-        static SubConfig Default() {
-            return { 0xff, 0xf, 0x80, 0x0, 0x80, 0x0 };
-        }
-    };
-
-    // NOTE: Possible 3dbrew erratum: Which SubConfig actually comes first?
-    SubConfig dest;
-    SubConfig source;
-};
-
 class CodeSet : public Object, public MemoryBlockOwner {
 public:
     char app_name[9]; // 8 characters + null-terminator
@@ -1431,48 +1372,6 @@ public:
     virtual ~AddressArbiter() = default;
 };
 
-struct MemoryBlock {
-    uint32_t size_bytes;
-
-    std::weak_ptr<MemoryBlockOwner> owner;
-};
-
-class MemoryManager {
-    // physical starting address of region
-    uint32_t region_start_paddr;
-
-    uint32_t region_size_bytes;
-
-public:
-// TODO: Needs an interface to check for ownership
-    // Maps describing the free/taken memory blocks (mapped by their starting physical address)
-    std::map<uint32_t, MemoryBlock> free;
-    std::map<uint32_t, MemoryBlock> taken;
-
-public:
-    MemoryManager(PAddr start_address, uint32_t size);
-
-    /**
-     * Allocate a memory block of the given size.
-     * @return Starting address of the allocated buffer. boost::none on failure.
-     * @todo Provide means to deallocate the block again!
-     */
-    std::optional<uint32_t> AllocateBlock(std::shared_ptr<MemoryBlockOwner>, uint32_t size_bytes);
-
-    void DeallocateBlock(std::shared_ptr<MemoryBlockOwner>, PAddr start_addr, uint32_t size_bytes);
-
-    void TransferOwnership(std::shared_ptr<MemoryBlockOwner> old_owner, std::shared_ptr<MemoryBlockOwner> new_owner, PAddr start_addr, uint32_t size_bytes);
-
-    void DeallocateBlock(PAddr start_addr, uint32_t size_bytes);
-
-    uint32_t UsedMemory() const;
-
-    uint32_t TotalSize() const;
-
-    PAddr RegionStart() const { return region_start_paddr; }
-    PAddr RegionEnd() const { return region_start_paddr + region_size_bytes; }
-};
-
 class SharedMemoryBlock : public Object, public MemoryBlockOwner {
 public:
     // Address to data stored in emulated memory
@@ -1522,7 +1421,20 @@ public: // TODO: Ugh.
 
     PAddr firm_launch_parameters = 0;
 
-    std::array<std::list<std::weak_ptr<Event>>, 0x76> bound_interrupts;
+    // Events bound to each interrupt via SVCBindInterrupt. Bindings don't
+    // keep events alive, so they are released along with the process that
+    // created them. Expired entries are dropped when delivering interrupts.
+    std::array<std::vector<std::weak_ptr<Event>>, 0x76> bound_interrupts;
+
+    /**
+     * Bitmask of interrupts raised via NotifyInterrupt since the last
+     * scheduling point, at which they are delivered in one batch. Atomic
+     * since emulated hardware may raise interrupts from other host threads.
+     */
+    std::array<std::atomic<uint64_t>, 2> pending_interrupts {};
+
+    // Set on vblank. Frames are presented to the host at the next scheduling point
+    bool frame_presentation_pending = false;
 
     // Id of the next process that is going to be created
     ProcessId next_pid;
@@ -1548,7 +1460,7 @@ public: // TODO: Ugh.
 public: // TODO: privatize this again!
     std::list<std::weak_ptr<Thread>> ready_queue; // Queue of threads that are ready to run
 //     std::list<std::weak_ptr<Thread>> priority_queue; // Queue of threads that are ready to run and should be prioritized over those in ready_queue (e.g. because they had been waiting on an event that was just signalled)
-    std::vector<std::weak_ptr<Thread>> waiting_queue; // List of threads waiting on a timeout
+    TimeoutQueue<Thread> timeout_queue; // Threads waiting on a timeout
 
     std::shared_ptr<MemoryBlockOwner> internal_memory_owner;
 
@@ -1564,12 +1476,32 @@ public: // TODO: privatize this again!
     MemoryManager& FindMemoryRegionContaining(uint32_t paddr, uint32_t size);
 
     OS( Profiler::Profiler&, Settings::Settings&, Interpreter::Setup&,
-        LogManager&, AudioFrontend&, PicaContext&, EmuDisplay::EmuDisplay&);
+        LogManager&, AudioFrontend&, PicaContext&, EmuDisplay::EmuDisplay&, InputSource&);
     ~OS();
 
     Profiler::Profiler& profiler;
     Profiler::Activity& activity;
 
+    // Event counters exposed through the metrics endpoint
+    struct Counters {
+        Profiler::Counter& system_ticks;
+        Profiler::Counter& idle_ticks;
+        Profiler::Counter& vblanks;
+        Profiler::Counter& instructions;
+        Profiler::Counter& cycles;
+        Profiler::Counter& ipc_requests;
+        Profiler::Counter& fs_bytes_read;
+    } counters;
+
+    // Sampling profiler for emulated code (optional)
+    std::unique_ptr<GuestProfiler> guest_profiler;
+
+    // Latches (and records or plays back) host input in deterministic mode (optional)
+    std::unique_ptr<InputReplay> input_replay;
+
+    // Per-service IPC accounting, enabled when a dump file is configured (optional)
+    std::unique_ptr<IPCStatistics> ipc_statistics;
+
     PicaContext& pica_context;
     EmuDisplay::EmuDisplay& display;
 
@@ -1815,6 +1747,8 @@ public:
 
     SVCFuture<Result> SVCBindInterrupt(Thread& source, uint32_t interrupt_index, std::shared_ptr<Event> signal_event, int32_t priority, uint32_t is_manual_clear);
 
+    SVCFuture<Result> SVCUnbindInterrupt(Thread& source, uint32_t interrupt_index, std::shared_ptr<Event> signal_event);
+
     /**
      * @param start Range start adress (must be mapped in the source process)
      */
@@ -1849,6 +1783,12 @@ public:
      */
     SVCFuture<Result> SVCSetResourceLimitValues(Thread& source, ResourceLimit& resource_limit, const std::vector<std::pair<uint32_t, uint64_t>>& limits);
 
+    /**
+     * Writes the limits (if is_limits is set) or the current values of the
+     * num_names resource types listed at names_addr to out_addr
+     */
+    SVCFuture<Result> SVCGetResourceLimitValues(Thread& source, ResourceLimit& resource_limit, bool is_limits, VAddr out_addr, VAddr names_addr, uint32_t num_names);
+
     // Fake SVCs begin here - these don't map to native SVCs but provide useful functionality
 
     /**
@@ -1859,6 +1799,13 @@ public:
      */
     SVCCallbackType SVCRaw(Thread& source, unsigned svc_id, Interpreter::ExecutionContext&);
 
+    /**
+     * Executes system calls that never block or reschedule directly on the
+     * calling thread, without a roundtrip through the scheduler.
+     * @return false if the system call must be processed via SVCRaw instead
+     */
+    bool TryInlineSVC(EmuThread& source, unsigned svc_id);
+
     SVCEmptyFuture SVCDoNothing(Thread& source); // TODO: We don't really need this one, it was just for testing!
 
     SVCFuture<Result,HandleTable::Entry<Object>> SVCCreateDummyObject(FakeThread& source, const std::string& name);
@@ -1870,7 +1817,7 @@ public:
      */
     SVCEmptyFuture SVCAddThread(std::shared_ptr<Thread> thread);
 
-    static std::pair<std::unique_ptr<OS>, std::unique_ptr<ConsoleModule>> Create(Settings::Settings& settings, Interpreter::Setup& setup, LogManager& log_manager, Profiler::Profiler&, AudioFrontend&, PicaContext&, EmuDisplay::EmuDisplay&);
+    static std::pair<std::unique_ptr<OS>, std::unique_ptr<ConsoleModule>> Create(Settings::Settings& settings, Interpreter::Setup& setup, LogManager& log_manager, Profiler::Profiler&, AudioFrontend&, PicaContext&, EmuDisplay::EmuDisplay&, InputSource&);
 
     /**
      * Initialized the OS, spawning all service processes along the way.
@@ -1939,16 +1886,21 @@ public:
     /**
      * Translate an IPC message (i.e. a request or a reply) from the source
      * thread to the destination thread.
+     * @return Number of bytes of buffer data copied or mapped
      */
-    void TranslateIPCMessage(Thread& source, Thread& dest, bool is_reply);
+    uint32_t TranslateIPCMessage(Thread& source, Thread& dest, bool is_reply);
 
     uint64_t GetTimeInNanoSeconds() const;
 
     /**
-     * Signalize all events that are bound to the given interrupt
+     * Marks the given interrupt as pending. Events bound to it will be
+     * signalled at the next scheduling point.
      */
     void NotifyInterrupt(uint32_t index) override;
 
+    // Signals all events bound to pending interrupts
+    void DeliverPendingInterrupts();
+
     void OnResourceReady(ObserverSubject& resource);
 };
 
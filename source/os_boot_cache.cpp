@@ -0,0 +1,186 @@
+#include "os_boot_cache.hpp"
+
+#include <platform/crypto.hpp>
+
+#include <cryptopp/sha.h>
+
+#include <spdlog/logger.h>
+
+#include <fmt/format.h>
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <string_view>
+
+namespace HLE {
+
+namespace OS {
+
+namespace {
+
+struct CacheHeader {
+    std::array<char, 4> magic;
+    uint32_t version;
+    uint32_t num_modules;
+    uint32_t padding;
+};
+
+struct CacheModuleHeader {
+    uint64_t title_id;
+    uint32_t code_size;
+    uint32_t padding;
+};
+
+constexpr std::array<char, 4> cache_magic = { 'M', 'B', 'C', 'H' };
+
+// Bump this when changing the layout of the structures above or the semantics of LoadCodeImage
+constexpr uint32_t cache_version = 1;
+
+} // anonymous namespace
+
+BootCache::BootCache(spdlog::logger& logger, std::filesystem::path cache_dir_, const std::filesystem::path& firm_path, const KeyDatabase& keydb)
+    : logger(logger), cache_dir(std::move(cache_dir_)) {
+    CryptoPP::SHA256 hash;
+    auto hash_value = [&hash](const auto& value) {
+        hash.Update(reinterpret_cast<const CryptoPP::byte*>(&value), sizeof(value));
+    };
+
+    hash_value(cache_version);
+
+    // Hash the FIRM content by path, size, and modification time rather than by its data, since reading
+    // the full file would defeat the purpose of the cache
+    auto firm_path_str = firm_path.string();
+    hash.Update(reinterpret_cast<const CryptoPP::byte*>(firm_path_str.data()), firm_path_str.size());
+    std::error_code ec;
+    uint64_t firm_size = std::filesystem::file_size(firm_path, ec);
+    int64_t firm_mtime = ec ? 0 : std::filesystem::last_write_time(firm_path, ec).time_since_epoch().count();
+    hash_value(ec ? uint64_t { 0 } : firm_size);
+    hash_value(firm_mtime);
+
+    // Decryption of the FIRM modules depends on the console keys
+    auto hash_key = [&](const std::optional<KeyDatabase::KeyType>& key) {
+        hash_value(key.has_value());
+        if (key) {
+            hash_value(*key);
+        }
+    };
+    for (auto& slot : keydb.aes_slots) {
+        hash_key(slot.x);
+        hash_key(slot.y);
+        hash_key(slot.n);
+    }
+    for (auto& key : keydb.common_y) {
+        hash_key(key);
+    }
+
+    std::array<CryptoPP::byte, CryptoPP::SHA256::DIGESTSIZE> digest;
+    hash.Final(digest.data());
+
+    // Truncate to 64 bits, which is plenty to tell configurations apart
+    for (auto byte : std::basic_string_view<CryptoPP::byte>(digest.data(), 8)) {
+        input_hash += fmt::format("{:02x}", byte);
+    }
+
+    Load();
+}
+
+std::filesystem::path BootCache::GetCachePath() const {
+    return cache_dir / (input_hash + ".bin");
+}
+
+void BootCache::Load() {
+    auto cache_path = GetCachePath();
+    if (!std::filesystem::exists(cache_path)) {
+        logger.info("No boot cache found for this configuration");
+        return;
+    }
+
+    try {
+        std::ifstream file(cache_path, std::ios::binary);
+        file.exceptions(std::ifstream::badbit | std::ifstream::failbit | std::ifstream::eofbit);
+
+        CacheHeader header;
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (header.magic != cache_magic || header.version != cache_version) {
+            throw std::runtime_error("Unrecognized format version");
+        }
+
+        for (uint32_t module_index = 0; module_index < header.num_modules; ++module_index) {
+            CacheModuleHeader module_header;
+            file.read(reinterpret_cast<char*>(&module_header), sizeof(module_header));
+
+            Module module {
+                FileFormat::SerializationInterface<FileFormat::ExHeader>::Load([&file](char* dest, size_t size) { file.read(dest, size); }),
+                std::vector<uint8_t>(module_header.code_size)
+            };
+            file.read(reinterpret_cast<char*>(module.code_image.data()), module.code_image.size());
+            modules[module_header.title_id] = std::move(module);
+        }
+    } catch (std::exception& err) {
+        logger.warn("Discarding boot cache {}: {}", cache_path.string(), err.what());
+        modules.clear();
+        return;
+    }
+
+    logger.info("Loaded {} modules from boot cache {}", modules.size(), cache_path.string());
+}
+
+const BootCache::Module* BootCache::Find(uint64_t title_id) const {
+    auto it = modules.find(title_id);
+    return (it == modules.end()) ? nullptr : &it->second;
+}
+
+void BootCache::Store(uint64_t title_id, Module module) {
+    modules[title_id] = std::move(module);
+    dirty = true;
+}
+
+void BootCache::Save() {
+    if (!dirty) {
+        return;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(cache_dir, ec);
+
+    // Only a single configuration is cached at any time
+    for (auto& entry : std::filesystem::directory_iterator(cache_dir, ec)) {
+        if (entry.path().extension() == ".bin") {
+            std::filesystem::remove(entry.path(), ec);
+        }
+    }
+
+    auto cache_path = GetCachePath();
+    auto temp_path = cache_path;
+    temp_path += ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        CacheHeader header { cache_magic, cache_version, static_cast<uint32_t>(modules.size()), 0 };
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (auto& [title_id, module] : modules) {
+            CacheModuleHeader module_header { title_id, static_cast<uint32_t>(module.code_image.size()), 0 };
+            file.write(reinterpret_cast<const char*>(&module_header), sizeof(module_header));
+            FileFormat::SerializationInterface<FileFormat::ExHeader>::Save(module.exheader, [&file](char* data, size_t size) {
+                file.write(data, size);
+            });
+            file.write(reinterpret_cast<const char*>(module.code_image.data()), module.code_image.size());
+        }
+        if (!file) {
+            logger.warn("Failed to write boot cache {}", temp_path.string());
+            return;
+        }
+    }
+
+    std::filesystem::rename(temp_path, cache_path, ec);
+    if (ec) {
+        logger.warn("Failed to write boot cache {}: {}", cache_path.string(), ec.message());
+        return;
+    }
+    dirty = false;
+}
+
+} // namespace OS
+
+} // namespace HLE
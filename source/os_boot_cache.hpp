@@ -0,0 +1,76 @@
+#pragma once
+
+#include <platform/file_formats/ncch.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace spdlog {
+class logger;
+}
+
+struct KeyDatabase;
+
+namespace HLE {
+
+namespace OS {
+
+/**
+ * On-disk cache of the FIRM modules launched during OS startup.
+ *
+ * Booting requires reading (and decrypting) the FIRM ExeFS, locating the
+ * embedded module NCCHs, decrypting their extended headers, and decompressing
+ * their code. The result of these steps only depends on the FIRM title
+ * installed to emulated NAND and on the console keys, so it's stored in the
+ * cache directory and restored directly on subsequent boots.
+ *
+ * Cache files are named after a hash of these inputs, so updating the FIRM
+ * title or the key database implicitly invalidates existing entries.
+ */
+class BootCache {
+public:
+    struct Module {
+        FileFormat::ExHeader exheader;
+
+        // Decompressed program code as returned by LoadCodeImage
+        std::vector<uint8_t> code_image;
+    };
+
+private:
+    spdlog::logger& logger;
+    std::filesystem::path cache_dir;
+
+    // Hex string of the hash over all boot inputs
+    std::string input_hash;
+
+    // Indexed by title ID
+    std::map<uint64_t, Module> modules;
+
+    bool dirty = false;
+
+    std::filesystem::path GetCachePath() const;
+
+    void Load();
+
+public:
+    /**
+     * Loads cached modules from the given directory, if the cache is
+     * consistent with the given FIRM content file and key database.
+     */
+    BootCache(spdlog::logger&, std::filesystem::path cache_dir, const std::filesystem::path& firm_path, const KeyDatabase&);
+
+    // Returns nullptr if the module is not cached
+    const Module* Find(uint64_t title_id) const;
+
+    void Store(uint64_t title_id, Module module);
+
+    // Writes the cache file if any modules were added. Stale cache files are removed in the process
+    void Save();
+};
+
+} // namespace OS
+
+} // namespace HLE
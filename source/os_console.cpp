@@ -99,7 +99,11 @@ std::optional<std::string> ConsoleModule::HandleCommand(const std::string& comma
                 ret += "Waiting for any of [";
 
             bool first = true;
-            for (auto object : thread.wait_list) {
+            for (auto& node : thread.wait_list) {
+                if (!node.linked) {
+                    continue;
+                }
+                auto& object = node.subject;
                 if (object->GetName() == "CSession_Port_srv:") {
                     auto service_name = Platform::SM::PortName::IPCDeserialize(thread.ReadTLS(0x84), thread.ReadTLS(0x88), 8).ToString();
                     ret += fmt::format("{}(Service {} to be up)", first ? "" : ", ", service_name);
@@ -147,7 +151,7 @@ std::optional<std::string> ConsoleModule::HandleCommand(const std::string& comma
             break;
         }
 
-        auto&& is_given_object = [&](std::weak_ptr<Event> event) {
+        auto&& is_given_object = [&](const std::weak_ptr<Event>& event) {
             return object_ptr && object_ptr == event.lock().get();
         };
 
@@ -192,6 +196,12 @@ std::optional<std::string> ConsoleModule::HandleCommand(const std::string& comma
         std::string ret;
         for (size_t manager_idx = 0; manager_idx < os.memory_regions.size(); ++manager_idx) {
             auto& manager = os.memory_regions[manager_idx];
+            auto stats = manager.GetStatistics();
+            ret += fmt::format("Region [{:#010x}-{:#010x}]: {:#x}/{:#x} bytes used (peak {:#x}), {} free blocks (largest {:#x} bytes), "
+                               "{} allocations ({} failed), {} deallocations\n",
+                               manager.RegionStart(), manager.RegionEnd(), stats.used_bytes, manager.TotalSize(), stats.peak_used_bytes,
+                               stats.num_free_blocks, stats.largest_free_block,
+                               stats.num_allocations, stats.num_failed_allocations, stats.num_deallocations);
             for (auto& mapping : manager.taken) {
                 auto owner = mapping.second.owner.lock();
                 ret += fmt::format("[{:#010x}-{:#010x}] ({:#x} bytes, owned by {} {})\n",
@@ -271,7 +281,7 @@ std::optional<std::string> ConsoleModule::HandleCommand(const std::string& comma
 
         ret += "\nHandle table:\n";
         std::map<DebugHandle, std::shared_ptr<Object>, std::less<Handle>> sorted_handle_table;
-        ranges::copy(process->handle_table.table, ranges::inserter(sorted_handle_table, ranges::begin(sorted_handle_table)));
+        ranges::copy(process->handle_table.GetEntries(), ranges::inserter(sorted_handle_table, ranges::begin(sorted_handle_table)));
         for (auto entry : sorted_handle_table) {
             ret += fmt::format("Handle {} -> {:#x} ({})", entry.first.value, reinterpret_cast<uintptr_t>(entry.second.get()), entry.second ? entry.second->GetName() : "INVALID");
             ret += ": " + handle_debug_info(entry.first.debug_info, entry.second.get()) + "\n";
@@ -0,0 +1,49 @@
+#include "os_dma.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace HLE {
+
+namespace OS {
+
+DMAAddressGenerator::DMAAddressGenerator(VAddr base, const DMAConfig::SubConfig& config) : base(base) {
+    if (config.unknown == 0xff && config.transfer_size && config.stride && config.stride != config.transfer_size) {
+        chunk_size = config.transfer_size;
+        stride = config.stride;
+    }
+}
+
+std::pair<VAddr, uint32_t> DMAAddressGenerator::operator()(uint32_t offset) const {
+    if (!chunk_size) {
+        return { base + offset, std::numeric_limits<uint32_t>::max() };
+    }
+    return { base + offset / chunk_size * stride + offset % chunk_size, chunk_size - offset % chunk_size };
+}
+
+uint32_t SplitDMATransfer(uint32_t size, const DMAAddressGenerator& source, const DMAAddressGenerator& dest,
+                          const DMAResolveFunction& resolve_source, const DMAResolveFunction& resolve_dest,
+                          const std::function<void(const DMARun&)>& on_run) {
+    uint32_t offset = 0;
+    while (offset < size) {
+        const auto [src_vaddr, src_chunk_remaining] = source(offset);
+        const auto [dst_vaddr, dst_chunk_remaining] = dest(offset);
+        auto src_range = resolve_source(src_vaddr);
+        auto dst_range = resolve_dest(dst_vaddr);
+        if (!src_range || !dst_range) {
+            break;
+        }
+
+        const auto [src_run_paddr, src_run_max] = *src_range;
+        const auto [dst_run_paddr, dst_run_max] = *dst_range;
+        const uint32_t run_size = std::min({ size - offset, src_chunk_remaining, dst_chunk_remaining, src_run_max, dst_run_max,
+                                             0x1000 - (src_run_paddr & 0xfff), 0x1000 - (dst_run_paddr & 0xfff) });
+        on_run(DMARun { offset, src_run_paddr, dst_run_paddr, run_size });
+        offset += run_size;
+    }
+    return offset;
+}
+
+} // namespace OS
+
+} // namespace HLE
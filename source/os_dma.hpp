@@ -0,0 +1,118 @@
+#pragma once
+
+#include "os_types.hpp"
+
+#include "framework/bit_field_new.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+
+namespace HLE {
+
+namespace OS {
+
+// TODO: Most of the contents of this struct need to be verified!
+struct DMAConfig {
+    // There are 8 channels the application may chose from (values 0 through 7)
+    // 0xff means "any channel"
+    uint8_t channel;
+
+    // Value size (used for endian-swapping): 0=uint8, 2=uint16, 4=uint32, 8=uint64
+    uint8_t value_size;
+
+    struct {
+        uint8_t storage;
+
+        using Fields = v2::BitField::Fields<uint32_t>;
+
+        /// Load target configuration following this structure
+        auto LoadTargetConfig() const { return Fields::MakeOn<0, 1>(this); }
+
+        /// Load source configuration following this structure and the target configuration
+        auto LoadSourceConfig() const { return Fields::MakeOn<1, 1>(this); }
+
+        auto BlockUntilCompletion() const { return Fields::MakeOn<2, 1>(this); }
+
+        /// Load target configuration, but force its peripheral_id to be 0xff
+        auto LoadTargetAltConfig() const { return Fields::MakeOn<6, 1>(this); }
+
+        /// Load source configuration, but force its peripheral_id to be 0xff
+        auto LoadSourceAltConfig() const { return Fields::MakeOn<7, 1>(this); }
+    } flags;
+
+    uint8_t unknown2;
+
+    struct SubConfig {
+        uint8_t unknown;
+
+        // Seems to indicate the value size? TODO: how is this compatible with the member value_size above?
+        uint8_t type;
+
+        uint16_t unknown2;
+
+        uint16_t transfer_size;
+
+        uint16_t unknown3;
+
+        uint16_t stride;
+
+        static SubConfig Default() {
+            return { 0xff, 0xf, 0x80, 0x0, 0x80, 0x0 };
+        }
+    };
+
+    // NOTE: Possible 3dbrew erratum: Which SubConfig actually comes first?
+    SubConfig dest;
+    SubConfig source;
+};
+
+/**
+ * Address generation for either side of an interprocess DMA. Memory-side
+ * configurations (peripheral ID 0xff) may gather/scatter data: Each chunk of
+ * transfer_size bytes then starts stride bytes after the previous one.
+ * Peripheral addresses are accessed linearly.
+ * TODO: Peripherals with a zero stride repeatedly access the same FIFO range
+ */
+struct DMAAddressGenerator {
+    VAddr base;
+    uint32_t chunk_size = 0;
+    uint32_t stride = 0;
+
+    DMAAddressGenerator(VAddr base, const DMAConfig::SubConfig& config);
+
+    // Returns the address of the byte at the given transfer offset and the number of bytes contiguous to it
+    std::pair<VAddr, uint32_t> operator()(uint32_t offset) const;
+};
+
+// Part of a DMA transfer that is contiguous in physical memory on both sides
+struct DMARun {
+    // Offset of the run within the transfer
+    uint32_t offset;
+
+    PAddr source;
+    PAddr dest;
+    uint32_t size;
+
+    bool operator==(const DMARun&) const = default;
+};
+
+// Returns the physical address for the given virtual address along with the
+// number of bytes mapped contiguously from it, or std::nullopt if unmapped
+using DMAResolveFunction = std::function<std::optional<std::pair<PAddr, uint32_t>>(VAddr)>;
+
+/**
+ * Splits a DMA transfer into runs that are contiguous in physical memory on
+ * both sides and that don't cross page boundaries, and invokes the given
+ * callback for each of them in order. Stops at the first address that is
+ * not mapped on either side.
+ * @return Number of bytes covered by the emitted runs. Less than size if the transfer was aborted
+ */
+uint32_t SplitDMATransfer(uint32_t size, const DMAAddressGenerator& source, const DMAAddressGenerator& dest,
+                          const DMAResolveFunction& resolve_source, const DMAResolveFunction& resolve_dest,
+                          const std::function<void(const DMARun&)>& on_run);
+
+} // namespace OS
+
+} // namespace HLE
@@ -0,0 +1,139 @@
+#include "os_guest_profiler.hpp"
+#include "os.hpp"
+
+#include <spdlog/logger.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+
+namespace HLE {
+
+namespace OS {
+
+GuestProfiler::GuestProfiler(uint64_t sample_interval) : sample_interval(std::max<uint64_t>(sample_interval, 1)) {
+}
+
+void GuestProfiler::LoadSymbols(const std::string& process_name, const std::filesystem::path& filename) {
+    std::ifstream file(filename);
+    if (!file) {
+        throw std::runtime_error(fmt::format("Could not open symbol file {}", filename.string()));
+    }
+
+    auto& table = symbol_tables[process_name];
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::vector<std::string> tokens;
+        for (std::string token; stream >> token;) {
+            tokens.push_back(std::move(token));
+        }
+
+        // Accepted formats are "addr type name" and "addr size type name"
+        if (tokens.size() != 3 && tokens.size() != 4) {
+            continue;
+        }
+
+        auto& type = tokens[tokens.size() - 2];
+        if (type != "t" && type != "T" && type != "w" && type != "W") {
+            continue;
+        }
+
+        try {
+            auto addr = std::stoul(tokens[0], nullptr, 16);
+            auto size = (tokens.size() == 4) ? std::stoul(tokens[1], nullptr, 16) : 0;
+            table[addr] = Symbol { static_cast<uint32_t>(size), tokens.back() };
+        } catch (std::logic_error&) {
+            // Skip lines that don't start with an address
+        }
+    }
+}
+
+void GuestProfiler::RecordSample(EmuProcess& process, VAddr pc, VAddr lr) {
+    auto [it, inserted] = processes.try_emplace(process.GetId());
+    auto& profile = it->second;
+    if (inserted) {
+        auto& codeset = *process.codeset;
+        auto segment_size = [](const std::vector<CodeSet::Mapping>& mappings) {
+            return std::accumulate(mappings.begin(), mappings.end(), uint32_t { 0 },
+                                   [](uint32_t size, auto& mapping) { return size + mapping.num_pages * 0x1000; });
+        };
+
+        profile.name = codeset.app_name;
+        profile.segments = {
+            { codeset.text_vaddr, segment_size(codeset.text_phys), ".text" },
+            { codeset.ro_vaddr, segment_size(codeset.ro_phys), ".rodata" },
+            { codeset.data_vaddr, segment_size(codeset.data_phys), ".data" },
+        };
+        if (auto symbols_it = symbol_tables.find(profile.name); symbols_it != symbol_tables.end()) {
+            profile.symbols = &symbols_it->second;
+        }
+    }
+
+    // Clear the Thumb bit of the return address
+    lr &= ~uint32_t { 1 };
+    ++profile.samples[(uint64_t { pc } << 32) | lr];
+}
+
+std::string GuestProfiler::Symbolize(const ProcessProfile& profile, VAddr addr) const {
+    if (profile.symbols) {
+        auto it = profile.symbols->upper_bound(addr);
+        if (it != profile.symbols->begin()) {
+            --it;
+            if (it->second.size == 0 || addr - it->first < it->second.size) {
+                return it->second.name;
+            }
+        }
+    }
+
+    for (auto& segment : profile.segments) {
+        if (addr >= segment.start && addr - segment.start < segment.size) {
+            return fmt::format("{}+{:#x}", segment.name, addr - segment.start);
+        }
+    }
+
+    return fmt::format("{:#010x}", addr);
+}
+
+void GuestProfiler::WriteFoldedStacks(spdlog::logger& logger, const std::filesystem::path& directory) const {
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        logger.warn("Could not create guest profile directory {}: {}", directory.string(), ec.message());
+        return;
+    }
+
+    for (auto& [pid, profile] : processes) {
+        // Merge samples that resolve to the same frames
+        std::map<std::string, uint64_t> stacks;
+        for (auto& [addrs, count] : profile.samples) {
+            auto pc_frame = Symbolize(profile, static_cast<VAddr>(addrs >> 32));
+            auto lr_frame = Symbolize(profile, static_cast<VAddr>(addrs));
+
+            // If LR points into the current function, it's not a meaningful caller
+            if (lr_frame == pc_frame) {
+                stacks[fmt::format("{};{}", profile.name, pc_frame)] += count;
+            } else {
+                stacks[fmt::format("{};{};{}", profile.name, lr_frame, pc_frame)] += count;
+            }
+        }
+
+        auto filename = directory / fmt::format("{}.{}.folded", profile.name, pid);
+        std::ofstream file(filename);
+        for (auto& [stack, count] : stacks) {
+            file << stack << ' ' << count << '\n';
+        }
+        if (!file) {
+            logger.warn("Could not write guest profile {}", filename.string());
+        }
+    }
+
+    logger.info("Wrote guest profiles to {}", directory.string());
+}
+
+} // namespace OS
+
+} // namespace HLE
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "os_types.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace spdlog {
+class logger;
+}
+
+namespace HLE {
+
+namespace OS {
+
+class EmuProcess;
+
+/**
+ * Statistical profiler for emulated code.
+ *
+ * The CPU engine records the guest PC and LR of the running thread every
+ * sample_interval CPU cycles of that thread. Samples are taken at arbitrary
+ * instruction boundaries rather than only when threads return control to
+ * the OS, so system call sites and preemption points aren't overrepresented.
+ *
+ * Samples are aggregated per process and written as folded stacks (as
+ * consumed by flamegraph.pl and compatible tools). Addresses are resolved
+ * against user-provided symbol files where available, and relative to the
+ * process CodeSet segments otherwise.
+ */
+class GuestProfiler {
+public:
+    struct Symbol {
+        uint32_t size; // 0 if unknown
+        std::string name;
+    };
+
+    using SymbolTable = std::map<VAddr, Symbol>;
+
+private:
+    struct Segment {
+        VAddr start;
+        uint32_t size;
+        const char* name;
+    };
+
+    struct ProcessProfile {
+        std::string name;
+        std::vector<Segment> segments;
+        const SymbolTable* symbols = nullptr;
+
+        // Number of samples for each pair of PC (upper 32 bits) and LR (lower 32 bits)
+        std::unordered_map<uint64_t, uint64_t> samples;
+    };
+
+    uint64_t sample_interval;
+
+    std::unordered_map<std::string, SymbolTable> symbol_tables;
+
+    std::unordered_map<ProcessId, ProcessProfile> processes;
+
+    std::string Symbolize(const ProcessProfile&, VAddr) const;
+
+public:
+    GuestProfiler(uint64_t sample_interval);
+
+    /**
+     * Loads symbols for processes with the given name from a text file in
+     * the format produced by "nm -S" (address, optional size, type, name).
+     * Lines that don't refer to code symbols are ignored.
+     */
+    void LoadSymbols(const std::string& process_name, const std::filesystem::path& filename);
+
+    // Number of CPU cycles between samples of each thread
+    uint64_t GetSampleInterval() const {
+        return sample_interval;
+    }
+
+    void RecordSample(EmuProcess& process, VAddr pc, VAddr lr);
+
+    // Writes one file of folded stacks per sampled process to the given directory. Failures are logged
+    void WriteFoldedStacks(spdlog::logger&, const std::filesystem::path& directory) const;
+};
+
+} // namespace OS
+
+} // namespace HLE
@@ -0,0 +1,108 @@
+#include "os_handle_table.hpp"
+
+#include <framework/exceptions.hpp>
+
+#include <fmt/format.h>
+
+#include <limits>
+
+namespace HLE {
+
+namespace OS {
+
+void HandleTable::ErrorNotFound(Handle handle, const char* requested_type) {
+    throw Mikage::Exceptions::Invalid("Could not find handle {} of type \"{}\" in handle table", handle.value, requested_type);
+}
+
+void HandleTable::ErrorWrongType(std::shared_ptr<Object> object, const char* requested_type) {
+    auto& obj = *object;
+    throw std::runtime_error(fmt::format("Requested type \"{}\", but found object has type \"{}\"\n", requested_type, obj.GetName()));
+}
+
+Handle HandleTable::AllocateSlot(std::shared_ptr<Object> object, const std::type_info& type, const DebugHandle::DebugInfo& debug_info) {
+    uint32_t index;
+    if (!free_slots.empty()) {
+        index = free_slots.back();
+        free_slots.pop_back();
+    } else {
+        if (slots.size() >= max_slots) {
+            throw Mikage::Exceptions::Invalid("Handle table exhausted");
+        }
+        index = slots.size();
+        slots.emplace_back();
+    }
+
+    const uint16_t generation = next_generation;
+    next_generation = (next_generation == std::numeric_limits<uint16_t>::max()) ? 1 : (next_generation + 1);
+
+    slots[index] = { std::move(object), &type, debug_info, generation };
+    return Handle { (uint32_t { generation } << index_bits) | index };
+}
+
+DebugHandle HandleTable::FindHandle(void* object) {
+    // Compare raw pointers in place to avoid taking a reference to each object
+    for (uint32_t index = 0; index < slots.size(); ++index) {
+        auto& slot = slots[index];
+        if (slot.object && slot.object.get() == object) {
+            return DebugHandle { (uint32_t { slot.generation } << index_bits) | index, slot.debug_info };
+        }
+    }
+    for (uint32_t index = 0; index < reserved_slots.size(); ++index) {
+        auto& slot = reserved_slots[index];
+        if (slot.object && slot.object.get() == object) {
+            return DebugHandle { reserved_handle_start + index, slot.debug_info };
+        }
+    }
+    return Handle{HANDLE_INVALID};
+}
+
+std::vector<HandleTable::Entry<Object>> HandleTable::GetEntries() const {
+    std::vector<Entry<Object>> entries;
+    for (uint32_t index = 0; index < slots.size(); ++index) {
+        auto& slot = slots[index];
+        if (slot.object) {
+            entries.emplace_back(DebugHandle { (uint32_t { slot.generation } << index_bits) | index, slot.debug_info }, slot.object);
+        }
+    }
+    for (uint32_t index = 0; index < reserved_slots.size(); ++index) {
+        auto& slot = reserved_slots[index];
+        if (slot.object) {
+            entries.emplace_back(DebugHandle { reserved_handle_start + index, slot.debug_info }, slot.object);
+        }
+    }
+    return entries;
+}
+
+std::vector<Handle> HandleTable::GetHandles() const {
+    std::vector<Handle> handles;
+    for (uint32_t index = 0; index < slots.size(); ++index) {
+        if (slots[index].object) {
+            handles.push_back(Handle { (uint32_t { slots[index].generation } << index_bits) | index });
+        }
+    }
+    for (uint32_t index = 0; index < reserved_slots.size(); ++index) {
+        if (reserved_slots[index].object) {
+            handles.push_back(Handle { reserved_handle_start + index });
+        }
+    }
+    return handles;
+}
+
+void HandleTable::CloseHandle(Handle handle) {
+    auto slot = LookupSlot(handle);
+    if (!slot) {
+        return; // TODO: 3dscraft workaround, only
+        throw std::runtime_error("Tried to close handle " + std::to_string(handle.value) + " that is not in the handle table");
+    }
+
+    // Move the object out of the table first, since its destructor may modify the table
+    auto object = std::move(slot->object);
+    *slot = {};
+    if (handle.value - reserved_handle_start >= reserved_slots.size()) {
+        free_slots.push_back(handle.value & (max_slots - 1));
+    }
+}
+
+} // namespace OS
+
+} // namespace HLE
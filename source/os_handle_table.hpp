@@ -0,0 +1,227 @@
+#pragma once
+
+#include "os_types.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+namespace HLE {
+
+namespace OS {
+
+class Thread;
+
+// Abstract object with some unique ID.
+class Object : public std::enable_shared_from_this<Object> {
+public:
+    Object() = default;
+    Object(const Object&) = delete;
+
+    virtual ~Object() = default;
+
+    std::string name{};
+
+    std::string GetName() const {
+        if (!name.empty())
+            return name;
+
+       return typeid(*this).name();
+    }
+};
+
+/**
+ * A handle table is a collection of handles owned by a particular process.
+ * Handles are process-unique, but handles of different threads may refer to
+ * the same object. The objects are "owned" in the sense that deleting all
+ * handles that refer to a particular object will trigger destruction of the
+ * object.
+ *
+ * Like the table in the actual kernel, entries are stored in a slot array
+ * indexed by the lower bits of the handle value. The upper bits hold a
+ * generation counter to detect use of stale handles after a slot has been
+ * reused. Looking up a handle hence is a bounds check plus a comparison.
+ */
+class HandleTable {
+    friend class ConsoleModule;
+
+    struct Slot {
+        std::shared_ptr<Object> object;
+
+        // Dynamic type of object, cached to avoid RTTI lookups for exact type matches
+        const std::type_info* type = nullptr;
+
+        DebugHandle::DebugInfo debug_info;
+
+        // Zero for unused slots
+        uint16_t generation = 0;
+    };
+
+    static constexpr uint32_t index_bits = 15;
+    static constexpr uint32_t max_slots = 1 << index_bits;
+
+    // Pseudo-handles referring to the current thread and the current process
+    static constexpr uint32_t reserved_handle_start = 0xFFFF8000;
+
+    std::vector<Slot> slots;
+
+    // Indexes of unused slots in slots, reused in LIFO order
+    std::vector<uint16_t> free_slots;
+
+    // Generation to assign to the next created handle. Never zero
+    uint16_t next_generation = 1;
+
+    std::array<Slot, 2> reserved_slots;
+
+    Slot* LookupSlot(Handle handle) {
+        if (handle.value - reserved_handle_start < reserved_slots.size()) {
+            auto& slot = reserved_slots[handle.value - reserved_handle_start];
+            return slot.object ? &slot : nullptr;
+        }
+
+        const uint32_t index = handle.value & (max_slots - 1);
+        if (index >= slots.size() || slots[index].generation != (handle.value >> index_bits)) {
+            return nullptr;
+        }
+        return &slots[index];
+    }
+
+    Handle AllocateSlot(std::shared_ptr<Object> object, const std::type_info& type, const DebugHandle::DebugInfo& debug_info);
+
+    template<typename Type>
+    static Type* CastObject(const Slot& slot) {
+        if constexpr (std::is_same_v<Type, Object>) {
+            return slot.object.get();
+        } else if (*slot.type == typeid(Type)) {
+            return static_cast<Type*>(slot.object.get());
+        } else {
+            return dynamic_cast<Type*>(slot.object.get());
+        }
+    }
+
+    // Prints an internal logging message about a type mismatch.
+    void ErrorNotFound(Handle, const char* requested_type);
+
+    // Prints an internal logging message about a type mismatch.
+    void ErrorWrongType(std::shared_ptr<Object> object, const char* requested_type);
+
+public:
+    template<typename Type>
+    using Entry = std::pair<DebugHandle, std::shared_ptr<Type>>;
+
+    /**
+     * Inserts the given Object into the handle table and returns a Handle to the object.
+     * @return Immutable pair of Handle and pointer the object.
+     */
+    template<typename Type>
+    Entry<Type> CreateHandle(std::shared_ptr<Type> object, const DebugHandle::DebugInfo& debug_info) {
+        static_assert(std::is_base_of<Object,Type>::value, "object must be a shared_ptr to a derivative class of Object!");
+        auto& type = typeid(*object);
+        DebugHandle debug_handle { AllocateSlot(object, type, debug_info).value, debug_info };
+        return { debug_handle, object };
+    }
+
+    /**
+     * Inserts the given Object into the handle table with the specified Handle.
+     * Use this to set up reserved handles (e.g. 0xFFFF8001 for the handle of the current process)
+     */
+    template<typename Type>
+    void CreateEntry(const DebugHandle& handle, std::shared_ptr<Type> object) {
+        static_assert(std::is_base_of<Object,Type>::value, "object must be a shared_ptr to a derivative class of Object!");
+        if (handle.value - reserved_handle_start >= reserved_slots.size())
+            throw std::runtime_error("Only reserved handles may be inserted explicitly!");
+
+        auto& slot = reserved_slots[handle.value - reserved_handle_start];
+        if (slot.object)
+            throw std::runtime_error("Handle already in table!");
+
+        auto& type = typeid(*object);
+        slot = { std::move(object), &type, handle.debug_info, 0 };
+    }
+
+    /**
+     * Returns a pointer to the kernel Object referenced by handle if it is in
+     * the table and if the object can be downcast to Type.
+     *
+     * Unlike FindObject, this doesn't take a reference to the object, so the
+     * returned pointer must not be used after the handle has been closed.
+     * @param fail_expected If true, we won't log an error when an object of different type is found with the given handle
+     * @return nullptr if the handle can't be used to obtain a pointer to Type.
+     */
+    template<typename Type>
+    Type* FindObjectPointer(Handle handle, bool fail_expected = false) {
+        static_assert(std::is_base_of<Object,Type>::value, "object must be a shared_ptr to a derivative class of Object!");
+
+        auto slot = LookupSlot(handle);
+        if (!slot) {
+            if (!fail_expected) {
+                ErrorNotFound(handle, typeid(Type).name());
+            }
+            return nullptr;
+        }
+
+        auto object_ptr = CastObject<Type>(*slot);
+        if (!fail_expected && !object_ptr)
+            ErrorWrongType(slot->object, typeid(Type).name());
+        return object_ptr;
+    }
+
+    /**
+     * Returns a shared pointer to the kernel Object referenced by handle if
+     * it is in the table and if the object can be downcast to Type.
+     * @param fail_expected If true, we won't log an error when an object of different type is found with the given handle
+     * @return shared_ptr of the given Type. nullptr if the handle can't be used to obtain a pointer to Type.
+     */
+    template<typename Type>
+    std::shared_ptr<Type> FindObject(Handle handle, bool fail_expected = false) {
+        auto object_ptr = FindObjectPointer<Type>(handle, fail_expected);
+        if (!object_ptr) {
+            return nullptr;
+        }
+
+        // Share ownership with the table entry without going through dynamic_pointer_cast
+        return std::shared_ptr<Type>(LookupSlot(handle)->object, object_ptr);
+    }
+
+    DebugHandle FindHandle(void* object);
+
+    template<typename Type>
+    Handle FindHandle(std::shared_ptr<Type> object) {
+        static_assert(std::is_base_of<Object,Type>::value, "object must be a shared_ptr to a derivative class of Object!");
+        return FindHandle(object.get());
+    }
+
+    /**
+     * Returns a snapshot of all entries in the table, including reserved handles.
+     * Intended for debugging and cleanup rather than for regular lookups.
+     */
+    std::vector<Entry<Object>> GetEntries() const;
+
+    /**
+     * Returns the handles of all entries in the table, including reserved
+     * handles. Unlike GetEntries, this doesn't take references to the objects.
+     */
+    std::vector<Handle> GetHandles() const;
+
+    /**
+     * Sets the currently running thread (to be exposed as handle 0xFFFF8000)
+     * TODO: What does this return when multiple threads of the same process run on different CPUs?
+     */
+    void SetCurrentThread(const std::shared_ptr<Thread>& thread);
+
+    /**
+     * Closes the given handle. Does not release any locks still hold on ObserverSubjects.
+     * @todo Implement error case?
+     */
+    void CloseHandle(Handle handle);
+};
+
+} // namespace OS
+
+} // namespace HLE
@@ -0,0 +1,182 @@
+#include "os_input_replay.hpp"
+
+#include <spdlog/logger.h>
+
+#include <fmt/format.h>
+
+#include <array>
+#include <stdexcept>
+
+namespace HLE {
+
+namespace OS {
+
+namespace {
+
+struct ReplayHeader {
+    std::array<char, 4> magic;
+    uint32_t version;
+
+    uint64_t title_id;
+    uint16_t title_version;
+
+    // Non-zero if Settings::EnableCycleAccounting was enabled while recording
+    uint8_t cycle_accounting;
+    std::array<uint8_t, 5> padding;
+};
+
+struct ReplayRecord {
+    // Index of the vblank at which the state was latched
+    uint64_t frame;
+
+    uint16_t buttons;
+    uint8_t touch_pressed;
+    uint8_t home_button;
+    float touch_x;
+    float touch_y;
+    float circle_pad_x;
+    float circle_pad_y;
+    uint32_t padding;
+};
+
+constexpr std::array<char, 4> replay_magic = { 'M', 'R', 'P', 'L' };
+
+// Bump this when changing the layout of the structures above
+constexpr uint32_t replay_version = 2;
+
+bool IsSameState(const InputSource::Snapshot& a, const InputSource::Snapshot& b) {
+    return  a.buttons == b.buttons &&
+            a.touch.pressed == b.touch.pressed && a.touch.x == b.touch.x && a.touch.y == b.touch.y &&
+            a.circle_pad.x == b.circle_pad.x && a.circle_pad.y == b.circle_pad.y &&
+            a.home_button == b.home_button;
+}
+
+InputReplay::Metadata ReadHeader(std::ifstream& file) {
+    ReplayHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (header.magic != replay_magic || header.version != replay_version) {
+        throw std::runtime_error("Unrecognized format version");
+    }
+    return { { header.title_id, header.title_version }, header.cycle_accounting != 0 };
+}
+
+} // anonymous namespace
+
+InputReplay::InputReplay(spdlog::logger& logger, InputSource& input, const Settings::Settings& settings, const Title& title)
+    : logger(logger), input(input) {
+    auto record_filename = settings.get<Settings::ReplayRecordFile>();
+    auto playback_filename = settings.get<Settings::ReplayPlaybackFile>();
+    if (!record_filename.empty() && !playback_filename.empty()) {
+        throw std::runtime_error("Cannot record and play back a replay at the same time");
+    }
+
+    if (!playback_filename.empty()) {
+        LoadPlaybackFile(settings, title, playback_filename);
+    }
+
+    if (!record_filename.empty()) {
+        record_file.open(record_filename, std::ios::binary | std::ios::trunc);
+        if (!record_file) {
+            throw std::runtime_error(fmt::format("Could not open replay file {} for writing", record_filename));
+        }
+
+        ReplayHeader header { replay_magic, replay_version, title.id, title.version, settings.get<Settings::EnableCycleAccounting>(), {} };
+        record_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        logger.info("Recording input to {}", record_filename);
+    }
+
+    // Hide frontend input until the first vblank
+    input.Latch(InputSource::Snapshot { });
+}
+
+InputReplay::Metadata InputReplay::ReadMetadata(const std::string& filename) {
+    try {
+        std::ifstream file(filename, std::ios::binary);
+        file.exceptions(std::ifstream::badbit | std::ifstream::failbit | std::ifstream::eofbit);
+        return ReadHeader(file);
+    } catch (std::exception& err) {
+        throw std::runtime_error(fmt::format("Could not load replay file {}: {}", filename, err.what()));
+    }
+}
+
+void InputReplay::LoadPlaybackFile(const Settings::Settings& settings, const Title& title, const std::string& filename) {
+    try {
+        std::ifstream file(filename, std::ios::binary);
+        file.exceptions(std::ifstream::badbit | std::ifstream::failbit | std::ifstream::eofbit);
+
+        auto metadata = ReadHeader(file);
+        if (metadata.title.id != title.id || metadata.title.version != title.version) {
+            throw std::runtime_error(fmt::format("Recorded for title {:#018x} version {}, but title {:#018x} version {} is being launched",
+                                                 metadata.title.id, metadata.title.version, title.id, title.version));
+        }
+        if (metadata.cycle_accounting != settings.get<Settings::EnableCycleAccounting>()) {
+            throw std::runtime_error(fmt::format("Recorded with cycle accounting {}", metadata.cycle_accounting ? "enabled" : "disabled"));
+        }
+
+        // Records are appended until shutdown, so read until the end of the file
+        file.exceptions(std::ifstream::badbit);
+        ReplayRecord record;
+        while (file.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+            InputSource::Snapshot state;
+            state.buttons = record.buttons;
+            state.touch.pressed = (record.touch_pressed != 0);
+            state.touch.x = record.touch_x;
+            state.touch.y = record.touch_y;
+            state.circle_pad.x = record.circle_pad_x;
+            state.circle_pad.y = record.circle_pad_y;
+            state.home_button = (record.home_button != 0);
+            playback_states.emplace_back(record.frame, state);
+        }
+    } catch (std::exception& err) {
+        throw std::runtime_error(fmt::format("Could not load replay file {}: {}", filename, err.what()));
+    }
+
+    playback = true;
+    logger.info("Playing back {} input states from {}", playback_states.size(), filename);
+}
+
+void InputReplay::Record(const InputSource::Snapshot& state) {
+    if (last_recorded && IsSameState(*last_recorded, state)) {
+        return;
+    }
+    last_recorded = state;
+
+    ReplayRecord record {
+        frame,
+        state.buttons,
+        state.touch.pressed,
+        state.home_button,
+        state.touch.x,
+        state.touch.y,
+        state.circle_pad.x,
+        state.circle_pad.y,
+        0
+    };
+    record_file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+
+    // Flush eagerly so that the replay remains usable if emulation crashes
+    record_file.flush();
+}
+
+void InputReplay::OnVBlank() {
+    if (playback) {
+        while (next_playback_state < playback_states.size() && playback_states[next_playback_state].first <= frame) {
+            input.Latch(playback_states[next_playback_state++].second);
+            if (next_playback_state == playback_states.size()) {
+                logger.info("Reached end of replay at vblank {}", frame);
+            }
+        }
+    } else {
+        auto state = input.GetFrontendState();
+        input.Latch(state);
+        if (record_file.is_open()) {
+            Record(state);
+        }
+    }
+
+    ++frame;
+}
+
+} // namespace OS
+
+} // namespace HLE
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "input.hpp"
+
+#include <framework/settings.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace spdlog {
+class logger;
+}
+
+namespace HLE {
+
+namespace OS {
+
+/**
+ * Makes host input deterministic, and optionally records it to or plays it
+ * back from a replay file.
+ *
+ * Emulated time is derived from the cycle counter of the CPU engine, and the
+ * DSP and GPU are stepped synchronously from the OS scheduler, so emulation
+ * is reproducible except for the input state the frontend may update at any
+ * point. To remove this last source of nondeterminism, input is latched once
+ * per vblank and the emulator core only observes the latched state.
+ *
+ * Replay files store each latched state that differs from the previous one
+ * along with the index of the vblank at which it was latched. Since the
+ * system clock is fixed (see the shared memory page setup), no other inputs
+ * need to be recorded.
+ */
+class InputReplay {
+public:
+    // Application the replay was recorded for
+    struct Title {
+        uint64_t id = 0;
+        uint16_t version = 0;
+    };
+
+    // Information stored in the replay file header
+    struct Metadata {
+        Title title;
+
+        // Value of Settings::EnableCycleAccounting while recording
+        bool cycle_accounting;
+    };
+
+private:
+    spdlog::logger& logger;
+    InputSource& input;
+
+    // Number of vblanks since startup
+    uint64_t frame = 0;
+
+    std::ofstream record_file;
+    std::optional<InputSource::Snapshot> last_recorded;
+
+    bool playback = false;
+
+    // Sorted by vblank index
+    std::vector<std::pair<uint64_t, InputSource::Snapshot>> playback_states;
+    std::size_t next_playback_state = 0;
+
+    void LoadPlaybackFile(const Settings::Settings&, const Title&, const std::string& filename);
+
+    void Record(const InputSource::Snapshot&);
+
+public:
+    /**
+     * Opens the replay files configured in the given settings.
+     * @param title Application to be launched. Playback fails if the replay was recorded for a different one
+     * @note Settings that affect emulated timing must match the replay file on playback (see ReadMetadata)
+     */
+    InputReplay(spdlog::logger&, InputSource&, const Settings::Settings&, const Title& title);
+
+    /**
+     * Reads the header of the given replay file, e.g. to restore the settings
+     * used while recording before the emulator core is set up.
+     */
+    static Metadata ReadMetadata(const std::string& filename);
+
+    // Latches the input state for the next emulated frame
+    void OnVBlank();
+};
+
+} // namespace OS
+
+} // namespace HLE
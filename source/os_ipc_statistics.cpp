@@ -0,0 +1,109 @@
+#include "os_ipc_statistics.hpp"
+#include "os.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+namespace HLE {
+
+namespace OS {
+
+void IPCStatistics::OnRequestSent(const Thread& client, std::string service, uint32_t command_id, uint64_t tick) {
+    pending[client.GetId()] = { std::move(service), command_id, 0, clock::now(), {}, tick };
+}
+
+void IPCStatistics::OnRequestDelivered(const Thread& client, Thread& server, uint32_t bytes_translated) {
+    auto it = pending.find(client.GetId());
+    if (it == pending.end()) {
+        return;
+    }
+
+    auto& request = it->second;
+    if (request.service.empty()) {
+        request.service = server.GetParentProcess().GetName();
+    }
+    request.bytes_translated += bytes_translated;
+    request.delivered_at = clock::now();
+}
+
+void IPCStatistics::OnReplySent(const Thread& client, uint32_t bytes_translated, uint64_t tick) {
+    auto it = pending.find(client.GetId());
+    if (it == pending.end()) {
+        return;
+    }
+
+    auto now = clock::now();
+    auto& request = it->second;
+
+    {
+        std::lock_guard guard(access_mutex);
+
+        auto& stats = services[request.service][request.command_id];
+        ++stats.calls;
+        stats.bytes_translated += request.bytes_translated + bytes_translated;
+        if (request.delivered_at != clock::time_point {}) {
+            stats.handler_host_time += now - request.delivered_at;
+        }
+        stats.blocked_host_time += now - request.sent_at;
+        stats.blocked_ticks += tick - request.sent_at_tick;
+    }
+
+    pending.erase(it);
+}
+
+void IPCStatistics::OnThreadExited(const Thread& client) {
+    pending.erase(client.GetId());
+}
+
+template<typename Duration>
+static uint64_t ToMicroseconds(Duration duration) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+std::string IPCStatistics::FormatJSON() const {
+    std::lock_guard guard(access_mutex);
+
+    std::string body = "[";
+    for (auto& [service, commands] : services) {
+        for (auto& [command_id, stats] : commands) {
+            body += fmt::format(R"({{ "service": "{}", "command": {}, "calls": {}, "bytes_translated": {}, )"
+                                R"("handler_host_us": {}, "blocked_host_us": {}, "blocked_ticks": {} }},)",
+                                service, command_id, stats.calls, stats.bytes_translated,
+                                ToMicroseconds(stats.handler_host_time), ToMicroseconds(stats.blocked_host_time),
+                                stats.blocked_ticks);
+        }
+    }
+    if (body.back() == ',') {
+        // Drop trailing comma
+        body.pop_back();
+    }
+    return body + "]";
+}
+
+void IPCStatistics::WriteCSV(std::ostream& os) const {
+    std::lock_guard guard(access_mutex);
+
+    std::vector<std::tuple<const std::string*, uint32_t, const CommandStats*>> rows;
+    for (auto& [service, commands] : services) {
+        for (auto& [command_id, stats] : commands) {
+            rows.emplace_back(&service, command_id, &stats);
+        }
+    }
+    std::sort(rows.begin(), rows.end(), [](auto& a, auto& b) {
+        return std::get<2>(a)->handler_host_time > std::get<2>(b)->handler_host_time;
+    });
+
+    os << "service,command,calls,bytes_translated,handler_host_us,blocked_host_us,blocked_ticks\n";
+    for (auto& [service, command_id, stats] : rows) {
+        os << fmt::format("{},{:#06x},{},{},{},{},{}\n", *service, command_id, stats->calls, stats->bytes_translated,
+                          ToMicroseconds(stats->handler_host_time), ToMicroseconds(stats->blocked_host_time),
+                          stats->blocked_ticks);
+    }
+}
+
+} // namespace OS
+
+} // namespace HLE
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "os_types.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+namespace HLE {
+
+namespace OS {
+
+class Thread;
+
+/**
+ * Accounting of IPC requests per service and command.
+ *
+ * For each request, the OS reports when it's sent by the client, when it's
+ * delivered to the server, and when the server replies. Statistics are
+ * committed upon reply, so requests that are still in flight are not
+ * included.
+ *
+ * Event callbacks must be invoked from the emulation thread, whereas the
+ * reporting interface may be used from any thread.
+ */
+class IPCStatistics {
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct CommandStats {
+        uint64_t calls = 0;
+
+        // Number of bytes copied or mapped for buffer parameters (requests and replies)
+        uint64_t bytes_translated = 0;
+
+        // Host time between delivery of the request to the server and its reply
+        clock::duration handler_host_time {};
+
+        // Time the client spent waiting for the reply
+        clock::duration blocked_host_time {};
+        uint64_t blocked_ticks = 0;
+    };
+
+private:
+    struct PendingRequest {
+        std::string service;
+        uint32_t command_id;
+        uint64_t bytes_translated;
+        clock::time_point sent_at;
+        clock::time_point delivered_at;
+        uint64_t sent_at_tick;
+    };
+
+    // Requests awaiting a reply, indexed by the id of the requesting thread
+    std::unordered_map<ThreadId, PendingRequest> pending;
+
+    mutable std::mutex access_mutex;
+    std::map<std::string, std::map<uint32_t, CommandStats>> services;
+
+public:
+    /**
+     * @param service Name of the service, or an empty string if it can't be
+     *                determined by the client. In the latter case, the name
+     *                of the server process is used.
+     */
+    void OnRequestSent(const Thread& client, std::string service, uint32_t command_id, uint64_t tick);
+
+    void OnRequestDelivered(const Thread& client, Thread& server, uint32_t bytes_translated);
+
+    void OnReplySent(const Thread& client, uint32_t bytes_translated, uint64_t tick);
+
+    // Drops the request of the given thread if it exits before the reply is sent
+    void OnThreadExited(const Thread& client);
+
+    // Returns all statistics as a JSON array
+    std::string FormatJSON() const;
+
+    // Writes all statistics as comma-separated values, sorted by host time spent in handlers
+    void WriteCSV(std::ostream&) const;
+};
+
+} // namespace OS
+
+} // namespace HLE
@@ -0,0 +1,208 @@
+#include "os_memory_manager.hpp"
+
+#include <framework/exceptions.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace HLE {
+
+namespace OS {
+
+MemoryManager::MemoryManager(DiscardFunction discard_memory, PAddr start_address, uint32_t size)
+    : discard_memory(std::move(discard_memory)), region_start_paddr(start_address), region_size_bytes(size) {
+    InsertFreeBlock(region_start_paddr, region_size_bytes);
+}
+
+static bool IsSameOwner(const std::weak_ptr<MemoryBlockOwner>& a, const std::weak_ptr<MemoryBlockOwner>& b) {
+    return !a.owner_before(b) && !b.owner_before(a);
+}
+
+void MemoryManager::InsertFreeBlock(PAddr start_addr, uint32_t size_bytes) {
+    auto next_it = free.lower_bound(start_addr);
+    ValidateContract(next_it == free.end() || start_addr + size_bytes <= next_it->first);
+    if (next_it != free.end() && start_addr + size_bytes == next_it->first) {
+        size_bytes += next_it->second;
+        free_by_size.erase({ next_it->second, next_it->first });
+        next_it = free.erase(next_it);
+    }
+
+    if (next_it != free.begin()) {
+        auto prev_it = std::prev(next_it);
+        ValidateContract(prev_it->first + prev_it->second <= start_addr);
+        if (prev_it->first + prev_it->second == start_addr) {
+            start_addr = prev_it->first;
+            size_bytes += prev_it->second;
+            free_by_size.erase({ prev_it->second, prev_it->first });
+            free.erase(prev_it);
+        }
+    }
+
+    free.emplace_hint(next_it, start_addr, size_bytes);
+    free_by_size.emplace(size_bytes, start_addr);
+}
+
+void MemoryManager::InsertTakenBlock(PAddr start_addr, uint32_t size_bytes, std::weak_ptr<MemoryBlockOwner> owner) {
+    auto next_it = taken.lower_bound(start_addr);
+    if (next_it != taken.end() && start_addr + size_bytes == next_it->first && IsSameOwner(next_it->second.owner, owner)) {
+        size_bytes += next_it->second.size_bytes;
+        next_it = taken.erase(next_it);
+    }
+
+    if (next_it != taken.begin()) {
+        auto prev_it = std::prev(next_it);
+        if (prev_it->first + prev_it->second.size_bytes == start_addr && IsSameOwner(prev_it->second.owner, owner)) {
+            prev_it->second.size_bytes += size_bytes;
+            return;
+        }
+    }
+
+    taken.emplace_hint(next_it, start_addr, MemoryBlock { size_bytes, std::move(owner) });
+}
+
+std::map<uint32_t, MemoryBlock>::iterator MemoryManager::FindTakenBlock(PAddr addr) {
+    auto block_it = taken.upper_bound(addr);
+    if (block_it == taken.begin()) {
+        return taken.end();
+    }
+
+    --block_it;
+    if (block_it->first + block_it->second.size_bytes <= addr) {
+        return taken.end();
+    }
+    return block_it;
+}
+
+std::optional<uint32_t> MemoryManager::AllocateBlock(std::shared_ptr<MemoryBlockOwner> owner, uint32_t size_bytes) {
+    if (size_bytes == 0) {
+        throw Mikage::Exceptions::Invalid("Attempted to allocate an empty memory block");
+    }
+
+    // Pick the smallest free block that fits, preferring lower addresses among blocks of equal size
+    auto fit_it = free_by_size.lower_bound({ size_bytes, 0 });
+    if (fit_it == free_by_size.end()) {
+        ++stats.num_failed_allocations;
+        return {};
+    }
+
+    const auto [free_size, addr] = *fit_it;
+    free_by_size.erase(fit_it);
+    free.erase(addr);
+
+    // Add "free" entry for remaining space
+    if (free_size != size_bytes) {
+        InsertFreeBlock(addr + size_bytes, free_size - size_bytes);
+    }
+
+    InsertTakenBlock(addr, size_bytes, owner);
+
+    stats.used_bytes += size_bytes;
+    stats.peak_used_bytes = std::max(stats.peak_used_bytes, stats.used_bytes);
+    ++stats.num_allocations;
+    return addr;
+}
+
+void MemoryManager::DeallocateBlock(std::shared_ptr<MemoryBlockOwner> owner, PAddr start_addr, uint32_t size_bytes) {
+    auto block_it = FindTakenBlock(start_addr);
+    if (block_it == taken.end()) {
+        throw std::runtime_error("No suitable block found to free");
+    }
+
+    const uint32_t chunk_addr = block_it->first;
+    const uint32_t chunk_size = block_it->second.size_bytes;
+
+    ValidateContract(!block_it->second.owner.expired());
+    ValidateContract(block_it->second.owner.lock() == owner);
+
+    if (chunk_addr + chunk_size < start_addr + size_bytes) {
+        throw Mikage::Exceptions::Invalid("Size to free is larger than allocated block");
+    }
+
+    taken.erase(block_it);
+
+    // Add "taken" entries for remaining space
+    if (chunk_addr < start_addr) {
+        taken[chunk_addr] = { start_addr - chunk_addr, owner };
+    }
+    if (chunk_addr + chunk_size > start_addr + size_bytes) {
+        taken[start_addr + size_bytes] = { chunk_addr + chunk_size - start_addr - size_bytes, owner };
+    }
+
+    InsertFreeBlock(start_addr, size_bytes);
+    discard_memory(start_addr, size_bytes);
+
+    stats.used_bytes -= size_bytes;
+    ++stats.num_deallocations;
+}
+
+void MemoryManager::DeallocateAllBlocks(std::shared_ptr<MemoryBlockOwner> owner) {
+    std::weak_ptr<MemoryBlockOwner> weak_owner = owner;
+    for (auto block_it = taken.begin(); block_it != taken.end();) {
+        if (!IsSameOwner(block_it->second.owner, weak_owner)) {
+            ++block_it;
+            continue;
+        }
+
+        const uint32_t chunk_addr = block_it->first;
+        const uint32_t chunk_size = block_it->second.size_bytes;
+        block_it = taken.erase(block_it);
+        InsertFreeBlock(chunk_addr, chunk_size);
+        discard_memory(chunk_addr, chunk_size);
+
+        stats.used_bytes -= chunk_size;
+        ++stats.num_deallocations;
+    }
+}
+
+void MemoryManager::TransferOwnership(  std::shared_ptr<MemoryBlockOwner> old_owner, std::shared_ptr<MemoryBlockOwner> new_owner,
+                                        PAddr start_addr, uint32_t size_bytes) {
+    auto block_it = FindTakenBlock(start_addr);
+    if (block_it == taken.end()) {
+        throw std::runtime_error("No suitable block found to transfer ownership of");
+    }
+
+    const uint32_t chunk_addr = block_it->first;
+    const uint32_t chunk_size = block_it->second.size_bytes;
+
+    ValidateContract(!block_it->second.owner.expired());
+    ValidateContract(block_it->second.owner.lock() == old_owner);
+
+    if (chunk_addr + chunk_size < start_addr + size_bytes) {
+        auto next_it = std::next(block_it);
+        throw Mikage::Exceptions::Invalid("Size to transfer is larger than allocated block ({:#x}-{:#x}, next {:#x}-{:#x}",
+        chunk_addr, chunk_addr + chunk_size,
+        next_it == taken.end() ? 0 : next_it->first, next_it == taken.end() ? 0 : next_it->first + next_it->second.size_bytes);
+    }
+
+    taken.erase(block_it);
+
+    // Add "taken" entries for remaining space
+    if (chunk_addr < start_addr) {
+        taken[chunk_addr] = { start_addr - chunk_addr, old_owner };
+    }
+    if (chunk_addr + chunk_size > start_addr + size_bytes) {
+        taken[start_addr + size_bytes] = { chunk_addr + chunk_size - start_addr - size_bytes, old_owner };
+    }
+
+    InsertTakenBlock(start_addr, size_bytes, new_owner);
+}
+
+uint32_t MemoryManager::UsedMemory() const {
+    return stats.used_bytes;
+}
+
+uint32_t MemoryManager::TotalSize() const {
+    return region_size_bytes;
+}
+
+MemoryManager::Statistics MemoryManager::GetStatistics() const {
+    auto ret = stats;
+    ret.num_free_blocks = free.size();
+    ret.largest_free_block = free_by_size.empty() ? 0 : free_by_size.rbegin()->first;
+    return ret;
+}
+
+} // namespace OS
+
+} // namespace HLE
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "os_types.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <utility>
+
+namespace Memory {
+struct PhysicalMemory;
+}
+
+namespace HLE {
+
+namespace OS {
+
+/**
+ * Owner of a physical memory allocation: Either a Process, a SharedMemoryBlock, or a CodeSet
+ */
+class MemoryBlockOwner {
+public:
+    virtual ~MemoryBlockOwner() = default;
+};
+
+struct MemoryBlock {
+    uint32_t size_bytes;
+
+    std::weak_ptr<MemoryBlockOwner> owner;
+};
+
+/**
+ * Extent allocator for one of the FCRAM regions.
+ *
+ * Free extents are indexed both by address (for coalescing with neighbors)
+ * and by size (for best-fit allocation), so allocation and deallocation
+ * take logarithmic time in the number of extents. Adjacent free extents are
+ * always coalesced, as are adjacent taken extents of the same owner.
+ *
+ * Deallocated memory is returned to the host and reads back as zero, so
+ * reserving large blocks only commits host memory for pages the emulated
+ * system actually writes to.
+ */
+class MemoryManager {
+public:
+    struct Statistics {
+        uint32_t used_bytes = 0;
+        uint32_t peak_used_bytes = 0;
+
+        uint32_t num_allocations = 0;
+        uint32_t num_failed_allocations = 0;
+        uint32_t num_deallocations = 0;
+
+        uint32_t num_free_blocks = 0;
+        uint32_t largest_free_block = 0;
+    };
+
+    // Returns the given physical memory range to the host
+    using DiscardFunction = std::function<void(PAddr start_addr, uint32_t size_bytes)>;
+
+private:
+    DiscardFunction discard_memory;
+
+    // physical starting address of region
+    uint32_t region_start_paddr;
+
+    uint32_t region_size_bytes;
+
+    // Sizes of free memory blocks, mapped by their starting physical address
+    std::map<uint32_t, uint32_t> free;
+
+    // Pairs of size and starting physical address of free memory blocks
+    std::set<std::pair<uint32_t, uint32_t>> free_by_size;
+
+    Statistics stats;
+
+    // Adds the given range to the free blocks, coalescing it with adjacent free blocks
+    void InsertFreeBlock(PAddr start_addr, uint32_t size_bytes);
+
+    // Adds the given range to the taken blocks, coalescing it with adjacent blocks of the same owner
+    void InsertTakenBlock(PAddr start_addr, uint32_t size_bytes, std::weak_ptr<MemoryBlockOwner> owner);
+
+    // Returns the taken block containing the given address, or taken.end() if there is none
+    std::map<uint32_t, MemoryBlock>::iterator FindTakenBlock(PAddr addr);
+
+public:
+// TODO: Needs an interface to check for ownership
+    // Map describing the taken memory blocks (mapped by their starting physical address)
+    std::map<uint32_t, MemoryBlock> taken;
+
+public:
+    MemoryManager(DiscardFunction discard_memory, PAddr start_address, uint32_t size);
+
+    // Discards deallocated memory through Memory::DiscardHostMemory
+    MemoryManager(Memory::PhysicalMemory& mem, PAddr start_address, uint32_t size);
+
+    /**
+     * Allocate a memory block of the given size.
+     * @return Starting address of the allocated buffer. std::nullopt on failure.
+     * @note size_bytes must be non-zero
+     */
+    std::optional<uint32_t> AllocateBlock(std::shared_ptr<MemoryBlockOwner>, uint32_t size_bytes);
+
+    void DeallocateBlock(std::shared_ptr<MemoryBlockOwner>, PAddr start_addr, uint32_t size_bytes);
+
+    // Deallocates all memory blocks held by the given owner
+    void DeallocateAllBlocks(std::shared_ptr<MemoryBlockOwner>);
+
+    void TransferOwnership(std::shared_ptr<MemoryBlockOwner> old_owner, std::shared_ptr<MemoryBlockOwner> new_owner, PAddr start_addr, uint32_t size_bytes);
+
+    void DeallocateBlock(PAddr start_addr, uint32_t size_bytes);
+
+    uint32_t UsedMemory() const;
+
+    uint32_t TotalSize() const;
+
+    Statistics GetStatistics() const;
+
+    PAddr RegionStart() const { return region_start_paddr; }
+    PAddr RegionEnd() const { return region_start_paddr + region_size_bytes; }
+};
+
+} // namespace OS
+
+} // namespace HLE
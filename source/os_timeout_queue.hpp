@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace HLE {
+
+namespace OS {
+
+/**
+ * Min-heap of waiters (usually Threads) waiting on a timeout, ordered by
+ * deadline and then by scheduling order.
+ *
+ * Waiter must provide an int64_t timeout_at (-1 for no timeout) and a
+ * uint64_t wait_sequence member. Each call to Schedule starts a new wait
+ * operation, which implicitly cancels any timeouts of earlier waits. Entries
+ * of such cancelled waits are discarded lazily when they expire.
+ */
+template<typename Waiter>
+class TimeoutQueue {
+    struct Entry {
+        int64_t timeout_at;
+
+        // Waiter::wait_sequence at the time of scheduling the timeout
+        uint64_t wait_sequence;
+
+        std::weak_ptr<Waiter> waiter;
+    };
+
+    // Yields the earliest deadline first, and entries with equal deadline in scheduling order
+    static bool Compare(const Entry& a, const Entry& b) {
+        return std::tie(a.timeout_at, a.wait_sequence) > std::tie(b.timeout_at, b.wait_sequence);
+    }
+
+    std::vector<Entry> heap;
+
+    uint64_t next_wait_sequence = 1;
+
+public:
+    /**
+     * Starts a new wait operation for the given waiter, which invalidates
+     * any timeouts of previous waits. If the waiter's timeout_at is not -1,
+     * it will be returned from PopExpired once that time has passed.
+     */
+    void Schedule(const std::shared_ptr<Waiter>& waiter) {
+        waiter->wait_sequence = next_wait_sequence++;
+        if (waiter->timeout_at == -1) {
+            return;
+        }
+
+        heap.push_back({ waiter->timeout_at, waiter->wait_sequence, waiter });
+        std::push_heap(heap.begin(), heap.end(), Compare);
+    }
+
+    /**
+     * Removes the earliest timeout that expired at the given time and
+     * returns its waiter. Entries of waiters that were destroyed or that
+     * started a new wait operation since are skipped.
+     * @return nullptr if no more timeouts have expired
+     */
+    std::shared_ptr<Waiter> PopExpired(int64_t now) {
+        while (!heap.empty() && heap.front().timeout_at <= now) {
+            std::pop_heap(heap.begin(), heap.end(), Compare);
+            auto entry = std::move(heap.back());
+            heap.pop_back();
+
+            auto waiter = entry.waiter.lock();
+            if (waiter && waiter->wait_sequence == entry.wait_sequence) {
+                return waiter;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // Number of pending entries, including ones that will be discarded
+    std::size_t size() const {
+        return heap.size();
+    }
+};
+
+} // namespace OS
+
+} // namespace HLE
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "os_types.hpp"
+
+#include "memory.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+namespace HLE {
+
+namespace OS {
+
+/**
+ * Small direct-mapped software TLB for memory accesses performed by HLE code
+ * on behalf of a thread. Entries map recently used pages to host memory, which
+ * avoids walking the process memory map and scanning the memory busses on
+ * each access.
+ *
+ * Virtual entries are tagged with the memory map generation of the process
+ * they were filled for and are flushed when that changes. Physical entries
+ * never go stale, since the bus layout is fixed.
+ */
+struct TranslationCache {
+    struct Translation {
+        PAddr paddr;
+        Memory::HostMemoryBackedPage page;
+
+        // Must be checked on each access, since hooks may be installed after the entry was filled
+        Memory::PageHookSlots hooks;
+    };
+
+    struct Entry : Translation {
+        // Page-aligned address this entry was filled for, or invalid_tag
+        uint32_t tag = invalid_tag;
+    };
+
+    // Never matches any page-aligned address
+    static constexpr uint32_t invalid_tag = 1;
+
+    static constexpr std::size_t num_entries = 16;
+
+    std::array<Entry, num_entries> virtual_entries;
+    std::array<Entry, num_entries> physical_entries;
+
+    // Process::memory_map_generation at the time virtual_entries were filled
+    uint32_t generation = 0;
+
+    static Entry& Select(std::array<Entry, num_entries>& entries, uint32_t addr) {
+        return entries[(addr >> 12) % num_entries];
+    }
+
+    /**
+     * Returns the entry for the page containing the given virtual address.
+     * On a miss, resolve(page) is called to get the Translation of the page;
+     * it returns std::nullopt for pages that may not be cached.
+     * @param memory_map_generation Current memory map generation of the process. All virtual entries are flushed if this changed since they were filled.
+     * @return nullptr if the page can't be cached
+     */
+    template<typename Resolve>
+    const Entry* LookupVirtual(VAddr addr, uint32_t memory_map_generation, Resolve&& resolve) {
+        if (generation != memory_map_generation) {
+            for (auto& entry : virtual_entries) {
+                entry.tag = invalid_tag;
+            }
+            generation = memory_map_generation;
+        }
+
+        const VAddr page = addr & ~uint32_t { 0xfff };
+        auto& entry = Select(virtual_entries, page);
+        if (entry.tag == page) {
+            return &entry;
+        }
+
+        std::optional<Translation> translation = resolve(page);
+        if (!translation) {
+            return nullptr;
+        }
+
+        static_cast<Translation&>(entry) = *translation;
+        entry.tag = page;
+        return &entry;
+    }
+
+    /**
+     * Returns the entry for the page containing the given physical address.
+     * On a miss, resolve(page) is called to get the Translation of the page;
+     * it returns std::nullopt for pages not backed by host memory.
+     * @return nullptr if the page is not backed by host memory
+     */
+    template<typename Resolve>
+    const Entry* LookupPhysical(PAddr addr, Resolve&& resolve) {
+        const PAddr page = addr & ~uint32_t { 0xfff };
+        auto& entry = Select(physical_entries, page);
+        if (entry.tag == page) {
+            return &entry;
+        }
+
+        std::optional<Translation> translation = resolve(page);
+        if (!translation) {
+            return nullptr;
+        }
+
+        static_cast<Translation&>(entry) = *translation;
+        entry.tag = page;
+        return &entry;
+    }
+};
+
+} // namespace OS
+
+} // namespace HLE
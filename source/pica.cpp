@@ -19,6 +19,8 @@ PicaContext::PicaContext(   std::shared_ptr<spdlog::logger> logger, Debugger::De
     context->settings = &settings;
     context->renderer = renderer.get();
     context->activity = &profiler.GetActivity("GPU");
+    context->shader_cache_lookups = &profiler.GetCounter("gpu.shader_cache.lookups");
+    context->shader_cache_hits = &profiler.GetCounter("gpu.shader_cache.hits");
     context->logger = logger;
 }
 
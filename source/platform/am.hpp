@@ -49,6 +49,16 @@ struct GetProgramList : IPC::IPCCommand<0x2>::add_uint32::add_uint32::add_buffer
 struct GetProgramInfos : IPC::IPCCommand<0x3>::add_uint32::add_uint32::add_buffer_mapping_read::add_buffer_mapping_write
                             ::response::add_uint32::add_buffer_mapping_read::add_buffer_mapping_write {};
 
+/**
+ * Uninstalls the given title
+ *
+ * Inputs:
+ * - Media Type
+ * - Title ID
+ */
+struct DeleteUserProgram : IPC::IPCCommand<0x4>::add_uint32::add_uint64
+                              ::response {};
+
 /**
  * Inputs:
  * - Media Type
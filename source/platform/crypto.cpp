@@ -0,0 +1,54 @@
+#include "crypto.hpp"
+
+#include <algorithm>
+#include <functional>
+
+KeyDatabase::KeyType KeyDatabase::GetNormalKey(uint32_t slot, const KeyType& key_y) const {
+    const auto cache_key = std::make_pair(slot, key_y);
+    {
+        std::shared_lock lock(derived_keys.access_mutex);
+        auto it = derived_keys.keys.find(cache_key);
+        if (it != derived_keys.keys.end()) {
+            return it->second;
+        }
+    }
+
+    auto key = GenerateNormalKey(aes_slots[slot].x.value(), key_y);
+    std::unique_lock lock(derived_keys.access_mutex);
+    derived_keys.keys.emplace(cache_key, key);
+    return key;
+}
+
+KeyDatabase::KeyType KeyDatabase::GenerateNormalKey(const KeyType& key_x, const KeyType& key_y) {
+    KeyType key_gen_constant = { 0x1f, 0xf9, 0xe9, 0xaa, 0xc5, 0xfe, 0x04, 0x08, 0x02, 0x45, 0x91, 0xdc, 0x5d, 0x52, 0x76, 0x8a };
+
+    KeyType key = key_x;
+
+    // ROL 2
+    for (unsigned i = 0, overflow = (key[0] >> 6); i < key.size(); ++i) {
+        auto new_overflow = key[15 - i] >> 6;
+        key[15 - i] <<= 2;
+        key[15 - i] |= overflow;
+        overflow = new_overflow;
+    }
+
+    std::transform(key.begin(), key.end(), key_y.begin(), key.begin(), std::bit_xor<>{}); // (X ROL 2) XOR Y
+
+    // Add constant
+    for (int i = key.size() - 1, carry = 0; i >= 0; --i) {
+        auto result = uint16_t { key[i] } + key_gen_constant[i] + carry;
+        key[i] = static_cast<uint8_t>(result);
+        carry = result >> 8;
+    }
+
+    // ... ROR 41 == ROL 88 and ROR 1
+    std::rotate(key.begin(), key.begin() + 11, key.end());
+    for (unsigned i = 0, overflow = (key.back() & 1); i < key.size(); ++i) {
+        auto new_overflow = key[i] & 1;
+        key[i] >>= 1;
+        key[i] |= overflow << 7;
+        overflow = new_overflow;
+    }
+
+    return key;
+}
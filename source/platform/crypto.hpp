@@ -2,7 +2,11 @@
 
 #include <array>
 #include <cstdint>
+#include <map>
+#include <mutex>
 #include <optional>
+#include <shared_mutex>
+#include <utility>
 
 struct KeyDatabase {
     // Each AES slot has three entries called KeyX, KeyY, and KeyN ("normal key")
@@ -18,4 +22,45 @@ struct KeyDatabase {
 
     // KeyYs used to decrypt title keys (required to decrypt CDN contents and update CIAs)
     std::array<std::optional<KeyType>, 6> common_y;
+
+    /**
+     * Returns the normal key generated by the hardware key scrambler for the
+     * KeyX of the given slot and the given KeyY.
+     *
+     * Results are cached, since the same few KeyYs (one per title or ticket)
+     * are used over and over again by the loaders, PXI, and the installer.
+     * Safe to call concurrently. Since cached keys are not invalidated, KeyX
+     * must not be changed after its first use (modify a copy instead).
+     *
+     * @throws std::bad_optional_access if KeyX of the given slot is unknown
+     */
+    KeyType GetNormalKey(uint32_t slot, const KeyType& key_y) const;
+
+    // Implementation of the hardware key scrambler
+    static KeyType GenerateNormalKey(const KeyType& key_x, const KeyType& key_y);
+
+private:
+    class DerivedKeyCache {
+        std::shared_mutex access_mutex;
+
+        // Indexed by key slot and KeyY
+        std::map<std::pair<uint32_t, KeyType>, KeyType> keys;
+
+        friend struct KeyDatabase;
+
+    public:
+        DerivedKeyCache() = default;
+
+        // Copies start out empty, since KeyX may be modified in the copied KeyDatabase
+        DerivedKeyCache(const DerivedKeyCache&) {
+        }
+
+        DerivedKeyCache& operator=(const DerivedKeyCache&) {
+            std::unique_lock lock(access_mutex);
+            keys.clear();
+            return *this;
+        }
+    };
+
+    mutable DerivedKeyCache derived_keys;
 };
@@ -291,6 +291,16 @@ using GetTitleList = IPC::IPCCommand<0x2>::add_uint32::add_uint32::add_pxi_buffe
 using GetTitleInfos = IPC::IPCCommand<0x3>::add_uint32::add_uint32::add_pxi_buffer_r::add_pxi_buffer
                                           ::response;
 
+/**
+ * Deletes the given title from the given media type
+ *
+ * Inputs:
+ * - Media type
+ * - Title ID
+ */
+using DeleteTitle = IPC::IPCCommand<0x4>::add_uint32::add_uint64
+                                        ::response;
+
 } // namespace AM
 
 } // namespace PXI
@@ -83,6 +83,12 @@ OnIPCGetProgramInfos(FakeThread& thread, FakeAM& context, uint32_t media_type, u
     return std::make_tuple(RESULT_OK, title_count, title_ids_buffer, out_buffer);
 }
 
+static OS::ResultAnd<>
+OnIPCDeleteUserProgram(FakeThread& thread, FakeAM& context, uint32_t media_type, uint64_t title_id) {
+    IPC::SendIPCRequest<Platform::PXI::AM::DeleteTitle>(thread, context.pxiam_session, media_type, title_id);
+    return std::make_tuple(RESULT_OK);
+}
+
 static auto AppCommandHandler(FakeThread& thread, FakeAM& context, const Platform::IPC::CommandHeader& header) {
     using namespace Platform::AM;
 
@@ -117,6 +123,10 @@ static auto AppCommandHandler(FakeThread& thread, FakeAM& context, const Platfor
         IPC::HandleIPCCommand<GetProgramInfos>(OnIPCGetProgramInfos, thread, thread, context);
         break;
 
+    case DeleteUserProgram::id:
+        IPC::HandleIPCCommand<DeleteUserProgram>(OnIPCDeleteUserProgram, thread, thread, context);
+        break;
+
     case 0x13: // NeedsCleanup
         thread.WriteTLS(0x80, IPC::CommandHeader::Make(0, 2, 0).raw);
         thread.WriteTLS(0x84, RESULT_OK);
@@ -9,6 +9,7 @@
 #include "../os_serialization.hpp"
 
 #include <framework/exceptions.hpp>
+#include <framework/profiler.hpp>
 
 #include <boost/algorithm/cxx11/all_of.hpp>
 
@@ -1704,6 +1705,7 @@ OnIPCFileRead(  FakeThread& thread, FSContext& context,
     uint32_t bytes_read;
     auto file_buffer = FileBufferInEmulatedMemory { thread, buffer.addr };
     std::tie(result, bytes_read) = file.Read(context.file_context, context, file_offset, num_bytes, file_buffer);
+    thread.GetOS().counters.fs_bytes_read.Add(bytes_read);
     return std::make_tuple(RESULT_OK, bytes_read, buffer);
 }
 
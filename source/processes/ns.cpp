@@ -138,16 +138,14 @@ static void DecompressLZSSData(const RangeIn& compressed_reverse, const RangeOut
 }
 
 
-HandleTable::Entry<Process> LoadProcessFromFile(FakeThread& source,
-                                                bool from_firm,
-                                                const FileFormat::ExHeader& exheader,
-                                                std::unique_ptr<HLE::PXI::FS::File> file, bool is_exefs) {
-    HLE::PXI::FS::FileContext file_context { *source.GetLogger() };
+std::vector<uint8_t> LoadCodeImage(spdlog::logger& logger, const KeyDatabase& keydb,
+                                   const FileFormat::ExHeader& exheader,
+                                   std::unique_ptr<HLE::PXI::FS::File> file, bool is_exefs) {
+    HLE::PXI::FS::FileContext file_context { logger };
     if (!is_exefs) {
         // Read ExeFS
         uint8_t code[8] = { '.', 'c', 'o', 'd', 'e' };
-        auto input_file = PXI::FS::NCCHOpenExeFSSection(*source.GetLogger(), file_context,
-                                                        source.GetParentProcess().interpreter_setup.keydb,
+        auto input_file = PXI::FS::NCCHOpenExeFSSection(logger, file_context, keydb,
                                                         std::move(file), 1, std::basic_string_view<uint8_t>(code, sizeof(code)));
         if (std::get<0>(input_file->OpenReadOnly(file_context)) != RESULT_OK) {
             // TODO: Better error message
@@ -158,27 +156,24 @@ HandleTable::Entry<Process> LoadProcessFromFile(FakeThread& source,
     }
     auto& input_file = file;
 
-    // Load process data into CodeSet based on contents of the ExeFs ".code" section.
+    // Load process data based on contents of the ExeFs ".code" section.
     // The actual program binary may be compressed, so decompress it along the way.
-    HandleTable::Entry<CodeSet> codeset;
-source.GetLogger()->info("{}: {}", __FUNCTION__, __LINE__);
     const uint32_t page_size = 0x1000;
     uint32_t total_size_aligned = (exheader.section_text.size_pages + exheader.section_ro.size_pages + exheader.section_data.size_pages) * page_size;
     // TODO: Check if we still need the following line. It used to be necessary for loading SM, but I never figured out why!
 //    auto code_buffer = parent_process.AllocateBuffer(decompressed_size + /*0x300*/0);
-    auto& parent_process = source.GetParentProcess();
-    auto code_buffer = parent_process.AllocateBuffer(total_size_aligned);
+    std::vector<uint8_t> code_buffer(total_size_aligned);
     auto [result, code_size] = input_file->GetSize(file_context);
     if (exheader.flags.compress_exefs_code()()) {
-        auto compressed_code_buffer = parent_process.AllocateBuffer(code_size);
+        std::vector<uint8_t> compressed_code_buffer(code_size);
         uint32_t bytes_read;
-        std::tie(result, bytes_read) = input_file->Read(file_context, 0, code_size, HLE::PXI::FS::FileBufferInHostMemory(compressed_code_buffer.second, code_size));
+        std::tie(result, bytes_read) = input_file->Read(file_context, 0, code_size, HLE::PXI::FS::FileBufferInHostMemory(compressed_code_buffer.data(), code_size));
         if (result != RESULT_OK || bytes_read != code_size) {
             throw std::runtime_error("Failed to read code section from ExeFS");
         }
 
         // The last word in the compressed stream denotes the difference between compressed and decompressed buffer size
-        auto compressed_buffer_range = boost::iterator_range<uint8_t*>(compressed_code_buffer.second, compressed_code_buffer.second + code_size);
+        auto compressed_buffer_range = boost::iterator_range<uint8_t*>(compressed_code_buffer.data(), compressed_code_buffer.data() + code_size);
         uint32_t decompressed_size = GetDecompressedLZSSDataSize(compressed_buffer_range);
 
         if (decompressed_size > total_size_aligned)
@@ -186,21 +181,34 @@ source.GetLogger()->info("{}: {}", __FUNCTION__, __LINE__);
 
         // TODO: Handle exceptions thrown by this function!
         DecompressLZSSData(compressed_buffer_range,
-                           boost::iterator_range<uint8_t*>(code_buffer.second, code_buffer.second + decompressed_size));
-
-        parent_process.FreeBuffer(compressed_code_buffer.first);
+                           boost::iterator_range<uint8_t*>(code_buffer.data(), code_buffer.data() + decompressed_size));
     } else {
         if (code_size > total_size_aligned) {
             throw std::runtime_error("Code section size exceeds virtual memory size. Corrupt ROM?");
         }
 
         uint32_t bytes_read;
-        std::tie(result, bytes_read) = input_file->Read(file_context, 0, code_size, HLE::PXI::FS::FileBufferInHostMemory(code_buffer.second, code_size));
+        std::tie(result, bytes_read) = input_file->Read(file_context, 0, code_size, HLE::PXI::FS::FileBufferInHostMemory(code_buffer.data(), code_size));
         if (result != RESULT_OK || bytes_read != code_size) {
             throw std::runtime_error("Failed to read code section from ExeFS");
         }
     }
 
+    return code_buffer;
+}
+
+HandleTable::Entry<Process> CreateProcessFromCodeImage(FakeThread& source,
+                                                       bool from_firm,
+                                                       const FileFormat::ExHeader& exheader,
+                                                       const std::vector<uint8_t>& code_buffer) {
+    OS::Result result;
+    HandleTable::Entry<CodeSet> codeset;
+    const uint32_t page_size = 0x1000;
+    uint32_t total_size_aligned = (exheader.section_text.size_pages + exheader.section_ro.size_pages + exheader.section_data.size_pages) * page_size;
+    if (code_buffer.size() != total_size_aligned) {
+        throw std::runtime_error("Code image size doesn't match extended header");
+    }
+
     auto kernel_flags = Meta::invoke([&]() {
         for (auto cap : exheader.aci.arm11_kernel_capabilities) {
             auto flags = FileFormat::ExHeader::ARM11KernelCapabilityDescriptor::KernelFlags { cap.storage };
@@ -217,11 +225,7 @@ source.GetLogger()->info("{}: {}", __FUNCTION__, __LINE__);
         throw std::runtime_error("Failed to allocate memory for program");
     }
 
-    for (uint32_t offset = 0; offset < total_size_aligned; ++offset) {
-        source.WriteMemory(code_buffer2 + offset, *(code_buffer.second + offset));
-    }
-
-    parent_process.FreeBuffer(code_buffer.first);
+    source.GetParentProcess().WriteMemoryBlock(code_buffer2, code_buffer.data(), total_size_aligned);
 
     // NOTE: The decompressed buffer need not be aligned to page size, hence the distinction between size_bytes and size_pages is critical!
     VAddr text_vaddr = code_buffer2;
@@ -277,6 +281,14 @@ source.GetLogger()->info("{}: {}", __FUNCTION__, __LINE__);
     return process;
 }
 
+HandleTable::Entry<Process> LoadProcessFromFile(FakeThread& source,
+                                                bool from_firm,
+                                                const FileFormat::ExHeader& exheader,
+                                                std::unique_ptr<HLE::PXI::FS::File> file, bool is_exefs) {
+    auto code_image = LoadCodeImage(*source.GetLogger(), source.GetParentProcess().interpreter_setup.keydb, exheader, std::move(file), is_exefs);
+    return CreateProcessFromCodeImage(source, from_firm, exheader, code_image);
+}
+
 
 OS::ResultAnd<ProcessId> LaunchTitleInternal(FakeThread& source, bool from_firm, uint64_t title_id, uint32_t flags /* (currently unused) */) {
     // TODO: This is fairly ad-hoc currently, i.e. all logic in here is
@@ -2,10 +2,18 @@
 
 #include "fake_process.hpp"
 
+#include <vector>
+
 namespace FileFormat {
 struct ExHeader;
 }
 
+namespace spdlog {
+class logger;
+}
+
+struct KeyDatabase;
+
 namespace HLE {
 
 namespace OS {
@@ -26,6 +34,23 @@ HandleTable::Entry<Process> LoadProcessFromFile(FakeThread&,
                                                 const FileFormat::ExHeader&,
                                                 std::unique_ptr<HLE::PXI::FS::File> ncch_file, bool is_exefs = false /* TODO: Get rid of this */);
 
+/**
+ * Reads the program code of the given NCCH file into a host buffer,
+ * decompressing it if needed. The buffer covers all code pages listed in the
+ * extended header.
+ *
+ * This doesn't access any emulated state, so it may be called from any thread.
+ */
+std::vector<uint8_t> LoadCodeImage(spdlog::logger&, const KeyDatabase&,
+                                   const FileFormat::ExHeader&,
+                                   std::unique_ptr<HLE::PXI::FS::File> ncch_file, bool is_exefs = false);
+
+// Creates a process from a code image previously returned by LoadCodeImage
+HandleTable::Entry<Process> CreateProcessFromCodeImage(FakeThread&,
+                                                       bool from_firm,
+                                                       const FileFormat::ExHeader&,
+                                                       const std::vector<uint8_t>& code_image);
+
 }  // namespace OS
 
 }  // namespace HLE
@@ -11,6 +11,7 @@
 #include "platform/file_formats/ncch.hpp"
 #include "platform/pxi.hpp"
 #include "pxi_fs.hpp"
+#include "title_database.hpp"
 
 #include "framework/meta_tools.hpp"
 
@@ -18,13 +19,13 @@
 #include <range/v3/algorithm/find.hpp>
 #include <range/v3/algorithm/find_first_of.hpp>
 
-#include <charconv>
 #include <filesystem>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 
 std::vector<uint64_t>* nand_titles = nullptr;
+static HLE::PXI::TitleDatabase* nand_title_database = nullptr;
 
 namespace std {
 
@@ -105,6 +106,12 @@ std::optional<const char*> GetHLEModuleName(uint64_t title_id) {
     return it->second.name;
 }
 
+Context::~Context() {
+    if (nand_title_database == title_database.get()) {
+        nand_title_database = nullptr;
+    }
+}
+
 FakePXI::FakePXI(FakeThread& thread)
     : os(thread.GetOS()),
       logger(*thread.GetLogger()) {
@@ -112,35 +119,13 @@ FakePXI::FakePXI(FakeThread& thread)
 
     Context context;
 
-    // Search for installed NAND titles
+    // Look up installed NAND titles. The title database only rescans directories that changed since the last run
     // TODO: Move titles to ./data/title
     {
-        std::filesystem::path base_path = GetRootDataDirectory(os.settings);
-
-        auto parse_title_id_part = [](const std::string& filename) -> std::optional<uint32_t> {
-            // Expect an 8-digit zero-padded hexadecimal number
-            if (filename.size() != 8) {
-                return std::nullopt;
-            }
-
-            uint32_t title_id_word = 0;
-            auto result = std::from_chars(filename.data(), filename.data() + 8, title_id_word, 16);
-            if (result.ptr != filename.data() + 8) {
-                return std::nullopt;
-            }
-            return title_id_word;
-        };
-
-        for (const auto& dir : std::filesystem::directory_iterator(base_path)) {
-            if (auto title_id_high = parse_title_id_part(dir.path().filename().string())) {
-                for (const auto& subdir : std::filesystem::directory_iterator(dir)) {
-                    if (auto title_id_low = parse_title_id_part(subdir.path().filename().string())) {
-                        context.nand_titles.push_back((uint64_t { *title_id_high } << 32) | *title_id_low);
-                    }
-                }
-            }
-        }
+        context.title_database = std::make_unique<TitleDatabase>(logger, GetRootDataDirectory(os.settings), thread.GetParentProcess().interpreter_setup.keydb);
+        context.nand_titles = context.title_database->GetTitleIds();
         nand_titles = &context.nand_titles;
+        nand_title_database = context.title_database.get();
     }
 
     {
@@ -216,13 +201,10 @@ FileFormat::ExHeader GetExtendedHeader(FS::FileContext& file_context, const KeyD
 
     if (is_encrypted) {
         fprintf(stderr, "DECRYPTING EXHEADER: %c%c%c%c\n", ncch_header.magic[0], ncch_header.magic[1], ncch_header.magic[2], ncch_header.magic[3]);
-        std::array<uint8_t, 16> GenerateAESKey(const std::array<uint8_t, 16>& key_x, const std::array<uint8_t, 16>& key_y);
-
         // 0x2c key slot
-        const std::array<uint8_t, 16>& key_x = keydb.aes_slots[0x2c].x.value();
         std::array<uint8_t, 16> key_y;
         memcpy(key_y.data(), &ncch_header, sizeof(key_y));
-        auto key = GenerateAESKey(key_x, key_y);
+        auto key = keydb.GetNormalKey(0x2c, key_y);
 
         std::array<uint8_t, 16> iv {};
         // First 8 bytes are the partition id interpreted as big-endian
@@ -266,6 +248,13 @@ FileFormat::ExHeader GetExtendedHeader(Thread& thread, const Platform::FS::Progr
             return ret;
         }
 
+        // Use the extended header cached in the title database if available
+        if (nand_title_database) {
+            if (auto exheader = nand_title_database->GetExtendedHeader(title_info.program_id)) {
+                return *exheader;
+            }
+        }
+
         // TODO: The following should perhaps be done in the PXIFS subsystem instead
         // TODO: The content ID is hardcoded currently.
         uint32_t content_id = 0;
@@ -315,14 +304,11 @@ bool is_encrypted = !(encryption_flags & 4);
 
 if (is_encrypted) {
 fprintf(stderr, "DECRYPTING EXHEADER\n");
-    std::array<uint8_t, 16> GenerateAESKey(const std::array<uint8_t, 16>& key_x, const std::array<uint8_t, 16>& key_y);
-
     // 0x2c key slot
-    const std::array<uint8_t, 16>& key_x = keydb.aes_slots[0x2c].x.value();
     std::array<uint8_t, 16> key_y;
     input_file.seekg(ncch_begin);
     input_file.read(reinterpret_cast<char*>(key_y.data()), sizeof(key_y));
-    auto key = GenerateAESKey(key_x, key_y);
+    auto key = keydb.GetNormalKey(0x2c, key_y);
 
     std::array<uint8_t, 16> iv {};
     // First 8 bytes are the partition id interpreted as big-endian
@@ -707,8 +693,10 @@ static std::tuple<Result> AMHandleGetTitleInfos(FakeThread& thread, Context& con
 
             infos.Write<uint64_t>(thread, title_index * 24, *title_it);
             // TODO: What data should be returned here?
-            infos.Write<uint64_t>(thread, title_index * 24 + 0x8, 0x447000);
-            infos.Write<uint32_t>(thread, title_index * 24 + 0x10, 2055 );
+            // Fall back to placeholder values for information that's not indexed
+            auto record = context.title_database->Find(title_id);
+            infos.Write<uint64_t>(thread, title_index * 24 + 0x8, (record && record->total_content_size) ? record->total_content_size : 0x447000);
+            infos.Write<uint32_t>(thread, title_index * 24 + 0x10, (record && record->title_version) ? record->title_version : 2055);
             infos.Write<uint32_t>(thread, title_index * 24 + 0x14, 0x1);
         }
         return std::make_tuple(RESULT_OK);
@@ -730,6 +718,26 @@ static std::tuple<Result> AMHandleGetTitleInfos(FakeThread& thread, Context& con
     return std::make_tuple(RESULT_OK);
 }
 
+static std::tuple<Result> AMHandleDeleteTitle(FakeThread& thread, Context& context, uint32_t media_type, uint64_t title_id) {
+    thread.GetLogger()->info("{}received DeleteTitle for title {:#018x} with media_type {:#x}",
+                             ThreadPrinter{thread}, title_id, media_type);
+
+    // Only the lowest byte of the media type is used
+    media_type &= 0xff;
+
+    if (media_type != 0) {
+        throw Mikage::Exceptions::NotImplemented("Unsupported media type");
+    }
+
+    // Remove the title directory, which holds the contents of the title
+    auto title_path = TitleDatabase::GetContentPath(GetRootDataDirectory(thread.GetOS().settings), title_id, 0).parent_path().parent_path();
+    std::filesystem::remove_all(title_path);
+
+    context.title_database->OnTitleRemoved(title_id);
+    context.nand_titles = context.title_database->GetTitleIds();
+    return std::make_tuple(RESULT_OK);
+}
+
 static auto PXIAMCommandHandler(FakeThread& thread, Context& context, const IPC::CommandHeader& header) try {
     namespace PXIAM = Platform::PXI::AM;
 
@@ -746,6 +754,10 @@ static auto PXIAMCommandHandler(FakeThread& thread, Context& context, const IPC:
         IPC::HandleIPCCommand<PXIAM::GetTitleInfos>(AMHandleGetTitleInfos, thread, thread, context);
         break;
 
+    case PXIAM::DeleteTitle::id:
+        IPC::HandleIPCCommand<PXIAM::DeleteTitle>(AMHandleDeleteTitle, thread, thread, context);
+        break;
+
     // Takes a single input word (presumably a media_type)
     case 0x3f:
         // NOTE: This function is called by AM command 0x13 ("NeedsCleanup"),
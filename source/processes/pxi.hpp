@@ -21,6 +21,7 @@ class Archive;
 class File;
 class FileContext;
 }
+class TitleDatabase;
 }
 
 namespace PXI {
@@ -74,6 +75,10 @@ struct Context {
 
     // List of titles installed to the emulated NAND
     std::vector<uint64_t> nand_titles;
+
+    std::unique_ptr<TitleDatabase> title_database;
+
+    ~Context();
 };
 
 class FakePXI final {
@@ -7,6 +7,7 @@
 #include "platform/pxi.hpp"
 
 #include <framework/exceptions.hpp>
+#include <framework/profiler.hpp>
 
 #include "pxi_fs.hpp"
 #include "pxi_fs_file_buffer_emu.hpp"
@@ -35,40 +36,6 @@ namespace HLE {
 
 namespace PXI {
 
-std::array<uint8_t, 16> GenerateAESKey(const std::array<uint8_t, 16>& key_x, const std::array<uint8_t, 16>& key_y) {
-    std::array<uint8_t, 16> key_gen_constant = { 0x1f, 0xf9, 0xe9, 0xaa, 0xc5, 0xfe, 0x04, 0x08, 0x02, 0x45, 0x91, 0xdc, 0x5d, 0x52, 0x76, 0x8a };
-
-    std::array<uint8_t, 16> key = key_x;
-
-    // ROL 2
-    for (unsigned i = 0, overflow = (key[0] >> 6); i < key.size(); ++i) {
-        auto new_overflow = key[15 - i] >> 6;
-        key[15 - i] <<= 2;
-        key[15 - i] |= overflow;
-        overflow = new_overflow;
-    }
-
-    std::transform(key.begin(), key.end(), key_y.begin(), key.begin(), std::bit_xor<>{}); // (X ROL 2) XOR Y
-
-    // Add constant
-    for (int i = key.size() - 1, carry = 0; i >= 0; --i) {
-        auto result = uint16_t { key[i] } + key_gen_constant[i] + carry;
-        key[i] = static_cast<uint8_t>(result);
-        carry = result >> 8;
-    }
-
-    // ... ROR 41 == ROL 88 and ROR 1
-    std::rotate(key.begin(), key.begin() + 11, key.end());
-    for (unsigned i = 0, overflow = (key.back() & 1); i < key.size(); ++i) {
-        auto new_overflow = key[i] & 1;
-        key[i] >>= 1;
-        key[i] |= overflow << 7;
-        overflow = new_overflow;
-    }
-
-    return key;
-}
-
 using PAddr = OS::PAddr;
 using Thread = OS::Thread;
 
@@ -82,15 +49,14 @@ DataType PXIBuffer::Read(Thread& thread, uint32_t offset) const {
     if (offset != (offset & uint32_t{~uint32_t{sizeof(DataType) - 1}}))
         throw std::runtime_error("Improper address alignment: Might cross the page boundary");
 
-    auto& process = thread.GetParentProcess();
     auto address = LookupAddress(thread, offset);
 
     if (std::is_same<DataType, uint8_t>::value)
-        return process.ReadPhysicalMemory(address);
+        return thread.ReadPhysicalMemory(address);
     else if (std::is_same<DataType, uint32_t>::value)
-        return process.ReadPhysicalMemory32(address);
+        return thread.ReadPhysicalMemory32(address);
     else if (std::is_same<DataType, uint64_t>::value)
-        return uint64_t{process.ReadPhysicalMemory32(address)} | (uint64_t{process.ReadPhysicalMemory32(address + 4)} << uint64_t{32});
+        return uint64_t{thread.ReadPhysicalMemory32(address)} | (uint64_t{thread.ReadPhysicalMemory32(address + 4)} << uint64_t{32});
     // TODO: Other sizes...
 }
 
@@ -105,15 +71,14 @@ void PXIBuffer::Write(Thread& thread, uint32_t offset, DataType value) const {
     if (offset != (offset & uint32_t{~uint32_t{sizeof(DataType) - 1}}))
         throw std::runtime_error("Improper address alignment: Might cross the page boundary");
 
-    auto& process = thread.GetParentProcess();
     auto address = LookupAddress(thread, offset);
     if (std::is_same<DataType, uint8_t>::value)
-        return process.WritePhysicalMemory(address, value);
+        return thread.WritePhysicalMemory(address, value);
     else if (std::is_same<DataType, uint32_t>::value)
-        return process.WritePhysicalMemory32(address, value);
+        return thread.WritePhysicalMemory32(address, value);
     else if (std::is_same<DataType, uint64_t>::value) {
-        process.WritePhysicalMemory32(address + 0, value & 0xFFFFFFFF);
-        process.WritePhysicalMemory32(address + 4, value >> 32);
+        thread.WritePhysicalMemory32(address + 0, value & 0xFFFFFFFF);
+        thread.WritePhysicalMemory32(address + 4, value >> 32);
         return;
     }
     // TODO: Other sizes...
@@ -400,12 +365,10 @@ std::unique_ptr<File> NCCHOpenExeFSSection(spdlog::logger& logger, FileContext&
             throw Mikage::Exceptions::Invalid("Invalid NCCH encryption method");
         }
 
-        const std::array<uint8_t, 16>& key_x_0x25 = keydb.aes_slots[0x25].x.value();
-        const std::array<uint8_t, 16>& key_x_0x2c = keydb.aes_slots[0x2c].x.value();
         std::array<uint8_t, 16> key_y;
         memcpy(key_y.data(), &ncch_header, sizeof(key_y));
-        keys[0] = GenerateAESKey(key_x_0x2c, key_y);
-        keys[1] = GenerateAESKey(key_x_0x25, key_y);
+        keys[0] = keydb.GetNormalKey(0x2c, key_y);
+        keys[1] = keydb.GetNormalKey(0x25, key_y);
 
         // First 8 bytes are the partition id interpreted as big-endian
         // TODO: Should be version dependent? version==1 has different behavior, apparently
@@ -723,6 +686,10 @@ static std::tuple<Result,uint32_t> ReadFile(FakeThread& thread, Context& context
 
     FileContext file_context { *thread.GetLogger() };
     auto result_and_bytesread = file->Read(file_context, offset, num_bytes, FileBufferInEmulatedMemory { thread, dest });
+    if (thread.GetOS().settings.get<Settings::UseNativeFS>()) {
+        // Reads through the emulated FS module are already counted by FakeFS
+        thread.GetOS().counters.fs_bytes_read.Add(std::get<1>(result_and_bytesread));
+    }
     if (std::get<0>(result_and_bytesread) != RESULT_OK /*|| std::get<1>(result_and_bytesread) != num_bytes*/ /* TODO: TESTING ONLY: Works around lack of promo video */)
         thread.CallSVC(&OSImpl::SVCBreak, OSImpl::BreakReason::Panic);
 
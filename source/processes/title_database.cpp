@@ -0,0 +1,385 @@
+#include "title_database.hpp"
+#include "pxi.hpp"
+#include "pxi_fs.hpp"
+
+#include <framework/formats.hpp>
+
+#include <boost/interprocess/file_mapping.hpp>
+
+#include <spdlog/logger.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+
+namespace HLE {
+
+namespace PXI {
+
+namespace {
+
+struct IndexHeader {
+    std::array<char, 4> magic;
+    uint32_t version;
+    uint32_t num_groups;
+    uint32_t num_records;
+};
+
+struct IndexGroup {
+    uint32_t title_id_high;
+    uint32_t padding;
+    int64_t mtime;
+};
+
+constexpr std::array<char, 4> index_magic = { 'M', 'T', 'D', 'B' };
+
+// Bump this when changing the layout of any of the structures above or of TitleDatabase::Record
+constexpr uint32_t index_version = 2;
+
+int64_t GetModificationTime(const std::filesystem::path& path) {
+    return std::filesystem::last_write_time(path).time_since_epoch().count();
+}
+
+std::optional<uint32_t> ParseTitleIdPart(const std::string& filename) {
+    // Expect an 8-digit zero-padded hexadecimal number
+    if (filename.size() != 8) {
+        return std::nullopt;
+    }
+
+    uint32_t title_id_word = 0;
+    auto result = std::from_chars(filename.data(), filename.data() + 8, title_id_word, 16);
+    if (result.ptr != filename.data() + 8) {
+        return std::nullopt;
+    }
+    return title_id_word;
+}
+
+} // anonymous namespace
+
+TitleDatabase::TitleDatabase(spdlog::logger& logger, std::filesystem::path root_dir, const KeyDatabase& keydb)
+    : logger(logger), root_dir(std::move(root_dir)), keydb(keydb) {
+    Load();
+    Refresh();
+    if (dirty) {
+        Save();
+    }
+}
+
+std::filesystem::path TitleDatabase::GetIndexPath() const {
+    return root_dir / "titles.idx";
+}
+
+std::filesystem::path TitleDatabase::GetContentPath(const std::filesystem::path& root_dir, uint64_t title_id, uint32_t content_id) {
+    return root_dir / fmt::format("{:08x}/{:08x}/content/{:08x}.cxi", title_id >> 32, title_id & 0xFFFFFFFF, content_id);
+}
+
+void TitleDatabase::Load() {
+    auto index_path = GetIndexPath();
+    if (!std::filesystem::exists(index_path)) {
+        return;
+    }
+
+    try {
+        namespace bip = boost::interprocess;
+        bip::file_mapping file(index_path.string().c_str(), bip::read_only);
+        bip::mapped_region region(file, bip::read_only);
+
+        auto data = static_cast<const char*>(region.get_address());
+        auto size = region.get_size();
+        if (size < sizeof(IndexHeader)) {
+            throw std::runtime_error("Truncated header");
+        }
+
+        IndexHeader header;
+        memcpy(&header, data, sizeof(header));
+        if (header.magic != index_magic || header.version != index_version) {
+            throw std::runtime_error("Unrecognized format version");
+        }
+        if (size != sizeof(IndexHeader) + header.num_groups * sizeof(IndexGroup) + header.num_records * sizeof(Record)) {
+            throw std::runtime_error("Unexpected file size");
+        }
+
+        auto groups = reinterpret_cast<const IndexGroup*>(data + sizeof(IndexHeader));
+        for (uint32_t group_index = 0; group_index < header.num_groups; ++group_index) {
+            group_mtimes[groups[group_index].title_id_high] = groups[group_index].mtime;
+        }
+
+        // Record data is accessed in-place. The layout guarantees proper alignment
+        static_assert(sizeof(IndexHeader) % alignof(Record) == 0);
+        static_assert(sizeof(IndexGroup) % alignof(Record) == 0);
+        auto mapped_records = reinterpret_cast<const Record*>(groups + header.num_groups);
+        for (uint32_t record_index = 0; record_index < header.num_records; ++record_index) {
+            records[mapped_records[record_index].title_id] = &mapped_records[record_index];
+        }
+
+        mapped_index = std::move(region);
+    } catch (std::exception& err) {
+        logger.warn("Discarding title index {}: {}", index_path.string(), err.what());
+        group_mtimes.clear();
+        records.clear();
+        dirty = true;
+    }
+}
+
+void TitleDatabase::Refresh() {
+    std::map<uint32_t, int64_t> current_group_mtimes;
+    for (const auto& dir : std::filesystem::directory_iterator(root_dir)) {
+        if (auto title_id_high = ParseTitleIdPart(dir.path().filename().string()); title_id_high && dir.is_directory()) {
+            current_group_mtimes[*title_id_high] = GetModificationTime(dir.path());
+        }
+    }
+
+    // Drop titles from groups that have been removed
+    for (auto it = records.begin(); it != records.end();) {
+        if (!current_group_mtimes.contains(it->first >> 32)) {
+            it = records.erase(it);
+            dirty = true;
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto& [title_id_high, mtime] : current_group_mtimes) {
+        auto group_it = group_mtimes.find(title_id_high);
+        if (group_it != group_mtimes.end() && group_it->second == mtime) {
+            continue;
+        }
+
+        // Titles were added to or removed from this group, so rescan it
+        logger.info("Rescanning titles in {}", (root_dir / fmt::format("{:08x}", title_id_high)).string());
+        std::vector<uint64_t> title_ids;
+        for (const auto& subdir : std::filesystem::directory_iterator(root_dir / fmt::format("{:08x}", title_id_high))) {
+            if (auto title_id_low = ParseTitleIdPart(subdir.path().filename().string())) {
+                title_ids.push_back((uint64_t { title_id_high } << 32) | *title_id_low);
+            }
+        }
+
+        auto group_begin = records.lower_bound(uint64_t { title_id_high } << 32);
+        auto group_end = records.lower_bound(uint64_t { title_id_high + 1ull } << 32);
+        for (auto it = group_begin; it != group_end;) {
+            if (std::find(title_ids.begin(), title_ids.end(), it->first) == title_ids.end()) {
+                it = records.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        for (auto title_id : title_ids) {
+            if (!records.contains(title_id)) {
+                UpdateTitle(title_id);
+            }
+        }
+
+        group_mtimes[title_id_high] = mtime;
+        dirty = true;
+    }
+    std::erase_if(group_mtimes, [&](auto& group) { return !current_group_mtimes.contains(group.first); });
+
+    // Titles may have been reinstalled in-place, so validate each record against its main content.
+    // Titles that are found but lack a main content are still indexed, so only check existing content files
+    std::vector<uint64_t> stale_titles;
+    for (auto& [title_id, record] : records) {
+        std::error_code ec;
+        auto path = GetContentPath(root_dir, title_id, 0);
+        auto size = std::filesystem::file_size(path, ec);
+        if (ec) {
+            if (record->content_size != 0) {
+                stale_titles.push_back(title_id);
+            }
+            continue;
+        }
+        if (size != record->content_size || GetModificationTime(path) != record->content_mtime) {
+            stale_titles.push_back(title_id);
+        }
+    }
+    for (auto title_id : stale_titles) {
+        UpdateTitle(title_id);
+    }
+}
+
+void TitleDatabase::UpdateTitle(uint64_t title_id) {
+    dirty = true;
+
+    if (!std::filesystem::exists(root_dir / fmt::format("{:08x}/{:08x}", title_id >> 32, title_id & 0xFFFFFFFF))) {
+        records.erase(title_id);
+        return;
+    }
+
+    auto& record = updated_records.emplace_back();
+    memset(&record, 0, sizeof(record));
+    record.title_id = title_id;
+    if (auto old_record = Find(title_id)) {
+        // Retain TMD information, since it can't be recovered from the content
+        record.title_version = old_record->title_version;
+        record.num_contents = old_record->num_contents;
+        record.total_content_size = old_record->total_content_size;
+    }
+    records[title_id] = &record;
+
+    auto path = GetContentPath(root_dir, title_id, 0);
+    if (!std::filesystem::exists(path)) {
+        return;
+    }
+
+    if (!record.total_content_size) {
+        // Without a TMD, approximate the total size using the content files on disk
+        for (const auto& entry : std::filesystem::directory_iterator(path.parent_path())) {
+            if (entry.is_regular_file() && entry.path().extension() == ".cxi") {
+                record.total_content_size += entry.file_size();
+            }
+        }
+    }
+
+    record.content_size = std::filesystem::file_size(path);
+    record.content_mtime = GetModificationTime(path);
+
+    try {
+        FS::FileContext file_context { logger };
+        FS::HostFile file(path.string(), FS::HostFile::Default);
+        auto exheader = PXI::GetExtendedHeader(file_context, keydb, file);
+        auto exheader_ptr = reinterpret_cast<char*>(record.exheader.data());
+        FileFormat::SerializationInterface<FileFormat::ExHeader>::Save(exheader, [&exheader_ptr](char* data, size_t size) {
+            memcpy(exheader_ptr, data, size);
+            exheader_ptr += size;
+        });
+        record.has_exheader = true;
+    } catch (std::exception& err) {
+        logger.warn("Failed to read extended header of title {:#018x}: {}", title_id, err.what());
+    }
+
+    try {
+        std::ifstream file(path, std::ios::binary);
+        file.exceptions(std::ifstream::badbit | std::ifstream::failbit | std::ifstream::eofbit);
+        auto reader = [&file](char* dest, size_t size) { file.read(dest, size); };
+
+        auto ncch_header = FileFormat::SerializationInterface<FileFormat::NCCHHeader>::Load(reader);
+
+        // Only look for icons in unencrypted ExeFS
+        if ((ncch_header.flags & 4) && ncch_header.exefs_size.ToBytes() != 0) {
+            auto exefs_begin = ncch_header.exefs_offset.ToBytes();
+            file.seekg(exefs_begin);
+            auto exefs_header = FileFormat::SerializationInterface<FileFormat::ExeFSHeader>::Load(reader);
+            for (auto& section : exefs_header.files) {
+                if (memcmp(section.name.data(), "icon\0\0\0", section.name.size()) != 0) {
+                    continue;
+                }
+
+                record.icon_size = std::min<uint32_t>(section.size_bytes, record.icon.size());
+                file.seekg(exefs_begin + FileFormat::ExeFSHeader::Tags::expected_serialized_size + section.offset);
+                file.read(reinterpret_cast<char*>(record.icon.data()), record.icon_size);
+                break;
+            }
+        }
+    } catch (std::exception& err) {
+        logger.warn("Failed to read icon of title {:#018x}: {}", title_id, err.what());
+        record.icon_size = 0;
+    }
+}
+
+void TitleDatabase::Save() {
+    IndexHeader header { index_magic, index_version, static_cast<uint32_t>(group_mtimes.size()), static_cast<uint32_t>(records.size()) };
+
+    auto index_path = GetIndexPath();
+    auto temp_path = index_path;
+    temp_path += ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (auto& [title_id_high, mtime] : group_mtimes) {
+            IndexGroup group { title_id_high, 0, mtime };
+            file.write(reinterpret_cast<const char*>(&group), sizeof(group));
+        }
+        for (auto& [title_id, record] : records) {
+            file.write(reinterpret_cast<const char*>(record), sizeof(*record));
+        }
+        if (!file) {
+            logger.warn("Failed to write title index {}", temp_path.string());
+            return;
+        }
+    }
+
+    // Move records out of the old mapping before replacing the file it refers to
+    if (mapped_index.get_address()) {
+        for (auto& [title_id, record] : records) {
+            if (record >= static_cast<const Record*>(mapped_index.get_address()) &&
+                reinterpret_cast<const char*>(record) < static_cast<const char*>(mapped_index.get_address()) + mapped_index.get_size()) {
+                record = &updated_records.emplace_back(*record);
+            }
+        }
+        mapped_index = {};
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp_path, index_path, ec);
+    if (ec) {
+        logger.warn("Failed to replace title index {}: {}", index_path.string(), ec.message());
+        return;
+    }
+    dirty = false;
+}
+
+std::vector<uint64_t> TitleDatabase::GetTitleIds() const {
+    std::vector<uint64_t> ret;
+    ret.reserve(records.size());
+    for (auto& record : records) {
+        ret.push_back(record.first);
+    }
+    return ret;
+}
+
+const TitleDatabase::Record* TitleDatabase::Find(uint64_t title_id) const {
+    auto it = records.find(title_id);
+    return (it == records.end()) ? nullptr : it->second;
+}
+
+std::optional<FileFormat::ExHeader> TitleDatabase::GetExtendedHeader(uint64_t title_id) const {
+    auto record = Find(title_id);
+    if (!record || !record->has_exheader) {
+        return std::nullopt;
+    }
+
+    auto exheader_ptr = reinterpret_cast<const char*>(record->exheader.data());
+    return FileFormat::SerializationInterface<FileFormat::ExHeader>::Load([&exheader_ptr](char* dest, size_t size) {
+        memcpy(dest, exheader_ptr, size);
+        exheader_ptr += size;
+    });
+}
+
+void TitleDatabase::OnTitleInstalled(uint64_t title_id, uint16_t title_version, uint16_t num_contents, uint64_t total_content_size) {
+    UpdateTitle(title_id);
+
+    if (auto record = Find(title_id)) {
+        // UpdateTitle always creates a new record, so it's safe to modify it
+        auto& updated_record = const_cast<Record&>(*record);
+        updated_record.title_version = title_version;
+        updated_record.num_contents = num_contents;
+        updated_record.total_content_size = total_content_size;
+    }
+
+    // The group directory was modified by the installation, but there's no need to rescan it
+    if (auto group_path = root_dir / fmt::format("{:08x}", title_id >> 32); std::filesystem::exists(group_path)) {
+        group_mtimes[title_id >> 32] = GetModificationTime(group_path);
+    }
+
+    Save();
+}
+
+void TitleDatabase::OnTitleRemoved(uint64_t title_id) {
+    records.erase(title_id);
+
+    if (auto group_path = root_dir / fmt::format("{:08x}", title_id >> 32); std::filesystem::exists(group_path)) {
+        group_mtimes[title_id >> 32] = GetModificationTime(group_path);
+    } else {
+        group_mtimes.erase(title_id >> 32);
+    }
+
+    dirty = true;
+    Save();
+}
+
+} // namespace PXI
+
+} // namespace HLE
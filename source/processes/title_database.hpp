@@ -0,0 +1,129 @@
+#pragma once
+
+#include <platform/file_formats/ncch.hpp>
+
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <vector>
+
+namespace spdlog {
+class logger;
+}
+
+struct KeyDatabase;
+
+namespace HLE {
+
+namespace PXI {
+
+/**
+ * Persistent index of titles installed to the emulated NAND.
+ *
+ * Looking up installed titles otherwise requires walking the NAND directory
+ * tree and parsing (and possibly decrypting) NCCH headers every time. The
+ * index caches this data in a file next to the installed titles, which is
+ * memory-mapped on startup.
+ *
+ * Title ID groups (i.e. directories for each title ID high word) are only
+ * rescanned if their modification time changed, and records are validated
+ * against size and modification time of their main content. The index hence
+ * stays valid even if titles are added or removed externally.
+ */
+class TitleDatabase {
+public:
+    struct Record {
+        uint64_t title_id;
+
+        // Size and modification time of the main content, used to detect stale records
+        uint64_t content_size;
+        int64_t content_mtime;
+
+        // Combined size of all contents. Taken from the TMD for titles installed from CIAs
+        uint64_t total_content_size;
+
+        // Taken from the TMD; only known for titles installed from CIAs (0 otherwise)
+        uint16_t title_version;
+        uint16_t num_contents;
+
+        // Size of the SMDH data in icon; 0 if the ExeFS has no unencrypted icon
+        uint16_t icon_size;
+
+        // Non-zero if exheader holds valid data
+        uint16_t has_exheader;
+
+        // Decrypted extended header
+        std::array<uint8_t, FileFormat::ExHeader::Tags::expected_serialized_size> exheader;
+
+        // SMDH data from the ExeFS "icon" section
+        std::array<uint8_t, 0x36c0> icon;
+    };
+    static_assert(std::is_trivially_copyable_v<Record>);
+
+private:
+    spdlog::logger& logger;
+    std::filesystem::path root_dir;
+    const KeyDatabase& keydb;
+
+    // Index file as loaded on startup. Unchanged records point into this mapping
+    boost::interprocess::mapped_region mapped_index;
+
+    // Storage for records created or updated after loading the index file
+    std::deque<Record> updated_records;
+
+    // Sorted by title ID
+    std::map<uint64_t, const Record*> records;
+
+    // Modification times of the directories of each title ID group, indexed by the upper title ID word
+    std::map<uint32_t, int64_t> group_mtimes;
+
+    bool dirty = false;
+
+    std::filesystem::path GetIndexPath() const;
+
+    void Load();
+
+    // Rescans changed title ID groups and revalidates all records
+    void Refresh();
+
+    // Reparses the main content of the given title, or removes it from the index if it doesn't exist
+    void UpdateTitle(uint64_t title_id);
+
+    void Save();
+
+public:
+    /**
+     * Loads the index from the given data directory and refreshes it. The
+     * index file is updated if any changes were detected.
+     */
+    TitleDatabase(spdlog::logger&, std::filesystem::path root_dir, const KeyDatabase&);
+
+    // Returns the IDs of all indexed titles, in ascending order
+    std::vector<uint64_t> GetTitleIds() const;
+
+    // Returns nullptr if the title is not installed
+    const Record* Find(uint64_t title_id) const;
+
+    // Returns std::nullopt if the title is not installed or if its extended header couldn't be read
+    std::optional<FileFormat::ExHeader> GetExtendedHeader(uint64_t title_id) const;
+
+    static std::filesystem::path GetContentPath(const std::filesystem::path& root_dir, uint64_t title_id, uint32_t content_id);
+
+    /**
+     * Updates the index after the contents of the given title have been
+     * written to the data directory, and records the given TMD information.
+     */
+    void OnTitleInstalled(uint64_t title_id, uint16_t title_version, uint16_t num_contents, uint64_t total_content_size);
+
+    // Updates the index after the given title was removed from the data directory
+    void OnTitleRemoved(uint64_t title_id);
+};
+
+} // namespace PXI
+
+} // namespace HLE
@@ -13,6 +13,13 @@
 
 #include <spdlog/spdlog.h>
 
+#if ENABLE_PISTACHE
+#include "debug/metrics.hpp"
+#include "debug/os.hpp"
+#endif
+
+#include <filesystem>
+#include <fstream>
 #include <memory>
 
 std::unique_ptr<Loader::GameCard> LoadGameCard(spdlog::logger& logger, Settings::Settings& settings) {
@@ -62,6 +69,17 @@ std::unique_ptr<Loader::GameCard> LoadGameCard(spdlog::logger& logger, Settings:
     return gamecard;
 }
 
+static void WriteMetricsFile(const std::string& filename, Profiler::MetricsReporter& reporter) {
+    // Write to a temporary file first so that readers never observe partial output
+    auto temp_filename = filename + ".tmp";
+    {
+        std::ofstream file(temp_filename, std::ios_base::trunc);
+        file << reporter.Report("file");
+    }
+    std::error_code error;
+    std::filesystem::rename(temp_filename, filename, error);
+}
+
 EmuSession::EmuSession( LogManager& log_manager, Settings::Settings& settings,
                         AudioFrontend& audio, VulkanDeviceManager& vulkan_device_manager,
                         EmuDisplay::EmuDisplay& display, const KeyDatabase& keydb,
@@ -75,7 +93,7 @@ EmuSession::EmuSession( LogManager& log_manager, Settings::Settings& settings,
     setup->mem.InjectDependency(audio);
 
     std::unique_ptr<ConsoleModule> os_module;
-    std::tie(setup->os, os_module) = HLE::OS::OS::Create(settings, *setup, log_manager, profiler, audio, pica, display);
+    std::tie(setup->os, os_module) = HLE::OS::OS::Create(settings, *setup, log_manager, profiler, audio, pica, display, input);
     for (auto& cpu : setup->cpus)
         cpu.os = setup->os.get();
     setup->os->Initialize();
@@ -86,6 +104,22 @@ EmuSession::EmuSession( LogManager& log_manager, Settings::Settings& settings,
 
     setup->mem.InjectDependency(input);
 
+    metrics_reporter.AddRate("emulated_fps", "os.vblanks");
+    metrics_reporter.AddRatio("scheduler_idle", "os.scheduler.idle_ticks", "os.system_ticks");
+    metrics_reporter.AddRatio("shader_cache_hits", "gpu.shader_cache.hits", "gpu.shader_cache.lookups");
+    metrics_reporter.AddRatio("pipeline_cache_hits", "gpu.pipeline_cache.hits", "gpu.pipeline_cache.lookups");
+
+    if (auto metrics_filename = settings.get<Settings::MetricsDumpFile>(); !metrics_filename.empty()) {
+        metrics_dump_thread = std::thread { [this, metrics_filename]() {
+            std::unique_lock lock(metrics_dump_mutex);
+            while (!metrics_dump_cv.wait_for(lock, std::chrono::seconds { 1 }, [this]() { return metrics_dump_stop; })) {
+                WriteMetricsFile(metrics_filename, metrics_reporter);
+            }
+            // Write final metrics on exit
+            WriteMetricsFile(metrics_filename, metrics_reporter);
+        } };
+    }
+
     // TODO: Check if we can enable this on Android, too
     network_console = std::make_unique<NetworkConsole>(12347);
     console_thread = std::thread { [os_module=std::move(os_module), &console=*network_console]() mutable {
@@ -94,6 +128,11 @@ EmuSession::EmuSession( LogManager& log_manager, Settings::Settings& settings,
     } };
 
 #if ENABLE_PISTACHE
+    debug_server.GetService<Debugger::MetricsService>().RegisterReporter(metrics_reporter);
+    if (setup->os->ipc_statistics) {
+        debug_server.GetService<Debugger::OSService>().RegisterIPCStatistics(*setup->os->ipc_statistics);
+    }
+
     std::thread debug_server_thread([&]() {
         try {
             debug_server.Run(3001);
@@ -113,6 +152,20 @@ EmuSession::~EmuSession() {
     network_console->Stop();
     console_thread.join();
 
+    if (metrics_dump_thread.joinable()) {
+        {
+            std::lock_guard lock(metrics_dump_mutex);
+            metrics_dump_stop = true;
+        }
+        metrics_dump_cv.notify_one();
+        metrics_dump_thread.join();
+    }
+
+#if ENABLE_PISTACHE
+    debug_server.GetService<Debugger::MetricsService>().Shutdown();
+    debug_server.GetService<Debugger::OSService>().Shutdown();
+#endif
+
     // TODO: Shut down debug_server
 }
 
@@ -7,8 +7,11 @@
 
 #include <vulkan_utils/device_manager.hpp>
 
+#include <framework/metrics.hpp>
 #include <framework/profiler.hpp>
 
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 
 struct AudioFrontend;
@@ -23,6 +26,7 @@ struct KeyDatabase;
 
 struct EmuSession {
     Profiler::Profiler profiler;
+    Profiler::MetricsReporter metrics_reporter { profiler };
     Debugger::DebugServer debug_server;
 
     // TODO: Does this still need to be a shared_ptr?
@@ -39,6 +43,12 @@ struct EmuSession {
     std::unique_ptr<NetworkConsole> network_console;
     std::thread console_thread;
 
+    // Periodically writes metrics_reporter output to Settings::MetricsDumpFile
+    std::thread metrics_dump_thread;
+    std::mutex metrics_dump_mutex;
+    std::condition_variable metrics_dump_cv;
+    bool metrics_dump_stop = false;
+
     EmuSession( LogManager&, Settings::Settings&,
                 AudioFrontend&, VulkanDeviceManager&, EmuDisplay::EmuDisplay&,
                 const KeyDatabase&, std::unique_ptr<Loader::GameCard>);
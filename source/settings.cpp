@@ -21,6 +21,9 @@ namespace Config {
 template<>
 bool BooleanOption<Settings::BootToHomeMenu>::default_val = false;
 
+template<>
+bool BooleanOption<Settings::FastBoot>::default_val = false;
+
 
 template<>
 bool BooleanOption<Settings::UseNativeHID>::default_val = false;
@@ -50,4 +53,13 @@ Settings::ShaderEngine OptionDefault<Settings::ShaderEngine>::default_val = Sett
 template<>
 bool BooleanOption<Settings::EnableAudioEmulation>::default_val = false;
 
+template<>
+bool BooleanOption<Settings::EnableCycleAccounting>::default_val = false;
+
+template<>
+unsigned IntegralOption<unsigned, Settings::GuestProfileInterval>::default_val = 10000;
+
+template<>
+bool BooleanOption<Settings::DeterministicExecution>::default_val = false;
+
 } // namespace Config
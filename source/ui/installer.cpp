@@ -1,8 +1,10 @@
 #include <processes/pxi_fs.hpp>
+#include <processes/title_database.hpp>
 
 #include <platform/file_formats/cia.hpp>
 #include <platform/crypto.hpp>
 
+#include <framework/bounded_queue.hpp>
 #include <framework/exceptions.hpp>
 #include <framework/formats.hpp>
 #include <framework/ranges.hpp>
@@ -12,14 +14,18 @@
 #include <cryptopp/osrng.h>
 #include <cryptopp/rsa.h>
 
+#include <range/v3/algorithm/any_of.hpp>
 #include <range/v3/algorithm/equal.hpp>
 #include <range/v3/view/zip.hpp>
 
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
-
-namespace HLE::PXI {
-std::array<uint8_t, 16> GenerateAESKey(const std::array<uint8_t, 16>& key_x, const std::array<uint8_t, 16>& key_y);
-}
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
 
 template<typename T, typename SubType, typename Stream>
 T ParseSignedData(Stream& reader) {
@@ -57,12 +63,154 @@ struct CIA {
     FileFormat::Ticket ticket;
     FileFormat::TMD tmd;
 
-    std::vector<std::vector<uint8_t>> contents;
-
     FileFormat::CIAMeta meta;
 };
 
-void InstallCIA(std::filesystem::path content_dir, spdlog::logger& logger, const KeyDatabase& keydb, HLE::PXI::FS::FileContext& file_context, HLE::PXI::FS::File& file) {
+struct ContentInstallJob {
+    const FileFormat::TMD::ContentInfo& content_info;
+
+    // Offset of the content within the CIA
+    uint64_t offset;
+
+    // Location to write the content to until its hash was verified
+    std::filesystem::path temp_path;
+};
+
+// Contents are streamed in chunks of this size; must be a multiple of the AES block size
+static constexpr uint32_t install_chunk_size = 1024 * 1024;
+static_assert(install_chunk_size % CryptoPP::AES::BLOCKSIZE == 0);
+
+// Number of chunks each content pipeline may keep in memory at once
+static constexpr size_t install_chunks_in_flight = 4;
+
+static constexpr size_t max_concurrent_contents = 4;
+
+/**
+ * Streams the given content from the CIA to its temporary output file,
+ * decrypting and hashing it on the way.
+ *
+ * Reading, decryption/hashing, and writing are run on separate threads,
+ * passing a fixed set of chunk buffers between each other. Peak memory usage
+ * is hence bounded regardless of content size.
+ *
+ * @param file_mutex Mutex guarding accesses to file and file_context
+ * @param title_key Decrypted title key, if any contents are encrypted
+ */
+static void InstallContent(spdlog::logger& logger, std::mutex& file_mutex, HLE::PXI::FS::FileContext& file_context,
+                           HLE::PXI::FS::File& file, const ContentInstallJob& job,
+                           const std::optional<std::array<uint8_t, 16>>& title_key) {
+    const auto& content_info = job.content_info;
+
+    struct Chunk {
+        std::vector<uint8_t> data;
+        uint32_t size = 0;
+    };
+
+    Mikage::BoundedQueue<Chunk> free_chunks(install_chunks_in_flight);
+    Mikage::BoundedQueue<Chunk> read_chunks(install_chunks_in_flight);
+    Mikage::BoundedQueue<Chunk> processed_chunks(install_chunks_in_flight);
+    for (size_t i = 0; i < install_chunks_in_flight; ++i) {
+        free_chunks.Push(Chunk { std::vector<uint8_t>(install_chunk_size) });
+    }
+
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto abort = [&](std::exception_ptr exception) {
+        {
+            std::lock_guard guard(error_mutex);
+            if (!error) {
+                error = exception;
+            }
+        }
+        free_chunks.Close();
+        read_chunks.Close();
+        processed_chunks.Close();
+    };
+
+    CryptoPP::SHA256 hash;
+    std::optional<CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption> dec;
+    if (content_info.type & 1) {
+        // IV is the content index encoded as big-endian
+        std::array<uint8_t, 0x10> iv {};
+        memcpy(iv.data(), &content_info.index, sizeof(content_info.index));
+        std::reverse(iv.begin(), iv.begin() + sizeof(content_info.index));
+        dec.emplace().SetKeyWithIV(title_key.value().data(), title_key->size(), iv.data());
+    }
+
+    std::jthread processor([&]() {
+        try {
+            while (auto chunk = read_chunks.Pop()) {
+                // The CBC decryptor retains its chaining state across calls,
+                // so chunks may be processed independently
+                if (dec) {
+                    dec->ProcessData(chunk->data.data(), chunk->data.data(), chunk->size);
+                }
+                hash.Update(chunk->data.data(), chunk->size);
+                if (!processed_chunks.Push(std::move(*chunk))) {
+                    return;
+                }
+            }
+            processed_chunks.Close();
+        } catch (...) {
+            abort(std::current_exception());
+        }
+    });
+
+    std::jthread writer([&]() {
+        try {
+            std::ofstream out_file(job.temp_path, std::ios::binary | std::ios::trunc);
+            while (auto chunk = processed_chunks.Pop()) {
+                out_file.write(reinterpret_cast<const char*>(chunk->data.data()), chunk->size);
+                if (!out_file) {
+                    throw std::runtime_error(fmt::format("Failed to write {}", job.temp_path.string()));
+                }
+                free_chunks.Push(std::move(*chunk));
+            }
+        } catch (...) {
+            abort(std::current_exception());
+        }
+    });
+
+    try {
+        for (uint64_t content_offset = 0; content_offset < content_info.size;) {
+            auto chunk = free_chunks.Pop();
+            if (!chunk) {
+                break;
+            }
+            chunk->size = static_cast<uint32_t>(std::min<uint64_t>(install_chunk_size, content_info.size - content_offset));
+            {
+                std::lock_guard guard(file_mutex);
+                file.Read(file_context, job.offset + content_offset, chunk->size, HLE::PXI::FS::FileBufferInHostMemory { chunk->data.data(), chunk->size });
+            }
+            content_offset += chunk->size;
+            if (!read_chunks.Push(std::move(*chunk))) {
+                break;
+            }
+        }
+        read_chunks.Close();
+    } catch (...) {
+        abort(std::current_exception());
+    }
+
+    processor.join();
+    writer.join();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    CryptoPP::byte content_hash[CryptoPP::SHA256::DIGESTSIZE];
+    hash.Final(content_hash);
+
+    logger.info("  Content {:08x}:", content_info.id);
+    logger.info("    Reference content hash: {:02x}", fmt::join(content_info.sha256, ""));
+    logger.info("    Computed content hash:  {:02x}", fmt::join(content_hash, ""));
+
+    if (!ranges::equal(content_info.sha256, content_hash)) {
+        throw std::runtime_error("Content hash doesn't match TMD");
+    }
+}
+
+void InstallCIA(std::filesystem::path content_dir, spdlog::logger& logger, const KeyDatabase& keydb, HLE::PXI::TitleDatabase& title_database, HLE::PXI::FS::FileContext& file_context, HLE::PXI::FS::File& file) {
     auto cia_offset = uint64_t{0};
     auto read_file = [&](char* dest, size_t size) {
         file.Read(file_context, cia_offset, static_cast<uint32_t>(size), HLE::PXI::FS::FileBufferInHostMemory { dest, static_cast<uint32_t>(size) });
@@ -294,61 +442,90 @@ void InstallCIA(std::filesystem::path content_dir, spdlog::logger& logger, const
 
     // Content
     logger.info("Content:");
-    cia_offset = content_begin;
-
-    for (const auto& content_info : ret.tmd.content_infos) {
-        std::vector<uint8_t> ncch(content_info.size);
-        read_file(reinterpret_cast<char*>(ncch.data()), ncch.size());
 
-        if (content_info.type & 1) {
-            CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption dec;
+    // Check the content list before writing anything, so that unsupported
+    // titles don't leave behind partially installed contents
+    if (ret.tmd.data.main_content >= ret.tmd.content_infos.size()) {
+        throw Mikage::Exceptions::Invalid("Main content index {} out of range", ret.tmd.data.main_content);
+    }
+    std::set<uint32_t> content_ids;
+    for (size_t content_index = 0; content_index < ret.tmd.content_infos.size(); ++content_index) {
+        const auto content_id = ret.tmd.content_infos[content_index].id;
+        if (content_index != ret.tmd.data.main_content && content_id == 0) {
+            throw Mikage::Exceptions::NotImplemented("Content id 0 expected to be the main content");
+        }
+        if (!content_ids.insert(content_id).second) {
+            throw Mikage::Exceptions::Invalid("Duplicate content id {:#x}", content_id);
+        }
+    }
 
-            // Decrypt title key using common key
-            auto title_key = ret.ticket.data.title_key_encrypted;
-            {
-                const auto& common_key_x = keydb.aes_slots[0x3d].x.value();
-                const auto& common_key_y = keydb.common_y.at(ret.ticket.data.key_y_index).value();
-                auto common_key = HLE::PXI::GenerateAESKey(common_key_x, common_key_y);
-
-                // IV is the title ID encoded as big-endian
-                std::array<uint8_t, 0x10> iv {};
-                memcpy(iv.data(), &ret.ticket.data.title_id, sizeof(ret.ticket.data.title_id));
-                std::reverse(iv.begin(), iv.begin() + sizeof(ret.ticket.data.title_id));
-                dec.SetKeyWithIV(common_key.data(), sizeof(common_key), iv.data());
-                dec.ProcessData(reinterpret_cast<CryptoPP::byte*>(title_key.data()), reinterpret_cast<const CryptoPP::byte*>(title_key.data()), title_key.size());
-            }
+    uint32_t title_id_high = ret.ticket.data.title_id >> 32;
+    uint32_t title_id_low = ret.ticket.data.title_id & 0xffffffff;
+    content_dir /= fmt::format("{:08x}/{:08x}/content", title_id_high, title_id_low);
+    std::filesystem::create_directories(content_dir);
 
-            // Decrypt content using decrypted title key
-            {
-                // IV is the content ID encoded as big-endian
-                std::array<uint8_t, 0x10> iv {};
-                memcpy(iv.data(), &content_info.index, sizeof(content_info.index));
-                std::reverse(iv.begin(), iv.begin() + sizeof(content_info.index));
-                dec.SetKeyWithIV(title_key.data(), sizeof(title_key), iv.data());
-                dec.ProcessData(reinterpret_cast<CryptoPP::byte*>(ncch.data()), reinterpret_cast<const CryptoPP::byte*>(ncch.data()), ncch.size());
-            }
-        }
+    // Decrypt title key using common key
+    std::optional<std::array<uint8_t, 16>> title_key;
+    if (ranges::any_of(ret.tmd.content_infos, [](auto& content_info) { return (content_info.type & 1) != 0; })) {
+        title_key = ret.ticket.data.title_key_encrypted;
+
+        const auto& common_key_y = keydb.common_y.at(ret.ticket.data.key_y_index).value();
+        auto common_key = keydb.GetNormalKey(0x3d, common_key_y);
+
+        // IV is the title ID encoded as big-endian
+        std::array<uint8_t, 0x10> iv {};
+        memcpy(iv.data(), &ret.ticket.data.title_id, sizeof(ret.ticket.data.title_id));
+        std::reverse(iv.begin(), iv.begin() + sizeof(ret.ticket.data.title_id));
+        CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption dec;
+        dec.SetKeyWithIV(common_key.data(), sizeof(common_key), iv.data());
+        dec.ProcessData(title_key->data(), title_key->data(), title_key->size());
+    }
 
-        CryptoPP::byte content_hash[CryptoPP::SHA256::DIGESTSIZE];
-        CryptoPP::SHA256().CalculateDigest(content_hash,
-                                           reinterpret_cast<const CryptoPP::byte*>(ncch.data()), ncch.size());
+    // Contents are stored back-to-back, so their offsets are known upfront.
+    // This allows streaming multiple contents concurrently
+    std::vector<ContentInstallJob> jobs;
+    for (uint64_t offset = content_begin; const auto& content_info : ret.tmd.content_infos) {
+        jobs.push_back({ content_info, offset, content_dir / fmt::format("{:08x}.cxi.part", content_info.id) });
+        offset += content_info.size;
+    }
 
-        logger.info("  Reference content hash: {:02x}", fmt::join(content_info.sha256, ""));
-        logger.info("  Computed content hash:  {:02x}", fmt::join(content_hash, ""));
+    logger.info("Beginning install...\n");
 
-        if (!ranges::equal(content_info.sha256, content_hash)) {
-            throw std::runtime_error("Content hash doesn't match TMD");
+    std::mutex file_mutex;
+    std::atomic<size_t> next_job = 0;
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    auto install_worker = [&]() {
+        for (size_t job_index; (job_index = next_job++) < jobs.size();) {
+            try {
+                InstallContent(logger, file_mutex, file_context, file, jobs[job_index], title_key);
+            } catch (...) {
+                std::lock_guard guard(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                // Skip any remaining jobs
+                next_job = jobs.size();
+            }
         }
+    };
 
-        ret.contents.push_back(std::move(ncch));
+    // Each worker runs a three-stage pipeline, so only a few are needed to keep all cores busy
+    const auto num_workers = std::min({ std::max<size_t>(std::thread::hardware_concurrency() / 3, 1), max_concurrent_contents, jobs.size() });
+    {
+        std::vector<std::jthread> workers;
+        for (size_t i = 0; i < num_workers; ++i) {
+            workers.emplace_back(install_worker);
+        }
     }
 
-    logger.info("Beginning install...\n");
-
-    uint32_t title_id_high = ret.ticket.data.title_id >> 32;
-    uint32_t title_id_low = ret.ticket.data.title_id & 0xffffffff;
-    content_dir /= fmt::format("{:08x}/{:08x}/content", title_id_high, title_id_low);
-    std::filesystem::create_directories(content_dir);
+    if (error) {
+        for (auto& job : jobs) {
+            std::error_code ec;
+            std::filesystem::remove(job.temp_path, ec);
+        }
+        std::rethrow_exception(error);
+    }
 
 //    // TODO: Implement TMD writing
 //    {
@@ -356,25 +533,26 @@ void InstallCIA(std::filesystem::path content_dir, spdlog::logger& logger, const
 //        std::ofstream file(content_dir / fmt::format("{:x}.tmd", 0));
 //    }
 
-    for (auto content_index = 0; content_index < ret.contents.size(); ++content_index) {
-        const auto& ncch = ret.contents[content_index];
-        const auto& content_info = ret.tmd.content_infos.at(content_index);
-
-        std::ofstream out_file(content_dir / fmt::format("{:08x}.cxi", content_info.id));
-        out_file.write(reinterpret_cast<const char*>(ncch.data()), ncch.size());
+    // All contents were verified, so move them into place
+    for (size_t content_index = 0; content_index < jobs.size(); ++content_index) {
+        const auto& content_info = jobs[content_index].content_info;
+        std::filesystem::rename(jobs[content_index].temp_path, content_dir / fmt::format("{:08x}.cxi", content_info.id));
 
         // To simplify title launching, we always boot from 00000000.cxi currently.
         // Copy the main title to that location hence
         // TODO: Read TMD when launching titles instead
-        if (content_index == ret.tmd.data.main_content) {
-            if (content_info.id != 0) {
-                std::filesystem::copy(content_dir / fmt::format("{:08x}.cxi", content_info.id), content_dir / fmt::format("00000000.cxi"), std::filesystem::copy_options::overwrite_existing);
-            }
-        } else if (content_info.id == 0) {
-            throw Mikage::Exceptions::NotImplemented("Content id 0 expected to be the main content");
+        if (content_index == ret.tmd.data.main_content && content_info.id != 0) {
+            std::filesystem::copy(content_dir / fmt::format("{:08x}.cxi", content_info.id), content_dir / fmt::format("00000000.cxi"), std::filesystem::copy_options::overwrite_existing);
         }
     }
 
+    // Index the new title so that it's picked up without rescanning the data directory
+    uint64_t total_content_size = 0;
+    for (const auto& content_info : ret.tmd.content_infos) {
+        total_content_size += content_info.size;
+    }
+    title_database.OnTitleInstalled(ret.ticket.data.title_id, ret.tmd.data.title_version, ret.tmd.data.content_count, total_content_size);
+
     // TODO: If title id is native firm, extract its files...
 
 //    // Meta
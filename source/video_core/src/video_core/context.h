@@ -20,6 +20,7 @@ struct PhysicalMemory;
 
 namespace Profiler {
 class Activity;
+class Counter;
 }
 
 namespace Settings {
@@ -63,6 +64,10 @@ struct Context {
     Renderer* renderer = nullptr;
     Profiler::Activity* activity = nullptr;
 
+    // Statistics of the vertex shader engine cache (optional)
+    Profiler::Counter* shader_cache_lookups = nullptr;
+    Profiler::Counter* shader_cache_hits = nullptr;
+
     std::shared_ptr<spdlog::logger> logger;
 };
 
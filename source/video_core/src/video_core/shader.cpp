@@ -2,6 +2,7 @@
 #include "shader.hpp"
 
 #include <framework/exceptions.hpp>
+#include <framework/profiler.hpp>
 #include <framework/settings.hpp>
 
 #if ENABLE_PISTACHE
@@ -70,6 +71,12 @@ ShaderEngine& EnginePool::GetOrCompile(Context& context, Settings::ShaderEngine
     }
 
     auto engine_it = impl->engines.find(impl->shader_hash);
+    if (context.shader_cache_lookups) {
+        context.shader_cache_lookups->Add();
+        if (engine_it != impl->engines.end()) {
+            context.shader_cache_hits->Add();
+        }
+    }
     if (engine_it == impl->engines.end()) {
 #if ENABLE_PISTACHE
         // Register to debugger
@@ -20,7 +20,9 @@ std::size_t PipelineStateHashHasher::operator()(const PipelineStateHash& data) c
    return boost::hash_range(ptr, ptr + sizeof(data) / sizeof(uint32_t));
 }
 
-PipelineCache::PipelineCache(vk::Device device) : device(device) {
+PipelineCache::PipelineCache(vk::Device device, Profiler::Profiler& profiler)
+    : device(device), lookup_counter(profiler.GetCounter("gpu.pipeline_cache.lookups")),
+      hit_counter(profiler.GetCounter("gpu.pipeline_cache.hits")) {
 }
 
 PipelineCache::~PipelineCache() = default;
@@ -139,8 +141,10 @@ vk::Pipeline PipelineCache::Lookup(Profiler::Activity& activity, LinkedRenderTar
         pipeline_state_hash.depthstencil[1] |= static_cast<uint32_t>(stencil.op_pass_both()()) << 8;
     }
 
+    lookup_counter.Add();
     auto existing_pipeline = cache.find(pipeline_state_hash);
     if (existing_pipeline != cache.end()) {
+        hit_counter.Add();
         return *existing_pipeline->second;
     }
 
@@ -5,6 +5,8 @@
 
 namespace Profiler {
 class Activity;
+class Counter;
+class Profiler;
 }
 
 namespace Pica {
@@ -53,8 +55,11 @@ class PipelineCache {
 
     std::unordered_map<PipelineStateHash, vk::UniquePipeline, PipelineStateHashHasher> cache;
 
+    Profiler::Counter& lookup_counter;
+    Profiler::Counter& hit_counter;
+
 public:
-    PipelineCache(vk::Device device);
+    PipelineCache(vk::Device device, Profiler::Profiler&);
     ~PipelineCache();
 
     vk::Pipeline Lookup(Profiler::Activity&, LinkedRenderTargetResource&, vk::PipelineLayout, vk::ShaderModule vertex_shader,
@@ -90,7 +90,8 @@ constexpr uint32_t vs_uniform_data_size = sizeof(Context::shader_uniforms.f) + s
 constexpr uint32_t total_uniform_data_size = vs_uniform_data_size + fs_uniform_data_size;
 
 Renderer::Renderer(Memory::PhysicalMemory& mem, std::shared_ptr<spdlog::logger> logger, Profiler::Profiler& profiler, vk::PhysicalDevice physical_device, vk::Device device, uint32_t graphics_queue_family_index, vk::Queue graphics_queue)
-        : logger(logger), profiler(profiler), activity(reinterpret_cast<Profiler::TaggedActivity<Profiler::Activities::GPU>&>(profiler.GetActivity("GPU"))), device(device),
+        : logger(logger), profiler(profiler), activity(reinterpret_cast<Profiler::TaggedActivity<Profiler::Activities::GPU>&>(profiler.GetActivity("GPU"))),
+          texture_upload_bytes(profiler.GetCounter("gpu.texture_upload_bytes")), device(device),
           graphics_queue_index(graphics_queue_family_index),
           graphics_queue(graphics_queue),
           memory_types(*logger, physical_device) {
@@ -100,7 +101,7 @@ Renderer::Renderer(Memory::PhysicalMemory& mem, std::shared_ptr<spdlog::logger>
 
     resource_manager = std::make_unique<ResourceManager>(mem, device, graphics_queue, *command_pool, memory_types);
 
-    pipeline_cache = std::make_unique<PipelineCache>(device);
+    pipeline_cache = std::make_unique<PipelineCache>(device, profiler);
 
     {
         constexpr uint32_t num_tex_stages = 3;
@@ -873,6 +874,9 @@ void Renderer::FinalizeTriangleBatchInternal(Context& context, const VertexShade
 
         texcache_entries.emplace_back(&texture_resource);
 
+        if (texture_resource.state == Resource::State::Invalidated) {
+            texture_upload_bytes.Add(texture_resource.range.num_bytes);
+        }
         resource_manager->RefreshTextureMemory(*command_buffer, texture_resource, *context.mem, texture);
     }
     TracyCZoneEnd(TexCache);
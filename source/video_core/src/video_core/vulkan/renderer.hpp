@@ -25,6 +25,7 @@ namespace Profiler {
 namespace Activities {
 struct GPU;
 }
+class Counter;
 class Profiler;
 template<typename> struct TaggedActivity;
 }
@@ -73,6 +74,7 @@ private:
     std::shared_ptr<spdlog::logger> logger;
     Profiler::Profiler& profiler;
     Profiler::TaggedActivity<Profiler::Activities::GPU>& activity;
+    Profiler::Counter& texture_upload_bytes;
 
     vk::Device device;
     uint32_t graphics_queue_index;
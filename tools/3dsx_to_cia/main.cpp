@@ -1,3 +1,4 @@
+#include <framework/bounded_queue.hpp>
 #include <framework/formats.hpp>
 #include <framework/meta_tools.hpp>
 #include <platform/file_formats/3dsx.hpp>
@@ -21,11 +22,15 @@
 #include <boost/program_options.hpp>
 
 #include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <future>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
 #include <fstream>
 #include <sstream>
+#include <thread>
 
 // Helper used solely for implementing a custom boost::program_options validator that can read hex numbers
 struct HexUint64 {
@@ -72,6 +77,71 @@ static void ZeroUpToNextMediaUnitFrom(std::ostream& file, StreamPos base) {
     ZeroUpTo(file, base + diff);
 }
 
+// Large data (RomFS images, CIA contents) is streamed through buffers of this size rather than being loaded into memory entirely
+static constexpr size_t stream_chunk_size = 1024 * 1024;
+
+/**
+ * Reads the given number of bytes from the input stream, writing them to the
+ * output stream and updating the given hash (if either are non-null).
+ *
+ * Reading is done on a separate thread so that it overlaps with writing and
+ * hashing. Only a fixed number of chunks is kept in memory at any time.
+ */
+static void StreamData(std::istream& input, uint64_t size, std::ostream* output, CryptoPP::SHA256* hash) {
+    struct Chunk {
+        std::vector<char> data;
+        size_t size = 0;
+    };
+
+    constexpr size_t chunks_in_flight = 4;
+    Mikage::BoundedQueue<Chunk> free_chunks(chunks_in_flight);
+    Mikage::BoundedQueue<Chunk> read_chunks(chunks_in_flight);
+    for (size_t i = 0; i < chunks_in_flight; ++i) {
+        free_chunks.Push(Chunk { std::vector<char>(stream_chunk_size) });
+    }
+
+    std::exception_ptr read_error;
+    std::thread reader([&]() {
+        try {
+            for (uint64_t remaining = size; remaining != 0;) {
+                auto chunk = free_chunks.Pop();
+                if (!chunk) {
+                    break;
+                }
+                chunk->size = static_cast<size_t>(std::min<uint64_t>(remaining, chunk->data.size()));
+                input.read(chunk->data.data(), chunk->size);
+                remaining -= chunk->size;
+                read_chunks.Push(std::move(*chunk));
+            }
+        } catch (...) {
+            read_error = std::current_exception();
+        }
+        read_chunks.Close();
+    });
+
+    try {
+        while (auto chunk = read_chunks.Pop()) {
+            if (output) {
+                output->write(chunk->data.data(), chunk->size);
+            }
+            if (hash) {
+                hash->Update(reinterpret_cast<const CryptoPP::byte*>(chunk->data.data()), chunk->size);
+            }
+            free_chunks.Push(std::move(*chunk));
+        }
+    } catch (...) {
+        // Unblock the reader thread
+        free_chunks.Close();
+        reader.join();
+        throw;
+    }
+
+    reader.join();
+    if (read_error) {
+        std::rethrow_exception(read_error);
+    }
+}
+
 template<typename T, typename SubType, typename Stream>
 T ParseSignedData(Stream& stream) {
     auto sig = FileFormat::Signature { FileFormat::Load<boost::endian::big_uint32_t>(stream) };
@@ -168,13 +238,26 @@ struct CIA {
 
         struct RomFS {
             std::vector<uint8_t> data;
+
+            // If non-empty, RomFS data is streamed from this file instead of being held in memory
+            std::string source_filename;
+            uint64_t source_offset = 0;
+            uint64_t source_size = 0;
+
+            uint64_t GetSize() const {
+                return source_filename.empty() ? data.size() : source_size;
+            }
         } romfs;
     } ncch;
 
     FileFormat::CIAMeta meta;
 };
 
-CIA::NCCH ParseNCCH(std::ifstream& file) {
+/**
+ * @param filename Path to the file that is being parsed. Used to refer to the
+ *                 RomFS without loading it into memory
+ */
+CIA::NCCH ParseNCCH(std::ifstream& file, const std::string& filename) {
     CIA::NCCH ret;
 
     // TODO: Narrowing cast!
@@ -502,17 +585,14 @@ CIA::NCCH ParseNCCH(std::ifstream& file) {
 #endif
     }
 
-    auto romfs_begin = ncch_begin + (unsigned long long){ncch.romfs_offset.ToBytes()};
-    file.seekg(romfs_begin);
-
-    auto& romfs_data = ret.romfs.data;
-    romfs_data.resize(ncch.romfs_size.ToBytes());
-    file.read(reinterpret_cast<char*>(romfs_data.data()), romfs_data.size());
+    ret.romfs.source_filename = filename;
+    ret.romfs.source_offset = ncch_begin + (unsigned long long){ncch.romfs_offset.ToBytes()};
+    ret.romfs.source_size = ncch.romfs_size.ToBytes();
 
     return ret;
 }
 
-CIA ParseCIA(std::ifstream& file) {
+CIA ParseCIA(std::ifstream& file, const std::string& filename) {
     CIA ret;
 
     auto cia_begin = file.tellg();
@@ -777,12 +857,12 @@ std::cout << "Yo: " << pubkey.GetModulus() << std::endl;
         std::cout << "Content size: 0x" << std::hex << content_info.size << std::endl;
 
         file.seekg(content_begin);
-        std::vector<char> content_data(content_info.size);
-        file.read(content_data.data(), content_data.size());
 
         // Get content hash
+        CryptoPP::SHA256 running_hash;
         CryptoPP::byte content_hash[CryptoPP::SHA256::DIGESTSIZE];
-        CryptoPP::SHA256().CalculateDigest(content_hash, reinterpret_cast<const CryptoPP::byte*>(content_data.data()), content_data.size());
+        StreamData(file, content_info.size, nullptr, &running_hash);
+        running_hash.Final(content_hash);
 
         std::cout << "Reference hash: ";
         for (auto c : content_info.sha256)
@@ -799,7 +879,7 @@ std::cout << "Yo: " << pubkey.GetModulus() << std::endl;
     std::cout << std::endl << "Content: " << std::endl;
     strbuf_it = std::istreambuf_iterator<char>(file.rdbuf());
     stream = FileFormat::MakeStreamInFromContainer(strbuf_it, decltype(strbuf_it){});
-    ret.ncch = ParseNCCH(file);
+    ret.ncch = ParseNCCH(file, filename);
 
     file.seekg(meta_begin);
     strbuf_it = std::istreambuf_iterator<char>(file.rdbuf());
@@ -842,6 +922,11 @@ static void WriteExeFS(CIA::NCCH::ExeFS& exefs, std::ostream& stream) {
 
     ZeroUpTo(stream, header_end);
 
+#ifdef UPDATE_FIELDS
+    // Section hashes are computed concurrently to writing the sections
+    std::vector<std::future<void>> section_hash_tasks;
+#endif
+
     for (size_t section_index = 0; section_index < exefs.header.files.size(); ++section_index) {
         auto& exefs_section = exefs.header.files[section_index];
         auto& section_data = exefs.sections[section_index].data;
@@ -859,15 +944,23 @@ static void WriteExeFS(CIA::NCCH::ExeFS& exefs, std::ostream& stream) {
         assert(section_offset >= stream.tellp());
         ZeroUpTo(stream, section_offset);
 
-        stream.write(reinterpret_cast<const char*>(section_data.data()), section_data.size());
-
 #ifdef UPDATE_FIELDS
         // Update section hash
         auto& section_hash = *(exefs.header.hashes.rbegin() + section_index);
-        CryptoPP::SHA256().CalculateDigest(reinterpret_cast<CryptoPP::byte*>(section_hash.data()),
-                                           reinterpret_cast<const CryptoPP::byte*>(section_data.data()), section_data.size());
+        section_hash_tasks.push_back(std::async(std::launch::async, [&section_hash, &section_data]() {
+            CryptoPP::SHA256().CalculateDigest(reinterpret_cast<CryptoPP::byte*>(section_hash.data()),
+                                               reinterpret_cast<const CryptoPP::byte*>(section_data.data()), section_data.size());
+        }));
 #endif
+
+        stream.write(reinterpret_cast<const char*>(section_data.data()), section_data.size());
+    }
+
+#ifdef UPDATE_FIELDS
+    for (auto& task : section_hash_tasks) {
+        task.get();
     }
+#endif
 
     auto exefs_end = stream.tellp();
 
@@ -878,7 +971,30 @@ static void WriteExeFS(CIA::NCCH::ExeFS& exefs, std::ostream& stream) {
 }
 
 static void WriteRomFS(const CIA::NCCH::RomFS& romfs, std::ostream& ostream) {
-    ostream.write(reinterpret_cast<const char*>(romfs.data.data()), romfs.data.size());
+    if (romfs.source_filename.empty()) {
+        ostream.write(reinterpret_cast<const char*>(romfs.data.data()), romfs.data.size());
+        return;
+    }
+
+    std::ifstream file(romfs.source_filename, std::ios_base::binary);
+    file.exceptions(std::ifstream::badbit | std::ifstream::failbit | std::ifstream::eofbit);
+    file.seekg(romfs.source_offset);
+    StreamData(file, romfs.source_size, &ostream, nullptr);
+}
+
+// Returns the first num_bytes bytes of the RomFS, zero-padded if the RomFS is smaller than that
+static std::vector<uint8_t> ReadRomFSHead(const CIA::NCCH::RomFS& romfs, size_t num_bytes) {
+    std::vector<uint8_t> ret(num_bytes, 0);
+    auto size = static_cast<size_t>(std::min<uint64_t>(num_bytes, romfs.GetSize()));
+    if (romfs.source_filename.empty()) {
+        std::copy_n(romfs.data.begin(), size, ret.begin());
+    } else {
+        std::ifstream file(romfs.source_filename, std::ios_base::binary);
+        file.exceptions(std::ifstream::badbit | std::ifstream::failbit | std::ifstream::eofbit);
+        file.seekg(romfs.source_offset);
+        file.read(reinterpret_cast<char*>(ret.data()), size);
+    }
+    return ret;
 }
 
 void WriteNCCH(CIA::NCCH& ncch, std::ostream& file, WriteNCCHFlags flags) {
@@ -957,9 +1073,9 @@ void WriteNCCH(CIA::NCCH& ncch, std::ostream& file, WriteNCCHFlags flags) {
     header.exefs_size = FileFormat::MediaUnit32::FromBytes(ncch.exefs.header.GetExeFSSize());
 
     // RomFS
-    auto& romfs_data = ncch.romfs.data;
-    header.romfs_size = FileFormat::MediaUnit32::FromBytes(RoundToNextMediaUnit(romfs_data.size()));
-    if (romfs_data.size()) {
+    auto romfs_size = ncch.romfs.GetSize();
+    header.romfs_size = FileFormat::MediaUnit32::FromBytes(RoundToNextMediaUnit(romfs_size));
+    if (romfs_size) {
 #ifdef UPDATE_FIELDS
         // TODO: Remove the extra padding; seemed necessary to get the output matching to the reference CIA, but shouldn't be necessary!
         header.romfs_offset = FileFormat::MediaUnit32::FromBytes(0x400 + RoundToNextMediaUnit(NarrowCastStreamPos(file.tellp()) - ncch_begin));
@@ -968,18 +1084,15 @@ void WriteNCCH(CIA::NCCH& ncch, std::ostream& file, WriteNCCHFlags flags) {
         auto romfs_begin = ncch_begin + NarrowCastStreamPos(ncch.header.romfs_offset.ToBytes());
         ZeroUpTo(file, romfs_begin);
 
-        auto romfs_blob = Meta::invoke([&] {
-            std::ostringstream stream;
-            WriteRomFS(ncch.romfs, stream);
-            return stream.str();
-        });
-        file.write(reinterpret_cast<const char*>(romfs_data.data()), romfs_data.size());
+        // Stream RomFS directly to the output since it may be arbitrarily large
+        WriteRomFS(ncch.romfs, file);
 
 #ifdef UPDATE_FIELDS
         // Update header hash
         CryptoPP::byte romfs_hash[CryptoPP::SHA256::DIGESTSIZE];
         ncch.header.romfs_hash_message_size = FileFormat::MediaUnit32::FromBytes(0x200);
-        CryptoPP::SHA256().CalculateDigest(romfs_hash, reinterpret_cast<const CryptoPP::byte*>(romfs_blob.data()), ncch.header.romfs_hash_message_size.ToBytes());
+        auto romfs_head = ReadRomFSHead(ncch.romfs, ncch.header.romfs_hash_message_size.ToBytes());
+        CryptoPP::SHA256().CalculateDigest(romfs_hash, romfs_head.data(), romfs_head.size());
         memcpy(ncch.header.romfs_sha256.data(), romfs_hash, sizeof(romfs_hash));
 #endif
     }
@@ -1018,7 +1131,11 @@ void WriteNCCH(CIA::NCCH& ncch, std::ostream& file, WriteNCCHFlags flags) {
     file.seekp(ncch_end);
 }
 
-void WriteCIA(CIA& cia, std::ofstream& file, WriteNCCHFlags flags) {
+/**
+ * @param file Output stream. Must be readable, since the content hash is
+ *             computed by reading the content back after writing it.
+ */
+void WriteCIA(CIA& cia, std::fstream& file, WriteNCCHFlags flags) {
     auto cia_begin = NarrowCastStreamPos(file.tellp());
 
     auto content_mask_begin = cia_begin + cia.content_mask.size();
@@ -1050,28 +1167,54 @@ void WriteCIA(CIA& cia, std::ofstream& file, WriteNCCHFlags flags) {
     SaveSignedData(cia.ticket.sig, cia.ticket.data, file);
     cia.header.ticket_size = NarrowCastStreamPos(file.tellp()) - ticket_begin;
 
-    // Serialize content in memory so that we can compute its hash (to be stored in the TMD)
-    auto serialized_content = Meta::invoke([&] {
-        std::ostringstream stream;
-        WriteNCCH(cia.ncch, stream, flags);
-        return stream.str();
-    });
-
     auto tmd_begin = ticket_begin + (unsigned long long){(cia.header.ticket_size + 63) & ~UINT32_C(63)};
     ZeroUpTo(file, tmd_begin);
     assert(cia.tmd.content_infos.size() == 1); // TODO: Support more than one content
 #ifdef UPDATE_FIELDS
     cia.tmd.data.content_count = cia.tmd.content_infos.size();
-    cia.tmd.content_infos[0].size = cia.ncch.header.content_size.ToBytes();
 #endif
 #ifdef PATCH_TITLEID
     cia.tmd.data.title_id = alt_titleid;
 #endif
 
+    // The TMD size doesn't depend on the hashes stored in it, so the content
+    // can be written to its final location before the TMD. This avoids
+    // serializing the content in memory to compute its hash
+    auto tmd_size = Meta::invoke([&] {
+        std::ostringstream stream;
+        SaveSignedData(cia.tmd.sig, cia.tmd.data, stream);
+        for (auto& metacontentinfo : cia.tmd.content_info_hashes) {
+            FileFormat::Save(metacontentinfo, stream);
+        }
+        for (auto& content_info : cia.tmd.content_infos) {
+            FileFormat::Save(content_info, stream);
+        }
+        return NarrowCastStreamPos(stream.tellp());
+    });
+
+    // TODO: Support multiple contents
+    auto content_begin = tmd_begin + (unsigned long long){(tmd_size + 63) & ~UINT64_C(63)};
+    file.seekp(content_begin);
+    WriteNCCH(cia.ncch, file, flags);
+    auto content_end = NarrowCastStreamPos(file.tellp());
+
+    // Read back the content to compute its hash
+    CryptoPP::byte content_hash[CryptoPP::SHA256::DIGESTSIZE];
+    {
+        CryptoPP::SHA256 running_hash;
+        file.flush();
+        file.seekg(content_begin);
+        StreamData(file, content_end - content_begin, nullptr, &running_hash);
+        running_hash.Final(content_hash);
+    }
+
     // Iterate over all TMD content infos, and set one bit in the CIA content mask for each set content
     cia.header.content_size = 0;
     for (size_t content = 0; content < cia.tmd.data.content_count; ++content) {
         auto&& content_info = cia.tmd.content_infos[content];
+#ifdef UPDATE_FIELDS
+        content_info.size = content_end - content_begin;
+#endif
         auto index = content_info.index;
         cia.header.content_size += content_info.size;
         assert(index / 8 < cia.content_mask.size());
@@ -1082,11 +1225,8 @@ void WriteCIA(CIA& cia, std::ofstream& file, WriteNCCHFlags flags) {
     std::string serialized_content_infos = Meta::invoke([&] {
         std::ostringstream stream;
         for (auto& content_info : cia.tmd.content_infos) {
-#ifdef UPDATE_FIELDS
-            content_info.size = serialized_content.size();
-#endif
-            assert(content_info.size == serialized_content.size());
-            CryptoPP::SHA256().CalculateDigest(content_info.sha256.data(), reinterpret_cast<const CryptoPP::byte*>(serialized_content.data()), serialized_content.size());
+            assert(content_info.size == content_end - content_begin);
+            memcpy(content_info.sha256.data(), content_hash, sizeof(content_hash));
             FileFormat::Save(content_info, stream);
         }
         return stream.str();
@@ -1116,19 +1256,18 @@ void WriteCIA(CIA& cia, std::ofstream& file, WriteNCCHFlags flags) {
     CryptoPP::SHA256().CalculateDigest(cia.tmd.data.content_info_records_sha256.data(),
                                        reinterpret_cast<const CryptoPP::byte*>(serialized_metacontentinfos.data()), serialized_metacontentinfos.size());
 
-    // Write final data to file
+    // Write final TMD data to file, filling the gap left before the content
+    file.seekp(tmd_begin);
     SaveSignedData(cia.tmd.sig, cia.tmd.data, file);
     file.write(serialized_metacontentinfos.data(), serialized_metacontentinfos.size());
     file.write(serialized_content_infos.data(), serialized_content_infos.size());
     cia.header.tmd_size = NarrowCastStreamPos(file.tellp()) - tmd_begin;
-
-    // TODO: Support multiple contents
-    // TODO: Assert for just a single content being here
-    auto content_begin = tmd_begin + (unsigned long long){(cia.header.tmd_size + 63) & ~UINT32_C(63)};
+    assert(cia.header.tmd_size == tmd_size);
     ZeroUpTo(file, content_begin);
-    file.write(serialized_content.data(), serialized_content.size());
+
+    file.seekp(content_end);
 #ifdef UPDATE_FIELDS
-    cia.header.content_size = NarrowCastStreamPos(file.tellp()) - content_begin;
+    cia.header.content_size = content_end - content_begin;
 #endif
 
     auto meta_begin = content_begin + (unsigned long long){(cia.header.content_size + 63) & ~UINT32_C(63)};
@@ -1153,14 +1292,14 @@ CIA InjectCIA(const std::string& in_filename, const std::string& injected_filena
     auto cia = Meta::invoke([&]() {
                                 std::ifstream file(in_filename, std::ios_base::binary);
                                 file.exceptions(std::ifstream::badbit | std::ifstream::failbit | std::ifstream::eofbit);
-                                return ParseCIA(file);
+                                return ParseCIA(file, in_filename);
                             });
 return cia;
     std::cout << std::endl << std::endl << "Reading NCCH \"" << injected_filename << "\" to inject now... " << std::endl;
     const auto ncch_to_inject = Meta::invoke([&]() {
                                                 std::ifstream file(injected_filename, std::ios_base::binary);
                                                 file.exceptions(std::ifstream::badbit | std::ifstream::failbit | std::ifstream::eofbit);
-                                                return ParseNCCH(file);
+                                                return ParseNCCH(file, injected_filename);
                                             });
 
     cia.ncch = ncch_to_inject;
@@ -1445,6 +1584,7 @@ void validate(boost::any& v,
 int main(int argc, char* argv[]) {
     std::string in_filename;
     std::string in_3dsx_filename;
+    std::string romfs_filename;
 
     // Use a set of default dependencies when the caller does not specify any
     std::vector<HexUint64> exheader_dependencies = {
@@ -1469,6 +1609,7 @@ int main(int argc, char* argv[]) {
             ("help,h", "Print this help")
             ("template-cia", bpo::value<std::string>(&in_filename), "Path to CIA file to use to get certificate signatures")
             ("input,i", bpo::value<std::string>(&in_3dsx_filename)->required(), "Path to input 3DSX file")
+            ("romfs", bpo::value<std::string>(&romfs_filename), "Path to RomFS image (including its IVFC hash tree) to embed")
             ("title-id", bpo::value<HexUint64>(&alt_titleid)->required(), "Title ID to use for the output file")
             ("dep", bpo::value<std::vector<HexUint64>>(&exheader_dependencies)->composing(), "Add ExHeader dependency")
             ("gen-ncch", bpo::bool_switch(&generate_ncch)->default_value(false), "Generate NCCH")
@@ -1591,6 +1732,12 @@ int main(int argc, char* argv[]) {
             Generate3DSX(ifile, ncch);
         }
 
+        if (!romfs_filename.empty()) {
+            // Only record the location of the RomFS; it's streamed to the output when writing
+            ncch.romfs.source_filename = romfs_filename;
+            ncch.romfs.source_size = std::filesystem::file_size(romfs_filename);
+        }
+
         ncch.header = FileFormat::NCCHHeader{};
         ncch.header.magic = std::array<uint8_t, 4>{{'N', 'C', 'C', 'H'}};
         // content_size filled in by WriteNCCH
@@ -1600,7 +1747,10 @@ int main(int argc, char* argv[]) {
         ncch.header.platform = 1; // Old3DS
         ncch.header.type_mask = 0; // 3 ???
         ncch.header.unit_size_log2 = 0;
-        ncch.header.flags = 0x1 | 0x2 | 0x4; // don't mount RomFS; don't encrypt contents
+        ncch.header.flags = 0x1 | 0x4; // don't encrypt contents
+        if (romfs_filename.empty()) {
+            ncch.header.flags |= 0x2; // don't mount RomFS
+        }
         ncch.header.exefs_hash_message_size = FileFormat::MediaUnit32{1};
         ncch.header.romfs_hash_message_size = FileFormat::MediaUnit32{1};
 
@@ -1616,7 +1766,7 @@ int main(int argc, char* argv[]) {
     if (generate_cia) {
         std::ifstream file(in_filename, std::ios_base::binary);
         file.exceptions(std::ifstream::badbit | std::ifstream::failbit | std::ifstream::eofbit);
-        auto cia = ParseCIA(file); // TODO: Remove
+        auto cia = ParseCIA(file, in_filename); // TODO: Remove
 
         // Move out the certificate information, since common 3DS firmware patches
         // apparently don't patch out the certificate signature checks
@@ -1700,15 +1850,17 @@ int main(int argc, char* argv[]) {
         cia.header.header_size = FileFormat::CIAHeader::Tags::expected_serialized_size;
         // Rest of the header is filled in WriteCIA
 
-        std::ofstream ofile(std::string(in_3dsx_filename) + ".cia", std::ios_base::binary);
-        ofile.exceptions(std::ofstream::badbit | std::ofstream::failbit | std::ofstream::eofbit);
+        {
+            std::fstream ofile(std::string(in_3dsx_filename) + ".cia", std::ios_base::in | std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+            ofile.exceptions(std::ofstream::badbit | std::ofstream::failbit | std::ofstream::eofbit);
 
-        WriteCIA(cia, ofile, static_cast<WriteNCCHFlags>(0));
+            WriteCIA(cia, ofile, static_cast<WriteNCCHFlags>(0));
+        }
 
         {
             std::ifstream ifile(in_3dsx_filename + std::string(".cia"), std::ios_base::binary);
             ifile.exceptions(std::ofstream::badbit | std::ofstream::failbit | std::ofstream::eofbit);
-            (void)ParseCIA(ifile);
+            (void)ParseCIA(ifile, in_3dsx_filename + std::string(".cia"));
         }
     }
 }
@@ -26,9 +26,14 @@
 
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <iterator>
 #include <iomanip>
+#include <mutex>
+#include <set>
+#include <thread>
 
 template<typename IntType>
 static IntType RoundToNextMediaUnit(IntType value) {
@@ -87,7 +92,8 @@ struct CIA {
     FileFormat::Ticket ticket;
     FileFormat::TMD tmd;
 
-    std::vector<uint8_t> ncch;
+    // Absolute offsets of each TMD content within the CIA file
+    std::vector<uint64_t> content_offsets;
 
     FileFormat::CIAMeta meta;
 };
@@ -268,11 +274,9 @@ CIA ParseCIA(std::ifstream& file) {
         content_info_hash_info = FileFormat::Load<FileFormat::TMD::ContentInfoHash>(content_info_hash_info_stream);
 
     // Read raw content infos into memory for hashing first
-    // TODO: Support more than one content!
     // TODO: Clean this up.. we are just copying data from one memory buffer into another here,
     //       when instead we could just store a pointer to the current data stream offset...
     tmd.content_infos.resize(tmd.data.content_count);
-    assert(tmd.content_infos.size() == 1);
     auto content_info_data = Meta::invoke([&] {
         std::vector<uint8_t> data(FileFormat::TMD::ContentInfo::Tags::expected_serialized_size * tmd.content_infos.size());
         stream2.Read(reinterpret_cast<char*>(data.data()), data.size());
@@ -315,9 +319,10 @@ CIA ParseCIA(std::ifstream& file) {
         std::cout << std::endl;
     }
     std::cout << std::endl;
+    // Contents are stored back-to-back. They are hashed and written later
+    // (see InstallContent), so just record their offsets here
+    auto content_offset = content_begin;
     for (auto& content_info : tmd.content_infos) {
-        assert(tmd.content_infos.size() == 1);
-
         if (content_info.type & 1) {
             throw std::runtime_error("Encrypted CIA contents are unsupported");
         }
@@ -326,31 +331,10 @@ CIA ParseCIA(std::ifstream& file) {
         std::cout << "Content id: " << std::dec << content_info.id << std::endl;
         std::cout << "Content size: 0x" << std::hex << content_info.size << std::endl;
 
-        file.seekg(content_begin);
-        std::vector<char> content_data(content_info.size);
-        file.read(content_data.data(), content_data.size());
-
-        // Get content hash
-        CryptoPP::byte content_hash[CryptoPP::SHA256::DIGESTSIZE];
-        CryptoPP::SHA256().CalculateDigest(content_hash, reinterpret_cast<const CryptoPP::byte*>(content_data.data()), content_data.size());
-
-        std::cout << "Reference hash: ";
-        for (auto c : content_info.sha256)
-            std::cout << std::setw(2) << std::setfill('0') << std::hex << +c;
-        std::cout << std::endl;
-
-        std::cout << "Computed hash:  ";
-        for (auto c : content_hash)
-            std::cout << std::setw(2) << std::setfill('0') << std::hex << +c;
-        std::cout << std::endl;
+        ret.content_offsets.push_back(content_offset);
+        content_offset += content_info.size;
     }
 
-    file.seekg(content_begin);
-    std::cout << std::endl << "Content: " << std::endl;
-    strbuf_it = std::istreambuf_iterator<char>(file.rdbuf());
-    ret.ncch.resize(cia.content_size);
-    file.read(reinterpret_cast<char*>(ret.ncch.data()), ret.ncch.size());
-
     file.seekg(meta_begin);
     strbuf_it = std::istreambuf_iterator<char>(file.rdbuf());
     stream = FileFormat::MakeStreamInFromContainer(strbuf_it, decltype(strbuf_it){});
@@ -367,10 +351,91 @@ CIA ParseCIA(std::ifstream& file) {
     return ret;
 }
 
+// Contents are streamed through buffers of this size rather than being loaded into memory entirely
+static constexpr size_t content_chunk_size = 1024 * 1024;
+
+struct ContentJob {
+    std::string cia_filename;
+
+    // Absolute offset of the content within the CIA file
+    uint64_t offset;
+
+    FileFormat::TMD::ContentInfo content_info;
+
+    // Empty if the content should only be verified
+    boost::filesystem::path output_path;
+};
+
+struct ContentResult {
+    std::array<CryptoPP::byte, CryptoPP::SHA256::DIGESTSIZE> hash;
+    bool hash_matches;
+};
+
+/**
+ * Streams the given content from its CIA file, hashing it incrementally and
+ * writing it to the job's output path unless only verifying.
+ *
+ * Output is written to a temporary file first, which is only moved into
+ * place if the content hash matches the TMD.
+ *
+ * Each invocation opens its own file handles, so multiple contents can be
+ * processed concurrently.
+ */
+static ContentResult InstallContent(const ContentJob& job) {
+    std::ifstream file;
+    file.exceptions(std::ifstream::badbit | std::ifstream::failbit | std::ifstream::eofbit);
+    file.open(job.cia_filename, std::ios_base::binary);
+    file.seekg(job.offset);
+
+    auto temp_filename = job.output_path;
+    temp_filename += ".part";
+    std::ofstream ofile;
+    ofile.exceptions(std::ifstream::badbit | std::ifstream::failbit | std::ifstream::eofbit);
+    if (!job.output_path.empty()) {
+        ofile.open(temp_filename, std::ios_base::binary);
+    }
+
+    ContentResult result;
+    try {
+        CryptoPP::SHA256 hash;
+        std::vector<char> buffer(content_chunk_size);
+        for (uint64_t remaining = job.content_info.size; remaining != 0;) {
+            auto chunk_size = static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size()));
+            file.read(buffer.data(), chunk_size);
+            hash.Update(reinterpret_cast<const CryptoPP::byte*>(buffer.data()), chunk_size);
+            if (ofile.is_open()) {
+                ofile.write(buffer.data(), chunk_size);
+            }
+            remaining -= chunk_size;
+        }
+        hash.Final(result.hash.data());
+        result.hash_matches = ranges::equal(job.content_info.sha256, result.hash);
+    } catch (...) {
+        if (ofile.is_open()) {
+            ofile.close();
+            boost::filesystem::remove(temp_filename);
+        }
+        throw;
+    }
+
+    if (ofile.is_open()) {
+        ofile.close();
+        if (result.hash_matches) {
+            boost::filesystem::rename(temp_filename, job.output_path);
+        } else {
+            boost::filesystem::remove(temp_filename);
+        }
+    }
+
+    return result;
+}
+
 int main(int argc, char* argv[]) {
-    std::string in_filename;
+    std::vector<std::string> in_filenames;
     std::string target_path;
     bool force_overwrite;
+    bool verify_only;
+    unsigned num_threads;
 
     {
         namespace bpo = boost::program_options;
@@ -378,9 +443,11 @@ int main(int argc, char* argv[]) {
         bpo::options_description desc;
         desc.add_options()
             ("help,h", "Print this help")
-            ("input,i", bpo::value<std::string>(&in_filename)->required(), "Path to input CIA file")
-            ("base,b", bpo::value<std::string>(&target_path)->required(), "Path to target NAND tree")
-            ("force,f", bpo::bool_switch(&force_overwrite)->default_value(false), "Force overwrite if any output path already exists");
+            ("input,i", bpo::value<std::vector<std::string>>(&in_filenames)->required(), "Path to input CIA files")
+            ("base,b", bpo::value<std::string>(&target_path), "Path to target NAND tree")
+            ("force,f", bpo::bool_switch(&force_overwrite)->default_value(false), "Force overwrite if any output path already exists")
+            ("verify-only", bpo::bool_switch(&verify_only)->default_value(false), "Only verify content hashes without writing anything")
+            ("jobs,j", bpo::value<unsigned>(&num_threads)->default_value(std::max(std::thread::hardware_concurrency(), 1u)), "Number of contents to process in parallel");
 
         try {
             auto positional_arguments = bpo::positional_options_description{}.add("input", -1);
@@ -396,46 +463,117 @@ int main(int argc, char* argv[]) {
             std::cout << desc << std::endl;
             return 1;
         }
+
+        if (!verify_only && target_path.empty()) {
+            std::cout << "No target base directory given" << std::endl << desc << std::endl;
+            return 1;
+        }
     }
 
-    if (!boost::filesystem::exists(target_path)) {
+    if (!verify_only && !boost::filesystem::exists(target_path)) {
         std::cout << "Target base directory does not exist!" << std::endl;
         return 1;
     }
 
-    std::cout << "Attempting to open \"" << in_filename << "\" for reading" << std::endl;
-    std::ifstream file;
-    file.exceptions(std::ifstream::badbit | std::ifstream::failbit | std::ifstream::eofbit);
-    file.open(in_filename, std::ios_base::binary);
+    // Parse all CIAs upfront. This only reads metadata, so it's cheap
+    std::vector<ContentJob> jobs;
+    for (auto& in_filename : in_filenames) {
+        std::cout << "Attempting to open \"" << in_filename << "\" for reading" << std::endl;
+        std::ifstream file;
+        file.exceptions(std::ifstream::badbit | std::ifstream::failbit | std::ifstream::eofbit);
+        file.open(in_filename, std::ios_base::binary);
+
+        auto cia = ParseCIA(file);
+        auto&& tmd = cia.tmd;
+
+        // Check the content list before writing anything. Contents are
+        // installed by id, with the main content at id 0, so ids must be
+        // unique and no other content may use id 0.
+        if (tmd.data.main_content >= tmd.content_infos.size()) {
+            std::cout << fmt::format("Main content index {} out of range", tmd.data.main_content) << std::endl;
+            return 1;
+        }
+        std::set<uint32_t> content_ids;
+        for (size_t content_index = 0; content_index < tmd.content_infos.size(); ++content_index) {
+            auto content_id = tmd.content_infos[content_index].id;
+            if (content_index != tmd.data.main_content && content_id == 0) {
+                std::cout << "Content id 0 expected to be the main content" << std::endl;
+                return 1;
+            }
+            if (!content_ids.insert(content_id).second) {
+                std::cout << fmt::format("Duplicate content id {:#x}", content_id) << std::endl;
+                return 1;
+            }
+        }
 
-    auto cia = ParseCIA(file);
-    auto&& tmd = cia.tmd;
+        for (size_t content_index = 0; content_index < tmd.content_infos.size(); ++content_index) {
+            auto& content_info = tmd.content_infos[content_index];
+            ContentJob job { in_filename, cia.content_offsets[content_index], content_info, {} };
+
+            if (!verify_only) {
+                // Titles are booted from content 0, so install the main content there
+                // TODO: Read the main content id from the TMD when launching titles instead
+                uint32_t content_id = (content_index == tmd.data.main_content) ? 0 : content_info.id;
+
+                // TODO: Change extension to ".app" once we support this!
+                job.output_path = fmt::format("{}/{:08x}/{:08x}/content/{:08x}.cxi", target_path, tmd.data.title_id >> 32, tmd.data.title_id & 0xffffffff, content_id);
+
+                std::cout << "Attempting to create " << job.output_path << "" << std::endl;
+                if (!force_overwrite && boost::filesystem::exists(job.output_path)) {
+                    std::cout << "File already exists!" << std::endl;
+                    return 1;
+                }
+
+                try {
+                    (void)boost::filesystem::create_directories(job.output_path.parent_path());
+                } catch (boost::filesystem::filesystem_error& err) {
+                    std::cout << "Couldn't create directory structure: " << err.what() << std::endl;
+                    return 1;
+                }
+            }
 
-    uint32_t content_id = 0; // TODO: Should read this from the tmd instead
+            jobs.push_back(std::move(job));
+        }
+    }
 
-    // TODO: Change extension to ".app" once we support this!
-    boost::filesystem::path content_filename = fmt::format("{}/{:08x}/{:08x}/content/{:08x}.cxi", target_path, tmd.data.title_id >> 32, tmd.data.title_id & 0xffffffff, content_id);
+    // Contents are independent of each other, so hash and write them in parallel
+    std::atomic<size_t> next_job = 0;
+    std::atomic<size_t> num_failed = 0;
+    std::mutex output_mutex;
+    auto worker = [&]() {
+        for (size_t job_index; (job_index = next_job++) < jobs.size();) {
+            auto& job = jobs[job_index];
+            std::string status;
+            try {
+                auto result = InstallContent(job);
+                status = fmt::format("{:02x} ({})", fmt::join(result.hash, ""), result.hash_matches ? "OK" : "hash mismatch");
+                num_failed += !result.hash_matches;
+            } catch (std::exception& err) {
+                status = fmt::format("error: {}", err.what());
+                ++num_failed;
+            }
 
-    std::cout << "Attempting to create " << content_filename << "" << std::endl;
-    if (!force_overwrite && boost::filesystem::exists(content_filename)) {
-        std::cout << "File already exists!" << std::endl;
-        return 1;
+            std::lock_guard guard(output_mutex);
+            std::cout << fmt::format("{}: content {:08x}: {}", job.cia_filename, job.content_info.id, status) << std::endl;
+        }
+    };
+
+    {
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < std::max(num_threads, 1u); ++i) {
+            threads.emplace_back(worker);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
     }
 
-    try {
-        (void)boost::filesystem::create_directories(content_filename.parent_path());
-    } catch (boost::filesystem::filesystem_error& err) {
-        std::cout << "Couldn't create directory structure: " << err.what() << std::endl;
+    if (num_failed) {
+        std::cout << std::dec << num_failed << " of " << jobs.size() << " contents failed" << std::endl;
         return 1;
     }
 
-    std::ofstream ofile;
-    ofile.exceptions(std::ifstream::badbit | std::ifstream::failbit | std::ifstream::eofbit);
-    ofile.open(content_filename, std::ios_base::binary);
-    ofile.write(reinterpret_cast<char*>(cia.ncch.data()), cia.ncch.size());
-    ofile.close();
-
     // TODO: Also copy over tmd once we support that
     // TODO: Also generate cmd once we support that
-    std::cout << "Success!" << std::endl;
+    std::cout << (verify_only ? "All contents verified!" : "Success!") << std::endl;
 }